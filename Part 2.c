@@ -22,262 +22,195 @@
 **********************************************************************************************************************/
 //defines
 
-#define HWREG(x) (*((volatile unsigned int *) (x)))
+#include "hwreg.h"
+#include "am335x.h"
+#include "pca9685.h"
+#include "pca9685_cache.h"
+#include "servo.h"
+#include "trajectory.h"
+#include "i2c.h"
+#include "i2c_async.h"
+#include "intc.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "gpio.h"
+#include "boot.h"
 
-//BBB addresses and offsets for setting up I2C
+//GPIO1 pins and Timer2 values
 
-#define CNTRL_MODULE 0x44E10000         //control module for the pin muxing
-#define I2C2_BASE_ADDRESS 0x4819C000    //module I2C2 from L4_PER Memory Map
-#define CM_PER_ADDRESS 0x44E00000       //module to turn on the clock
+#define LEDS_MASK ( GPIO_USR0 | GPIO_USR1 | GPIO_USR2 )	//LED0 to LED2 on pins 21 to 23, outputs once ENABLE_GPIO1 has run
 
-#define I2C2_OFFSET 0x44                //offset to turn on the module
-#define SDA 0x978                       //offset for the data line
-#define SCL 0x97C                       //offset for the clock line
 
-#define PSC 0xB0                        //prescaler to scale the clock from 48MHz to 12MHz
-
-#define SCLL 0xB4                       //clock line low time
-#define SCLH 0xB8                       //clock line high time
-
-#define CON 0xA4                        //configuration register
-#define SYSS 0x90                       //system status register
-
-#define SA 0xAC                         //slave address register
-
-#define CNT 0x98                        //data counter register
+void INITIALIZE_CON ( ); 				//will be used for init the configuration register values
+void DELAY_COUNTER ( ); 				//used in init of the PCA
 
-#define IRQSTATUS_RAW 0x24              //status raw register
+void ENABLE_GPIO1 ( ); 					//set up the LED pins of GPIO1
 
-#define DATA 0x9C                       //data access register
+void ON_LED0 ( ); 						//used to turn on LED0 at pin 21
 
+void ON_LED1 ( ); 						//used to turn on LED1 at pin 22
 
-#define Busy_Bit 1 << 12
-#define Start_And_Stop_Bits 0x3
-//BBB addresses and offsets for using GPIO1 Pins and Timer2
+void ON_LED2 ( ); 						//used to turn on LED2 at pin 23
 
-#define GPIO1_BASE_ADDRESS 0x4804C000   //module GPIO1 from L4_PER Memory Map
-#define CM_PER_GPIO1_CLKCTRL 0xAC 		//turn on clock for GPIO1 for using LED0, LED1, LED2
-#define SETDATAOUT 0x194 				//used to light up the LEDS
-#define OUTPUT_ENABLE 0x134 			//enable the LEDs through RMW by using this offset
-#define CLEARDATAOUT 0x190 				//used to turn off the LEDs
+void DELAY_1_SECOND ( ); 				//post the sequence again after 1 second
+void DELAY_2_SECONDS ( ); 				//post the sequence again after 2 seconds
 
-#define LED0_SET_and_CLEAR 0x00200000 	//used to set and clear the LED0 (write a 1 to pin 21)
-#define LED0_RMW_MASK 0xFFDFFFFF 		//used to RMW the output enable to enable the LED0 (write a 0 to pin 21)
+void SERVO_SEQUENCE ( void *context ); 	//the steps below, one per run of the task
 
-#define LED1_SET_and_CLEAR 0x00400000 	//used for set and clear the LED1 (write a 1 to pin 22)
-#define LED1_RMW_MASK 0xFFBFFFFF 		//used to RMW the output enable to enable LED1 (write a 0 to pin 22)
+PCA9685_CACHE PCA;						//mirror of the PCA9685 registers, only changes go on the bus
+SERVO_MAP SERVOS;						//angle to OFF count of every channel
+TRAJECTORY MOTION;						//smooth moves between the positions, one frame per PWM period
 
-#define LED2_SET_and_CLEAR 0x00800000 	//used for set and clear the LED2 (write a 1 to pin 23)
-#define LED2_RMW_MASK 0xFF7FFFFF 		//used to RMW the otput enable to enable LED2 (write a 0 to pin 23)
+SCHEDULER SCHEDULER_MAIN;				//runs the sequence and the trajectory tasks
+SCHED_TASK SEQUENCE;					//the init, move, delay, LED steps, state is the next step
+SCHED_TASK I2C2_RECOVERY;				//frees I2C2 after a NACK, outside the interrupt handler
+TIMER DELAY;							//the delay between two steps
+unsigned int ROUNDS;					//times the sequence has run
+#define CENTER SERVO_COUNT ( ( SERVO_MIN_US + SERVO_MAX_US ) / 2, PCA9685_PRESCALE_50HZ )
+const unsigned short FIRST_FRAME [ PCA9685_CHANNELS ] = {	//every channel at 0 degrees, sent with the configuration
+	CENTER, CENTER, CENTER, CENTER, CENTER, CENTER, CENTER, CENTER,
+	CENTER, CENTER, CENTER, CENTER, CENTER, CENTER, CENTER, CENTER
+};
+GPIO_GROUP LEDS;						//the user LEDs, set and cleared without reading GPIO1
 
-#define TIMER2_BASE_ADDRESS 0x48040000	//module for Timer2 from L4_PER Memory Map
-#define CM_PER_TIMER2_CLKCTRL 0x80 		//turn on clock for Timer2 in order to set the Timer2 to 1s or 2s
-#define PRCMCLKSEL_TIMER2 0x508 		//set clock frequency multiplexer for 32.760 KHz
-#define IRQSTATUS_RAW_TIMER2 0x24 		//going to check the IRQSTATIS_RAW for timer2 (to make sure overflow happened)
-#define TCLR 0x38						//timer control register (value will be set to a 1 to begin counting)
-#define TCRR 0x3C 						//timer counter (will have 1s or 2s value after TLDR)
+#define SERVO_CHANNEL 8					//the servo is on LED8
 
-#define ONE_SECOND  0x7FFF8000			//value of 1 second that will be put in TLDR and TCRR
-#define TWO_SECONDS 0xFFFF0000			//value of 2 seconds that will be put in TLDR and TCRR
+//steps of the sequence
 
+#define STEP_INIT 0
+#define STEP_AT_0 1
+#define STEP_LED0 2
+#define STEP_AT_90 3
+#define STEP_LED1 4
+#define STEP_AT_MINUS_90 5
+#define STEP_LED2 6
 
-//PCA9685 addresses
+int main ( void )
+{
 
-#define MODE1 0x00                      //address to enable bits for SLEEP, ALLCALL, RESTART, etc
-#define PRE_SCALE_SERVO 0xFE            //prescale address for servo
-#define MODE2 0x01                      //address to enable totem pole structure and non-inverted
+    //turn on the I2C2, GPIO1 and Timer2 clocks together, enable the SCL and SDA lines for I2C2 while they start,
+    //then reset and configure I2C2 once it is functional, 12 MHz internal clock and 400 kbs on the bus
+    BOOT_INIT ( &I2C2_BUS );
 
-#define LED8_ON_H 0x27 					//address for LED8 on high
-#define LED8_ON_L 0x26 					//address for LED8 on low
+    //the servo frequency, every channel at 0 degrees and the wake up in three or four transactions while GPIO1 and
+    //Timer2 come up; the first pulse comes as soon as the oscillator is up, the first round then finds nothing to send
+    PCA9685_CACHE_INIT ( &PCA, &I2C2_BUS, &I2C2_QUEUE, PCA9685_ADDRESS );
+    BOOT_PCA9685 ( &PCA, PCA9685_PRESCALE_50HZ, FIRST_FRAME );
 
-#define LED8_OFF_H 0x29 				//address for LED8 off high
-#define LED8_OFF_L 0x28					//address for LED8 off low
+    //GPIO1 and Timer2 came up meanwhile
+    BOOT_FINISH ( );
 
-void INITIALIZE_CON ( ); 				//will be used for init the configuration register values
-void DELAY_COUNTER ( ); 				//used in init of the PCA
+    //the LED pins of GPIO1 become outputs
+    ENABLE_GPIO1 ( );
 
-void ENABLE_GPIO1 ( ); 					//turn on GPIO1 to enable it
-void ENABLE_TIMER2 ( ); 				//turn on Timer2 to enable it
+    //servo moves are queued and sent by the I2C2 interrupt while the LEDs and timer are handled
+    INTC_INIT ( );
+    I2C_QUEUE_INIT ( &I2C2_QUEUE );
 
-void ON_LED0 ( ); 						//used to turn on LED0 at pin 21
+    //Timer2 runs free from here on, the delays below sleep until its match interrupt
+    TIMER_SERVICE_START ( &TIMER2_SERVICE );
 
-void ON_LED1 ( ); 						//used to turn on LED1 at pin 22
+    //every queued transaction gets a deadline, a hung I2C2 fails it instead of stopping the queue
+    I2C2_QUEUE.timers = &TIMER2_SERVICE;
 
-void ON_LED2 ( ); 						//used to turn on LED2 at pin 23
+    //a PCA9685 that stops answering is reset through the general call and gets its registers back from the mirror
+    PCA9685_CACHE_ATTACH_RECOVERY ( &PCA );
 
-void DELAY_1_SECOND ( ); 				//turn on timer2 for 1 second
-void DELAY_2_SECONDS ( ); 				//turn on timer2 for 2 seconds
+    //1 ms at -90 degrees to 2 ms at +90 degrees on every channel, for the 50 Hz period
+    //every frame stages all 16 channels, only the bytes that differ from the last frame are sent
+    SERVO_INIT ( &SERVOS, PCA9685_PRESCALE_50HZ );
 
-int main ( void )
-{
+    //the servo is ramped to each position at 300 degrees per second instead of jumping there
+    TRAJECTORY_INIT ( &MOTION, &PCA, &SERVOS, PCA9685_PRESCALE_50HZ );
 
-    //enable the SCL and SDA lines for using I2C2 using the control module's base address
-    //and do pin muxing on pins 19 and 20 to enable those lines (mode 3).
-    //the hex value represents the fast slew, receiver enabled, pullup disable, and 3 in lowest
-    //bits for the module
-    HWREG ( CNTRL_MODULE + SCL ) = 0x0000002B;
-    HWREG ( CNTRL_MODULE + SDA ) = 0x0000002B;
+    //frames go out on every PWM period from Timer2, the steps below run as one task between them
+    SCHED_INIT ( &SCHEDULER_MAIN );
+    SCHED_TASK_INIT ( &SEQUENCE, &SCHEDULER_MAIN, SERVO_SEQUENCE, 0 );
+    SCHED_TASK_INIT ( &I2C2_RECOVERY, &SCHEDULER_MAIN, I2C_QUEUE_RECOVER_TASK, &I2C2_QUEUE );
+    I2C2_QUEUE.recover = SCHED_WAKE;
+    I2C2_QUEUE.recover_context = &I2C2_RECOVERY;
+    TRAJECTORY_STREAM ( &MOTION, &SCHEDULER_MAIN, &TIMER2_SERVICE );
+    SCHED_POST ( &SEQUENCE );
 
-    //turn on the clock to enable I2C2
-    HWREG (CM_PER_ADDRESS + I2C2_OFFSET ) = 0x02;
+    //the CPU sleeps whenever no task has work, until the sequence has run 5 times
+    SCHED_RUN ( &SCHEDULER_MAIN );
 
-    //turn on the clock to enable GPIO1
-    ENABLE_GPIO1 ( );
+    I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
 
-    // Step 1 to 12 Mhz
-    //program the prescaler to scale down the clock from 48MHz to 12 MhZ
-    HWREG ( I2C2_BASE_ADDRESS + PSC ) = 0x3;
 
-    // Step 2, for 400 kbs
-    //program the I2C clock
-    HWREG ( I2C2_BASE_ADDRESS + SCLL ) = 0x8;
-    HWREG ( I2C2_BASE_ADDRESS + SCLH ) = 0xA;
 
- 	//poll for transferring and transmitting data
-	unsigned int PCA_ADDRESSES_AND_OFFSETS [] = { MODE1, 0x11, PRE_SCALE_SERVO, 0x79, MODE1, 0x81, MODE2, 0x04 };
-    //instructions to turn the servo 0 degrees
-    unsigned int PCA_0_DEGREES [ ] = { LED8_ON_H, 0x00, LED8_ON_L, 0x00,  LED8_OFF_H , 0x1, LED8_OFF_L, 0x32 };
+    return 0;
+}
 
-    //instructions to turn the servo 90 degrees
-    unsigned int PCA_90_DEGREES [ ] = { LED8_ON_H , 0x00, LED8_ON_L , 0x00, LED8_OFF_H , 0x1, LED8_OFF_L , 0x99 };
+//one step of the servo sequence per run; a step starts a move or a delay that posts the task again when it is done
+void SERVO_SEQUENCE ( void *context ){
 
-    //instructions to turn the servo -90 degrees
-    unsigned int PCA_NEGATIVE_90_DEGREES [ ] = { LED8_ON_H , 0x00, LED8_ON_L , 0x00, LED8_OFF_H , 0x00, LED8_OFF_L , 0xCC }; 
+	int mode, prescale;
 
-    //repeat the below sequence of steps 5 times
-    for (int i = 0; i < 5; i++){
+	( void ) context;
 
+	switch ( SEQUENCE.state ) {
 
   	/****************************
     **INITIALIZE THE PCA DEVICE *
     *****************************
     */ 
 
-	for (unsigned int j = 0; j < sizeof (PCA_ADDRESSES_AND_OFFSETS )/ sizeof (unsigned int); j+=2 ){
-
-
-
-		//software reset of BBB
-		HWREG ( I2C2_BASE_ADDRESS + 0x10 ) = 0x00000002;
-
-		//buffer of clear fifo and set threshold bit 
-		HWREG ( I2C2_BASE_ADDRESS + 0x94) = 0x41;
+	case STEP_INIT:
 
-		HWREG ( I2C2_BASE_ADDRESS + CON ) = 0x00008600;
+	//the LEDs of the last round go off, one CLEARDATAOUT write
+	GPIO_GROUP_CLEAR ( &LEDS, LEDS_MASK );
 
-		while( HWREG (I2C2_BASE_ADDRESS + SYSS ) != 1 );  // wait until the system status register's reset is  done
-		
-		//configure the I2C_SA and I2C_CNT registers 
-		//I will use the slave address 1000 000 or 0x40 because
-		//A5-A0 are grounded in the schematic and the MSB is a always a 1
-		HWREG ( I2C2_BASE_ADDRESS + SA ) = 0x40; 
-		//set the counter to transfer the desired number of bytes
-		HWREG ( I2C2_BASE_ADDRESS + CNT ) = 0x2;
-
-		//begin the transfer by polling the BB bit 12 from IRQSTATUS_RAW register
-		//if the bit is not 0, then wait
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 12 ) != 0x0 );
-
-		//set the start and stop bits in the configuration register to 1
-		HWREG ( I2C2_BASE_ADDRESS + CON ) |= Start_And_Stop_Bits;
-
-		for( int delay = 0; delay < 5000; delay++ ){
-			asm ("NOP");
+	//after the first round MODE1, MODE2 and PRE_SCALE are read back instead of being written again blindly; a
+	//device that lost them (reset, brown out) also lost its channels, so those are read back too and the next
+	//frame puts them right. A read that failed says nothing about the device, the whole mirror goes and is sent again
+	if ( ROUNDS > 0 ) {
+		mode = PCA9685_CACHE_VERIFY ( &PCA, MODE1, 2 );
+		prescale = PCA9685_CACHE_VERIFY ( &PCA, PRE_SCALE_SERVO, 1 );
+		if ( mode < 0 || prescale < 0 ) {
+			PCA9685_CACHE_INVALIDATE ( &PCA );
 		}
-
-		for (unsigned int i = 0; i < 2; i++ ){
-			//wait until bit 4 (XRDY) is 1
-			while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 4 ) == 0 );
-			//transmit the commands
-			HWREG ( I2C2_BASE_ADDRESS + DATA ) = PCA_ADDRESSES_AND_OFFSETS[j+i];
-
-			for( int delay = 0; delay < 5000; delay++ )
-			{
-				asm ("NOP");
-			}
-
-			// Clears the XRDY
-			HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) |= 1<<4;
-			
+		else if ( mode != 0 || prescale != 0 ) {
+			PCA9685_CACHE_VERIFY ( &PCA, LED0_ON_L, 4 * PCA9685_CHANNELS );
 		}
-
-		//check if the busy free bit has been set
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 8 ) !=  1 << 8 );
 	}
 
+	//servo frequency (SLEEP, PRE_SCALE 0x79, wake with RESTART), then auto-increment and ALLCALL in MODE1 and
+	//the totem pole outputs in MODE2; only what the device does not already hold is sent
+	PCA9685_CACHE_SET_PRESCALE ( &PCA, PCA9685_PRESCALE_50HZ );
+	PCA9685_CACHE_WRITE ( &PCA, MODE1, MODE1_AI | MODE1_ALLCALL );
+	PCA9685_CACHE_WRITE ( &PCA, MODE2, 0x04 );
+	PCA9685_CACHE_FLUSH ( &PCA );
+
 
     /*****************************
     ** TURN SERVO 0 DEGREES      *
     ******************************
     */
 
-	for (unsigned int j = 0; j < sizeof ( PCA_0_DEGREES )/ sizeof (unsigned int); j+=2 ){
-
-		//software reset of BBB
-		HWREG ( I2C2_BASE_ADDRESS + 0x10 ) = 0x00000002;
-
-		//buffer of clear fifo and set threshold bit 
-		HWREG ( I2C2_BASE_ADDRESS + 0x94) = 0x41;
-
-		HWREG ( I2C2_BASE_ADDRESS + CON ) = 0x00008600;
-
-		while( HWREG (I2C2_BASE_ADDRESS + SYSS ) != 1 );  // wait until the system status register's reset is  done
-		
-		//configure the I2C_SA and I2C_CNT registers 
-		//I will use the slave address 1000 000 or 0x40 because
-		//A5-A0 are grounded in the schematic and the MSB is a always a 1
-		HWREG ( I2C2_BASE_ADDRESS + SA ) = 0x40; 
-		//set the counter to transfer the desired number of bytes
-		HWREG ( I2C2_BASE_ADDRESS + CNT ) = 0x2;
-
-		//begin the transfer by polling the BB bit 12 from IRQSTATUS_RAW register
-		//if the bit is not 0, then wait
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 12 ) != 0x0 );
-
-		//set the start and stop bits in the configuration register to 1
-		HWREG ( I2C2_BASE_ADDRESS + CON ) |= Start_And_Stop_Bits;
-
-
-		for( int delay = 0; delay < 5000; delay++ ){
-			asm ("NOP");
-		}
-
-		for (unsigned int i = 0; i < 2; i++ ){
-			//wait until bit 4 (XRDY) is 1
-			while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 4 ) == 0 );
-			//transmit the commands
-			HWREG ( I2C2_BASE_ADDRESS + DATA ) = PCA_0_DEGREES[j+i];
-
-			for( int delay = 0; delay < 5000; delay++ )
-			{
-				asm ("NOP");
-			}
-
-			// Clears the XRDY
-			HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) |= 1<<4;
-			
-		}
-
-		//check if the busy free bit has been set
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 8 ) !=  1 << 8 );
-
-		
-
-    
-	}
+	TRAJECTORY_WAYPOINT ( &MOTION, SERVO_CHANNEL, SERVO_ANGLE ( 0 ) );
+	TRAJECTORY_NOTIFY ( &MOTION, &SEQUENCE );
+	SEQUENCE.state = STEP_AT_0;
+	break;
 
 	/****************************
 	** Delay for 2 seconds      *
 	*****************************
 	*/
 
+	case STEP_AT_0:
+
 	DELAY_2_SECONDS ( );
+	SEQUENCE.state = STEP_LED0;
+	break;
 
 	/****************************
     ** TURN on LED0             *
     *****************************
     */
 
+	case STEP_LED0:
+
     ON_LED0 ( );
 
 
@@ -286,70 +219,29 @@ int main ( void )
     *****************************
     */
 
-    for (unsigned int j = 0; j < sizeof ( PCA_90_DEGREES )/ sizeof (unsigned int); j+=2 ){
-
-		//software reset of BBB
-		HWREG ( I2C2_BASE_ADDRESS + 0x10 ) = 0x00000002;
-
-		//buffer of clear fifo and set threshold bit 
-		HWREG ( I2C2_BASE_ADDRESS + 0x94) = 0x41;
-
-		HWREG ( I2C2_BASE_ADDRESS + CON ) = 0x00008600;
-
-		while( HWREG (I2C2_BASE_ADDRESS + SYSS ) != 1 );  // wait until the system status register's reset is  done
-		
-		//configure the I2C_SA and I2C_CNT registers 
-		//I will use the slave address 1000 000 or 0x40 because
-		//A5-A0 are grounded in the schematic and the MSB is a always a 1
-		HWREG ( I2C2_BASE_ADDRESS + SA ) = 0x40; 
-		//set the counter to transfer the desired number of bytes
-		HWREG ( I2C2_BASE_ADDRESS + CNT ) = 0x2;
-
-		//begin the transfer by polling the BB bit 12 from IRQSTATUS_RAW register
-		//if the bit is not 0, then wait
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 12 ) != 0x0 );
-
-		//set the start and stop bits in the configuration register to 1
-		HWREG ( I2C2_BASE_ADDRESS + CON ) |= Start_And_Stop_Bits;
-
-
-		for( int delay = 0; delay < 5000; delay++ ){
-			asm ("NOP");
-		}
-
-		for (unsigned int i = 0; i < 2; i++ ){
-			//wait until bit 4 (XRDY) is 1
-			while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 4 ) == 0 );
-			//transmit the commands
-			HWREG ( I2C2_BASE_ADDRESS + DATA ) = PCA_90_DEGREES[j+i];
-
-			for( int delay = 0; delay < 5000; delay++ )
-			{
-				asm ("NOP");
-			}
-
-			// Clears the XRDY
-			HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) |= 1<<4;
-			
-		}
-
-		//check if the busy free bit has been set
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 8 ) !=  1 << 8 );
-
-	}
+	TRAJECTORY_WAYPOINT ( &MOTION, SERVO_CHANNEL, SERVO_ANGLE ( 90 ) );
+	TRAJECTORY_NOTIFY ( &MOTION, &SEQUENCE );
+	SEQUENCE.state = STEP_AT_90;
+	break;
  
 	/****************************
 	** Delay for 1 second       *
 	*****************************
 	*/
 
+	case STEP_AT_90:
+
     DELAY_1_SECOND ( );
+	SEQUENCE.state = STEP_LED1;
+	break;
 
 	/****************************
     ** TURN on LED1             *
     *****************************
     */
 
+	case STEP_LED1:
+
     ON_LED1 ( );
 
 
@@ -358,64 +250,21 @@ int main ( void )
     ******************************
     */
 
-	for (unsigned int j = 0; j < sizeof ( PCA_NEGATIVE_90_DEGREES )/ sizeof (unsigned int); j+=2 ){
-
-		//software reset of BBB
-		HWREG ( I2C2_BASE_ADDRESS + 0x10 ) = 0x00000002;
-
-		//buffer of clear fifo and set threshold bit 
-		HWREG ( I2C2_BASE_ADDRESS + 0x94) = 0x41;
-
-		HWREG ( I2C2_BASE_ADDRESS + CON ) = 0x00008600;
-
-		while( HWREG (I2C2_BASE_ADDRESS + SYSS ) != 1 );  // wait until the system status register's reset is  done
-		
-		//configure the I2C_SA and I2C_CNT registers 
-		//I will use the slave address 1000 000 or 0x40 because
-		//A5-A0 are grounded in the schematic and the MSB is a always a 1
-		HWREG ( I2C2_BASE_ADDRESS + SA ) = 0x40; 
-		//set the counter to transfer the desired number of bytes
-		HWREG ( I2C2_BASE_ADDRESS + CNT ) = 0x2;
-
-		//begin the transfer by polling the BB bit 12 from IRQSTATUS_RAW register
-		//if the bit is not 0, then wait
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 12 ) != 0x0 );
-
-		//set the start and stop bits in the configuration register to 1
-		HWREG ( I2C2_BASE_ADDRESS + CON ) |= Start_And_Stop_Bits;
-
-
-		for( int delay = 0; delay < 5000; delay++ ){
-			asm ("NOP");
-		}
-
-		for (unsigned int i = 0; i < 2; i++ ){
-			//wait until bit 4 (XRDY) is 1
-			while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 4 ) == 0 );
-			//transmit the commands
-			HWREG ( I2C2_BASE_ADDRESS + DATA ) = PCA_NEGATIVE_90_DEGREES[j+i];
-
-			for( int delay = 0; delay < 5000; delay++ )
-			{
-				asm ("NOP");
-			}
-
-			// Clears the XRDY
-			HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) |= 1<<4;
-			
-		}
-
-		//check if the busy free bit has been set
-		while ( ( HWREG ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW ) & 1 << 8 ) !=  1 << 8 );
-
-	}
+	TRAJECTORY_WAYPOINT ( &MOTION, SERVO_CHANNEL, SERVO_ANGLE ( -90 ) );
+	TRAJECTORY_NOTIFY ( &MOTION, &SEQUENCE );
+	SEQUENCE.state = STEP_AT_MINUS_90;
+	break;
 
 	/****************************
 	** Delay for 2 seconds      *
 	*****************************
 	*/
 
-    DELAY_2_SECONDS ( );    
+	case STEP_AT_MINUS_90:
+
+    DELAY_2_SECONDS ( );
+	SEQUENCE.state = STEP_LED2;
+	break;
 
  
 	/****************************
@@ -423,74 +272,58 @@ int main ( void )
     *****************************
     */
 
+	case STEP_LED2:
+
     ON_LED2 ( );
 
+	//repeat the sequence 5 times, then stop the frames and leave the loop
+	if ( ++ROUNDS < 5 ) {
+		SEQUENCE.state = STEP_INIT;
+		SCHED_POST ( &SEQUENCE );
+	}
+	else {
+		TRAJECTORY_STREAM_STOP ( &MOTION );
+		SCHED_STOP ( &SCHEDULER_MAIN );
+	}
+	break;
     }
-
-
-
-    return 0;
 }
 
 
-//enable Timer2
-void ENABLE_TIMER2 ( ){
-
-	HWREG ( CM_PER_ADDRESS + CM_PER_TIMER2_CLKCTRL ) = 0x02; //turn on clock for Timer2
-	HWREG ( CM_PER_ADDRESS + PRCMCLKSEL_TIMER2 ) = 0x2; 	 //select the 32 KHz clock
-}
-
-//turn on timer2 for 1 second
+//start a 1 second delay, the sequence runs again when the Timer2 interrupt posts it
 void DELAY_1_SECOND ( ){
-	//enable the timer2
-	ENABLE_TIMER2 ( );
-
-	HWREG ( TIMER2_BASE_ADDRESS + 0x10 ) = 0x1; 			//reset timer2
-	HWREG ( TIMER2_BASE_ADDRESS + TCRR ) = ONE_SECOND; 		//put the value in the timer counter
-	HWREG ( TIMER2_BASE_ADDRESS + TCLR ) = 0x1; 			//write a 1 to the timer control register at bit 0 to start the timer
-
 
+	TIMER_START ( &TIMER2_SERVICE, &DELAY, TIMER_MS ( 1000 ), 0, SCHED_WAKE, &SEQUENCE );
 }
 
-//turn on timer2 for 2 seconds
+//start a 2 second delay
 void DELAY_2_SECONDS ( ){
 
-	//enable the timer2
-	ENABLE_TIMER2 ( );
-
-	HWREG ( TIMER2_BASE_ADDRESS + 0x10 ) = 0x1; 		//reset timer2
-	HWREG ( TIMER2_BASE_ADDRESS + TCRR ) = TWO_SECONDS; //put the value in the timer counter
-	HWREG ( TIMER2_BASE_ADDRESS + TCLR ) = 0x1; 		//write a 1 to the timer control register at bit 0 to start the timer
-
+	TIMER_START ( &TIMER2_SERVICE, &DELAY, TIMER_MS ( 2000 ), 0, SCHED_WAKE, &SEQUENCE );
 }
 
-//enable GPIO1
+//GPIO1 is clocked from BOOT_INIT, make the LED pins outputs once instead of on every ON_LEDn
 void ENABLE_GPIO1 ( ){
 
-	HWREG ( CM_PER_ADDRESS + CM_PER_GPIO1_CLKCTRL ) = 0x02; 
+	GPIO_GROUP_INIT ( &LEDS, GPIO1_BASE_ADDRESS, LEDS_MASK );
 }
 
 
 //turn on LED0
 void ON_LED0 ( ){
 
-	HWREG ( GPIO1_BASE_ADDRESS + SETDATAOUT ) = LED0_SET_and_CLEAR; //write a 1 to set data out for LED0
-	HWREG ( GPIO1_BASE_ADDRESS + OUTPUT_ENABLE ) &= LED0_RMW_MASK;	//to turn on do a RMW for LED0
+	GPIO_GROUP_SET ( &LEDS, GPIO_USR0 ); 	//one SETDATAOUT write for LED0
 }
 
 //turn on LED1
 void ON_LED1 ( ){
 
-	HWREG ( GPIO1_BASE_ADDRESS + SETDATAOUT ) = LED1_SET_and_CLEAR; //write a 1 to set data out for LED1
-	HWREG ( GPIO1_BASE_ADDRESS + OUTPUT_ENABLE ) &= LED1_RMW_MASK; 	//to turn on do a RMW for LED1
+	GPIO_GROUP_SET ( &LEDS, GPIO_USR1 ); 	//one SETDATAOUT write for LED1
 }
 
 
 //turn on LED2
 void ON_LED2 ( ){
 
-	HWREG ( GPIO1_BASE_ADDRESS + SETDATAOUT ) = LED2_SET_and_CLEAR; //write a 1 to set data out for LED2
-	HWREG ( GPIO1_BASE_ADDRESS + OUTPUT_ENABLE ) &= LED2_RMW_MASK; 	//to turn on do a RMW for LED2
+	GPIO_GROUP_SET ( &LEDS, GPIO_USR2 ); 	//one SETDATAOUT write for LED2
 }
-
-
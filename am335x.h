@@ -0,0 +1,210 @@
+/**********************************************************************************************************************
+*   AM335x addresses and offsets                                                                                      *
+*                                                                                                                     *
+*   Base addresses and register offsets for the modules used by the Beaglebone Black programs: the control module     *
+*   for pin muxing, CM_PER for the module clocks, I2C2, GPIO1, Timer2, the interrupt controller and EDMA3. The        *
+*   offsets and bits follow the AM335x Sitara Technical Reference Manual.                                             *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef AM335X_H
+#define AM335X_H
+
+//BBB addresses and offsets for setting up I2C
+
+#define CNTRL_MODULE 0x44E10000         //control module for the pin muxing
+#define I2C2_BASE_ADDRESS 0x4819C000    //module I2C2 from L4_PER Memory Map
+#define CM_PER_ADDRESS 0x44E00000       //module to turn on the clock
+
+#define I2C2_OFFSET 0x44                //offset to turn on the module
+#define SDA 0x978                       //offset for the data line
+#define SCL 0x97C                       //offset for the clock line
+
+#define I2C0_BASE_ADDRESS 0x44E0B000    //module I2C0 from L4_WKUP Memory Map
+#define I2C1_BASE_ADDRESS 0x4802A000    //module I2C1 from L4_PER Memory Map
+#define CM_WKUP_I2C0_CLKCTRL 0x4B8      //offset from CM_PER_ADDRESS, I2C0 clock is in CM_WKUP
+#define CM_PER_I2C1_CLKCTRL 0x48        //offset to turn on I2C1
+#define I2C0_SDA 0x988                  //i2c0_sda pad, mode 0
+#define I2C0_SCL 0x98C                  //i2c0_scl pad, mode 0
+#define I2C1_SDA 0x958                  //spi0_d1 pad (P9_18), mode 2
+#define I2C1_SCL 0x95C                  //spi0_cs0 pad (P9_17), mode 2
+
+#define SYSC 0x10                       //system configuration register (soft reset)
+#define IRQSTATUS_RAW 0x24              //status raw register
+#define IRQSTATUS 0x28                  //status register, write a 1 to clear an event
+#define IRQENABLE_SET 0x2C              //enable interrupt events
+#define IRQENABLE_CLR 0x30              //disable interrupt events
+#define DMATXENABLE_SET 0x38            //enable the transmit DMA request line
+#define DMATXENABLE_CLR 0x40            //disable the transmit DMA request line
+#define SYSS 0x90                       //system status register
+#define BUF 0x94                        //buffer configuration register (FIFO thresholds and clears)
+#define CNT 0x98                        //data counter register
+#define DATA 0x9C                       //data access register
+#define CON 0xA4                        //configuration register
+#define OA 0xA8                         //own address register
+#define SA 0xAC                         //slave address register
+#define PSC 0xB0                        //prescaler to scale the clock from 48MHz to 12MHz
+#define SCLL 0xB4                       //clock line low time
+#define SCLH 0xB8                       //clock line high time
+#define SYSTEST 0xBC                    //system test register
+#define BUFSTAT 0xC0                    //buffer status register (FIFO depth and levels)
+
+//IRQSTATUS_RAW / IRQSTATUS bits
+
+#define I2C_IRQ_AL ( 1 << 0 )           //arbitration lost
+#define I2C_IRQ_NACK ( 1 << 1 )         //no acknowledgment from the slave
+#define I2C_IRQ_ARDY ( 1 << 2 )         //registers ready to be accessed again
+#define I2C_IRQ_RRDY ( 1 << 3 )         //receive data ready
+#define I2C_IRQ_XRDY ( 1 << 4 )         //transmit data ready
+#define I2C_IRQ_BF ( 1 << 8 )           //bus free
+#define I2C_IRQ_XUDF ( 1 << 10 )        //transmit underflow
+#define I2C_IRQ_ROVR ( 1 << 11 )        //receive overrun
+#define I2C_IRQ_BB ( 1 << 12 )          //bus busy
+#define I2C_IRQ_RDR ( 1 << 13 )         //receive draining
+#define I2C_IRQ_XDR ( 1 << 14 )         //transmit draining
+
+#define Busy_Bit 1 << 12
+#define Start_And_Stop_Bits 0x3
+
+//I2C_CON bits
+
+#define I2C_CON_STT ( 1 << 0 )          //start condition
+#define I2C_CON_STP ( 1 << 1 )          //stop condition
+#define I2C_CON_TRX ( 1 << 9 )          //transmitter mode
+#define I2C_CON_MST ( 1 << 10 )         //master mode
+#define I2C_CON_EN ( 1 << 15 )          //module enable
+
+//I2C_SYSTEST bits, in SCL/SDA IO mode the CPU drives the lines itself (bus clear)
+
+#define I2C_SYSTEST_ST_EN ( 1 << 15 )   //test mode enable
+#define I2C_SYSTEST_TMODE_MASK ( 3 << 12 )
+#define I2C_SYSTEST_TMODE_IO ( 3 << 12 )   //SCL_O / SDA_O drive the lines, SCL_I / SDA_I read them
+#define I2C_SYSTEST_SCL_I_FUNC ( 1 << 8 )  //SCL line level in functional mode
+#define I2C_SYSTEST_SDA_I_FUNC ( 1 << 6 )  //SDA line level in functional mode
+#define I2C_SYSTEST_SCL_I ( 1 << 3 )
+#define I2C_SYSTEST_SCL_O ( 1 << 2 )
+#define I2C_SYSTEST_SDA_I ( 1 << 1 )
+#define I2C_SYSTEST_SDA_O ( 1 << 0 )
+
+//I2C_SYSC, I2C_SYSS and I2C_BUF bits
+
+#define I2C_SYSC_SRST ( 1 << 1 )        //software reset
+#define I2C_SYSS_RDONE ( 1 << 0 )       //reset done
+#define I2C_BUF_TXTRSH_MASK 0x3F        //transmit threshold minus one
+#define I2C_BUF_TXFIFO_CLR ( 1 << 6 )   //clear the transmit FIFO
+#define I2C_BUF_XDMA_EN ( 1 << 7 )      //transmit DMA request instead of XRDY
+#define I2C_BUF_RXTRSH_SHIFT 8
+#define I2C_BUF_RXTRSH_MASK ( 0x3F << 8 )  //receive threshold minus one
+#define I2C_BUF_RXFIFO_CLR ( 1 << 14 )  //clear the receive FIFO
+#define I2C_BUFSTAT_TXSTAT_MASK 0x3F    //bytes still to be written for the transfer (used with XDR)
+#define I2C_BUFSTAT_RXSTAT_SHIFT 8
+#define I2C_BUFSTAT_RXSTAT_MASK ( 0x3F << 8 )  //bytes waiting in the receive FIFO (used with RDR)
+#define I2C_FIFO_DEPTH 32               //bytes in each of the transmit and receive FIFOs
+
+//BBB addresses and offsets for using GPIO1 Pins and Timer2
+
+#define GPIO1_BASE_ADDRESS 0x4804C000   //module GPIO1 from L4_PER Memory Map
+#define CM_PER_GPIO1_CLKCTRL 0xAC       //turn on clock for GPIO1 for using LED0, LED1, LED2
+#define SETDATAOUT 0x194                //used to light up the LEDS
+#define OUTPUT_ENABLE 0x134             //enable the LEDs through RMW by using this offset
+#define CLEARDATAOUT 0x190              //used to turn off the LEDs
+#define DATAOUT 0x13C                   //output level of every pin, SETDATAOUT and CLEARDATAOUT change it bit by bit
+
+#define TIMER2_BASE_ADDRESS 0x48040000  //module for Timer2 from L4_PER Memory Map
+#define CM_PER_TIMER2_CLKCTRL 0x80      //turn on clock for Timer2 in order to set the Timer2 to 1s or 2s
+#define PRCMCLKSEL_TIMER2 0x508         //set clock frequency multiplexer for 32.760 KHz
+#define IRQSTATUS_RAW_TIMER2 0x24       //going to check the IRQSTATIS_RAW for timer2 (to make sure overflow happened)
+#define TCLR 0x38                       //timer control register (value will be set to a 1 to begin counting)
+#define TCRR 0x3C                       //timer counter (will have 1s or 2s value after TLDR)
+
+#define TIOCP_CFG 0x10                  //timer OCP configuration (soft reset)
+#define IRQSTATUS_TIMER2 0x28           //enabled timer events, write a 1 to clear an event
+#define IRQENABLE_SET_TIMER2 0x2C       //enable timer interrupt events
+#define IRQENABLE_CLR_TIMER2 0x30       //disable timer interrupt events
+#define TLDR 0x40                       //value loaded into TCRR on overflow in auto-reload mode
+#define TTGR 0x44                       //write anything to load TLDR into TCRR
+#define TWPS 0x48                       //write posting status, a bit stays set until the write reached the timer
+#define TMAR 0x4C                       //match value compared against TCRR
+
+#define TIMER_IRQ_MAT ( 1 << 0 )        //TCRR reached TMAR
+#define TIMER_IRQ_OVF ( 1 << 1 )        //TCRR overflowed
+#define TIMER_IRQ_TCAR ( 1 << 2 )       //capture
+#define TIMER_TCLR_ST ( 1 << 0 )        //start the timer
+#define TIMER_TCLR_AR ( 1 << 1 )        //auto-reload from TLDR on overflow
+#define TIMER_TCLR_CE ( 1 << 6 )        //compare enable
+#define TIMER_TIOCP_SOFTRESET ( 1 << 0 )
+#define TIMER_TWPS_TCLR ( 1 << 0 )      //write to TCLR pending
+#define TIMER_TWPS_TCRR ( 1 << 1 )
+#define TIMER_TWPS_TLDR ( 1 << 2 )
+#define TIMER_TWPS_TMAR ( 1 << 4 )
+
+#define CLKSEL_TIMER_M_OSC 0x1          //PRCMCLKSEL_TIMER2: 24 MHz master oscillator
+#define CLKSEL_TIMER_32KHZ 0x2          //PRCMCLKSEL_TIMER2: 32.768 KHz clock
+#define CM_PER_MODULEMODE_ENABLE 0x2    //MODULEMODE field of a CM_PER clock control register
+#define CM_PER_IDLEST_MASK ( 3 << 16 )  //IDLEST field, 0 once the module is fully functional
+
+//interrupt controller (INTC)
+
+#define INTC_BASE_ADDRESS 0x48200000    //module INTC from the MPU memory map
+#define INTC_SIR_IRQ 0x40               //number of the active IRQ
+#define INTC_CONTROL 0x48               //write NEWIRQAGR when the handler is done
+#define INTC_MIR(n) ( 0x84 + 0x20 * (n) )       //interrupt mask of lines 32n to 32n+31
+#define INTC_MIR_CLEAR(n) ( 0x88 + 0x20 * (n) ) //write a 1 to unmask a line
+#define INTC_MIR_SET(n) ( 0x8C + 0x20 * (n) )   //write a 1 to mask a line
+#define INTC_ILR(m) ( 0x100 + 4 * (m) )         //priority and IRQ/FIQ routing of line m
+#define INTC_SIR_ACTIVEIRQ_MASK 0x7F
+#define INTC_CONTROL_NEWIRQAGR 0x1
+#define INTC_LINES 128
+
+#define I2C0_INT 70                     //I2C0 interrupt line
+#define I2C1_INT 71                     //I2C1 interrupt line
+#define I2C2_INT 30                     //I2C2 interrupt line
+#define EDMA_COMPLETION_INT 12          //EDMACOMPINT, transfer completion of shadow region 0
+#define TIMER2_INT 68                   //TINT2, DMTimer2 interrupt line
+
+//EDMA3 channel controller (TPCC), only region 0 and the first 32 channels are used
+
+#define EDMA_BASE_ADDRESS 0x49000000    //module TPCC from the L3 memory map
+#define CM_PER_TPCC_CLKCTRL 0xBC        //turn on clock for the channel controller
+#define CM_PER_TPTC0_CLKCTRL 0x24       //turn on clock for transfer controller 0
+#define EDMA_DCHMAP(n) ( 0x100 + 4 * (n) )      //PaRAM set used by channel n
+#define EDMA_EMR 0x300                  //event missed
+#define EDMA_EMCR 0x308                 //write a 1 to clear a missed event
+#define EDMA_DRAE0 0x340                //channels whose events and interrupts belong to region 0
+#define EDMA_ER 0x2000                  //region 0 event register
+#define EDMA_ECR 0x2008                 //write a 1 to clear a pending event
+#define EDMA_ESR 0x2010                 //write a 1 to trigger a channel by hand
+#define EDMA_EER 0x2020                 //events that start a transfer
+#define EDMA_EECR 0x2028                //write a 1 to disable an event
+#define EDMA_EESR 0x2030                //write a 1 to enable an event
+#define EDMA_SECR 0x2040                //write a 1 to clear a secondary event
+#define EDMA_IER 0x2050                 //completion codes that raise EDMACOMPINT
+#define EDMA_IECR 0x2058
+#define EDMA_IESR 0x2060
+#define EDMA_IPR 0x2068                 //completion codes that are pending
+#define EDMA_ICR 0x2070                 //write a 1 to clear a pending completion code
+#define EDMA_IEVAL 0x2078               //write EVAL so an interrupt pending on exit is raised again
+#define EDMA_PARAM(n) ( 0x4000 + 0x20 * (n) )   //PaRAM set n, eight words
+#define EDMA_PARAM_SETS 64
+
+//PaRAM words and the OPT bits
+#define EDMA_OPT 0x00
+#define EDMA_SRC 0x04
+#define EDMA_A_B_CNT 0x08               //BCNT in the upper half, ACNT in the lower
+#define EDMA_DST 0x0C
+#define EDMA_SRC_DST_BIDX 0x10
+#define EDMA_LINK_BCNTRLD 0x14
+#define EDMA_SRC_DST_CIDX 0x18
+#define EDMA_CCNT 0x1C
+#define EDMA_OPT_SYNCDIM ( 1 << 2 )     //AB synchronized, one event moves ACNT * BCNT bytes
+#define EDMA_OPT_TCC(c) ( (c) << 12 )   //completion code
+#define EDMA_OPT_TCINTEN ( 1 << 20 )    //set the completion code in IPR when the last transfer is done
+#define EDMA_LINK_NULL 0xFFFF           //no link, the set becomes a null set when it is used up
+#define EDMA_IEVAL_EVAL 0x1
+
+//event crossbar in the control module, I2C2 has no direct mapped EDMA event
+#define TPCC_EVT_MUX(n) ( 0xF90 + ( (n) & ~3 ) )  //one byte per channel, four channels per register
+#define EDMA_XBAR_I2C2_TX 3             //crossbar input of I2CTXEVT2
+#define EDMA_I2C2_TX_CHANNEL 20         //channel the I2C2 transmit event is routed to
+
+#endif
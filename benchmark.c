@@ -0,0 +1,1313 @@
+/**********************************************************************************************************************
+*   Servo update benchmark                                                                                            *
+*                                                                                                                     *
+*   Host program that runs the I2C2 transmit path against the simulated AM335x and PCA9685 (sim_am335x.c) and prints  *
+*   what one servo update costs: simulated time, CPU cycles, register accesses, bus bytes and START/STOP conditions.  *
+*   The output is one "name value" pair per line so runs can be diffed or checked by a script.                        *
+*                                                                                                                     *
+*   Build and run on the host (every module except the two Part programs):                                            *
+*       gcc -std=gnu99 -DAM335X_SIM -o benchmark [a-z]*.c && ./benchmark                                              *
+*                                                                                                                     *
+*   Built with -DI2C_TRACING as well, the first transfers on I2C2 are traced phase by phase: the statistics are       *
+*   printed as trace.* lines and the binary dump is written to i2c2_trace.bin for tools/i2c_trace_decode.c.           *
+*                                                                                                                     *
+*   The fixed set of numbers every change to the transmit path is checked against, with its regression limits, is     *
+*   tools/servo_suite.c.                                                                                              *
+*                                                                                                                     *
+*   On a Linux host the i2c-dev transport (i2c_dev.h) is run against its loopback as well; those i2cdev.* lines are   *
+*   timed on the wall clock, so unlike the rest they change from run to run.                                          *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hwreg.h"
+#include "am335x.h"
+#include "pca9685.h"
+#include "pca9685_cache.h"
+#include "servo.h"
+#include "trajectory.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "pca9685_bank.h"
+#include "sequence.h"
+#include "gpio.h"
+#include "boot.h"
+#include "power.h"
+#include "i2c.h"
+#include "i2c_async.h"
+#include "i2c_dma.h"
+#include "i2c_dev.h"
+#include "i2c_trace.h"
+#include "intc.h"
+#include "cpu.h"
+
+//same tables as Part 2.c
+static const unsigned int PCA_INIT [ ] = { MODE1, 0x11, PRE_SCALE_SERVO, 0x79, MODE1, 0xA1, MODE2, 0x04 };
+static const unsigned int PCA_0_DEGREES [ ] = { LED8_ON_H, 0x00, LED8_ON_L, 0x00, LED8_OFF_H, 0x1, LED8_OFF_L, 0x32 };
+static const unsigned char PCA_90_DEGREES [ ] = { 0x00, 0x00, 0x99, 0x1 };
+static const unsigned char PCA_MOVES [ 3 ] [ 4 ] = { { 0x00, 0x00, 0x32, 0x1 }, { 0x00, 0x00, 0x99, 0x1 }, { 0x00, 0x00, 0xCC, 0x00 } };
+
+//the Part 1 set up as register/value pairs and a burst, and as a byte coded sequence
+static const unsigned char LED15_FULL_ON [ ] = { 0x10, 0x00, 0x00 };
+static const unsigned char PCA_SETUP [ ] = {
+	SEQ_WRITE ( PCA9685_ADDRESS, MODE1, 0x11 ),
+	SEQ_WRITE ( PCA9685_ADDRESS, PRE_SCALE_SERVO, 0x79 ),
+	SEQ_WRITE ( PCA9685_ADDRESS, MODE1, 0xA1 ),
+	SEQ_WRITE ( PCA9685_ADDRESS, MODE2, 0x04 ),
+	SEQ_WRITE ( PCA9685_ADDRESS, LED15_ON_H, 0x10, 0x00, 0x00 ),
+	SEQ_END
+};
+
+//LED0 on with the servo at +90 degrees, off back at 0, three times; the writes are queued and waited for
+//the user LEDs lit one after the other, then all off
+static const int ZERO_DEGREES [ PCA9685_CHANNELS ];
+
+static const unsigned int LED_WALK [ ] = { GPIO_USR0, GPIO_USR1, GPIO_USR2, 0 };
+static const unsigned int LED_BLINK [ ] = { GPIO_USR_LEDS, 0 };
+
+static const unsigned char PCA_SWING [ ] = {
+	SEQ_LOOP ( 3 ),
+		SEQ_GPIO_SET ( 1 << 21 ),
+		SEQ_WRITE ( PCA9685_ADDRESS, LED8_ON_L, 0x00, 0x00, 0x99, 0x1 ),
+		SEQ_WAIT ( SEQ_EVENT_I2C_IDLE ),
+		SEQ_DELAY_MS ( 20 ),
+		SEQ_GPIO_CLEAR ( 1 << 21 ),
+		SEQ_WRITE ( PCA9685_ADDRESS, LED8_ON_L, 0x00, 0x00, 0x32, 0x1 ),
+		SEQ_WAIT ( SEQ_EVENT_I2C_IDLE ),
+		SEQ_DELAY_MS ( 20 ),
+	SEQ_NEXT,
+	SEQ_END
+};
+
+static PCA9685_CACHE cache;
+static SERVO_MAP servos;
+static TRAJECTORY trajectory;
+static TIMER timers [ 64 ];
+static unsigned int ticks;
+
+static SCHEDULER scheduler;
+static PCA9685_CACHE boards [ 12 ];
+static PCA9685_BANK bank;
+static unsigned short bank_width [ 12 * PCA9685_CHANNELS ];
+static SCHED_TASK finished;
+static SEQUENCE sequence;
+static SCHED_TASK stepper;
+static GPIO_GROUP leds;
+static POWER power;
+static SCHED_TASK mover;
+static SCHED_TASK stopper;
+static TIMER move_timer;
+static unsigned int moves;
+
+#define POWER_MOVES 6                               //channel 8 moves of the idle run, 200 ms apart
+
+static void COUNT_TICK ( void *context ){
+
+	( void ) context;
+	ticks++;
+}
+
+static void RUN_SEQUENCE ( void *context ){
+
+	if ( ( stepper.result = SEQ_RUN ( context ) ) != SEQ_BLOCKED ) {
+		SCHED_STOP ( &scheduler );
+	}
+}
+
+static void STOP_STREAM ( void *context ){
+
+	TRAJECTORY_STREAM_STOP ( context );
+	SCHED_STOP ( &scheduler );
+}
+
+//channel 8 to +90 degrees and back to 0 through the queued cache, the next move 200 ms later
+static void MOVE_SERVO ( void *context ){
+
+	( void ) context;
+	PCA9685_CACHE_WRITE_BURST ( &cache, LED8_ON_L, moves % 2 ? PCA_MOVES[0] : PCA_90_DEGREES, 4 );
+	PCA9685_CACHE_FLUSH ( &cache );
+	if ( ++moves < POWER_MOVES ) {
+		TIMER_START ( &TIMER2_SERVICE, &move_timer, TIMER_MS ( 200 ), 0, SCHED_WAKE, &mover );
+	}
+}
+
+static void STOP_RUN ( void *context ){
+
+	( void ) context;
+	SCHED_STOP ( &scheduler );
+}
+
+//the policy, and the end of the run once the last move is done and the PCA9685 and the I2C clock are off
+static void POWER_THEN_STOP ( void *context ){
+
+	POWER_IDLE ( context );
+	if ( moves == POWER_MOVES && power.state == POWER_ASLEEP && I2C2_BUS.gated ) {
+		SCHED_POST ( &stopper );
+	}
+}
+
+//start up to the first frame: the way Part 2 did it, clocks one after the other without IDLEST and the
+//SLEEP / PRE_SCALE / RESTART sequence of the cache before MODE2 and the frame, or through BOOT_INIT and BOOT_PCA9685
+static void BOOT_RUN ( unsigned int fast, const unsigned short *widths ){
+
+	if ( fast ) {
+		BOOT_INIT ( &I2C2_BUS );
+		PCA9685_CACHE_INIT ( &cache, &I2C2_BUS, 0, PCA9685_ADDRESS );
+		BOOT_PCA9685 ( &cache, PCA9685_PRESCALE_50HZ, widths );
+		BOOT_FINISH ( );
+		return;
+	}
+	I2C2_PINMUX_AND_CLOCK ( );
+	REG_WRITE ( CM_PER_ADDRESS + CM_PER_GPIO1_CLKCTRL, 0x02 );
+	I2C_INIT ( &I2C2_BUS );
+	PCA9685_CACHE_INIT ( &cache, &I2C2_BUS, 0, PCA9685_ADDRESS );
+	PCA9685_CACHE_SET_PRESCALE ( &cache, PCA9685_PRESCALE_50HZ );
+	PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+	PCA9685_CACHE_WRITE ( &cache, MODE2, MODE2_OUTDRV );
+	PCA9685_CACHE_FLUSH ( &cache );
+	PCA9685_CACHE_WRITE_FRAME ( &cache, widths );
+}
+
+//channel 8 moved 8 times at different points of the PWM period; the latency of a move is from the command to the
+//start of the first pulse with the new width, the mean is returned
+static unsigned long long MOVE_LATENCY ( const char *label ){
+
+	unsigned long long sum = 0, worst = 0, latency, issued;
+
+	for ( unsigned int i = 0; i < 8; i++ ) {
+		SIM_SPIN ( 1150000 + i * 370000 );
+		issued = SIM_NOW_NS ( );
+		SERVO_MOVE ( &cache, &servos, 8, i & 1 ? SERVO_ANGLE ( 45 ) : SERVO_ANGLE ( -45 ) );
+		PCA9685_CACHE_FLUSH ( &cache );
+		latency = SIM_PCA_PULSE_NS ( PCA9685_ADDRESS, 8 ) - issued;
+		sum += latency;
+		worst = latency > worst ? latency : worst;
+	}
+	printf ( "%s.move_latency_mean_ns %llu\n%s.move_latency_max_ns %llu\n", label, sum / 8, label, worst );
+	return sum / 8;
+}
+
+//pulse of a channel as the output puts it out
+static unsigned long long PULSE_WIDTH_NS ( unsigned int channel ){
+
+	unsigned int on = ( ( SIM_PCA_REG ( PCA9685_ADDRESS, LED_ON_H ( channel ) ) & 0x0F ) << 8 ) |
+	                  SIM_PCA_REG ( PCA9685_ADDRESS, LED_ON_L ( channel ) );
+	unsigned int off = ( ( SIM_PCA_REG ( PCA9685_ADDRESS, LED_OFF_H ( channel ) ) & 0x0F ) << 8 ) |
+	                   SIM_PCA_REG ( PCA9685_ADDRESS, LED_OFF_L ( channel ) );
+
+	return ( off - on ) * SIM_PCA_PERIOD_NS ( PCA9685_ADDRESS ) / 4096;
+}
+
+//rates for the sweep, every entry is checked at compile time
+typedef struct {
+	const char *label;
+	unsigned int rate, psc, scll, sclh;
+} RATE;
+
+I2C_TIMING_CHECK ( I2C_FCLK_HZ, I2C_RATE_STANDARD );
+I2C_TIMING_CHECK ( I2C_FCLK_HZ, I2C_RATE_FAST );
+I2C_TIMING_CHECK ( I2C_FCLK_HZ, I2C_RATE_FASTEST );
+
+#define RATE_ENTRY(label, rate) \
+	{ label, rate, I2C_PSC ( I2C_FCLK_HZ, rate ), I2C_SCLL ( I2C_FCLK_HZ, rate ), I2C_SCLH ( I2C_FCLK_HZ, rate ) }
+
+static const RATE RATES [ ] = {
+	RATE_ENTRY ( "rate_100k", I2C_RATE_STANDARD ),
+	RATE_ENTRY ( "rate_400k", I2C_RATE_FAST ),
+	RATE_ENTRY ( "rate_fastest", I2C_RATE_FASTEST ),
+};
+
+#ifdef __linux__
+#define DEV_BOARDS 4
+#define DEV_FRAMES 200
+
+static unsigned long long WALL_NS ( void ){
+
+	struct timespec now;
+
+	clock_gettime ( CLOCK_MONOTONIC, &now );
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//DEV_FRAMES frames to DEV_BOARDS boards on the loopback i2c-dev, every channel moving every frame: one write() per
+//register, or the bursts of the caches batched into one I2C_RDWR per frame. This runs for real, so the time is the
+//wall clock and not the simulated one; the system calls are returned and the registers of the model left in regs
+static unsigned int DEV_RUN ( const char *label, unsigned int batched, const int *spread, unsigned char *regs ){
+
+	static I2C_DEV dev;
+	int angles [ PCA9685_CHANNELS ];
+	unsigned short widths [ PCA9685_CHANNELS ];
+	unsigned char bytes [ 4 ], write [ 2 ];
+	unsigned long long start, ns;
+	unsigned int syscalls, messages;
+
+	I2C_DEV_LOOPBACK ( &dev );
+	for ( unsigned int b = 0; b < DEV_BOARDS; b++ ) {
+		PCA9685_CACHE_INIT ( &boards[b], 0, 0, PCA9685_ADDRESS + b );
+		PCA9685_CACHE_ATTACH_DEV ( &boards[b], &dev );
+		PCA9685_CACHE_WRITE ( &boards[b], MODE1, MODE1_AI | MODE1_ALLCALL );
+		PCA9685_CACHE_FLUSH ( &boards[b] );
+	}
+	I2C_DEV_FLUSH ( &dev );
+	syscalls = dev.syscalls;
+	messages = dev.messages;
+
+	start = WALL_NS ( );
+	for ( unsigned int frame = 0; frame < DEV_FRAMES; frame++ ) {
+		for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+			angles[i] = spread[( i + frame ) % PCA9685_CHANNELS];
+		}
+		SERVO_FRAME ( &servos, angles, widths );
+		for ( unsigned int b = 0; b < DEV_BOARDS; b++ ) {
+			if ( batched ) {
+				PCA9685_CACHE_WRITE_FRAME ( &boards[b], widths );
+				continue;
+			}
+			for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+				bytes[0] = bytes[1] = 0x00;
+				bytes[2] = widths[channel] & 0xFF;
+				bytes[3] = widths[channel] >> 8;
+				for ( unsigned int i = 0; i < 4; i++ ) {
+					write[0] = (unsigned char) ( LED_ON_L ( channel ) + i );
+					write[1] = bytes[i];
+					I2C_DEV_WRITE ( &dev, PCA9685_ADDRESS + b, write, 2 );
+				}
+			}
+		}
+		I2C_DEV_FLUSH ( &dev );
+	}
+	ns = WALL_NS ( ) - start;
+	syscalls = dev.syscalls - syscalls;
+	messages = dev.messages - messages;
+
+	printf ( "%s.syscalls_per_frame %.2f\n", label, (double) syscalls / DEV_FRAMES );
+	printf ( "%s.transactions_per_frame %.1f\n", label, (double) messages / DEV_FRAMES );
+	printf ( "%s.ns_per_frame %llu\n", label, ns / DEV_FRAMES );
+	memcpy ( regs, dev.regs, sizeof ( dev.regs ) );
+	I2C_DEV_CLOSE ( &dev );
+	return syscalls;
+}
+
+//the paths of the cache that do not go through a flush, on two loopback adapters with a board each: the boot, the
+//read-back, the restore after a reset, the recovery hook, a broadcast to both and the power policy's MODE1 writes;
+//returns how many of them did not do what they should
+static unsigned int DEV_PATHS ( const unsigned short *widths ){
+
+	static I2C_DEV devs [ 2 ];
+	static const unsigned char ALL_OFF [ 4 ] = { 0x00, 0x00, 0x00, 0x10 };
+	PCA9685_CACHE *first = &boards[0], *second = &boards[1];
+	unsigned int failures = 0;
+
+	PCA9685_BANK_INIT ( &bank );
+	for ( unsigned int b = 0; b < 2; b++ ) {
+		I2C_DEV_LOOPBACK ( &devs[b] );
+		PCA9685_CACHE_INIT ( &boards[b], 0, 0, PCA9685_ADDRESS );
+		PCA9685_CACHE_ATTACH_DEV ( &boards[b], &devs[b] );
+		PCA9685_BANK_ADD ( &bank, &boards[b] );
+		failures += PCA9685_CACHE_BOOT ( &boards[b], PCA9685_PRESCALE_50HZ, widths ) != I2C_OK
+		            || devs[b].regs[PRE_SCALE_SERVO] != PCA9685_PRESCALE_50HZ || ( devs[b].regs[MODE1] & MODE1_SLEEP )
+		            || memcmp ( &devs[b].regs[LED0_ON_L], &boards[b].regs[LED0_ON_L], 4 * PCA9685_CHANNELS ) != 0;
+	}
+
+	//one register the device lost is found by the read-back
+	devs[0].regs[LED8_OFF_L] ^= 0x01;
+	failures += PCA9685_CACHE_VERIFY ( first, LED0_ON_L, 4 * PCA9685_CHANNELS ) != 1;
+
+	//SWRST puts the model back to power on, the restore sends the mirror and wakes it
+	failures += PCA9685_CACHE_RESTORE ( first ) != I2C_OK || devs[0].regs[PRE_SCALE_SERVO] != PCA9685_PRESCALE_50HZ
+	            || ( devs[0].regs[MODE1] & MODE1_SLEEP ) || devs[0].regs[LED8_OFF_L] != first->regs[LED8_OFF_L];
+	failures += PCA9685_CACHE_ATTACH_RECOVERY ( first ) != PCA9685_ERR_TRANSPORT;
+
+	//every board on its own adapter, so the broadcast is one transaction on each
+	failures += PCA9685_BANK_BROADCAST ( &bank, PCA9685_ALLCALL_ADDRESS, ALL_LED_ON_L, ALL_OFF, 4 ) != I2C_OK;
+	I2C_DEV_FLUSH ( &devs[0] );
+	I2C_DEV_FLUSH ( &devs[1] );
+	failures += bank.broadcast_transactions != 2 || devs[1].regs[ALL_LED_OFF_H] != ALL_OFF[3];
+
+	//the policy's sleep and wake go into the batch like the frames, the task goes on once the batch is sent
+	SCHED_INIT ( &scheduler );
+	POWER_INIT ( &power, &scheduler, 0, &TIMER2_SERVICE, second, 0 );
+	power.state = POWER_SLEEPING;
+	power.task.function ( power.task.context );
+	failures += power.state != POWER_SUSPENDING || power.task.queued;
+	I2C_DEV_FLUSH ( &devs[1] );
+	SCHED_STOP ( &scheduler );
+	SCHED_RUN ( &scheduler );
+	failures += power.state != POWER_ASLEEP || !( devs[1].regs[MODE1] & MODE1_SLEEP );
+	power.state = POWER_WAKING;
+	power.task.function ( power.task.context );
+	failures += power.state != POWER_STARTING || power.task.queued;
+	I2C_DEV_FLUSH ( &devs[1] );
+	SCHED_STOP ( &scheduler );
+	SCHED_RUN ( &scheduler );
+	failures += power.state != POWER_RESTARTING || ( devs[1].regs[MODE1] & MODE1_SLEEP ) || !power.timer.active;
+	TIMER_CANCEL ( &TIMER2_SERVICE, &power.timer );
+	SCHED_INIT ( &scheduler );
+
+	printf ( "i2cdev.paths.syscalls %u\ni2cdev.paths.failures %u\n", devs[0].syscalls + devs[1].syscalls, failures );
+	I2C_DEV_CLOSE ( &devs[0] );
+	I2C_DEV_CLOSE ( &devs[1] );
+	return failures;
+}
+#endif
+
+//run one step and print what it cost
+#define MEASURE(label, step) do { \
+		SIM_STATS before = SIM_GET_STATS ( ); \
+		step; \
+		SIM_STATS after = SIM_GET_STATS ( ); \
+		SIM_STATS delta = SIM_STATS_DELTA ( &after, &before ); \
+		SIM_PRINT_STATS ( stdout, label, &delta ); \
+		measured = delta; \
+	} while ( 0 )
+
+static SIM_STATS measured;                          //cost of the last MEASURE step
+
+//status reads per wait phase of the session
+static void PRINT_WAITS ( const char *label, const I2C_BUS *bus )
+{
+	static const char *names [ I2C_PHASES ] = { "reset", "bus_free", "xrdy", "ardy", "rrdy" };
+
+	for ( unsigned int phase = 0; phase < I2C_PHASES; phase++ ) {
+		printf ( "%s.waits.%s %llu\n", label, names[phase], bus->waits[phase] );
+		printf ( "%s.max_waits.%s %u\n", label, names[phase], bus->max_waits[phase] );
+	}
+}
+
+#ifdef I2C_TRACING
+//per phase statistics of the trace, then the ring as a dump file
+static void PRINT_TRACE ( const char *label, I2C_TRACE *trace, const char *path )
+{
+	static const char *names [ I2C_TRACE_PHASES ] = { "reset", "bus_free", "xrdy", "ardy", "rrdy", "spin" };
+	unsigned char dump [ I2C_TRACE_HEADER_BYTES + I2C_TRACE_DEPTH * I2C_TRACE_ENTRY_BYTES ];
+	unsigned int length;
+	FILE *out;
+
+	for ( unsigned int phase = 0; phase < I2C_TRACE_PHASES; phase++ ) {
+		const I2C_TRACE_STATS *stats = &trace->phase[phase];
+
+		if ( stats->count == 0 ) {
+			continue;
+		}
+		printf ( "%s.%s.count %u\n", label, names[phase], stats->count );
+		printf ( "%s.%s.min_cycles %u\n", label, names[phase], stats->min );
+		printf ( "%s.%s.max_cycles %u\n", label, names[phase], stats->max );
+		printf ( "%s.%s.mean_cycles %llu\n", label, names[phase], stats->sum / stats->count );
+		printf ( "%s.%s.total_cycles %llu\n", label, names[phase], stats->sum );
+	}
+	printf ( "%s.dropped %u\n", label, trace->dropped );
+
+	length = I2C_TRACE_DUMP ( trace, dump, sizeof ( dump ) );
+	if ( ( out = fopen ( path, "wb" ) ) != NULL ) {
+		fwrite ( dump, 1, length, out );
+		fclose ( out );
+	}
+	printf ( "%s.dump_bytes %u\n", label, length );
+}
+#endif
+
+int main ( void )
+{
+	unsigned char frame [ 64 ];
+	unsigned char readback [ 64 ];
+	unsigned char poke [ 2 ];
+	unsigned short widths [ PCA9685_CHANNELS ];
+	unsigned int pairs [ 2 * 64 ];
+	unsigned long long start;
+	unsigned long long boot_pulse_ns [ 2 ];
+	unsigned long long move_latency [ 2 ], width_ns;
+	unsigned int rate_millihz;
+	int spread [ PCA9685_CHANNELS ];
+	volatile int done;
+
+	SIM_RESET ( );
+	SIM_SET_TIME_LIMIT ( 10000000000ULL );
+
+	//from reset to the first pulse on LED8, every channel at 0 degrees (one ALL_LED write) and spread from -90 to
+	//+90 degrees (all 64 channel registers)
+	for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+		spread[i] = SERVO_ANGLE ( -90 ) + (int) i * SERVO_RANGE / ( PCA9685_CHANNELS - 1 );
+	}
+	SERVO_INIT ( &servos, PCA9685_PRESCALE_50HZ );
+	for ( unsigned int run = 0; run < 4; run++ ) {
+		static const char *names [ ] = { "boot.session", "boot.fast", "boot.session_spread", "boot.fast_spread" };
+
+		SIM_RESET ( );
+		SERVO_FRAME ( &servos, run < 2 ? ZERO_DEGREES : spread, widths );
+		MEASURE ( names[run], BOOT_RUN ( run & 1, widths ) );
+		boot_pulse_ns[run & 1] = SIM_PCA_PULSE_NS ( PCA9685_ADDRESS, 8 );
+		printf ( "%s.transactions_to_pulse %llu\n%s.first_pulse_ns %llu\n", names[run], measured.transactions, names[run],
+		         boot_pulse_ns[run & 1] );
+		if ( run & 1 ) {
+			printf ( "%s.clock_polls %u\n%s.first_pwm_cycles %u\n", names[run], BOOT.clock_polls, names[run],
+			         BOOT.first_pwm_cycles );
+			if ( boot_pulse_ns[1] == 0 || boot_pulse_ns[1] >= boot_pulse_ns[0] ) {
+				printf ( "error the fast boot did not put out the first pulse sooner\n" );
+				return 1;
+			}
+		}
+	}
+
+	//servo update rate: a move reaches the output with the next PWM period, so it waits up to one period. The
+	//simulated oscillator runs 4 % fast, as a part can; 333 Hz is set from the rate measured on the output at 50 Hz
+	SIM_RESET ( );
+	SIM_SET_PCA_OSC ( PCA9685_ADDRESS, 26000000 );
+	SERVO_INIT ( &servos, PCA9685_PRESCALE_50HZ );
+	SERVO_FRAME ( &servos, ZERO_DEGREES, widths );
+	BOOT_RUN ( 1, widths );
+	move_latency[0] = MOVE_LATENCY ( "rate.50hz" );
+	rate_millihz = (unsigned int) ( 1000000000000ULL / SIM_PCA_PERIOD_NS ( PCA9685_ADDRESS ) );
+	width_ns = PULSE_WIDTH_NS ( 8 );
+	printf ( "rate.50hz.measured_millihz %u\nrate.50hz.width_ns %llu\n", rate_millihz, width_ns );
+	printf ( "rate.333hz.uncalibrated_prescale %u\n", PCA9685_PRESCALE_FOR ( PCA9685_OSC_HZ, 333 ) );
+
+	PCA9685_CACHE_CALIBRATE ( &cache, rate_millihz );
+	SERVO_SET_OSCILLATOR ( &servos, cache.osc_hz );
+	MEASURE ( "rate.set_333hz", PCA9685_CACHE_SET_RATE ( &cache, 333 ) );
+	SERVO_SET_PRESCALE ( &servos, cache.regs[PRE_SCALE_SERVO] );
+	rate_millihz = (unsigned int) ( 1000000000000ULL / SIM_PCA_PERIOD_NS ( PCA9685_ADDRESS ) );
+	printf ( "rate.333hz.osc_hz %u\nrate.333hz.prescale %u\nrate.333hz.measured_millihz %u\nrate.333hz.width_ns %llu\n",
+	         cache.osc_hz, cache.regs[PRE_SCALE_SERVO], rate_millihz, PULSE_WIDTH_NS ( 8 ) );
+	printf ( "rate.333hz.rescaled %u\n", cache.rescaled );
+
+	//within 1 % of 333 Hz, the pulse within one count of what it was, RESTART after the oscillator start up
+	if ( rate_millihz < 329670 || rate_millihz > 336330 || measured.pca_early_restarts != 0 ||
+	     PULSE_WIDTH_NS ( 8 ) + SIM_PCA_PERIOD_NS ( PCA9685_ADDRESS ) / 4096 < width_ns ||
+	     PULSE_WIDTH_NS ( 8 ) > width_ns + SIM_PCA_PERIOD_NS ( PCA9685_ADDRESS ) / 4096 ) {
+		printf ( "error the 333 Hz rate did not take as set\n" );
+		return 1;
+	}
+	move_latency[1] = MOVE_LATENCY ( "rate.333hz" );
+	printf ( "rate.latency_ratio %.1f\n", (double) move_latency[0] / move_latency[1] );
+	if ( move_latency[1] * 4 > move_latency[0] ) {
+		printf ( "error moves at 333 Hz did not reach the output sooner\n" );
+		return 1;
+	}
+	SERVO_INIT ( &servos, PCA9685_PRESCALE_50HZ );
+
+	//a servo moved every 200 ms from a scheduler task with the power policy as the idle hook: the I2C clock is off
+	//between the moves, the PCA9685 sleeps 50 ms after each one and the move wakes it
+	SIM_RESET ( );
+	SERVO_FRAME ( &servos, ZERO_DEGREES, widths );
+	BOOT_RUN ( 1, widths );
+	INTC_INIT ( );
+	I2C_QUEUE_INIT ( &I2C2_QUEUE );
+	TIMER_SERVICE_START ( &TIMER2_SERVICE );
+	PCA9685_CACHE_INIT ( &cache, &I2C2_BUS, &I2C2_QUEUE, PCA9685_ADDRESS );
+	PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+	SCHED_INIT ( &scheduler );
+	SCHED_TASK_INIT ( &mover, &scheduler, MOVE_SERVO, 0 );
+	SCHED_TASK_INIT ( &stopper, &scheduler, STOP_RUN, 0 );
+	POWER_INIT ( &power, &scheduler, &I2C2_QUEUE, &TIMER2_SERVICE, &cache, 50000 );
+	scheduler.idle = POWER_THEN_STOP;
+	moves = 0;
+	MEASURE ( "power.moves", {
+		SCHED_POST ( &mover );
+		SCHED_RUN ( &scheduler );
+		TIMER_NOW ( &TIMER2_SERVICE );
+		I2C_UNGATE ( &I2C2_BUS );
+	} );
+	printf ( "power.cpu_duty_pct %.3f\n", 100.0 * scheduler.busy_cycles / ( scheduler.busy_cycles + scheduler.idle_cycles ) );
+	printf ( "power.idles %u\n", power.idles );
+	printf ( "power.i2c.gates %u\npower.i2c.gated_pct %.1f\n", I2C2_BUS.gates,
+	         100.0 * I2C2_BUS.gated_cycles / ( measured.now_ns * SIM_CPU_MHZ / 1000 ) );
+	printf ( "power.i2c.wake_max_cycles %u\n", I2C2_BUS.wake_max_cycles );
+	printf ( "power.pca.sleeps %u\npower.pca.wakes %u\npower.pca.asleep_pct %.1f\n", power.pca_sleeps, power.pca_wakes,
+	         100.0 * power.pca_asleep_ticks / ( measured.now_ns * ( TIMER_HZ / 1000000 ) / 1000 ) );
+	printf ( "power.pca.wake_mean_cycles %llu\npower.pca.wake_max_cycles %u\n",
+	         power.pca_wakes ? power.wake_cycles / power.pca_wakes : 0, power.wake_max_cycles );
+
+	//every move after the first woke the device, none of its registers was accessed unclocked, no RESTART came early
+	//and the last position is on the output
+	if ( power.pca_wakes != POWER_MOVES - 1 || measured.unclocked != 0 || measured.pca_early_restarts != 0 ||
+	     SIM_PCA_REG ( PCA9685_ADDRESS, LED8_OFF_L ) != 0x32 || ( SIM_PCA_REG ( PCA9685_ADDRESS, MODE1 ) & MODE1_SLEEP ) == 0 ) {
+		printf ( "error the idle run did not sleep and wake as it should\n" );
+		return 1;
+	}
+
+	//Timer2 with its clock off for 1 ms loses that 1 ms, which is why the policy leaves it running
+	{
+		unsigned long long before = TIMER_NOW ( &TIMER2_SERVICE ), stood;
+
+		REG_WRITE ( CM_PER_ADDRESS + CM_PER_TIMER2_CLKCTRL, 0 );
+		CPU_SPIN ( 1000 * CPU_MHZ );
+		REG_WRITE ( CM_PER_ADDRESS + CM_PER_TIMER2_CLKCTRL, CM_PER_MODULEMODE_ENABLE );
+		while ( REG_READ ( CM_PER_ADDRESS + CM_PER_TIMER2_CLKCTRL ) & CM_PER_IDLEST_MASK );
+		stood = TIMER_NOW ( &TIMER2_SERVICE ) - before;
+		printf ( "power.timer.gated_1ms_ticks %llu\n", stood );
+		if ( stood >= TIMER_US ( 100 ) ) {
+			printf ( "error Timer2 counted on with its clock off\n" );
+			return 1;
+		}
+	}
+
+	//queued, to a board that is not there: nothing is assumed until the queue reports the NACK, SLEEP is undone then,
+	//and a wake up that was not acknowledged leaves it asleep without starting the oscillator timer
+	SCHED_INIT ( &scheduler );
+	PCA9685_CACHE_INIT ( &boards[0], &I2C2_BUS, &I2C2_QUEUE, PCA9685_ADDRESS + 1 );
+	POWER_INIT ( &power, &scheduler, &I2C2_QUEUE, &TIMER2_SERVICE, &boards[0], 0 );
+	power.state = POWER_SLEEPING;
+	power.task.function ( power.task.context );
+	if ( power.state != POWER_SUSPENDING || boards[0].valid[MODE1] ) {
+		printf ( "error a queued SLEEP was taken as sent before it went out\n" );
+		return 1;
+	}
+	I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	power.task.function ( power.task.context );
+	if ( power.failed != 1 || power.state != POWER_AWAKE || boards[0].valid[MODE1] ) {
+		printf ( "error a queued SLEEP that was not acknowledged put the device to sleep\n" );
+		return 1;
+	}
+	power.state = POWER_WAKING;
+	power.task.function ( power.task.context );
+	I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	power.task.function ( power.task.context );
+	if ( power.failed != 2 || power.state != POWER_ASLEEP || power.timer.active || power.pca_wakes != 0 ) {
+		printf ( "error a queued wake up that was not acknowledged started the oscillator timer\n" );
+		return 1;
+	}
+
+	//polled, the SLEEP that was not acknowledged stays out of the mirror as well
+	SCHED_INIT ( &scheduler );
+	PCA9685_CACHE_INIT ( &boards[0], &I2C2_BUS, 0, PCA9685_ADDRESS + 1 );
+	POWER_INIT ( &power, &scheduler, 0, &TIMER2_SERVICE, &boards[0], 0 );
+	power.state = POWER_SLEEPING;
+	power.task.function ( power.task.context );
+	power.task.function ( power.task.context );
+	if ( power.failed != 1 || power.state != POWER_AWAKE || boards[0].valid[MODE1] ) {
+		printf ( "error a MODE1 write that was not acknowledged was taken as sent\n" );
+		return 1;
+	}
+
+	//a threshold longer than a 32 bit cycle count lasts at 1 GHz (4.29 s) arms its timer that far out
+	POWER_INIT ( &power, &scheduler, 0, &TIMER2_SERVICE, &boards[0], 5000000 );
+	POWER_IDLE ( &power );
+	TIMER_CANCEL ( &TIMER2_SERVICE, &power.timer );
+	if ( power.timer.deadline - power.changed < TIMER_MS ( 5000 ) || power.timer.deadline - power.changed > TIMER_MS ( 5001 ) ) {
+		printf ( "error the 5 s idle threshold did not arm its timer 5 s out\n" );
+		return 1;
+	}
+
+	//the original start up from here on
+	SIM_RESET ( );
+	I2C2_PINMUX_AND_CLOCK ( );
+
+#ifdef I2C_TRACING
+	//where the time goes in the original path against the session burst
+	I2C_TRACE_INIT ( &I2C2_TRACE, &I2C2_BUS );
+#endif
+
+	//original path, the module is soft reset for every register pair
+	MEASURE ( "pairs.init", I2C2_TRANSMIT_PAIRS ( PCA9685_ADDRESS, PCA_INIT, sizeof ( PCA_INIT ) / sizeof ( unsigned int ) ) );
+	MEASURE ( "pairs.servo_update", I2C2_TRANSMIT_PAIRS ( PCA9685_ADDRESS, PCA_0_DEGREES, sizeof ( PCA_0_DEGREES ) / sizeof ( unsigned int ) ) );
+
+	//configured once, then the 90 degree move as one auto-increment burst starting at LED8_ON_L
+	MEASURE ( "session.controller_init", I2C_INIT ( &I2C2_BUS ) );
+	MEASURE ( "burst.servo_update", PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED8_ON_L, PCA_90_DEGREES, sizeof ( PCA_90_DEGREES ) ) );
+	PRINT_WAITS ( "burst", &I2C2_BUS );
+
+	//a burst that does not fit is refused whole instead of cut short
+	{
+		unsigned char too_long [ PCA9685_MAX_BURST + 1 ] = { 0 };
+
+		if ( PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED0_ON_L, too_long, sizeof ( too_long ) ) != I2C_ERR_LENGTH ||
+		     PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED0_ON_L, too_long, 0 ) != I2C_ERR_LENGTH ) {
+			printf ( "error a burst of 0 or more than 64 registers was not refused\n" );
+			return 1;
+		}
+		if ( I2C_WRITE ( &I2C2_BUS, PCA9685_ADDRESS, too_long, 0 ) != I2C_ERR_LENGTH ||
+		     I2C_WRITE ( &I2C2_BUS, PCA9685_ADDRESS, too_long, 0x10000 ) != I2C_ERR_LENGTH ) {
+			printf ( "error a write of 0 or more than 0xFFFF bytes was not refused\n" );
+			return 1;
+		}
+	}
+#ifdef I2C_TRACING
+	PRINT_TRACE ( "trace", &I2C2_TRACE, "i2c2_trace.bin" );
+	I2C_TRACE_INIT ( NULL, &I2C2_BUS );
+#endif
+
+	//auto-increment goes on top of MODE1 as the device has it: asleep with SUB1 it stays asleep with SUB1
+	{
+		unsigned char mode1 [ 2 ] = { MODE1, SIM_PCA_REG ( PCA9685_ADDRESS, MODE1 ) };
+		unsigned char asleep [ 2 ] = { MODE1, MODE1_SLEEP | MODE1_SUB1 | MODE1_ALLCALL };
+
+		I2C_WRITE ( &I2C2_BUS, PCA9685_ADDRESS, asleep, 2 );
+		start = SIM_GET_STATS ( ).pca_early_restarts;
+		if ( PCA9685_ENABLE_AUTO_INCREMENT ( &I2C2_BUS, PCA9685_ADDRESS ) != I2C_OK ||
+		     SIM_PCA_REG ( PCA9685_ADDRESS, MODE1 ) != ( asleep[1] | MODE1_AI ) || SIM_GET_STATS ( ).pca_early_restarts != start ) {
+			printf ( "error auto-increment did not keep the rest of MODE1\n" );
+			return 1;
+		}
+		I2C_WRITE ( &I2C2_BUS, PCA9685_ADDRESS, mode1, 2 );
+	}
+
+	//the same burst at every rate of the sweep, then back to the compiled in rate
+	for ( unsigned int i = 0; i < sizeof ( RATES ) / sizeof ( RATES[0] ); i++ ) {
+		char label [ 48 ];
+
+		I2C2_BUS.psc = RATES[i].psc;
+		I2C2_BUS.scll = RATES[i].scll;
+		I2C2_BUS.sclh = RATES[i].sclh;
+		I2C_INIT ( &I2C2_BUS );
+		snprintf ( label, sizeof ( label ), "%s.servo_update", RATES[i].label );
+		MEASURE ( label, PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED8_ON_L, PCA_90_DEGREES, sizeof ( PCA_90_DEGREES ) ) );
+		printf ( "%s.psc %u\n%s.scll %u\n%s.sclh %u\n", RATES[i].label, RATES[i].psc, RATES[i].label, RATES[i].scll,
+		         RATES[i].label, RATES[i].sclh );
+		printf ( "%s.scl_hz %llu\n", RATES[i].label, 1000000000ULL * measured.scl_cycles / measured.bus_busy_ns );
+		printf ( "%s.bytes_per_s %llu\n", label, 1000000000ULL * measured.bus_bytes / measured.now_ns );
+		printf ( "%s.updates_per_s %llu\n", label, 1000000000ULL / measured.now_ns );
+	}
+	I2C2_BUS.psc = I2C_PSC ( I2C_FCLK_HZ, I2C2_RATE_HZ );
+	I2C2_BUS.scll = I2C_SCLL ( I2C_FCLK_HZ, I2C2_RATE_HZ );
+	I2C2_BUS.sclh = I2C_SCLH ( I2C_FCLK_HZ, I2C2_RATE_HZ );
+	I2C_INIT ( &I2C2_BUS );
+
+	//the 5 rounds of Part 2: init pairs and three full moves every round, then the same through the register cache
+	MEASURE ( "uncached.part2_rounds", {
+		for ( unsigned int round = 0; round < 5; round++ ) {
+			I2C_WRITE_PAIRS ( &I2C2_BUS, PCA9685_ADDRESS, PCA_INIT, sizeof ( PCA_INIT ) / sizeof ( unsigned int ) );
+			for ( unsigned int move = 0; move < 3; move++ ) {
+				PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED8_ON_L, PCA_MOVES[move], 4 );
+			}
+		}
+	} );
+
+	PCA9685_CACHE_INIT ( &cache, &I2C2_BUS, 0, PCA9685_ADDRESS );
+	MEASURE ( "cached.part2_rounds", {
+		for ( unsigned int round = 0; round < 5; round++ ) {
+			PCA9685_CACHE_SET_PRESCALE ( &cache, 0x79 );
+			PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+			PCA9685_CACHE_WRITE ( &cache, MODE2, 0x04 );
+			PCA9685_CACHE_FLUSH ( &cache );
+			for ( unsigned int move = 0; move < 3; move++ ) {
+				PCA9685_CACHE_WRITE_BURST ( &cache, LED8_ON_L, PCA_MOVES[move], 4 );
+				PCA9685_CACHE_FLUSH ( &cache );
+			}
+		}
+	} );
+	printf ( "cached.writes %u\ncached.dropped %u\ncached.bursts %u\ncached.bytes %u\ncached.bridged %u\n",
+	         cache.writes, cache.dropped, cache.bursts, cache.bytes, cache.bridged );
+
+	//values resent to join a burst only count once the burst went out: nothing answers at 0x41
+	{
+		PCA9685_CACHE absent;
+		unsigned char mode1 = MODE1_AI | MODE1_ALLCALL, on_h = 0;
+
+		PCA9685_CACHE_INIT ( &absent, &I2C2_BUS, 0, 0x41 );
+		PCA9685_CACHE_ASSUME ( &absent, MODE1, &mode1, 1 );
+		PCA9685_CACHE_ASSUME ( &absent, LED_ON_H ( 0 ), &on_h, 1 );
+		PCA9685_CACHE_WRITE ( &absent, LED0_ON_L, 1 );
+		PCA9685_CACHE_WRITE ( &absent, LED_OFF_L ( 0 ), 1 );
+		if ( PCA9685_CACHE_FLUSH ( &absent ) == I2C_OK || absent.failed != 1 || absent.bridged != 0 ) {
+			printf ( "error a burst that failed counted its bridged values\n" );
+			return 1;
+		}
+	}
+
+	//one more move once everything is in the mirror: only what changed goes out
+	MEASURE ( "cached.servo_update", {
+		PCA9685_CACHE_WRITE_BURST ( &cache, LED8_ON_L, PCA_90_DEGREES, 4 );
+		PCA9685_CACHE_FLUSH ( &cache );
+	} );
+
+	//a new width on every channel: one register/value pair per transaction against one frame burst
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		widths[channel] = 205 + 10 * channel;
+		for ( unsigned int i = 0; i < 4; i++ ) {
+			pairs[8 * channel + 2 * i] = LED_ON_L ( channel ) + i;
+		}
+		pairs[8 * channel + 1] = 0x00;
+		pairs[8 * channel + 3] = 0x00;
+		pairs[8 * channel + 5] = widths[channel] & 0xFF;
+		pairs[8 * channel + 7] = widths[channel] >> 8;
+	}
+	MEASURE ( "pairs.frame_16", I2C_WRITE_PAIRS ( &I2C2_BUS, PCA9685_ADDRESS, pairs, sizeof ( pairs ) / sizeof ( unsigned int ) ) );
+	//the pairs went around the mirror, so start it again
+	PCA9685_CACHE_INVALIDATE ( &cache );
+	PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+	PCA9685_CACHE_FLUSH ( &cache );
+	MEASURE ( "frame.all_16", PCA9685_CACHE_WRITE_FRAME ( &cache, widths ) );
+
+	//three neighbouring channels move, the rest stay
+	widths[3] += 50;
+	widths[5] += 50;
+	MEASURE ( "frame.channels_3_to_5", PCA9685_CACHE_WRITE_FRAME ( &cache, widths ) );
+
+	//every channel to the same width goes through ALL_LED
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		widths[channel] = 307;
+	}
+	MEASURE ( "frame.all_led", PCA9685_CACHE_WRITE_FRAME ( &cache, widths ) );
+	printf ( "frame.frames %u\nframe.all_led_frames %u\n", cache.frames, cache.all_led_frames );
+
+	//angles instead of register tables: the counts of the three old positions, then all 16 servos sweeping
+	//through arbitrary angles, one frame per step
+	SERVO_INIT ( &servos, PCA9685_PRESCALE_50HZ );
+	for ( int degrees = -90; degrees <= 90; degrees += 90 ) {
+		unsigned short on, off;
+
+		SERVO_ANGLE_TO_PWM ( &servos, 8, SERVO_ANGLE ( degrees ), &on, &off );
+		printf ( "servo.off_count.%d %u\n", degrees, off );
+	}
+	{
+		unsigned short on = 1, off = 1, longest;
+
+		if ( SERVO_ANGLE_TO_PWM ( &servos, PCA9685_CHANNELS, 0, &on, &off ) != SERVO_ERR_RANGE || on != 1 || off != 1 ||
+		     SERVO_CALIBRATE ( &servos, 8, 1000, 0x10000 ) != SERVO_ERR_RANGE ||
+		     SERVO_CALIBRATE ( &servos, PCA9685_CHANNELS, 1000, 2000 ) != SERVO_ERR_RANGE ||
+		     PCA9685_SET_CHANNEL ( &I2C2_BUS, PCA9685_ADDRESS, PCA9685_CHANNELS, 0, 0 ) != PCA9685_ERR_REGISTER ||
+		     servos.max_us[8] != SERVO_MAX_US ) {
+			printf ( "error a channel or a pulse width out of range was taken\n" );
+			return 1;
+		}
+
+		//at PRE_SCALE 3 a count is 0.16 us: a 10.5 ms span is 2^32 in Q16, past the period it stays at the last count
+		SERVO_SET_PRESCALE ( &servos, 3 );
+		SERVO_CALIBRATE ( &servos, 8, 100, 10586 );
+		SERVO_ANGLE_TO_PWM ( &servos, 8, SERVO_ANGLE_MIN, &on, &off );
+		SERVO_ANGLE_TO_PWM ( &servos, 8, SERVO_ANGLE_MAX, &on, &longest );
+		if ( off != 625 || longest != 4095 ) {
+			printf ( "error a pulse width longer than the PWM period wrapped around at a fast PRE_SCALE\n" );
+			return 1;
+		}
+		SERVO_INIT ( &servos, PCA9685_PRESCALE_50HZ );
+	}
+	MEASURE ( "servo.sweep_16x20", {
+		for ( int step = 0; step < 20; step++ ) {
+			int angles [ PCA9685_CHANNELS ];
+
+			for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+				angles[channel] = SERVO_ANGLE_MIN + ( step * 93 + (int) channel * 37 ) % SERVO_RANGE;
+			}
+			SERVO_FRAME ( &servos, angles, widths );
+			PCA9685_CACHE_WRITE_FRAME ( &cache, widths );
+		}
+	} );
+	printf ( "servo.frames_per_s %llu\n", 20 * 1000000000ULL / measured.now_ns );
+
+	//all 16 channels as one 64 byte burst, one XRDY per byte against FIFO thresholds
+	for ( unsigned int i = 0; i < sizeof ( frame ); i++ ) {
+		frame[i] = ( i % 4 == 2 ) ? 0x32 : ( i % 4 == 3 ) ? 0x1 : 0x00;
+	}
+	I2C2_BUS.tx_threshold = 1;
+	start = I2C2_BUS.interventions;
+	MEASURE ( "byte.frame_16", PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED0_ON_L, frame, sizeof ( frame ) ) );
+	printf ( "byte.frame_16.interventions %llu\n", I2C2_BUS.interventions - start );
+
+	I2C2_BUS.tx_threshold = I2C_TX_THRESHOLD_AUTO;
+	start = I2C2_BUS.interventions;
+	MEASURE ( "fifo.frame_16", PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED0_ON_L, frame, sizeof ( frame ) ) );
+	printf ( "fifo.frame_16.interventions %llu\n", I2C2_BUS.interventions - start );
+
+	//the 90 degree move through the interrupt driven queue, the CPU sleeps in WFI while the bus works and Timer2
+	//holds the deadline of every transaction
+	INTC_INIT ( );
+	I2C_QUEUE_INIT ( &I2C2_QUEUE );
+	TIMER_SERVICE_INIT ( &TIMER2_SERVICE );
+	I2C2_QUEUE.timers = &TIMER2_SERVICE;
+	MEASURE ( "async.servo_update", {
+		PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED8_ON_L, PCA_90_DEGREES, sizeof ( PCA_90_DEGREES ), &done );
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	} );
+	printf ( "async.servo_update.result %d\n", done );
+	if ( I2C_QUEUE_WRITE ( &I2C2_QUEUE, PCA9685_ADDRESS, frame, 0, 0, 0, 0 ) != I2C_ERR_LENGTH ||
+	     I2C_QUEUE_WRITE ( &I2C2_QUEUE, PCA9685_ADDRESS, frame, I2C_QUEUE_MAX_BYTES + 1, 0, 0, 0 ) != I2C_ERR_LENGTH ) {
+		printf ( "error the queue took a transaction no ring entry can hold\n" );
+		return 1;
+	}
+
+	//16 moves queued back to back, then back to 0 degrees
+	start = I2C2_QUEUE.completed;
+	MEASURE ( "async.queue_16", {
+		for ( unsigned int i = 0; i < 16; i++ ) {
+			PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED8_ON_L, i % 2 ? frame : PCA_90_DEGREES, 4, &done );
+		}
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	} );
+	printf ( "async.queue_16.completed %llu\n", I2C2_QUEUE.completed - start );
+	printf ( "async.max_depth %u\n", I2C2_QUEUE.max_depth );
+	printf ( "async.mean_latency_cycles %llu\n", I2C2_QUEUE.latency_cycles / I2C2_QUEUE.completed );
+	printf ( "async.max_latency_cycles %u\n", I2C2_QUEUE.max_latency_cycles );
+
+	//the three positions as a streamed trajectory, one frame per 20 ms PWM period through the queued cache; INIT
+	//takes whatever was in the structure before, a frame timer included
+	PCA9685_CACHE_INIT ( &cache, &I2C2_BUS, &I2C2_QUEUE, PCA9685_ADDRESS );
+	PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+	PCA9685_CACHE_FLUSH ( &cache );
+	I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	memset ( &trajectory, 0xFF, sizeof ( trajectory ) );
+	TRAJECTORY_INIT ( &trajectory, &cache, &servos, PCA9685_PRESCALE_50HZ );
+	if ( trajectory.frame_timer.active ) {
+		printf ( "error TRAJECTORY_INIT left the frame timer active\n" );
+		return 1;
+	}
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( 90 ) );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( -90 ) );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( 0 ) );
+	MEASURE ( "trajectory.stream", {
+		TRAJECTORY_RUN ( &trajectory );
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	} );
+	printf ( "trajectory.period_us %u\n", trajectory.period_us );
+	printf ( "trajectory.steps %u\n", trajectory.steps );
+	printf ( "trajectory.frames %u\n", trajectory.frames );
+	printf ( "trajectory.repeats %u\n", trajectory.repeats );
+	printf ( "trajectory.missed %u\n", trajectory.missed );
+	printf ( "trajectory.jitter_min_cycles %u\n", trajectory.jitter_min );
+	printf ( "trajectory.jitter_max_cycles %u\n", trajectory.jitter_max );
+	printf ( "trajectory.jitter_mean_cycles %llu\n", trajectory.jitter_sum / ( trajectory.frames + trajectory.repeats ) );
+	printf ( "trajectory.bytes_per_frame %.1f\n", (double) measured.bus_bytes / trajectory.frames );
+
+	//a producer that holds the CPU for 50 ms every tenth setpoint: one slot is lost, the next one is served 10 ms late
+	TRAJECTORY_INIT ( &trajectory, &cache, &servos, PCA9685_PRESCALE_50HZ );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( 45 ) );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( 0 ) );
+	while ( !TRAJECTORY_IDLE ( &trajectory ) ) {
+		if ( !trajectory.fresh ) {
+			TRAJECTORY_STEP ( &trajectory );
+			if ( trajectory.steps % 10 == 0 ) {
+				CPU_SPIN ( 50000000 / SIM_SPIN_NS );
+			}
+		}
+		if ( !TRAJECTORY_POLL ( &trajectory, CYCLE_COUNT ( ) ) ) {
+			CPU_SPIN ( TRAJECTORY_POLL_SPIN );
+		}
+	}
+	I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	printf ( "trajectory_stalled.frames %u\n", trajectory.frames );
+	printf ( "trajectory_stalled.missed %u\n", trajectory.missed );
+	printf ( "trajectory_stalled.jitter_max_cycles %u\n", trajectory.jitter_max );
+
+	//Timer2 as a free running tick: a 1 ms delay sleeps in WFI, the CPU only pays for arming and the interrupt
+	TIMER_SERVICE_INIT ( &TIMER2_SERVICE );
+	MEASURE ( "timer.delay_1ms", TIMER_DELAY ( &TIMER2_SERVICE, TIMER_MS ( 1 ) ) );
+	printf ( "timer.delay_1ms.error_ns %lld\n", (long long) measured.now_ns - 1000000 );
+
+	//64 one-shot timers started in scattered order, the sorted insert walks the list
+	MEASURE ( "timer.oneshot_64", {
+		for ( unsigned int i = 0; i < 64; i++ ) {
+			TIMER_START ( &TIMER2_SERVICE, &timers[i], TIMER_US ( 100 + ( i * 37 ) % 64 * 10 ), 0, COUNT_TICK, 0 );
+		}
+		TIMER_DELAY ( &TIMER2_SERVICE, TIMER_MS ( 1 ) );
+	} );
+	printf ( "timer.oneshot_64.fired %u\n", ticks );
+	printf ( "timer.start_cycles_per_timer %llu\n", TIMER2_SERVICE.start_cycles / TIMER2_SERVICE.started );
+	printf ( "timer.insert_steps_per_timer %u\n", TIMER2_SERVICE.insert_steps / TIMER2_SERVICE.started );
+	printf ( "timer.irq_cycles_per_fire %llu\n", TIMER2_SERVICE.irq_cycles / TIMER2_SERVICE.fired );
+	printf ( "timer.mean_late_ns %llu\n", TIMER2_SERVICE.late_ticks * 1000 / ( TIMER_HZ / 1000000 ) / TIMER2_SERVICE.fired );
+	printf ( "timer.max_late_ns %llu\n", (unsigned long long) TIMER2_SERVICE.max_late_ticks * 1000 / ( TIMER_HZ / 1000000 ) );
+
+	//a 1 ms periodic timer across the 32 bit wrap of TCRR, the overflow interrupt carries TIMER_NOW on
+	REG_WRITE ( TIMER2_BASE_ADDRESS + TCRR, 0xFFFFFFFF - (unsigned int) TIMER_MS ( 5 ) );
+	ticks = 0;
+	start = TIMER_NOW ( &TIMER2_SERVICE );
+	TIMER_START ( &TIMER2_SERVICE, &timers[0], TIMER_MS ( 1 ), TIMER_MS ( 1 ), COUNT_TICK, 0 );
+	TIMER_DELAY ( &TIMER2_SERVICE, TIMER_US ( 10500 ) );
+	TIMER_CANCEL ( &TIMER2_SERVICE, &timers[0] );
+	printf ( "timer.periodic_1ms.fired %u\n", ticks );
+	printf ( "timer.periodic_1ms.overflows %u\n", TIMER2_SERVICE.overflows );
+	printf ( "timer.periodic_1ms.elapsed_us %llu\n", ( TIMER_NOW ( &TIMER2_SERVICE ) - start ) / ( TIMER_HZ / 1000000 ) );
+	if ( ticks != 10 ) {
+		printf ( "error the periodic timer fired %u times instead of 10\n", ticks );
+		return 1;
+	}
+
+	//the same moves from scheduler tasks: Timer2 posts the writer every period, the producer runs while the frame
+	//is on the bus, and the CPU sleeps in between instead of spinning on the cycle counter
+	SCHED_INIT ( &scheduler );
+	SCHED_TASK_INIT ( &finished, &scheduler, STOP_STREAM, &trajectory );
+	TRAJECTORY_INIT ( &trajectory, &cache, &servos, PCA9685_PRESCALE_50HZ );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( 90 ) );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( -90 ) );
+	TRAJECTORY_WAYPOINT ( &trajectory, 8, SERVO_ANGLE ( 0 ) );
+	MEASURE ( "sched.stream", {
+		TRAJECTORY_STREAM ( &trajectory, &scheduler, &TIMER2_SERVICE );
+		TRAJECTORY_NOTIFY ( &trajectory, &finished );
+		SCHED_RUN ( &scheduler );
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	} );
+	printf ( "sched.stream.frames %u\n", trajectory.frames );
+	printf ( "sched.stream.missed %u\n", trajectory.missed );
+	printf ( "sched.stream.jitter_max_cycles %u\n", trajectory.jitter_max );
+	printf ( "sched.stream.jitter_mean_cycles %llu\n", trajectory.jitter_sum / ( trajectory.frames + trajectory.repeats ) );
+	printf ( "sched.runs %u\n", scheduler.runs );
+	printf ( "sched.sleeps %u\n", scheduler.sleeps );
+	printf ( "sched.max_depth %u\n", scheduler.max_depth );
+	printf ( "sched.max_task_cycles %u\n", scheduler.max_task_cycles );
+	printf ( "sched.busy_cycles %llu\n", scheduler.busy_cycles );
+	printf ( "sched.utilization_pct %.3f\n", 100.0 * scheduler.busy_cycles / ( scheduler.busy_cycles + scheduler.idle_cycles ) );
+
+	//PCA9685 boards at 0x40 to 0x43 on each of I2C0, I2C1 and I2C2, every bus with its own queue
+	for ( unsigned int i = 1; i < 4; i++ ) {
+		SIM_ATTACH_PCA ( I2C2_BASE_ADDRESS, (unsigned char) ( PCA9685_ADDRESS + i ) );
+	}
+	for ( unsigned int i = 0; i < 4; i++ ) {
+		SIM_ATTACH_PCA ( I2C0_BASE_ADDRESS, (unsigned char) ( PCA9685_ADDRESS + i ) );
+		SIM_ATTACH_PCA ( I2C1_BASE_ADDRESS, (unsigned char) ( PCA9685_ADDRESS + i ) );
+	}
+	I2C_PINMUX_AND_CLOCK ( &I2C0_BUS );
+	I2C_PINMUX_AND_CLOCK ( &I2C1_BUS );
+	I2C_INIT ( &I2C0_BUS );
+	I2C_INIT ( &I2C1_BUS );
+	I2C_QUEUE_INIT ( &I2C0_QUEUE );
+	I2C_QUEUE_INIT ( &I2C1_QUEUE );
+
+	//64 channels on I2C2 alone, then 192 on the three buses
+	for ( unsigned int buses = 1; buses <= 3; buses += 2 ) {
+		static I2C_QUEUE *const QUEUES [ 3 ] = { &I2C2_QUEUE, &I2C0_QUEUE, &I2C1_QUEUE };
+		char label [ 32 ];
+
+		PCA9685_BANK_INIT ( &bank );
+		for ( unsigned int i = 0; i < 4 * buses; i++ ) {
+			PCA9685_CACHE_INIT ( &boards[i], QUEUES[i / 4]->bus, QUEUES[i / 4], PCA9685_ADDRESS + i % 4 );
+			PCA9685_BANK_ADD ( &bank, &boards[i] );
+		}
+
+		//SLEEP, PRE_SCALE, wake and RESTART for every board, one transaction per bus for each step
+		snprintf ( label, sizeof ( label ), "bank_%ubus.config", buses );
+		MEASURE ( label, {
+			unsigned char mode1 = MODE1_SLEEP | MODE1_ALLCALL;
+			unsigned char prescale = PCA9685_PRESCALE_50HZ;
+
+			PCA9685_BANK_BROADCAST ( &bank, PCA9685_ALLCALL_ADDRESS, MODE1, &mode1, 1 );
+			PCA9685_BANK_BROADCAST ( &bank, PCA9685_ALLCALL_ADDRESS, PRE_SCALE_SERVO, &prescale, 1 );
+			mode1 = MODE1_AI | MODE1_ALLCALL;
+			PCA9685_BANK_BROADCAST ( &bank, PCA9685_ALLCALL_ADDRESS, MODE1, &mode1, 1 );
+			PCA9685_BANK_WAIT ( &bank );
+			TIMER_DELAY ( &TIMER2_SERVICE, TIMER_US ( 500 ) );
+			mode1 = MODE1_RESTART | MODE1_AI | MODE1_ALLCALL;
+			PCA9685_BANK_BROADCAST ( &bank, PCA9685_ALLCALL_ADDRESS, MODE1, &mode1, 1 );
+			PCA9685_BANK_WAIT ( &bank );
+		} );
+
+		//an update where every channel changes, one burst per board
+		for ( unsigned int channel = 0; channel < bank.channels; channel++ ) {
+			bank_width[channel] = (unsigned short) ( 205 + channel * 13 % 205 );
+		}
+		snprintf ( label, sizeof ( label ), "bank_%ubus.frame_%u", buses, bank.channels );
+		MEASURE ( label, {
+			PCA9685_BANK_WRITE_FRAME ( &bank, bank_width );
+			PCA9685_BANK_WAIT ( &bank );
+		} );
+		printf ( "%s.channels_per_period %llu\n", label, bank.channels * 20000000ULL / measured.now_ns );
+
+		//the same width on every channel of every board: ALL_LED once per bus through ALLCALL
+		for ( unsigned int channel = 0; channel < bank.channels; channel++ ) {
+			bank_width[channel] = 307;
+		}
+		snprintf ( label, sizeof ( label ), "bank_%ubus.all_call", buses );
+		MEASURE ( label, {
+			PCA9685_BANK_WRITE_FRAME ( &bank, bank_width );
+			PCA9685_BANK_WAIT ( &bank );
+		} );
+		printf ( "%s.broadcast_transactions %u\n", label, bank.broadcast_transactions );
+	}
+	if ( SIM_BUS_PCA_REG ( I2C1_BASE_ADDRESS, PCA9685_ADDRESS + 3, LED_OFF_L ( 15 ) ) != ( 307 & 0xFF )
+	     || SIM_BUS_PCA_REG ( I2C0_BASE_ADDRESS, PCA9685_ADDRESS + 2, PRE_SCALE_SERVO ) != PCA9685_PRESCALE_50HZ ) {
+		printf ( "error the broadcast did not reach the boards on I2C0 and I2C1\n" );
+		return 1;
+	}
+
+	//a broadcast that fails on the second bus: the board on the first bus has the value and its mirror forgets it, the
+	//mirror of the board that did not answer is lost
+	PCA9685_BANK_INIT ( &bank );
+	PCA9685_CACHE_INIT ( &boards[0], &I2C0_BUS, 0, PCA9685_ADDRESS );
+	PCA9685_CACHE_INIT ( &boards[1], &I2C1_BUS, 0, PCA9685_ADDRESS + 8 );
+	PCA9685_BANK_ADD ( &bank, &boards[0] );
+	PCA9685_BANK_ADD ( &bank, &boards[1] );
+	PCA9685_BANK_SUBADDRESS ( &bank, 1, 1, PCA9685_ADDRESS + 8 );
+	poke[0] = 0x42;
+	PCA9685_CACHE_ASSUME ( &boards[1], LED_OFF_L ( 0 ), poke, 1 );
+	if ( PCA9685_BANK_BROADCAST ( &bank, PCA9685_ADDRESS + 8, LED_OFF_L ( 0 ), poke, 1 ) == I2C_OK
+	     || bank.broadcast_failures != 1 || boards[0].valid[LED_OFF_L ( 0 )] || !boards[0].valid[SUBADR1]
+	     || boards[1].valid[LED_OFF_L ( 0 )] || SIM_BUS_PCA_REG ( I2C0_BASE_ADDRESS, PCA9685_ADDRESS, LED_OFF_L ( 0 ) ) != 0x42 ) {
+		printf ( "error a broadcast that failed half way left mirrors that do not match the devices\n" );
+		return 1;
+	}
+	PCA9685_BANK_SUBADDRESS ( &bank, 0, 1, PCA9685_ADDRESS + 8 );
+
+	//register reads: the register byte, a repeated START and the data in one transaction; MODE1 and MODE2, then
+	//the 64 channel registers through the receive FIFO, half a FIFO per RRDY
+	MEASURE ( "read.mode", PCA9685_READ_BURST ( &I2C2_BUS, PCA9685_ADDRESS, MODE1, readback, 2 ) );
+	MEASURE ( "read.frame_16", PCA9685_READ_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED0_ON_L, readback, sizeof ( readback ) ) );
+	for ( unsigned int i = 0; i < sizeof ( readback ); i++ ) {
+		if ( readback[i] != SIM_PCA_REG ( PCA9685_ADDRESS, LED0_ON_L + i ) ) {
+			printf ( "error register 0x%02x read back as 0x%02x\n", LED0_ON_L + i, readback[i] );
+			return 1;
+		}
+	}
+	PRINT_WAITS ( "read", &I2C2_BUS );
+
+	//the check between two rounds of Part 2: the configuration written again blindly against read back
+	PCA9685_CACHE_INIT ( &cache, &I2C2_BUS, 0, PCA9685_ADDRESS );
+	MEASURE ( "reinit.config", {
+		PCA9685_CACHE_INVALIDATE ( &cache );
+		PCA9685_CACHE_SET_PRESCALE ( &cache, PCA9685_PRESCALE_50HZ );
+		PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+		PCA9685_CACHE_WRITE ( &cache, MODE2, 0x04 );
+		PCA9685_CACHE_FLUSH ( &cache );
+	} );
+	MEASURE ( "verify.config", {
+		PCA9685_CACHE_VERIFY ( &cache, MODE1, 2 );
+		PCA9685_CACHE_VERIFY ( &cache, PRE_SCALE_SERVO, 1 );
+		PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+		PCA9685_CACHE_WRITE ( &cache, MODE2, 0x04 );
+		PCA9685_CACHE_FLUSH ( &cache );
+	} );
+
+	//the device put to sleep behind the mirror: the read-back finds it and only MODE1 is sent again
+	poke[0] = MODE1;
+	poke[1] = MODE1_SLEEP | MODE1_AI | MODE1_ALLCALL;
+	I2C_WRITE ( &I2C2_BUS, PCA9685_ADDRESS, poke, 2 );
+	MEASURE ( "verify.repair", {
+		PCA9685_CACHE_VERIFY ( &cache, MODE1, 2 );
+		PCA9685_CACHE_VERIFY ( &cache, PRE_SCALE_SERVO, 1 );
+		PCA9685_CACHE_WRITE ( &cache, MODE1, MODE1_AI | MODE1_ALLCALL );
+		PCA9685_CACHE_WRITE ( &cache, MODE2, 0x04 );
+		PCA9685_CACHE_FLUSH ( &cache );
+	} );
+	printf ( "verify.mismatches %u\n", cache.mismatches );
+	if ( SIM_PCA_REG ( PCA9685_ADDRESS, MODE1 ) != ( MODE1_AI | MODE1_ALLCALL ) ) {
+		printf ( "error MODE1 was not repaired\n" );
+		return 1;
+	}
+
+	//verify mode: every frame is read back in one transaction; LED8 overwritten behind the mirror is caught with
+	//the next frame and sent again
+	cache.verify = 1;
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		widths[channel] = 307;
+	}
+	widths[0] = 410;
+	MEASURE ( "verify.frame_16", PCA9685_CACHE_WRITE_FRAME ( &cache, widths ) );
+	poke[0] = LED8_OFF_L;
+	poke[1] = 0x99;
+	I2C_WRITE ( &I2C2_BUS, PCA9685_ADDRESS, poke, 2 );
+	widths[3] = 410;
+	MEASURE ( "verify.frame_repair", PCA9685_CACHE_WRITE_FRAME ( &cache, widths ) );
+	printf ( "verify.verifies %u\nverify.repairs %u\n", cache.verifies, cache.repairs );
+	if ( SIM_PCA_REG ( PCA9685_ADDRESS, LED8_OFF_L ) != ( 307 & 0xFF ) ) {
+		printf ( "error LED8 was not repaired\n" );
+		return 1;
+	}
+	cache.verify = 0;
+
+	//bus faults one at a time under the same one channel update, the recovery ladder starts from the cheapest step
+	//that fits; the hang and the stuck SDA are only seen when a wait runs out, so their time includes a timeout
+	PCA9685_CACHE_ATTACH_RECOVERY ( &cache );
+	for ( unsigned int fault = 0; fault < 6; fault++ ) {
+		static const char *names [ ] = { "nack", "nack_x3", "arbitration", "sda_stuck", "hang", "wedge" };
+		static const char *steps [ I2C_STEPS ] = { "retry", "stop", "bus_clear", "reset", "reinit" };
+		unsigned int taken [ I2C_STEPS ];
+		char label [ 32 ];
+		int result = I2C_OK;
+
+		switch ( fault ) {
+		case 0: SIM_INJECT_NACK ( I2C2_BASE_ADDRESS, 1 ); break;
+		case 1: SIM_INJECT_NACK ( I2C2_BASE_ADDRESS, 3 ); break;
+		case 2: SIM_INJECT_ARBITRATION_LOSS ( I2C2_BASE_ADDRESS, 1 ); break;
+		case 3: SIM_INJECT_SDA_STUCK ( I2C2_BASE_ADDRESS, 5 ); break;
+		case 4: SIM_INJECT_HANG ( I2C2_BASE_ADDRESS ); break;
+		case 5: SIM_INJECT_WEDGE ( I2C2_BASE_ADDRESS, PCA9685_ADDRESS ); break;
+		}
+		for ( unsigned int step = 0; step < I2C_STEPS; step++ ) {
+			taken[step] = I2C2_BUS.steps[step];
+		}
+		snprintf ( label, sizeof ( label ), "fault.%s", names[fault] );
+		MEASURE ( label, result = PCA9685_SET_CHANNEL ( &I2C2_BUS, PCA9685_ADDRESS, 8, 0, 0x132 ) );
+		printf ( "%s.result %d\n", label, result );
+		for ( unsigned int step = 0; step < I2C_STEPS; step++ ) {
+			printf ( "%s.steps.%s %u\n", label, steps[step], I2C2_BUS.steps[step] - taken[step] );
+		}
+		if ( result != I2C_OK || SIM_PCA_REG ( PCA9685_ADDRESS, LED8_OFF_L ) != 0x32 ) {
+			printf ( "error the update did not get through the %s fault\n", names[fault] );
+			return 1;
+		}
+	}
+	for ( unsigned int step = 0; step < I2C_STEPS; step++ ) {
+		static const char *steps [ I2C_STEPS ] = { "retry", "stop", "bus_clear", "reset", "reinit" };
+
+		printf ( "fault.step_max_cycles.%s %u\n", steps[step], I2C2_BUS.step_max_cycles[step] );
+	}
+	printf ( "fault.overruns %u\nfault.recovered %u\nfault.unrecovered %u\n", I2C2_BUS.overruns, I2C2_BUS.recovered,
+	         I2C2_BUS.unrecovered );
+	printf ( "fault.recovery_max_cycles %u\nfault.bus_stuck %u\n", I2C2_BUS.recovery_max_cycles, I2C2_BUS.bus_stuck );
+	printf ( "fault.nacks %u\nfault.arbitration_lost %u\nfault.timeouts %u\n", I2C2_BUS.nacks, I2C2_BUS.arbitration_lost,
+	         I2C2_BUS.timeouts );
+	printf ( "fault.restores %u\n", cache.restores );
+
+	//the queue gets the head transaction through a NACK with one more try; the handler only stops the queue, the
+	//reset is left to I2C_QUEUE_FLUSH
+	SIM_INJECT_NACK ( I2C2_BASE_ADDRESS, 1 );
+	start = I2C2_BUS.resets;
+	PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED8_ON_L, PCA_MOVES[0], 4, &done );
+	CPU_SPIN ( 1000 * CPU_MHZ );
+	if ( !I2C2_QUEUE.fault || I2C2_BUS.resets != start ) {
+		printf ( "error the handler did not leave the NACK to the task side\n" );
+		return 1;
+	}
+	MEASURE ( "fault.async_nack", I2C_QUEUE_FLUSH ( &I2C2_QUEUE ) );
+	printf ( "fault.async_nack.result %d\nfault.async_nack.retries %u\n", done, I2C2_QUEUE.retries );
+	if ( done != I2C_OK || I2C2_BUS.resets == start ) {
+		printf ( "error the queue did not recover from the NACK\n" );
+		return 1;
+	}
+
+	//a hung controller never interrupts again, the watchdog fails the transaction and the flush returns
+	SIM_INJECT_HANG ( I2C2_BASE_ADDRESS );
+	MEASURE ( "fault.async_hang", {
+		PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED8_ON_L, PCA_MOVES[0], 4, &done );
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	} );
+	printf ( "fault.async_hang.result %d\nfault.async_hang.timeouts %u\n", done, I2C2_QUEUE.timeouts );
+	if ( done != I2C_ERR_TIMEOUT || I2C2_QUEUE.timeouts != 1 ) {
+		printf ( "error the hung transaction was not timed out\n" );
+		return 1;
+	}
+
+	//without a timer service the flush polls the cycle counter for the same deadline
+	I2C2_QUEUE.timers = 0;
+	SIM_INJECT_HANG ( I2C2_BASE_ADDRESS );
+	PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED8_ON_L, PCA_MOVES[0], 4, &done );
+	I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	I2C2_QUEUE.timers = &TIMER2_SERVICE;
+	if ( done != I2C_ERR_TIMEOUT || I2C2_QUEUE.timeouts != 2 ) {
+		printf ( "error the polled flush did not time out the hung transaction\n" );
+		return 1;
+	}
+	PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED8_ON_L, PCA_MOVES[0], 4, &done );
+	I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	if ( done != I2C_OK ) {
+		printf ( "error the queue did not come back after the timeout\n" );
+		return 1;
+	}
+
+	//the Part 1 set up: the same five transactions from a pair table and from a sequence
+	MEASURE ( "pairs.setup", {
+		I2C_WRITE_PAIRS ( &I2C2_BUS, PCA9685_ADDRESS, PCA_INIT, sizeof ( PCA_INIT ) / sizeof ( PCA_INIT[0] ) );
+		PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED15_ON_H, LED15_FULL_ON, sizeof ( LED15_FULL_ON ) );
+	} );
+	printf ( "pairs.setup.table_bytes %u\n", (unsigned int) ( sizeof ( PCA_INIT ) + sizeof ( LED15_FULL_ON ) ) );
+	SEQ_INIT ( &sequence, PCA_SETUP, sizeof ( PCA_SETUP ), &I2C2_BUS, 0, GPIO1_BASE_ADDRESS, 0, 0 );
+	MEASURE ( "seq.setup", stepper.result = SEQ_RUN ( &sequence ) );
+	printf ( "seq.setup.table_bytes %u\nseq.setup.result %d\n", (unsigned int) sizeof ( PCA_SETUP ), stepper.result );
+	if ( stepper.result != I2C_OK || SIM_PCA_REG ( PCA9685_ADDRESS, LED15_ON_H ) != 0x10 ) {
+		printf ( "error the set up sequence did not run\n" );
+		return 1;
+	}
+
+	//a looping sequence as a scheduler task: queued writes, GPIO, waits for the queue and timer delays
+	SCHED_INIT ( &scheduler );
+	SCHED_TASK_INIT ( &stepper, &scheduler, RUN_SEQUENCE, &sequence );
+	SEQ_INIT ( &sequence, PCA_SWING, sizeof ( PCA_SWING ), &I2C2_BUS, &I2C2_QUEUE, GPIO1_BASE_ADDRESS, &TIMER2_SERVICE,
+	           &stepper );
+	MEASURE ( "seq.swing", {
+		SCHED_POST ( &stepper );
+		SCHED_RUN ( &scheduler );
+	} );
+	printf ( "seq.swing.result %d\nseq.swing.table_bytes %u\n", stepper.result, (unsigned int) sizeof ( PCA_SWING ) );
+	printf ( "seq.swing.ops %u\nseq.swing.writes %u\nseq.swing.delays %u\n", sequence.ops, sequence.writes,
+	         sequence.delays );
+	printf ( "seq.swing.waits %u\nseq.swing.blocks %u\nseq.swing.task_runs %u\n", sequence.waits, sequence.blocks,
+	         stepper.runs );
+	if ( stepper.result != I2C_OK || SIM_PCA_REG ( PCA9685_ADDRESS, LED8_OFF_L ) != 0x32 ) {
+		printf ( "error the swing sequence did not finish at 0 degrees\n" );
+		return 1;
+	}
+
+	//LED0 to LED2 turned on the way Part 2 did it, a SETDATAOUT write and a read-modify-write of OUTPUT_ENABLE for
+	//each LED, then from a group that made its pins outputs once and only writes
+	MEASURE ( "led.rmw_on_3", {
+		for ( unsigned int i = 0; i < 3; i++ ) {
+			REG_WRITE ( GPIO1_BASE_ADDRESS + SETDATAOUT, GPIO_USR0 << i );
+			REG_WRITE ( GPIO1_BASE_ADDRESS + OUTPUT_ENABLE,
+			            REG_READ ( GPIO1_BASE_ADDRESS + OUTPUT_ENABLE ) & ~( GPIO_USR0 << i ) );
+		}
+	} );
+	REG_WRITE ( GPIO1_BASE_ADDRESS + OUTPUT_ENABLE, 0xFFFFFFFF );
+	REG_WRITE ( GPIO1_BASE_ADDRESS + CLEARDATAOUT, GPIO_USR_LEDS );
+	MEASURE ( "led.group_init", GPIO_GROUP_INIT ( &leds, GPIO1_BASE_ADDRESS, GPIO_USR_LEDS ) );
+	MEASURE ( "led.group_on_3", {
+		for ( unsigned int i = 0; i < 3; i++ ) {
+			GPIO_GROUP_SET ( &leds, GPIO_USR0 << i );
+		}
+	} );
+
+	//a walk changes two pins per step, one SETDATAOUT and one CLEARDATAOUT write whatever the pattern
+	MEASURE ( "led.group_walk", {
+		for ( unsigned int i = 0; i < sizeof ( LED_WALK ) / sizeof ( LED_WALK[0] ); i++ ) {
+			GPIO_GROUP_WRITE ( &leds, LED_WALK[i] );
+		}
+	} );
+	printf ( "led.group_walk.pins 0x%08X\n", SIM_GPIO1_PINS ( ) );
+
+	//all four LEDs blinking at 5 Hz from Timer2 for 5 periods, the CPU sleeps in between
+	MEASURE ( "led.blink_5", {
+		GPIO_GROUP_PLAY ( &leds, &TIMER2_SERVICE, LED_BLINK, 2, TIMER_MS ( 100 ), 5 );
+		while ( leds.playing ) {
+			CPU_WAIT_FOR_INTERRUPT ( );
+		}
+	} );
+	printf ( "led.group.updates %u\nled.group.writes %u\nled.group.unchanged %u\nled.group.ticks %u\n", leds.updates,
+	         leds.writes, leds.unchanged, leds.ticks );
+	if ( measured.gpio_edges != 40 || SIM_GPIO1_PINS ( ) != 0 ) {
+		printf ( "error the LEDs did not blink 5 times and end off\n" );
+		return 1;
+	}
+
+#ifdef __linux__
+	//the same PCA9685 layer from a Linux process through i2c-dev, stood in for by the loopback: 4 boards, a frame of
+	//every channel per board, written one register at a time against batched; then the paths outside the flush
+	{
+		unsigned char naive_regs [ 256 ], batched_regs [ 256 ];
+		unsigned int naive = DEV_RUN ( "i2cdev.naive", 0, spread, naive_regs );
+		unsigned int batched = DEV_RUN ( "i2cdev.batched", 1, spread, batched_regs );
+
+		printf ( "i2cdev.syscall_ratio %.1f\n", (double) naive / batched );
+		if ( batched != DEV_FRAMES || memcmp ( &naive_regs[LED0_ON_L], &batched_regs[LED0_ON_L], 4 * PCA9685_CHANNELS ) != 0 ) {
+			printf ( "error the batched frames did not take one ioctl each or did not land like the writes\n" );
+			return 1;
+		}
+		SERVO_FRAME ( &servos, spread, widths );
+		if ( DEV_PATHS ( widths ) != 0 ) {
+			printf ( "error a cache on i2c-dev did not boot, read back, restore, broadcast or sleep\n" );
+			return 1;
+		}
+	}
+#endif
+
+	//the 16 channel frame through the queue three ways: the CPU writes every byte (PIO), the CPU fills FIFO
+	//thresholds, the EDMA moves the bytes; the register byte counts, the address byte does not
+	for ( unsigned int mode = 0; mode < 3; mode++ ) {
+		static const char *names [ ] = { "async_pio", "async_fifo", "async_dma" };
+		char label [ 32 ];
+
+		I2C2_BUS.tx_threshold = mode == 0 ? 1 : I2C_TX_THRESHOLD_AUTO;
+		if ( mode == 2 ) {
+			I2C_DMA_INIT ( &I2C2_DMA, &I2C2_BUS );
+		}
+		snprintf ( label, sizeof ( label ), "%s.frame_16", names[mode] );
+		MEASURE ( label, {
+			PCA9685_WRITE_BURST_ASYNC ( &I2C2_QUEUE, PCA9685_ADDRESS, LED0_ON_L, frame, sizeof ( frame ), &done );
+			I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+		} );
+		printf ( "%s.result %d\n", label, done );
+		printf ( "%s.cpu_cycles_per_byte %.1f\n", label,
+		         (double) measured.cpu_ns * SIM_CPU_MHZ / 1000 / ( sizeof ( frame ) + 1 ) );
+	}
+	printf ( "async_dma.completions %u\n", I2C2_DMA.completed );
+
+	//the blocking call takes the same EDMA path, the CPU only polls for ARDY
+	MEASURE ( "dma.frame_16", PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS, LED0_ON_L, frame, sizeof ( frame ) ) );
+
+	//the servo should now be back at 0 degrees
+	if ( SIM_PCA_REG ( PCA9685_ADDRESS, LED8_OFF_H ) != 0x1 || SIM_PCA_REG ( PCA9685_ADDRESS, LED8_OFF_L ) != 0x32 ) {
+		printf ( "error LED8 registers do not hold the 0 degree pulse\n" );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,83 @@
+/**********************************************************************************************************************
+*   Fast boot                                                                                                         *
+*                                                                                                                     *
+*   A module reports IDLEST 0 once its clock is running and it has left idle. The clocks are independent, so every    *
+*   one is enabled before the first IDLEST read and the wait is as long as the slowest module, not the sum of them.   *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "am335x.h"
+#include "boot.h"
+
+BOOT_STATS BOOT;
+
+void BOOT_CLOCKS_ENABLE ( const unsigned int *clkctrl, unsigned int count ){
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		REG_WRITE ( CM_PER_ADDRESS + clkctrl[i], CM_PER_MODULEMODE_ENABLE );
+	}
+}
+
+int BOOT_CLOCKS_WAIT ( const unsigned int *clkctrl, unsigned int count ){
+
+	unsigned int waiting = ( 1u << count ) - 1;
+
+	//a module that is up is not read again
+	for ( unsigned int round = 0; waiting && round < BOOT_CLOCK_POLLS; round++ ) {
+		for ( unsigned int i = 0; i < count; i++ ) {
+			if ( ( waiting & ( 1u << i ) ) == 0 ) {
+				continue;
+			}
+			BOOT.clock_polls++;
+			if ( ( REG_READ ( CM_PER_ADDRESS + clkctrl[i] ) & CM_PER_IDLEST_MASK ) == 0 ) {
+				waiting &= ~( 1u << i );
+			}
+		}
+	}
+	return waiting ? I2C_ERR_TIMEOUT : I2C_OK;
+}
+
+//the modules BOOT_INIT turns on but does not wait for
+static const unsigned int BOOT_LATE_CLOCKS [ 2 ] = { CM_PER_GPIO1_CLKCTRL, CM_PER_TIMER2_CLKCTRL };
+
+int BOOT_INIT ( I2C_BUS *bus ){
+
+	unsigned int clkctrl = I2C_CLKCTRL ( bus );
+	int result;
+
+	CYCLE_COUNTER_INIT ( );
+	BOOT.start = CYCLE_COUNT ( );
+	BOOT.clock_polls = 0;
+
+	//the I2C clock first, it is the one the first pulse waits for; Timer2 gets its functional clock selected before
+	//it is turned on, and the pads are written while the clocks start
+	BOOT_CLOCKS_ENABLE ( &clkctrl, 1 );
+	REG_WRITE ( CM_PER_ADDRESS + PRCMCLKSEL_TIMER2, CLKSEL_TIMER_M_OSC );
+	BOOT_CLOCKS_ENABLE ( BOOT_LATE_CLOCKS, 2 );
+	I2C_PINMUX ( bus );
+
+	if ( ( result = BOOT_CLOCKS_WAIT ( &clkctrl, 1 ) ) == I2C_OK ) {
+		result = I2C_INIT ( bus );
+	}
+	BOOT.init_cycles = CYCLE_COUNT ( ) - BOOT.start;
+	return result;
+}
+
+int BOOT_FINISH ( void ){
+
+	int result = BOOT_CLOCKS_WAIT ( BOOT_LATE_CLOCKS, 2 );
+
+	BOOT.clocks_cycles = CYCLE_COUNT ( ) - BOOT.start;
+	return result;
+}
+
+int BOOT_PCA9685 ( PCA9685_CACHE *cache, unsigned char prescale, const unsigned short width[PCA9685_CHANNELS] ){
+
+	int result = PCA9685_CACHE_BOOT ( cache, prescale, width );
+
+	BOOT.config_cycles = CYCLE_COUNT ( ) - BOOT.start;
+	BOOT.first_pwm_cycles = cache->woken - BOOT.start + PCA9685_OSC_US * CPU_MHZ;
+	return result;
+}
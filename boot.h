@@ -0,0 +1,49 @@
+/**********************************************************************************************************************
+*   Fast boot                                                                                                         *
+*                                                                                                                     *
+*   The start up path from reset to the first servo pulse. BOOT_INIT turns on the I2C, GPIO1 and Timer2 module        *
+*   clocks with one CLKCTRL write each, the I2C one first, writes the I2C pads while the clocks come up, and          *
+*   configures the controller as soon as IDLEST reports the I2C module functional. BOOT_PCA9685 then sends the        *
+*   PCA9685 configuration and the first frame with PCA9685_CACHE_BOOT. GPIO1 and Timer2 finish starting meanwhile;    *
+*   BOOT_FINISH checks them before they are used, which by then is one IDLEST read each, so their start up times      *
+*   overlap instead of adding up.                                                                                     *
+*                                                                                                                     *
+*   BOOT_INIT also starts the cycle counter, and BOOT records how long each part took from there. The first pulse     *
+*   comes PCA9685_OSC_US (500 us) after the wake up, when the PCA9685 oscillator is up.                               *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include "pca9685_cache.h"
+
+#define BOOT_CLOCK_POLLS 1000                       //IDLEST rounds before a module that does not come up is given up
+
+typedef struct {
+	unsigned int start;                 //CYCLE_COUNT when BOOT_INIT started
+	unsigned int clock_polls;           //IDLEST reads until every module was functional
+	unsigned int init_cycles;           //from start until the I2C controller was configured
+	unsigned int clocks_cycles;         //from start until every clock was up
+	unsigned int config_cycles;         //from start until the PCA9685 configuration was sent
+	unsigned int first_pwm_cycles;      //from start until the first pulse: the wake up and the oscillator start up
+} BOOT_STATS;
+
+extern BOOT_STATS BOOT;
+
+//one MODULEMODE enable write per CLKCTRL (offsets from CM_PER_ADDRESS), nothing waits
+void BOOT_CLOCKS_ENABLE ( const unsigned int *clkctrl, unsigned int count );
+
+//poll the IDLEST fields of all the modules together until every one is functional; I2C_OK or I2C_ERR_TIMEOUT
+int BOOT_CLOCKS_WAIT ( const unsigned int *clkctrl, unsigned int count );
+
+//the clocks of bus, GPIO1 and Timer2 and the pads of bus, then I2C_INIT once the bus module is up
+int BOOT_INIT ( I2C_BUS *bus );
+
+//wait until GPIO1 and Timer2 are functional, before either is touched
+int BOOT_FINISH ( void );
+
+//PCA9685_CACHE_BOOT of the first frame
+int BOOT_PCA9685 ( PCA9685_CACHE *cache, unsigned char prescale, const unsigned short width[PCA9685_CHANNELS] );
+
+#endif
@@ -0,0 +1,62 @@
+/**********************************************************************************************************************
+*   Cortex-A8 core helpers                                                                                            *
+*                                                                                                                     *
+*   Masking IRQs around data shared with an interrupt handler, sleeping in WFI until the next interrupt, and reading  *
+*   the PMU cycle counter. On a host build with -DAM335X_SIM they map to the simulated core in sim_am335x.c.          *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef CPU_H
+#define CPU_H
+
+#ifdef AM335X_SIM
+
+#include "sim_am335x.h"
+
+#define CPU_MHZ SIM_CPU_MHZ
+#define IRQ_SAVE() SIM_IRQ_SAVE ( )
+#define IRQ_RESTORE(state) SIM_IRQ_RESTORE ( state )
+#define IRQ_ENABLE() SIM_IRQ_RESTORE ( 1 )
+#define CPU_WAIT_FOR_INTERRUPT() SIM_WFI ( )
+#define CYCLE_COUNTER_INIT()
+#define CYCLE_COUNT() SIM_CYCLES ( )
+
+#else
+
+#define CPU_MHZ 1000                    //Cortex-A8 core clock of the Beaglebone Black
+
+//mask IRQs and return the previous CPSR
+static inline unsigned int IRQ_SAVE ( void )
+{
+	unsigned int cpsr;
+
+	asm volatile ( "mrs %0, cpsr\n\tcpsid i" : "=r" ( cpsr ) : : "memory" );
+	return cpsr;
+}
+
+//put the I bit back the way IRQ_SAVE found it
+static inline void IRQ_RESTORE ( unsigned int cpsr )
+{
+	asm volatile ( "msr cpsr_c, %0" : : "r" ( cpsr ) : "memory" );
+}
+
+#define IRQ_ENABLE() asm volatile ( "cpsie i" : : : "memory" )
+#define CPU_WAIT_FOR_INTERRUPT() asm volatile ( "dsb\n\twfi" : : : "memory" )
+
+//turn on the PMU cycle counter (PMCR E and C bits, then PMCNTENSET bit 31)
+#define CYCLE_COUNTER_INIT() do { \
+		asm volatile ( "mcr p15, 0, %0, c9, c12, 0" : : "r" ( 0x5 ) ); \
+		asm volatile ( "mcr p15, 0, %0, c9, c12, 1" : : "r" ( 0x80000000 ) ); \
+	} while ( 0 )
+
+static inline unsigned int CYCLE_COUNT ( void )
+{
+	unsigned int cycles;
+
+	asm volatile ( "mrc p15, 0, %0, c9, c13, 0" : "=r" ( cycles ) );
+	return cycles;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,100 @@
+/**********************************************************************************************************************
+*   GPIO output groups                                                                                                *
+*                                                                                                                     *
+*   The shadow is changed with interrupts masked, so a pattern step from the timer and an update from the main loop   *
+*   never write from a stale copy.                                                                                    *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "gpio.h"
+
+void GPIO_GROUP_INIT ( GPIO_GROUP *group, unsigned int base, unsigned int mask ){
+
+	group->base = base;
+	group->mask = mask;
+	group->state = 0;
+	group->timer.active = 0;
+	group->timers = 0;
+	group->playing = 0;
+	group->updates = group->writes = group->unchanged = group->ticks = 0;
+
+	//low before they become outputs, so they do not glitch to whatever DATAOUT held
+	REG_WRITE ( base + CLEARDATAOUT, mask );
+	REG_WRITE ( base + OUTPUT_ENABLE, REG_READ ( base + OUTPUT_ENABLE ) & ~mask );
+}
+
+void GPIO_GROUP_WRITE ( GPIO_GROUP *group, unsigned int pattern ){
+
+	unsigned int state = IRQ_SAVE ( );
+	unsigned int high = pattern & group->mask & ~group->state;
+	unsigned int low = ~pattern & group->mask & group->state;
+
+	group->updates++;
+	if ( high ) {
+		REG_WRITE ( group->base + SETDATAOUT, high );
+		group->writes++;
+	}
+	if ( low ) {
+		REG_WRITE ( group->base + CLEARDATAOUT, low );
+		group->writes++;
+	}
+	if ( !( high | low ) ) {
+		group->unchanged++;
+	}
+	group->state = ( group->state | high ) & ~low;
+	IRQ_RESTORE ( state );
+}
+
+void GPIO_GROUP_SET ( GPIO_GROUP *group, unsigned int pins ){
+
+	GPIO_GROUP_WRITE ( group, group->state | pins );
+}
+
+void GPIO_GROUP_CLEAR ( GPIO_GROUP *group, unsigned int pins ){
+
+	GPIO_GROUP_WRITE ( group, group->state & ~pins );
+}
+
+//the next pattern; the last step of the last pass cancels the timer, which a periodic timer allows from its callback
+static void GPIO_GROUP_TICK ( void *context ){
+
+	GPIO_GROUP *group = context;
+
+	group->ticks++;
+	GPIO_GROUP_WRITE ( group, group->patterns[group->step] );
+	if ( ++group->step == group->steps ) {
+		group->step = 0;
+		if ( group->passes && --group->passes == 0 ) {
+			GPIO_GROUP_STOP ( group );
+		}
+	}
+}
+
+void GPIO_GROUP_PLAY ( GPIO_GROUP *group, TIMER_SERVICE *timers, const unsigned int *patterns, unsigned int steps,
+                       unsigned long long period, unsigned int passes ){
+
+	GPIO_GROUP_STOP ( group );
+	if ( steps == 0 ) {
+		return;
+	}
+	group->timers = timers;
+	group->patterns = patterns;
+	group->steps = steps;
+	group->step = 0;
+	group->passes = passes;
+	group->playing = 1;
+	GPIO_GROUP_TICK ( group );
+	if ( group->playing ) {
+		TIMER_START ( timers, &group->timer, period, period, GPIO_GROUP_TICK, group );
+	}
+}
+
+void GPIO_GROUP_STOP ( GPIO_GROUP *group ){
+
+	if ( group->playing ) {
+		TIMER_CANCEL ( group->timers, &group->timer );
+		group->playing = 0;
+	}
+}
@@ -0,0 +1,64 @@
+/**********************************************************************************************************************
+*   GPIO output groups                                                                                                *
+*                                                                                                                     *
+*   A group is a set of pins of one GPIO module that are driven together, like the four user LEDs on GPIO1 21 to 24.  *
+*   GPIO_GROUP_INIT makes them outputs once, with the only read-modify-write of OUTPUT_ENABLE; from then on the group *
+*   keeps the level of its pins in a shadow, so an update never reads the module. GPIO_GROUP_WRITE sets the pins of a *
+*   new pattern with at most one SETDATAOUT write and one CLEARDATAOUT write, and none for pins that already have the *
+*   level. Both registers only change the pins written as 1, so the other pins of the module are left alone without   *
+*   reading DATAOUT first.                                                                                            *
+*                                                                                                                     *
+*   GPIO_GROUP_PLAY steps through a table of patterns from a periodic timer of the timer service (blinking is a table *
+*   of two), so the main loop does not have to time it. The steps run in the Timer2 interrupt.                        *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef GPIO_H
+#define GPIO_H
+
+#include "timer.h"
+
+//the user LEDs of the Beaglebone Black on GPIO1
+#define GPIO_USR0 ( 1u << 21 )
+#define GPIO_USR1 ( 1u << 22 )
+#define GPIO_USR2 ( 1u << 23 )
+#define GPIO_USR3 ( 1u << 24 )
+#define GPIO_USR_LEDS ( GPIO_USR0 | GPIO_USR1 | GPIO_USR2 | GPIO_USR3 )
+
+typedef struct {
+	unsigned int base;                  //GPIO module
+	unsigned int mask;                  //pins of the group
+	volatile unsigned int state;        //level the pins of the group were last given
+
+	TIMER timer;                        //steps of a pattern
+	TIMER_SERVICE *timers;
+	const unsigned int *patterns;
+	unsigned int steps;
+	volatile unsigned int step;         //next pattern
+	volatile unsigned int passes;       //passes through the table still to run, 0 for ever
+	volatile unsigned int playing;
+
+	//statistics
+	unsigned int updates;               //patterns written
+	unsigned int writes;                //SETDATAOUT and CLEARDATAOUT writes
+	unsigned int unchanged;             //updates that wrote nothing, the pins already had the level
+	unsigned int ticks;                 //pattern steps written by GPIO_GROUP_PLAY and its timer
+} GPIO_GROUP;
+
+//the pins in mask of the module at base become outputs, driven low
+void GPIO_GROUP_INIT ( GPIO_GROUP *group, unsigned int base, unsigned int mask );
+
+//pins of the group set in pattern go high, the others go low; safe from interrupt handlers
+void GPIO_GROUP_WRITE ( GPIO_GROUP *group, unsigned int pattern );
+
+void GPIO_GROUP_SET ( GPIO_GROUP *group, unsigned int pins );      //these pins high, the others keep their level
+void GPIO_GROUP_CLEAR ( GPIO_GROUP *group, unsigned int pins );    //these pins low
+
+//write patterns[0] now and the next one every period ticks, passes times through the table (0 for ever); the group
+//keeps the last pattern when it is done
+void GPIO_GROUP_PLAY ( GPIO_GROUP *group, TIMER_SERVICE *timers, const unsigned int *patterns, unsigned int steps,
+                       unsigned long long period, unsigned int passes );
+
+void GPIO_GROUP_STOP ( GPIO_GROUP *group );         //stop the pattern, the pins keep their level
+
+#endif
@@ -0,0 +1,44 @@
+/**********************************************************************************************************************
+*   Register access backend                                                                                           *
+*                                                                                                                     *
+*   Every peripheral access in the driver goes through REG_READ / REG_WRITE instead of dereferencing the physical     *
+*   address directly. On the Beaglebone Black these are plain volatile loads and stores through HWREG. When the       *
+*   code is built on a host with -DAM335X_SIM they are routed to the simulated AM335x in sim_am335x.c, which models   *
+*   the I2C2 block and the PCA9685 on the other end of the bus and counts every access and bus cycle.                 *
+*                                                                                                                     *
+*   CPU_SPIN replaces the open coded "for ( delay < n ) asm NOP" loops so the simulator can charge their cost too.    *
+*                                                                                                                     *
+*   DMA_ADDRESS gives the address a DMA controller uses for a buffer in memory. On the board that is the pointer      *
+*   itself (the programs run without the MMU and caches, so no cache maintenance is needed). The simulator hands out  *
+*   a 32 bit alias for the host buffer.                                                                               *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef HWREG_H
+#define HWREG_H
+
+#ifdef AM335X_SIM
+
+#include "sim_am335x.h"
+
+#define REG_READ(x) SIM_READ ( (unsigned int) (x) )
+#define REG_WRITE(x, v) SIM_WRITE ( (unsigned int) (x), (unsigned int) (v) )
+#define CPU_SPIN(n) SIM_SPIN ( (unsigned int) (n) )
+#define DMA_ADDRESS(p, n) SIM_DMA_MAP ( (p), (n) )
+
+#else
+
+#define HWREG(x) (*((volatile unsigned int *) (x)))
+
+#define REG_READ(x) HWREG ( x )
+#define REG_WRITE(x, v) ( HWREG ( x ) = (v) )
+#define CPU_SPIN(n) for ( int delay = 0; delay < (n); delay++ ) { asm ("NOP"); }
+#define DMA_ADDRESS(p, n) ( (unsigned int) (p) )
+
+#endif
+
+//read-modify-write helpers, these are two bus accesses on the hardware as well
+#define REG_SET_BITS(x, m) REG_WRITE ( (x), REG_READ ( x ) | (m) )
+#define REG_CLEAR_BITS(x, m) REG_WRITE ( (x), REG_READ ( x ) & ~(m) )
+
+#endif
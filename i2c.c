@@ -0,0 +1,755 @@
+/**********************************************************************************************************************
+*   I2C master transmitter and receiver                                                                               *
+*                                                                                                                     *
+*   The sequence of steps follow the How to program I2C from the Sitara Manual. Before transmitting the data, we      *
+*   wait for the system status register on the bus to give us the signal to set the slave address and the data        *
+*   counter. The next step is to initiate a transfer by polling the bus busy bit from the IRQSTATUS_RAW register so   *
+*   that we can send over the data. After we confirm that the bus is free, we can then check if we can transmit data  *
+*   over the bus by polling the XRDY bit from the IRQSTATUS_RAW register. The data counter will decrement as this is  *
+*   happening.                                                                                                        *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "i2c.h"
+#include "i2c_dma.h"
+#include "i2c_trace.h"
+
+//enable the SCL and SDA lines for using I2C2 and turn on its clock
+void I2C2_PINMUX_AND_CLOCK ( ){
+
+	//enable the SCL and SDA lines for using I2C2 using the control module's base address
+	//and do pin muxing on pins 19 and 20 to enable those lines (mode 3).
+	//the hex value represents the fast slew, receiver enabled, pullup disable, and 3 in lowest
+	//bits for the module
+	REG_WRITE ( CNTRL_MODULE + SCL, 0x0000002B );
+	REG_WRITE ( CNTRL_MODULE + SDA, 0x0000002B );
+
+	//turn on the clock to enable I2C2
+	REG_WRITE ( CM_PER_ADDRESS + I2C2_OFFSET, 0x02 );
+}
+
+//the pads of any of the three modules: I2C0 on its own pads (mode 0), I2C1 on P9_17 / P9_18 (mode 2), I2C2 on
+//P9_19 / P9_20 (mode 3)
+void I2C_PINMUX ( const I2C_BUS *bus ){
+
+	switch ( bus->base ) {
+	case I2C0_BASE_ADDRESS:
+		REG_WRITE ( CNTRL_MODULE + I2C0_SCL, 0x00000028 );
+		REG_WRITE ( CNTRL_MODULE + I2C0_SDA, 0x00000028 );
+		break;
+	case I2C1_BASE_ADDRESS:
+		REG_WRITE ( CNTRL_MODULE + I2C1_SCL, 0x0000002A );
+		REG_WRITE ( CNTRL_MODULE + I2C1_SDA, 0x0000002A );
+		break;
+	case I2C2_BASE_ADDRESS:
+		REG_WRITE ( CNTRL_MODULE + SCL, 0x0000002B );
+		REG_WRITE ( CNTRL_MODULE + SDA, 0x0000002B );
+		break;
+	}
+}
+
+//CLKCTRL register of the module, as an offset from CM_PER_ADDRESS (I2C0 is in CM_WKUP, further on)
+unsigned int I2C_CLKCTRL ( const I2C_BUS *bus ){
+
+	switch ( bus->base ) {
+	case I2C0_BASE_ADDRESS:
+		return CM_WKUP_I2C0_CLKCTRL;
+	case I2C1_BASE_ADDRESS:
+		return CM_PER_I2C1_CLKCTRL;
+	default:
+		return I2C2_OFFSET;
+	}
+}
+
+//the same for any of the three modules
+void I2C_PINMUX_AND_CLOCK ( const I2C_BUS *bus ){
+
+	I2C_PINMUX ( bus );
+	REG_WRITE ( CM_PER_ADDRESS + I2C_CLKCTRL ( bus ), 0x02 );
+}
+
+I2C_TIMING_CHECK ( I2C_FCLK_HZ, I2C0_RATE_HZ );
+I2C_TIMING_CHECK ( I2C_FCLK_HZ, I2C1_RATE_HZ );
+I2C_TIMING_CHECK ( I2C_FCLK_HZ, I2C2_RATE_HZ );
+
+I2C_BUS I2C0_BUS = { .base = I2C0_BASE_ADDRESS, I2C_TIMING ( I2C_FCLK_HZ, I2C0_RATE_HZ ), .timeout = I2C_DEFAULT_TIMEOUT };
+I2C_BUS I2C1_BUS = { .base = I2C1_BASE_ADDRESS, I2C_TIMING ( I2C_FCLK_HZ, I2C1_RATE_HZ ), .timeout = I2C_DEFAULT_TIMEOUT };
+I2C_BUS I2C2_BUS = { .base = I2C2_BASE_ADDRESS, I2C_TIMING ( I2C_FCLK_HZ, I2C2_RATE_HZ ), .timeout = I2C_DEFAULT_TIMEOUT };
+
+//bytes to hand over per XRDY
+unsigned int I2C_TX_THRESHOLD ( const I2C_BUS *bus, unsigned int length ){
+
+	unsigned int threshold;
+
+	//the EDMA only moves whole thresholds, so use the largest one up to half a FIFO that divides the length
+	if ( bus->dma && length > 0 ) {
+		if ( length <= I2C_FIFO_DEPTH ) {
+			return length;
+		}
+		threshold = I2C_FIFO_DEPTH / 2;
+		while ( length % threshold != 0 ) {
+			threshold--;
+		}
+		return threshold;
+	}
+
+	if ( bus->tx_threshold != I2C_TX_THRESHOLD_AUTO ) {
+		return bus->tx_threshold;
+	}
+
+	//a transfer that fits is loaded in one go, a longer one refills half the FIFO while the other half drains
+	if ( length == 0 ) {
+		return 1;
+	}
+	return length <= I2C_FIFO_DEPTH ? length : I2C_FIFO_DEPTH / 2;
+}
+
+//bytes to take per RRDY, the same split as the transmit side
+static unsigned int I2C_RX_THRESHOLD ( unsigned int length ){
+
+	return length <= I2C_FIFO_DEPTH ? length : I2C_FIFO_DEPTH / 2;
+}
+
+//close the current wait phase and remember the worst case
+static void I2C_END_PHASE ( I2C_BUS *bus, unsigned int phase, unsigned int polls ){
+
+	if ( polls > bus->max_waits[phase] ) {
+		bus->max_waits[phase] = polls;
+	}
+	I2C_TRACE_PHASE ( bus, phase );
+}
+
+void I2C_GATE ( I2C_BUS *bus ){
+
+	if ( bus->gated ) {
+		return;
+	}
+	REG_WRITE ( CM_PER_ADDRESS + I2C_CLKCTRL ( bus ), 0 );
+	bus->gated = 1;
+	bus->gated_at = CYCLE_COUNT ( );
+	bus->gates++;
+}
+
+void I2C_UNGATE ( I2C_BUS *bus ){
+
+	unsigned int begin, cycles;
+	unsigned int polls = 0;
+
+	if ( !bus->gated ) {
+		return;
+	}
+	//the registers are not there until IDLEST reads functional again
+	begin = CYCLE_COUNT ( );
+	REG_WRITE ( CM_PER_ADDRESS + I2C_CLKCTRL ( bus ), CM_PER_MODULEMODE_ENABLE );
+	while ( ( REG_READ ( CM_PER_ADDRESS + I2C_CLKCTRL ( bus ) ) & CM_PER_IDLEST_MASK ) && ++polls < bus->timeout );
+	bus->gated = 0;
+	bus->gated_cycles += begin - bus->gated_at;
+	cycles = CYCLE_COUNT ( ) - begin;
+	bus->wake_cycles += cycles;
+	if ( cycles > bus->wake_max_cycles ) {
+		bus->wake_max_cycles = cycles;
+	}
+}
+
+//reset the module and configure it as master transmitter, the cost is paid once
+int I2C_INIT ( I2C_BUS *bus ){
+
+	unsigned int polls = 0;
+
+	I2C_UNGATE ( bus );
+	I2C_TRACE_BEGIN ( bus );
+
+	//software reset, this also clears PSC, SCLL and SCLH so they are programmed afterwards
+	REG_WRITE ( bus->base + SYSC, I2C_SYSC_SRST );
+
+	// Step 1, internal clock
+	//program the prescaler to scale down the clock from 48MHz (12 MhZ for 400 kbs, see i2c_timing.h)
+	REG_WRITE ( bus->base + PSC, bus->psc );
+
+	// Step 2, SCL rate
+	//program the I2C clock
+	REG_WRITE ( bus->base + SCLL, bus->scll );
+	REG_WRITE ( bus->base + SCLH, bus->sclh );
+
+	//clear both FIFOs, one byte thresholds so XRDY asks for every byte
+	REG_WRITE ( bus->base + BUF, I2C_BUF_TXFIFO_CLR | I2C_BUF_RXFIFO_CLR );
+
+	//enable the module as master transmitter
+	REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_TRX );
+
+	//the reset also dropped the transmit DMA request line
+	if ( bus->dma ) {
+		REG_WRITE ( bus->base + DMATXENABLE_SET, I2C_DMATX_ENABLE );
+	}
+
+	bus->resets++;
+
+	// wait until the reset is done
+	while ( ( REG_READ ( bus->base + SYSS ) & I2C_SYSS_RDONE ) == 0 ) {
+		bus->waits[I2C_PHASE_RESET]++;
+		if ( ++polls > bus->timeout ) {
+			I2C_END_PHASE ( bus, I2C_PHASE_RESET, polls );
+			bus->timeouts++;
+			bus->initialized = 0;
+			return I2C_ERR_TIMEOUT;
+		}
+	}
+	I2C_END_PHASE ( bus, I2C_PHASE_RESET, polls );
+
+	bus->initialized = 1;
+	return I2C_OK;
+}
+
+//one try of a transaction on the configured controller, every step waits on an IRQSTATUS_RAW event:
+//BB clear -> load SA, CNT and START/STOP, XRDY / XDR -> next chunk into DATA, ARDY -> done
+static int I2C_WRITE_ONCE ( I2C_BUS *bus, unsigned int slave, const unsigned char *bytes, unsigned int length ){
+
+	unsigned int phase = I2C_PHASE_BUS_FREE;
+	unsigned int threshold = I2C_TX_THRESHOLD ( bus, length );
+	unsigned int sent = 0;
+	unsigned int chunk;
+	unsigned int polls = 0;
+	unsigned int status;
+	int result;
+
+	if ( !bus->initialized && ( result = I2C_INIT ( bus ) ) != I2C_OK ) {
+		return result;
+	}
+
+	I2C_TRACE_BEGIN ( bus );
+	for ( ;; ) {
+
+		status = REG_READ ( bus->base + IRQSTATUS_RAW );
+		bus->waits[phase]++;
+		polls++;
+
+		//once the START is out a NACK or a lost arbitration ends the transfer
+		if ( phase != I2C_PHASE_BUS_FREE && ( status & ( I2C_IRQ_NACK | I2C_IRQ_AL ) ) ) {
+			result = ( status & I2C_IRQ_AL ) ? I2C_ERR_AL : I2C_ERR_NACK;
+			break;
+		}
+
+		if ( phase == I2C_PHASE_BUS_FREE && ( status & I2C_IRQ_BB ) == 0 ) {
+
+			//clear the events left over from the previous transfer
+			REG_WRITE ( bus->base + IRQSTATUS, 0xFFFF );
+
+			//empty FIFO and the threshold for this transfer, with a backend the EDMA answers the requests
+			if ( bus->dma && length ) {
+				I2C_DMA_START ( bus->dma, bus, bytes, length, threshold );
+				REG_WRITE ( bus->base + BUF, I2C_BUF_TXFIFO_CLR | I2C_BUF_XDMA_EN | ( threshold - 1 ) );
+			}
+			else {
+				REG_WRITE ( bus->base + BUF, I2C_BUF_TXFIFO_CLR | ( threshold - 1 ) );
+			}
+
+			REG_WRITE ( bus->base + SA, slave );
+			REG_WRITE ( bus->base + CNT, length );
+
+			//start and stop in one write, the rest of CON stays as I2C_INIT left it
+			REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_TRX | I2C_CON_STP | I2C_CON_STT );
+
+			I2C_END_PHASE ( bus, phase, polls );
+			phase = ( length && !bus->dma ) ? I2C_PHASE_XRDY : I2C_PHASE_ARDY;
+			polls = 0;
+		}
+		else if ( phase == I2C_PHASE_XRDY && ( status & ( I2C_IRQ_XRDY | I2C_IRQ_XDR ) ) ) {
+
+			//XRDY: room for a full threshold, XDR: TXSTAT says how many bytes are left for the tail
+			if ( status & I2C_IRQ_XRDY ) {
+				chunk = threshold;
+			}
+			else {
+				chunk = REG_READ ( bus->base + BUFSTAT ) & I2C_BUFSTAT_TXSTAT_MASK;
+			}
+			if ( chunk > length - sent ) {
+				chunk = length - sent;
+			}
+
+			//transmit the chunk, then clear the event through IRQSTATUS (IRQSTATUS_RAW only sets bits)
+			while ( chunk-- ) {
+				REG_WRITE ( bus->base + DATA, bytes[sent++] );
+			}
+			REG_WRITE ( bus->base + IRQSTATUS, status & ( I2C_IRQ_XRDY | I2C_IRQ_XDR ) );
+			bus->interventions++;
+
+			I2C_END_PHASE ( bus, phase, polls );
+			if ( sent == length ) {
+				phase = I2C_PHASE_ARDY;
+			}
+			polls = 0;
+		}
+		else if ( phase == I2C_PHASE_ARDY && ( status & I2C_IRQ_ARDY ) ) {
+
+			//the STOP is out and the registers can be accessed again
+			REG_WRITE ( bus->base + IRQSTATUS, I2C_IRQ_ARDY | I2C_IRQ_BF );
+
+			I2C_END_PHASE ( bus, phase, polls );
+			bus->transactions++;
+			return I2C_OK;
+		}
+		else if ( polls > bus->timeout ) {
+			result = I2C_ERR_TIMEOUT;
+			break;
+		}
+	}
+
+	I2C_END_PHASE ( bus, phase, polls );
+	return result;
+}
+
+//one try of command bytes, repeated START as receiver, data back; every step waits on an IRQSTATUS_RAW event:
+//BB clear -> SA, CNT and START -> XRDY -> command into DATA -> ARDY -> CNT, START/STOP with TRX clear ->
+//RRDY / RDR -> FIFO into bytes -> ARDY -> done
+static int I2C_READ_ONCE ( I2C_BUS *bus, unsigned int slave, const unsigned char *command, unsigned int command_length,
+                           unsigned char *bytes, unsigned int length ){
+
+	unsigned int phase = I2C_PHASE_BUS_FREE;
+	unsigned int threshold = I2C_RX_THRESHOLD ( length );
+	unsigned int turned = command_length == 0;     //the receive part is on the bus
+	unsigned int received = 0;
+	unsigned int chunk;
+	unsigned int polls = 0;
+	unsigned int status;
+	int result;
+
+	if ( !bus->initialized && ( result = I2C_INIT ( bus ) ) != I2C_OK ) {
+		return result;
+	}
+
+	I2C_TRACE_BEGIN ( bus );
+	for ( ;; ) {
+
+		status = REG_READ ( bus->base + IRQSTATUS_RAW );
+		bus->waits[phase]++;
+		polls++;
+
+		if ( phase != I2C_PHASE_BUS_FREE && ( status & ( I2C_IRQ_NACK | I2C_IRQ_AL ) ) ) {
+			result = ( status & I2C_IRQ_AL ) ? I2C_ERR_AL : I2C_ERR_NACK;
+			break;
+		}
+
+		if ( phase == I2C_PHASE_BUS_FREE && ( status & I2C_IRQ_BB ) == 0 ) {
+
+			REG_WRITE ( bus->base + IRQSTATUS, 0xFFFF );
+
+			//both FIFOs empty, the whole command on the first XRDY, the receive threshold for the data
+			REG_WRITE ( bus->base + BUF, I2C_BUF_TXFIFO_CLR | I2C_BUF_RXFIFO_CLR
+			                             | ( ( threshold - 1 ) << I2C_BUF_RXTRSH_SHIFT )
+			                             | ( command_length ? command_length - 1 : 0 ) );
+			REG_WRITE ( bus->base + SA, slave );
+
+			//the write part ends without a STOP, the controller holds the bus and raises ARDY
+			if ( command_length ) {
+				REG_WRITE ( bus->base + CNT, command_length );
+				REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_TRX | I2C_CON_STT );
+				phase = I2C_PHASE_XRDY;
+			}
+			else {
+				REG_WRITE ( bus->base + CNT, length );
+				REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_STP | I2C_CON_STT );
+				phase = I2C_PHASE_RRDY;
+			}
+			I2C_END_PHASE ( bus, I2C_PHASE_BUS_FREE, polls );
+			polls = 0;
+		}
+		else if ( phase == I2C_PHASE_XRDY && ( status & I2C_IRQ_XRDY ) ) {
+
+			for ( unsigned int i = 0; i < command_length; i++ ) {
+				REG_WRITE ( bus->base + DATA, command[i] );
+			}
+			REG_WRITE ( bus->base + IRQSTATUS, I2C_IRQ_XRDY );
+			bus->interventions++;
+
+			I2C_END_PHASE ( bus, phase, polls );
+			phase = I2C_PHASE_ARDY;
+			polls = 0;
+		}
+		else if ( phase == I2C_PHASE_ARDY && ( status & I2C_IRQ_ARDY ) ) {
+
+			REG_WRITE ( bus->base + IRQSTATUS, I2C_IRQ_ARDY | I2C_IRQ_BF );
+			I2C_END_PHASE ( bus, phase, polls );
+			polls = 0;
+
+			if ( turned ) {
+				bus->transactions++;
+				return I2C_OK;
+			}
+
+			//repeated START with TRX clear, the slave address now goes out with the read bit
+			turned = 1;
+			REG_WRITE ( bus->base + CNT, length );
+			REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_STP | I2C_CON_STT );
+			phase = I2C_PHASE_RRDY;
+		}
+		else if ( phase == I2C_PHASE_RRDY && ( status & ( I2C_IRQ_RRDY | I2C_IRQ_RDR ) ) ) {
+
+			//RRDY: a full threshold is waiting, RDR: RXSTAT says how many bytes the tail has
+			if ( status & I2C_IRQ_RRDY ) {
+				chunk = threshold;
+			}
+			else {
+				chunk = ( REG_READ ( bus->base + BUFSTAT ) & I2C_BUFSTAT_RXSTAT_MASK ) >> I2C_BUFSTAT_RXSTAT_SHIFT;
+			}
+			if ( chunk > length - received ) {
+				chunk = length - received;
+			}
+			while ( chunk-- ) {
+				bytes[received++] = (unsigned char) REG_READ ( bus->base + DATA );
+			}
+			REG_WRITE ( bus->base + IRQSTATUS, status & ( I2C_IRQ_RRDY | I2C_IRQ_RDR ) );
+			bus->interventions++;
+
+			I2C_END_PHASE ( bus, phase, polls );
+			if ( received == length ) {
+				phase = I2C_PHASE_ARDY;
+			}
+			polls = 0;
+		}
+		else if ( polls > bus->timeout ) {
+			result = I2C_ERR_TIMEOUT;
+			break;
+		}
+	}
+
+	I2C_END_PHASE ( bus, phase, polls );
+	return result;
+}
+
+/**********************************************************************************************************************
+*   Recovery ladder                                                                                                   *
+**********************************************************************************************************************/
+
+static const unsigned int I2C_STEP_BUDGET_US [ I2C_STEPS ] = {
+	I2C_RETRY_BUDGET_US, I2C_STOP_BUDGET_US, I2C_BUS_CLEAR_BUDGET_US, I2C_RESET_BUDGET_US, I2C_REINIT_BUDGET_US
+};
+
+//the error class of a failed try
+static void I2C_COUNT ( I2C_BUS *bus, int result ){
+
+	if ( result == I2C_ERR_NACK ) {
+		bus->nacks++;
+	}
+	else if ( result == I2C_ERR_AL ) {
+		bus->arbitration_lost++;
+	}
+	else if ( result == I2C_ERR_TIMEOUT ) {
+		bus->timeouts++;
+	}
+}
+
+static unsigned int I2C_BUS_BUSY ( const I2C_BUS *bus ){
+
+	return REG_READ ( bus->base + IRQSTATUS_RAW ) & I2C_IRQ_BB;
+}
+
+static unsigned int I2C_SDA_LOW ( const I2C_BUS *bus ){
+
+	return ( REG_READ ( bus->base + SYSTEST ) & I2C_SYSTEST_SDA_I_FUNC ) == 0;
+}
+
+//wait for BB to clear, at most the status reads worth budget_us
+static unsigned int I2C_WAIT_BUS_FREE ( const I2C_BUS *bus, unsigned int budget_us ){
+
+	for ( unsigned int polls = 0; polls < budget_us * I2C_POLLS_PER_US; polls++ ) {
+		if ( !I2C_BUS_BUSY ( bus ) ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//drive SCL and SDA from the CPU, a released line is pulled high
+static void I2C_DRIVE ( const I2C_BUS *bus, unsigned int scl, unsigned int sda ){
+
+	REG_WRITE ( bus->base + SYSTEST, I2C_SYSTEST_ST_EN | I2C_SYSTEST_TMODE_IO
+	                                 | ( scl ? I2C_SYSTEST_SCL_O : 0 ) | ( sda ? I2C_SYSTEST_SDA_O : 0 ) );
+	CPU_SPIN ( I2C_BUS_CLEAR_HALF_BIT * CPU_MHZ / 2 );
+}
+
+//clock the slave out of the byte it is stuck in, then a STOP: SDA rising while SCL is high
+static unsigned int I2C_BUS_CLEAR ( const I2C_BUS *bus ){
+
+	unsigned int released = 0;
+
+	I2C_DRIVE ( bus, 1, 1 );
+	for ( unsigned int pulse = 0; pulse < I2C_BUS_CLEAR_PULSES && !released; pulse++ ) {
+		I2C_DRIVE ( bus, 0, 1 );
+		I2C_DRIVE ( bus, 1, 1 );
+		released = REG_READ ( bus->base + SYSTEST ) & I2C_SYSTEST_SDA_I;
+	}
+	I2C_DRIVE ( bus, 0, 1 );
+	I2C_DRIVE ( bus, 0, 0 );
+	I2C_DRIVE ( bus, 1, 0 );
+	I2C_DRIVE ( bus, 1, 1 );
+
+	//back to functional mode
+	REG_WRITE ( bus->base + SYSTEST, 0 );
+	REG_WRITE ( bus->base + IRQSTATUS, 0xFFFF );
+	return released && !I2C_BUS_BUSY ( bus );
+}
+
+//does a step fit the failure
+static unsigned int I2C_STEP_APPLIES ( I2C_BUS *bus, unsigned int step, int result, unsigned int retries ){
+
+	switch ( step ) {
+	case I2C_STEP_RETRY:
+		return ( result == I2C_ERR_NACK || result == I2C_ERR_AL ) && retries < I2C_RETRIES;
+	case I2C_STEP_STOP:
+		return I2C_BUS_BUSY ( bus );
+	case I2C_STEP_BUS_CLEAR:
+		return I2C_SDA_LOW ( bus );
+	case I2C_STEP_RESET:
+		return 1;
+	case I2C_STEP_REINIT:
+		return bus->reinit && !bus->recovering;
+	}
+	return 0;
+}
+
+//run one step, returns 1 when the bus is in a state worth trying the transfer again
+static unsigned int I2C_STEP_RUN ( I2C_BUS *bus, unsigned int step ){
+
+	unsigned int start = CYCLE_COUNT ( );
+	unsigned int cycles;
+	unsigned int ready = 0;
+
+	switch ( step ) {
+	case I2C_STEP_RETRY:
+		//after a NACK the STOP is ours to send, after lost arbitration the other master finishes first
+		REG_WRITE ( bus->base + IRQSTATUS, 0xFFFF );
+		if ( I2C_BUS_BUSY ( bus ) ) {
+			REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_TRX | I2C_CON_STP );
+		}
+		ready = I2C_WAIT_BUS_FREE ( bus, I2C_RETRY_BUDGET_US );
+		break;
+	case I2C_STEP_STOP:
+		bus->bus_stuck++;
+		REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_TRX | I2C_CON_STP );
+		ready = I2C_WAIT_BUS_FREE ( bus, I2C_STOP_BUDGET_US );
+		break;
+	case I2C_STEP_BUS_CLEAR:
+		ready = I2C_BUS_CLEAR ( bus );
+		break;
+	case I2C_STEP_RESET:
+		ready = I2C_INIT ( bus ) == I2C_OK;
+		break;
+	case I2C_STEP_REINIT:
+		bus->recovering = 1;
+		ready = bus->reinit ( bus->reinit_context ) == I2C_OK;
+		bus->recovering = 0;
+		break;
+	}
+
+	cycles = CYCLE_COUNT ( ) - start;
+	bus->steps[step]++;
+	if ( cycles > bus->step_max_cycles[step] ) {
+		bus->step_max_cycles[step] = cycles;
+	}
+	if ( cycles > I2C_STEP_BUDGET_US[step] * CPU_MHZ ) {
+		bus->overruns++;
+	}
+	return ready;
+}
+
+//one try of a write (in_length 0) or of a combined read
+static int I2C_ATTEMPT ( I2C_BUS *bus, unsigned int slave, const unsigned char *out, unsigned int out_length,
+                         unsigned char *in, unsigned int in_length ){
+
+	if ( in_length ) {
+		return I2C_READ_ONCE ( bus, slave, out, out_length, in, in_length );
+	}
+	return I2C_WRITE_ONCE ( bus, slave, out, out_length );
+}
+
+//try the transfer, and after a failure the cheapest step that fits it and the transfer again, up the ladder until
+//it goes through or no step is left
+static int I2C_TRANSFER ( I2C_BUS *bus, unsigned int slave, const unsigned char *out, unsigned int out_length,
+                          unsigned char *in, unsigned int in_length ){
+
+	unsigned int start = CYCLE_COUNT ( );
+	unsigned int step = I2C_STEP_RETRY;
+	unsigned int retries = 0;
+	unsigned int cycles;
+	int result;
+
+	I2C_UNGATE ( bus );
+	result = I2C_ATTEMPT ( bus, slave, out, out_length, in, in_length );
+
+	if ( result == I2C_OK ) {
+		return I2C_OK;
+	}
+
+	while ( result != I2C_OK ) {
+		I2C_COUNT ( bus, result );
+
+		while ( step < I2C_STEPS && !I2C_STEP_APPLIES ( bus, step, result, retries ) ) {
+			step++;
+		}
+		if ( step == I2C_STEPS ) {
+			break;
+		}
+
+		//a step that did not get the bus back goes straight on to the next one
+		if ( step == I2C_STEP_RETRY ) {
+			retries++;
+			if ( !I2C_STEP_RUN ( bus, step ) ) {
+				result = I2C_ERR_BUS;
+				continue;
+			}
+		}
+		else if ( !I2C_STEP_RUN ( bus, step++ ) ) {
+			result = I2C_ERR_BUS;
+			continue;
+		}
+		result = I2C_ATTEMPT ( bus, slave, out, out_length, in, in_length );
+	}
+
+	if ( result == I2C_OK ) {
+		bus->recovered++;
+	}
+	else {
+		bus->unrecovered++;
+	}
+	cycles = CYCLE_COUNT ( ) - start;
+	if ( cycles > bus->recovery_max_cycles ) {
+		bus->recovery_max_cycles = cycles;
+	}
+	return result;
+}
+
+//free the bus and start the controller over, without a transfer to try
+int I2C_RECOVER ( I2C_BUS *bus ){
+
+	if ( I2C_STEP_APPLIES ( bus, I2C_STEP_STOP, I2C_ERR_BUS, 0 ) ) {
+		I2C_STEP_RUN ( bus, I2C_STEP_STOP );
+	}
+	if ( I2C_STEP_APPLIES ( bus, I2C_STEP_BUS_CLEAR, I2C_ERR_BUS, 0 ) ) {
+		I2C_STEP_RUN ( bus, I2C_STEP_BUS_CLEAR );
+	}
+	I2C_STEP_RUN ( bus, I2C_STEP_RESET );
+	return bus->initialized ? I2C_OK : I2C_ERR_TIMEOUT;
+}
+
+int I2C_WRITE ( I2C_BUS *bus, unsigned int slave, const unsigned char *bytes, unsigned int length ){
+
+	//CNT is 16 bits, and 0 in it would not end the transfer
+	if ( length == 0 || length > 0xFFFF ) {
+		return I2C_ERR_LENGTH;
+	}
+	return I2C_TRANSFER ( bus, slave, bytes, length, 0, 0 );
+}
+
+int I2C_READ ( I2C_BUS *bus, unsigned int slave, const unsigned char *command, unsigned int command_length,
+               unsigned char *bytes, unsigned int length ){
+
+	//the command has to fit the transmit FIFO in one go, nothing to read is a plain write
+	if ( length == 0 ) {
+		return I2C_WRITE ( bus, slave, command, command_length );
+	}
+	if ( command_length > I2C_FIFO_DEPTH || length > 0xFFFF ) {
+		return I2C_ERR_LENGTH;
+	}
+	return I2C_TRANSFER ( bus, slave, command, command_length, bytes, length );
+}
+
+//register/value pairs on the configured controller
+int I2C_WRITE_PAIRS ( I2C_BUS *bus, unsigned int slave, const unsigned int *pairs, unsigned int length ){
+
+	int result;
+
+	for (unsigned int j = 0; j < length; j+=2 ){
+
+		unsigned char pair [ 2 ] = { (unsigned char) pairs[j], (unsigned char) pairs[j+1] };
+
+		if ( ( result = I2C_WRITE ( bus, slave, pair, 2 ) ) != I2C_OK ) {
+			return result;
+		}
+	}
+	return I2C_OK;
+}
+
+//original path: wait until the masked register reads value, giving up after I2C2_BUS.timeout reads
+static int I2C2_WAIT ( unsigned int offset, unsigned int mask, unsigned int value ){
+
+	for ( unsigned int polls = 0; ( REG_READ ( I2C2_BASE_ADDRESS + offset ) & mask ) != value; polls++ ) {
+		if ( polls == I2C2_BUS.timeout ) {
+			I2C2_BUS.timeouts++;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//one transaction: START, the slave address, length bytes, STOP
+void I2C2_TRANSMIT ( unsigned int slave, const unsigned char *bytes, unsigned int length ){
+
+	I2C_TRACE_BEGIN ( &I2C2_BUS );
+
+	//software reset of BBB
+	REG_WRITE ( I2C2_BASE_ADDRESS + SYSC, 0x00000002 );
+
+	//buffer of clear fifo and set threshold bit 
+	REG_WRITE ( I2C2_BASE_ADDRESS + BUF, 0x41 );
+
+	REG_WRITE ( I2C2_BASE_ADDRESS + CON, 0x00008600 );
+
+	// wait until the system status register's reset is  done
+	if ( !I2C2_WAIT ( SYSS, 0xFFFFFFFF, 1 ) ) {
+		return;
+	}
+	I2C_TRACE_PHASE ( &I2C2_BUS, I2C_PHASE_RESET );
+
+	//configure the I2C_SA and I2C_CNT registers 
+	REG_WRITE ( I2C2_BASE_ADDRESS + SA, slave );
+	//set the counter to transfer the desired number of bytes
+	REG_WRITE ( I2C2_BASE_ADDRESS + CNT, length );
+
+	//begin the transfer by polling the BB bit 12 from IRQSTATUS_RAW register
+	//if the bit is not 0, then wait
+	if ( !I2C2_WAIT ( IRQSTATUS_RAW, 1 << 12, 0x0 ) ) {
+		return;
+	}
+	I2C_TRACE_PHASE ( &I2C2_BUS, I2C_PHASE_BUS_FREE );
+
+	//set the start and stop bits in the configuration register to 1
+	REG_SET_BITS ( I2C2_BASE_ADDRESS + CON, Start_And_Stop_Bits );
+
+	CPU_SPIN ( 5000 );
+	I2C_TRACE_PHASE ( &I2C2_BUS, I2C_TRACE_SPIN );
+
+	for (unsigned int i = 0; i < length; i++ ){
+		//wait until bit 4 (XRDY) is 1
+		if ( !I2C2_WAIT ( IRQSTATUS_RAW, 1 << 4, 1 << 4 ) ) {
+			return;
+		}
+		I2C_TRACE_PHASE ( &I2C2_BUS, I2C_PHASE_XRDY );
+		//transmit the commands
+		REG_WRITE ( I2C2_BASE_ADDRESS + DATA, bytes[i] );
+
+		CPU_SPIN ( 5000 );
+		I2C_TRACE_PHASE ( &I2C2_BUS, I2C_TRACE_SPIN );
+
+		// Clears the XRDY
+		REG_SET_BITS ( I2C2_BASE_ADDRESS + IRQSTATUS_RAW, 1<<4 );
+	}
+
+	//check if the busy free bit has been set
+	if ( !I2C2_WAIT ( IRQSTATUS_RAW, 1 << 8, 1 << 8 ) ) {
+		return;
+	}
+	I2C_TRACE_PHASE ( &I2C2_BUS, I2C_PHASE_ARDY );
+}
+
+//poll for transferring and transmitting data
+void I2C2_TRANSMIT_PAIRS ( unsigned int slave, const unsigned int *pairs, unsigned int length ){
+
+	for (unsigned int j = 0; j < length; j+=2 ){
+
+		unsigned char pair [ 2 ] = { (unsigned char) pairs[j], (unsigned char) pairs[j+1] };
+
+		I2C2_TRANSMIT ( slave, pair, 2 );
+	}
+}
@@ -0,0 +1,174 @@
+/**********************************************************************************************************************
+*   I2C master transmitter and receiver                                                                               *
+*                                                                                                                     *
+*   Transmit routines shared by the Beaglebone Black programs. All register accesses go through hwreg.h so the same   *
+*   code runs on the board and against the simulated AM335x on a host.                                                *
+*                                                                                                                     *
+*   I2C_INIT resets and configures the controller once and leaves it enabled as master transmitter. After that each   *
+*   I2C_WRITE only reloads SA and CNT and sets START/STOP. The module is only reset again when a transfer went wrong. *
+*                                                                                                                     *
+*   A transfer advances only on IRQSTATUS_RAW events (BB, XRDY, ARDY, NACK, AL), there are no fixed NOP delays. Each  *
+*   wait is bounded by timeout status reads, and the reads spent in each phase are counted in waits / max_waits.      *
+*                                                                                                                     *
+*   The transmit FIFO is filled a threshold at a time: every XRDY means there is room for TXTRSH + 1 bytes, and XDR   *
+*   with BUFSTAT TXSTAT gives the size of the last, shorter chunk. With tx_threshold set to 0 the threshold is picked *
+*   from the transfer length, so a transfer that fits in the FIFO is loaded on the first XRDY and a longer one is     *
+*   refilled half a FIFO at a time. Setting tx_threshold to 1 gives one XRDY per byte.                                *
+*                                                                                                                     *
+*   With an EDMA3 backend attached (I2C_DMA_INIT in i2c_dma.h) the data bytes are moved by the EDMA instead, and      *
+*   the CPU only starts the transfer and waits for ARDY.                                                              *
+*                                                                                                                     *
+*   I2C_READ is a combined transaction: the command bytes (usually a register address) go out without a STOP, then    *
+*   a repeated START turns the controller around as master receiver for the data. The receive FIFO is drained a       *
+*   threshold at a time on RRDY, and RDR with BUFSTAT RXSTAT gives the last, shorter chunk.                           *
+*                                                                                                                     *
+*   One I2C_BUS describes one module. I2C0_BUS, I2C1_BUS and I2C2_BUS are independent and can be used at the same     *
+*   time, each with its own transaction queue.                                                                        *
+*                                                                                                                     *
+*   A failed transfer climbs a recovery ladder, each step tried only when it fits the failure and followed by another *
+*   try of the transfer:                                                                                              *
+*                                                                                                                     *
+*       retry       NACK or lost arbitration, wait for the bus to go free and try again (I2C_RETRIES times)           *
+*       STOP        BB still set, send a STOP and wait for it                                                         *
+*       bus clear   SDA held low by a slave, up to 9 SCL pulses from the CPU through SYSTEST, then a STOP             *
+*       reset       soft reset and reconfigure the controller (I2C_INIT)                                              *
+*       re-init     the device hook in reinit, a software reset of the slaves and their registers restored            *
+*                                                                                                                     *
+*   Every step has a budget in microseconds. Its waits are bounded by status reads worth that budget, and the cycles  *
+*   it took are counted against it, so the worst case of a recovery is the sum of the budgets plus the timeouts of    *
+*   the failed tries. I2C_RECOVER is the ladder without the transfer: STOP, bus clear and reset as needed.            *
+*                                                                                                                     *
+*   I2C2_TRANSMIT and I2C2_TRANSMIT_PAIRS are the original path that soft resets the module for every transaction.    *
+*   They are kept as the baseline the benchmark compares against. Their waits give up after I2C2_BUS.timeout reads    *
+*   and count a timeout, the rest of the transaction is dropped.                                                      *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef I2C_H
+#define I2C_H
+
+#include "am335x.h"
+#include "i2c_timing.h"
+
+//results of the transfer functions
+#define I2C_OK 0
+#define I2C_ERR_TIMEOUT -1                          //an event did not arrive within the timeout
+#define I2C_ERR_NACK -2                             //the slave did not acknowledge
+#define I2C_ERR_AL -3                               //arbitration lost
+#define I2C_ERR_LENGTH -6                           //the transfer does not fit the controller
+#define I2C_ERR_BUS -7                              //the bus could not be freed
+
+//phases a transfer waits in, index of the wait counters
+#define I2C_PHASE_RESET 0                           //SYSS RDONE after a soft reset
+#define I2C_PHASE_BUS_FREE 1                        //BB clear before the START
+#define I2C_PHASE_XRDY 2                            //room in the transmit FIFO
+#define I2C_PHASE_ARDY 3                            //STOP sent, transfer complete
+#define I2C_PHASE_RRDY 4                            //data in the receive FIFO
+#define I2C_PHASES 5
+
+#define I2C_DEFAULT_TIMEOUT 100000                  //status reads before a wait gives up, about 15 ms
+#define I2C_POLLS_PER_US 6                          //status reads per microsecond, one L4_PER read is about 150 ns
+
+//recovery ladder steps, index of the step counters
+#define I2C_STEP_RETRY 0
+#define I2C_STEP_STOP 1
+#define I2C_STEP_BUS_CLEAR 2
+#define I2C_STEP_RESET 3
+#define I2C_STEP_REINIT 4
+#define I2C_STEPS 5
+
+#define I2C_RETRIES 2                               //tries again after a NACK or lost arbitration
+
+//step budgets in microseconds
+#define I2C_RETRY_BUDGET_US 2000                    //the other master's transfer, up to a 64 byte burst at 400 kbps
+#define I2C_STOP_BUDGET_US 100
+#define I2C_BUS_CLEAR_BUDGET_US 200                 //9 clocks and a STOP at 100 kHz
+#define I2C_RESET_BUDGET_US 100
+#define I2C_REINIT_BUDGET_US 5000                   //software reset and a full restore of the device registers
+
+#define I2C_BUS_CLEAR_PULSES 9                      //a slave in the middle of a byte lets go after at most 9 clocks
+#define I2C_BUS_CLEAR_HALF_BIT 5                    //microseconds, the bus clear clocks at 100 kHz
+#define I2C_TX_THRESHOLD_AUTO 0                     //pick the FIFO threshold from the transfer length
+
+//controller session, one per I2C module
+typedef struct {
+	unsigned int base;                  //module base address
+	unsigned int psc;                   //prescaler, 48MHz / ( psc + 1 ) is the internal clock
+	unsigned int scll;                  //clock line low time
+	unsigned int sclh;                  //clock line high time
+	unsigned int timeout;               //status reads allowed in one wait phase
+	unsigned int tx_threshold;          //bytes per XRDY, 1 to I2C_FIFO_DEPTH or I2C_TX_THRESHOLD_AUTO
+	struct I2C_DMA *dma;                //EDMA transmit backend, NULL when the CPU feeds the FIFO
+#ifdef I2C_TRACING
+	struct I2C_TRACE *trace;            //phase trace (i2c_trace.h), NULL when not traced
+#endif
+	unsigned int initialized;
+	unsigned int resets;                //full resets done by I2C_INIT and I2C_RECOVER
+	unsigned int transactions;
+	unsigned long long interventions;   //XRDY / XDR / RRDY / RDR events the CPU serviced
+	unsigned int timeouts;
+	unsigned int nacks;
+	unsigned int arbitration_lost;
+	unsigned long long waits[I2C_PHASES];   //status reads spent in each phase
+	unsigned int max_waits[I2C_PHASES];     //longest single wait in each phase
+
+	//recovery
+	int ( *reinit ) ( void *context );  //last step of the ladder, resets and restores the slaves, may be NULL
+	void *reinit_context;
+	unsigned int recovering;            //the reinit hook is running, its own transfers do not call it again
+	unsigned int bus_stuck;             //BB still set after a failure
+	unsigned int steps[I2C_STEPS];      //ladder steps taken
+	unsigned int step_max_cycles[I2C_STEPS];    //longest run of each step
+	unsigned int overruns;              //steps that took longer than their budget
+	unsigned int recovered;             //failed transfers the ladder got through
+	unsigned int unrecovered;           //failed transfers that ran out of steps
+	unsigned int recovery_max_cycles;   //longest failed transfer, from its start to the end of the ladder
+
+	//module clock gating
+	volatile unsigned int gated;        //MODULEMODE off, the next transfer turns it on again
+	unsigned int gated_at;              //CYCLE_COUNT when it was turned off
+	unsigned int gates;
+	unsigned long long gated_cycles;    //time spent gated, up to the last wake up
+	unsigned long long wake_cycles;     //clock back on to the controller ready for its first byte, summed
+	unsigned int wake_max_cycles;
+} I2C_BUS;
+
+extern I2C_BUS I2C0_BUS;                            //I2C0 at I2C0_RATE_HZ
+extern I2C_BUS I2C1_BUS;                            //I2C1 at I2C1_RATE_HZ
+extern I2C_BUS I2C2_BUS;                            //I2C2 at I2C2_RATE_HZ, 400 kbps unless overridden
+
+void I2C2_PINMUX_AND_CLOCK ( );                     //pin mux SCL/SDA and turn on the I2C2 module clock
+void I2C_PINMUX_AND_CLOCK ( const I2C_BUS *bus );   //the same for the module of any bus
+void I2C_PINMUX ( const I2C_BUS *bus );             //only the SCL/SDA pads of the bus
+unsigned int I2C_CLKCTRL ( const I2C_BUS *bus );    //CM_PER offset of the module clock of the bus
+
+int I2C_INIT ( I2C_BUS *bus );                      //reset and configure the controller, done once at start up
+int I2C_RECOVER ( I2C_BUS *bus );                   //free the bus and reset the controller after an error
+
+//turn the module clock off between bursts, only while no transfer is on the bus; the controller keeps its
+//configuration and the next transfer, polled or queued, turns the clock back on and waits for IDLEST first
+void I2C_GATE ( I2C_BUS *bus );
+void I2C_UNGATE ( I2C_BUS *bus );
+
+//one transaction of length bytes to the slave, returns I2C_OK or one of the I2C_ERR codes; a failure goes up the
+//recovery ladder and the result is that of the last try. I2C_ERR_LENGTH for 0 or more than 0xFFFF bytes
+int I2C_WRITE ( I2C_BUS *bus, unsigned int slave, const unsigned char *bytes, unsigned int length );
+
+//command_length bytes to the slave, then a repeated START and length bytes back into bytes, STOP at the end;
+//returns I2C_OK or one of the I2C_ERR codes
+int I2C_READ ( I2C_BUS *bus, unsigned int slave, const unsigned char *command, unsigned int command_length,
+               unsigned char *bytes, unsigned int length );
+
+//FIFO threshold used for a transfer of length bytes
+unsigned int I2C_TX_THRESHOLD ( const I2C_BUS *bus, unsigned int length );
+
+//register/value pairs, one 2 byte transaction per pair
+int I2C_WRITE_PAIRS ( I2C_BUS *bus, unsigned int slave, const unsigned int *pairs, unsigned int length );
+
+//original path: one transaction of length bytes to the slave, CNT is sized to match
+void I2C2_TRANSMIT ( unsigned int slave, const unsigned char *bytes, unsigned int length );
+
+//original path: register/value pairs, one reset and 2 byte transaction per pair
+void I2C2_TRANSMIT_PAIRS ( unsigned int slave, const unsigned int *pairs, unsigned int length );
+
+#endif
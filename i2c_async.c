@@ -0,0 +1,314 @@
+/**********************************************************************************************************************
+*   Interrupt driven I2C transaction queue                                                                            *
+*                                                                                                                     *
+*   The ring is shared between I2C_QUEUE_WRITE and the interrupt handler, so the enqueue side masks IRQs while it     *
+*   copies the transaction in. The handler follows the same steps as the polled I2C_WRITE, only it is woken by the    *
+*   module interrupt instead of spinning on IRQSTATUS_RAW.                                                            *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "intc.h"
+#include "i2c_async.h"
+#include "i2c_dma.h"
+#include "i2c_trace.h"
+
+#define I2C_QUEUE_EVENTS ( I2C_IRQ_XRDY | I2C_IRQ_XDR | I2C_IRQ_ARDY | I2C_IRQ_NACK | I2C_IRQ_AL )
+
+I2C_QUEUE I2C0_QUEUE = { .bus = &I2C0_BUS, .line = I2C0_INT };
+I2C_QUEUE I2C1_QUEUE = { .bus = &I2C1_BUS, .line = I2C1_INT };
+I2C_QUEUE I2C2_QUEUE = { .bus = &I2C2_BUS, .line = I2C2_INT };
+
+//the head transaction ran out of time: stopped like a NACK, I2C_QUEUE_RECOVER fails it; IRQs are masked
+static void I2C_QUEUE_EXPIRED ( void *context ){
+
+	I2C_QUEUE *queue = (I2C_QUEUE *) context;
+
+	if ( !queue->busy || queue->fault ) {
+		return;
+	}
+	REG_WRITE ( queue->bus->base + IRQENABLE_CLR, I2C_QUEUE_EVENTS );
+	queue->fault = I2C_QUEUE_FAULT_TIMEOUT;
+	queue->timeouts++;
+	if ( queue->recover ) {
+		queue->recover ( queue->recover_context );
+	}
+}
+
+//put the head transaction on the bus, or go idle when the ring is empty
+static void I2C_QUEUE_START ( I2C_QUEUE *queue ){
+
+	I2C_BUS *bus = queue->bus;
+	I2C_TRANSFER *transfer;
+
+	if ( queue->count == 0 ) {
+		queue->busy = 0;
+		REG_WRITE ( bus->base + IRQENABLE_CLR, I2C_QUEUE_EVENTS );
+		if ( queue->timers ) {
+			TIMER_CANCEL ( queue->timers, &queue->watchdog );
+		}
+		return;
+	}
+
+	I2C_UNGATE ( bus );
+	transfer = &queue->ring[queue->head];
+	queue->busy = 1;
+	queue->sent = 0;
+	queue->threshold = I2C_TX_THRESHOLD ( bus, transfer->length );
+	I2C_TRACE_BEGIN ( bus );
+
+	//the previous transaction ended with its STOP, so the bus is free
+	REG_WRITE ( bus->base + IRQSTATUS, 0xFFFF );
+	if ( bus->dma ) {
+		//the EDMA feeds the FIFO straight from the ring entry, only the end of the transaction interrupts
+		I2C_DMA_START ( bus->dma, bus, transfer->bytes, transfer->length, queue->threshold );
+		REG_WRITE ( bus->base + BUF, I2C_BUF_TXFIFO_CLR | I2C_BUF_XDMA_EN | ( queue->threshold - 1 ) );
+		REG_WRITE ( bus->base + IRQENABLE_SET, I2C_QUEUE_EVENTS & ~( I2C_IRQ_XRDY | I2C_IRQ_XDR ) );
+	}
+	else {
+		REG_WRITE ( bus->base + BUF, I2C_BUF_TXFIFO_CLR | ( queue->threshold - 1 ) );
+		REG_WRITE ( bus->base + IRQENABLE_SET, I2C_QUEUE_EVENTS );
+	}
+	REG_WRITE ( bus->base + SA, transfer->slave );
+	REG_WRITE ( bus->base + CNT, transfer->length );
+	REG_WRITE ( bus->base + CON, I2C_CON_EN | I2C_CON_MST | I2C_CON_TRX | I2C_CON_STP | I2C_CON_STT );
+	if ( queue->timers ) {
+		TIMER_START ( queue->timers, &queue->watchdog, TIMER_US ( I2C_QUEUE_TIMEOUT_US ), 0, I2C_QUEUE_EXPIRED, queue );
+	}
+}
+
+//report the head transaction and drop it from the ring
+static void I2C_QUEUE_COMPLETE ( I2C_QUEUE *queue, int result ){
+
+	I2C_TRANSFER *transfer = &queue->ring[queue->head];
+	unsigned int latency = CYCLE_COUNT ( ) - transfer->enqueued_at;
+
+	queue->head = ( queue->head + 1 ) % I2C_QUEUE_DEPTH;
+	queue->count--;
+	queue->retried = 0;
+
+	if ( result == I2C_OK ) {
+		queue->completed++;
+		queue->bus->transactions++;
+		queue->latency_cycles += latency;
+		if ( latency > queue->max_latency_cycles ) {
+			queue->max_latency_cycles = latency;
+		}
+	}
+	else {
+		queue->failed++;
+	}
+
+	if ( transfer->status ) {
+		*transfer->status = result;
+	}
+	if ( transfer->callback ) {
+		transfer->callback ( transfer->context, result );
+	}
+}
+
+void I2C_QUEUE_INIT ( I2C_QUEUE *queue ){
+
+	if ( queue == &I2C0_QUEUE ) {
+		INTC_REGISTER ( queue->line, I2C0_IRQ_HANDLER );
+	}
+	else if ( queue == &I2C1_QUEUE ) {
+		INTC_REGISTER ( queue->line, I2C1_IRQ_HANDLER );
+	}
+	else if ( queue == &I2C2_QUEUE ) {
+		INTC_REGISTER ( queue->line, I2C2_IRQ_HANDLER );
+	}
+}
+
+//copy the transaction into the ring, kick the bus if it is idle
+int I2C_QUEUE_WRITE ( I2C_QUEUE *queue, unsigned int slave, const unsigned char *bytes, unsigned int length,
+                      volatile int *status, I2C_CALLBACK callback, void *context ){
+
+	I2C_TRANSFER *transfer;
+	unsigned int state;
+
+	if ( length == 0 || length > I2C_QUEUE_MAX_BYTES ) {
+		return I2C_ERR_LENGTH;
+	}
+
+	state = IRQ_SAVE ( );
+
+	if ( queue->count == I2C_QUEUE_DEPTH ) {
+		queue->rejected++;
+		IRQ_RESTORE ( state );
+		return I2C_ERR_FULL;
+	}
+
+	transfer = &queue->ring[( queue->head + queue->count ) % I2C_QUEUE_DEPTH];
+	transfer->slave = (unsigned char) slave;
+	transfer->length = (unsigned char) length;
+	for ( unsigned int i = 0; i < length; i++ ) {
+		transfer->bytes[i] = bytes[i];
+	}
+	transfer->status = status;
+	transfer->callback = callback;
+	transfer->context = context;
+	transfer->enqueued_at = CYCLE_COUNT ( );
+	if ( status ) {
+		*status = I2C_PENDING;
+	}
+
+	queue->count++;
+	queue->enqueued++;
+	if ( queue->count > queue->max_depth ) {
+		queue->max_depth = queue->count;
+	}
+
+	if ( !queue->busy ) {
+		I2C_QUEUE_START ( queue );
+	}
+
+	IRQ_RESTORE ( state );
+	return I2C_OK;
+}
+
+//sleep until the ring is empty, recovering from the faults the handler leaves on the way; without a timer service
+//nothing wakes the core at the deadline, so the cycle counter is polled instead
+void I2C_QUEUE_FLUSH ( I2C_QUEUE *queue ){
+
+	unsigned int finished = queue->completed + queue->failed;
+	unsigned int begin = CYCLE_COUNT ( );
+	unsigned int state;
+
+	while ( queue->busy ) {
+		if ( queue->fault ) {
+			I2C_QUEUE_RECOVER ( queue );
+			continue;
+		}
+
+		//the watchdog wakes the core; a fault between the check and WFI would leave nothing to wake it
+		if ( queue->timers ) {
+			state = IRQ_SAVE ( );
+			if ( queue->busy && !queue->fault ) {
+				CPU_WAIT_FOR_INTERRUPT ( );
+			}
+			IRQ_RESTORE ( state );
+			continue;
+		}
+
+		if ( finished != queue->completed + queue->failed ) {
+			finished = queue->completed + queue->failed;
+			begin = CYCLE_COUNT ( );
+		}
+		else if ( CYCLE_COUNT ( ) - begin > I2C_QUEUE_TIMEOUT_US * CPU_MHZ ) {
+			state = IRQ_SAVE ( );
+			I2C_QUEUE_EXPIRED ( queue );
+			IRQ_RESTORE ( state );
+			continue;
+		}
+		CPU_SPIN ( I2C_QUEUE_POLL_SPIN );
+	}
+}
+
+//free the bus and reset the controller after the fault; a NACK or lost arbitration gets the head transaction one
+//more try before it fails, a timeout fails it at once
+void I2C_QUEUE_RECOVER ( I2C_QUEUE *queue ){
+
+	unsigned int fault = queue->fault;
+	unsigned int state;
+
+	if ( !fault ) {
+		return;
+	}
+	I2C_RECOVER ( queue->bus );
+
+	state = IRQ_SAVE ( );
+	queue->fault = 0;
+	if ( fault & I2C_QUEUE_FAULT_TIMEOUT ) {
+		I2C_QUEUE_COMPLETE ( queue, I2C_ERR_TIMEOUT );
+	}
+	else if ( queue->retried ) {
+		I2C_QUEUE_COMPLETE ( queue, ( fault & I2C_IRQ_AL ) ? I2C_ERR_AL : I2C_ERR_NACK );
+	}
+	else {
+		queue->retried = 1;
+		queue->retries++;
+	}
+	I2C_QUEUE_START ( queue );
+	IRQ_RESTORE ( state );
+}
+
+void I2C_QUEUE_RECOVER_TASK ( void *queue ){
+
+	I2C_QUEUE_RECOVER ( (I2C_QUEUE *) queue );
+}
+
+//one module interrupt: feed the FIFO, or finish the head transaction and start the next
+void I2C_QUEUE_IRQ ( I2C_QUEUE *queue ){
+
+	I2C_BUS *bus = queue->bus;
+	I2C_TRANSFER *transfer = &queue->ring[queue->head];
+	unsigned int status = REG_READ ( bus->base + IRQSTATUS );
+	unsigned int chunk;
+
+	if ( !queue->busy ) {
+		REG_WRITE ( bus->base + IRQSTATUS, status );
+		return;
+	}
+
+	//a NACK or lost arbitration: the module is quietened and left to I2C_QUEUE_RECOVER, the ladder takes too long
+	//for an interrupt handler
+	if ( status & ( I2C_IRQ_NACK | I2C_IRQ_AL ) ) {
+		if ( status & I2C_IRQ_AL ) {
+			bus->arbitration_lost++;
+		}
+		else {
+			bus->nacks++;
+		}
+		REG_WRITE ( bus->base + IRQENABLE_CLR, I2C_QUEUE_EVENTS );
+		REG_WRITE ( bus->base + IRQSTATUS, status );
+		queue->fault = status & ( I2C_IRQ_NACK | I2C_IRQ_AL );
+		if ( queue->recover ) {
+			queue->recover ( queue->recover_context );
+		}
+		return;
+	}
+
+	//XRDY: room for a full threshold, XDR: TXSTAT says how many bytes are left for the tail
+	if ( status & ( I2C_IRQ_XRDY | I2C_IRQ_XDR ) ) {
+		if ( status & I2C_IRQ_XRDY ) {
+			chunk = queue->threshold;
+		}
+		else {
+			chunk = REG_READ ( bus->base + BUFSTAT ) & I2C_BUFSTAT_TXSTAT_MASK;
+		}
+		if ( chunk > transfer->length - queue->sent ) {
+			chunk = transfer->length - queue->sent;
+		}
+		while ( chunk-- ) {
+			REG_WRITE ( bus->base + DATA, transfer->bytes[queue->sent++] );
+		}
+		REG_WRITE ( bus->base + IRQSTATUS, status & ( I2C_IRQ_XRDY | I2C_IRQ_XDR ) );
+		bus->interventions++;
+		I2C_TRACE_PHASE ( bus, I2C_PHASE_XRDY );
+	}
+
+	//STOP is out, hand the result back and move on
+	if ( status & I2C_IRQ_ARDY ) {
+		REG_WRITE ( bus->base + IRQSTATUS, I2C_IRQ_ARDY | I2C_IRQ_BF );
+		I2C_TRACE_PHASE ( bus, I2C_PHASE_ARDY );
+		I2C_QUEUE_COMPLETE ( queue, I2C_OK );
+		I2C_QUEUE_START ( queue );
+	}
+}
+
+void I2C2_IRQ_HANDLER ( ){
+
+	I2C_QUEUE_IRQ ( &I2C2_QUEUE );
+}
+
+void I2C0_IRQ_HANDLER ( ){
+
+	I2C_QUEUE_IRQ ( &I2C0_QUEUE );
+}
+
+void I2C1_IRQ_HANDLER ( ){
+
+	I2C_QUEUE_IRQ ( &I2C1_QUEUE );
+}
@@ -0,0 +1,98 @@
+/**********************************************************************************************************************
+*   Interrupt driven I2C transaction queue                                                                            *
+*                                                                                                                     *
+*   I2C_QUEUE_WRITE copies a transaction into a fixed ring and returns straight away, it never waits for the bus.     *
+*   The I2C interrupt handler drains the ring: it starts the transaction at the head, feeds the FIFO on XRDY / XDR,   *
+*   and on ARDY reports the result and starts the next one. Completion is signalled through an optional status flag   *
+*   (I2C_PENDING until the transaction is done) and an optional callback, which runs in interrupt context.            *
+*                                                                                                                     *
+*   A NACK or lost arbitration stops the queue; I2C_QUEUE_RECOVER runs I2C_RECOVER outside the handler and puts the   *
+*   transaction on the bus once more before it is reported as failed. The recover hook, when set, is called from the  *
+*   handler to post a task that does it (SCHED_WAKE and a task on I2C_QUEUE_RECOVER_TASK); I2C_QUEUE_FLUSH does it    *
+*   while it waits.                                                                                                   *
+*                                                                                                                     *
+*   With a timer service attached every transaction has I2C_QUEUE_TIMEOUT_US to finish; a hung bus then fails the     *
+*   head transaction with I2C_ERR_TIMEOUT the same way, and I2C_QUEUE_FLUSH cannot sleep forever.                     *
+*                                                                                                                     *
+*   Every bus has its own queue and interrupt line, so transactions on I2C0, I2C1 and I2C2 run at the same time.      *
+*                                                                                                                     *
+*   While a queue is active the polled I2C_WRITE must not be used on the same bus; I2C_QUEUE_FLUSH waits for it to    *
+*   drain first.                                                                                                      *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef I2C_ASYNC_H
+#define I2C_ASYNC_H
+
+#include "i2c.h"
+#include "timer.h"
+
+#define I2C_QUEUE_DEPTH 16                          //transactions waiting or on the bus
+#define I2C_QUEUE_MAX_BYTES 65                      //register byte plus all 64 LED registers of a PCA9685
+
+#define I2C_PENDING 1                               //status flag value until the transaction completes
+#define I2C_ERR_FULL -4                             //the ring is full, nothing was queued
+#define I2C_QUEUE_TIMEOUT_US 20000                  //the longest transaction, 65 bytes at 100 kHz, takes about 6 ms
+#define I2C_QUEUE_POLL_SPIN 10000                   //NOP iterations between two polls in I2C_QUEUE_FLUSH without timers
+#define I2C_QUEUE_FAULT_TIMEOUT 0x10000             //fault of a transaction that ran out of time, above the IRQ bits
+
+typedef void ( *I2C_CALLBACK ) ( void *context, int result );
+
+typedef struct {
+	unsigned char slave;
+	unsigned char length;
+	unsigned char bytes[I2C_QUEUE_MAX_BYTES];
+	volatile int *status;               //set to the result when done, may be NULL
+	I2C_CALLBACK callback;              //called from the interrupt handler when done, may be NULL
+	void *context;
+	unsigned int enqueued_at;           //cycle counter when queued
+} I2C_TRANSFER;
+
+typedef struct {
+	I2C_BUS *bus;
+	unsigned int line;                  //INTC line of the module
+	I2C_TRANSFER ring[I2C_QUEUE_DEPTH];
+	volatile unsigned int head;         //transaction on the bus
+	volatile unsigned int count;        //transactions in the ring, including the one on the bus
+	volatile unsigned int busy;
+	unsigned int sent;                  //bytes of the head transaction written to DATA
+	unsigned int threshold;
+	unsigned int retried;               //the head transaction was put on the bus a second time
+	volatile unsigned int fault;        //NACK or AL bits left by the handler for I2C_QUEUE_RECOVER, 0 for none
+	void ( *recover ) ( void *context );//called from the handler after a fault, may be NULL
+	void *recover_context;
+	TIMER_SERVICE *timers;              //times out the head transaction, may be NULL
+	TIMER watchdog;
+
+	//statistics
+	unsigned int enqueued;
+	unsigned int completed;
+	unsigned int failed;
+	unsigned int retries;               //transactions tried again after a NACK or lost arbitration
+	unsigned int timeouts;              //transactions failed by the watchdog
+	unsigned int rejected;              //I2C_QUEUE_WRITE found the ring full
+	unsigned int max_depth;
+	unsigned long long latency_cycles;  //enqueue to completion, summed over completed transactions
+	unsigned int max_latency_cycles;
+} I2C_QUEUE;
+
+extern I2C_QUEUE I2C0_QUEUE;
+extern I2C_QUEUE I2C1_QUEUE;
+extern I2C_QUEUE I2C2_QUEUE;
+
+void I2C_QUEUE_INIT ( I2C_QUEUE *queue );          //register the handler and unmask the module interrupt
+
+//queue one transaction without waiting: I2C_OK, I2C_ERR_FULL, or I2C_ERR_LENGTH for 0 or more than
+//I2C_QUEUE_MAX_BYTES bytes, which no ring entry can hold
+int I2C_QUEUE_WRITE ( I2C_QUEUE *queue, unsigned int slave, const unsigned char *bytes, unsigned int length,
+                      volatile int *status, I2C_CALLBACK callback, void *context );
+
+void I2C_QUEUE_FLUSH ( I2C_QUEUE *queue );         //sleep in WFI until every queued transaction is done or failed
+void I2C_QUEUE_RECOVER ( I2C_QUEUE *queue );       //recover from the fault the handler left and restart the queue
+void I2C_QUEUE_RECOVER_TASK ( void *queue );        //SCHED_FUNCTION that runs I2C_QUEUE_RECOVER
+void I2C_QUEUE_IRQ ( I2C_QUEUE *queue );           //service the module, called from its interrupt handler
+void I2C0_IRQ_HANDLER ( );                          //INTC handler for I2C0
+void I2C1_IRQ_HANDLER ( );                          //INTC handler for I2C1
+void I2C2_IRQ_HANDLER ( );                          //INTC handler for I2C2
+
+#endif
@@ -0,0 +1,285 @@
+/**********************************************************************************************************************
+*   Linux i2c-dev transport                                                                                           *
+*                                                                                                                     *
+*   The batch keeps its messages as offsets into one buffer, so nothing is allocated; the struct i2c_msg array the    *
+*   ioctl takes is built on the stack when it is sent. errno from the adapter driver is mapped to the I2C_ERR codes   *
+*   of the bare metal driver: ENXIO and EREMOTEIO for a missing ACK, ETIMEDOUT, and EAGAIN for lost arbitration.      *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+//the ioctl of that name is not used here, i2c.h has its own I2C_RETRIES
+#undef I2C_RETRIES
+
+#include "pca9685.h"
+#include "i2c_dev.h"
+
+static int I2C_DEV_ERROR ( I2C_DEV *dev ){
+
+	dev->failed++;
+	switch ( errno ) {
+	case ENXIO:
+	case EREMOTEIO:
+		return I2C_ERR_NACK;
+	case ETIMEDOUT:
+		return I2C_ERR_TIMEOUT;
+	case EAGAIN:
+		return I2C_ERR_AL;
+	default:
+		return I2C_DEV_ERR_SYSTEM;
+	}
+}
+
+static void I2C_DEV_POWER_ON ( I2C_DEV *dev ){
+
+	memset ( dev->regs, 0, sizeof ( dev->regs ) );
+	dev->regs[MODE1] = MODE1_SLEEP | MODE1_ALLCALL;
+	dev->regs[MODE2] = MODE2_OUTDRV;
+	dev->regs[PRE_SCALE_SERVO] = 0x1E;
+}
+
+//the register after reg with the auto-increment of MODE1
+static unsigned int I2C_DEV_NEXT ( const I2C_DEV *dev, unsigned int reg ){
+
+	if ( !( dev->regs[MODE1] & MODE1_AI ) ) {
+		return reg;
+	}
+	return reg == LED15_OFF_H || reg == PRE_SCALE_SERVO ? MODE1 : ( reg + 1 ) & 0xFF;
+}
+
+//a transaction into the loopback PCA9685: the register byte, then values; SWRST through the general call resets it
+static void I2C_DEV_LOOP ( I2C_DEV *dev, unsigned int slave, const unsigned char *bytes, unsigned int length ){
+
+	unsigned int reg;
+
+	if ( length == 0 ) {
+		return;
+	}
+	if ( slave == PCA9685_GENERAL_CALL_ADDRESS ) {
+		if ( length == 1 && bytes[0] == PCA9685_SWRST ) {
+			I2C_DEV_POWER_ON ( dev );
+		}
+		return;
+	}
+	reg = bytes[0];
+	for ( unsigned int i = 1; i < length; i++ ) {
+		dev->regs[reg] = bytes[i];
+		reg = I2C_DEV_NEXT ( dev, reg );
+	}
+}
+
+static void I2C_DEV_RESET ( I2C_DEV *dev ){
+
+	dev->slave = -1;
+	dev->count = dev->used = 0;
+	dev->syscalls = dev->binds = dev->batches = dev->messages = dev->bytes = dev->failed = 0;
+	I2C_DEV_POWER_ON ( dev );
+}
+
+int I2C_DEV_OPEN ( I2C_DEV *dev, unsigned int adapter ){
+
+	char path [ 20 ];
+
+	I2C_DEV_RESET ( dev );
+	dev->adapter = adapter;
+	dev->loopback = 0;
+	snprintf ( path, sizeof ( path ), "/dev/i2c-%u", adapter );
+	if ( ( dev->fd = open ( path, O_RDWR ) ) < 0 ) {
+		return I2C_DEV_ERR_SYSTEM;
+	}
+	return I2C_OK;
+}
+
+int I2C_DEV_LOOPBACK ( I2C_DEV *dev ){
+
+	I2C_DEV_RESET ( dev );
+	dev->adapter = 0;
+	dev->loopback = 1;
+	if ( ( dev->fd = open ( "/dev/null", O_WRONLY ) ) < 0 ) {
+		return I2C_DEV_ERR_SYSTEM;
+	}
+	return I2C_OK;
+}
+
+void I2C_DEV_CLOSE ( I2C_DEV *dev ){
+
+	if ( dev->fd >= 0 ) {
+		I2C_DEV_FLUSH ( dev );
+		close ( dev->fd );
+		dev->fd = -1;
+	}
+}
+
+int I2C_DEV_WRITE ( I2C_DEV *dev, unsigned int slave, const unsigned char *bytes, unsigned int length ){
+
+	int done;
+
+	//the binding stays with the fd, so a run of writes to one slave pays for it once
+	if ( dev->slave != (int) slave ) {
+		dev->syscalls++;
+		dev->binds++;
+		done = dev->loopback ? fcntl ( dev->fd, F_GETFL ) : ioctl ( dev->fd, I2C_SLAVE, (unsigned long) slave );
+		if ( done < 0 ) {
+			dev->slave = -1;
+			return I2C_DEV_ERROR ( dev );
+		}
+		dev->slave = (int) slave;
+	}
+
+	dev->syscalls++;
+	if ( write ( dev->fd, bytes, length ) != (ssize_t) length ) {
+		return I2C_DEV_ERROR ( dev );
+	}
+	if ( dev->loopback ) {
+		I2C_DEV_LOOP ( dev, slave, bytes, length );
+	}
+	dev->messages++;
+	dev->bytes += length;
+	return I2C_OK;
+}
+
+int I2C_DEV_QUEUE ( I2C_DEV *dev, unsigned int slave, const unsigned char *bytes, unsigned int length,
+                    I2C_CALLBACK callback, void *context ){
+
+	unsigned int n;
+	int result;
+
+	if ( length == 0 || length > I2C_DEV_BATCH_BYTES ) {
+		return I2C_ERR_LENGTH;
+	}
+	if ( dev->count == I2C_DEV_MAX_MSGS || dev->used + length > I2C_DEV_BATCH_BYTES ) {
+		if ( ( result = I2C_DEV_FLUSH ( dev ) ) != I2C_OK ) {
+			return result;
+		}
+	}
+
+	n = dev->count++;
+	dev->msg_slave[n] = (unsigned short) slave;
+	dev->msg_offset[n] = (unsigned short) dev->used;
+	dev->msg_length[n] = (unsigned short) length;
+	dev->callback[n] = callback;
+	dev->context[n] = context;
+	memcpy ( &dev->data[dev->used], bytes, length );
+	dev->used += length;
+	return I2C_OK;
+}
+
+int I2C_DEV_FLUSH ( I2C_DEV *dev ){
+
+	struct i2c_msg msgs [ I2C_DEV_MAX_MSGS ];
+	struct iovec iov [ I2C_DEV_MAX_MSGS ];
+	struct i2c_rdwr_ioctl_data batch;
+	I2C_CALLBACK callback [ I2C_DEV_MAX_MSGS ];
+	void *context [ I2C_DEV_MAX_MSGS ];
+	unsigned int count = dev->count;
+	int result = I2C_OK;
+	int done;
+
+	if ( count == 0 ) {
+		return I2C_OK;
+	}
+	for ( unsigned int n = 0; n < count; n++ ) {
+		msgs[n].addr = dev->msg_slave[n];
+		msgs[n].flags = 0;
+		msgs[n].len = dev->msg_length[n];
+		msgs[n].buf = &dev->data[dev->msg_offset[n]];
+		iov[n].iov_base = msgs[n].buf;
+		iov[n].iov_len = msgs[n].len;
+	}
+	batch.msgs = msgs;
+	batch.nmsgs = count;
+
+	dev->syscalls++;
+	dev->batches++;
+	done = dev->loopback ? (int) writev ( dev->fd, iov, (int) count ) : ioctl ( dev->fd, I2C_RDWR, &batch );
+
+	//the ioctl returns the number of messages that went through, fewer is a slave that stopped answering
+	if ( done < 0 ) {
+		result = I2C_DEV_ERROR ( dev );
+	}
+	else if ( !dev->loopback && done != (int) count ) {
+		dev->failed++;
+		result = I2C_ERR_NACK;
+	}
+	else {
+		for ( unsigned int n = 0; n < count; n++ ) {
+			if ( dev->loopback ) {
+				I2C_DEV_LOOP ( dev, msgs[n].addr, msgs[n].buf, msgs[n].len );
+			}
+			dev->bytes += msgs[n].len;
+		}
+		dev->messages += count;
+	}
+
+	//emptied before the callbacks, they may queue the next transactions
+	memcpy ( callback, dev->callback, count * sizeof ( callback[0] ) );
+	memcpy ( context, dev->context, count * sizeof ( context[0] ) );
+	dev->count = dev->used = 0;
+	for ( unsigned int n = 0; n < count; n++ ) {
+		if ( callback[n] ) {
+			callback[n] ( context[n], result );
+		}
+	}
+	return result;
+}
+
+int I2C_DEV_READ ( I2C_DEV *dev, unsigned int slave, unsigned char reg, unsigned char *values, unsigned int count ){
+
+	struct i2c_msg msgs [ 2 ];
+	struct i2c_rdwr_ioctl_data batch = { .msgs = msgs, .nmsgs = 2 };
+	unsigned int r = reg;
+	int result, done;
+
+	if ( count == 0 || count > 0xFFFF ) {
+		return I2C_ERR_LENGTH;
+	}
+	if ( ( result = I2C_DEV_FLUSH ( dev ) ) != I2C_OK ) {
+		return result;
+	}
+
+	//the register byte and the read joined by a repeated START; the loopback writes the register byte to /dev/null
+	msgs[0].addr = msgs[1].addr = (unsigned short) slave;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &reg;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = (unsigned short) count;
+	msgs[1].buf = values;
+
+	dev->syscalls++;
+	if ( dev->loopback ) {
+		done = write ( dev->fd, &reg, 1 ) == 1 ? 2 : -1;
+	}
+	else {
+		done = ioctl ( dev->fd, I2C_RDWR, &batch );
+	}
+	if ( done < 0 ) {
+		return I2C_DEV_ERROR ( dev );
+	}
+	if ( done != 2 ) {
+		dev->failed++;
+		return I2C_ERR_NACK;
+	}
+	if ( dev->loopback ) {
+		for ( unsigned int i = 0; i < count; i++ ) {
+			values[i] = dev->regs[r];
+			r = I2C_DEV_NEXT ( dev, r );
+		}
+	}
+	dev->messages += 2;
+	dev->bytes += 1 + count;
+	return I2C_OK;
+}
+
+#endif
@@ -0,0 +1,89 @@
+/**********************************************************************************************************************
+*   Linux i2c-dev transport                                                                                           *
+*                                                                                                                     *
+*   The same PCA9685 layer from a Linux process on the AM335x, through /dev/i2c-N instead of the controller           *
+*   registers. I2C_DEV_OPEN opens the adapter once and keeps the fd for the life of the process.                      *
+*                                                                                                                     *
+*   I2C_DEV_WRITE is the plain way: one write() per transaction, to the slave bound with the I2C_SLAVE ioctl; the     *
+*   ioctl is only repeated when the slave changes. I2C_DEV_QUEUE works like I2C_QUEUE_WRITE: it copies a transaction  *
+*   into a batch and returns at once, and I2C_DEV_FLUSH sends the whole batch as the messages of one I2C_RDWR ioctl.  *
+*   A frame of several bursts, or the frames of several boards, costs one system call and one switch into the kernel  *
+*   instead of one per transaction. I2C_RDWR joins the messages with repeated STARTs and ends with one STOP; a        *
+*   PCA9685 takes the register byte after each START, so every burst lands where it would on its own. A full batch    *
+*   is sent before the next transaction is added.                                                                     *
+*                                                                                                                     *
+*   A PCA9685 cache with PCA9685_CACHE_ATTACH_DEV queues its bursts here, so frames, servos and trajectories run      *
+*   unchanged on top. I2C_DEV_READ is the register read-back of PCA9685_CACHE_VERIFY, one I2C_RDWR of a write and a   *
+*   read message.                                                                                                     *
+*                                                                                                                     *
+*   I2C_DEV_LOOPBACK is a stand-in for a host with no I2C adapter: the fd is /dev/null, each write() is written there *
+*   and each ioctl is one system call on it too (writev of every message buffer for I2C_RDWR), so the system call     *
+*   count and the cost of entering the kernel are real. The bytes go to one PCA9685 register model in memory,         *
+*   whatever the slave address; SWRST through the general call resets it.                                             *
+*                                                                                                                     *
+*   Everything but the structure is only built on Linux.                                                              *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef I2C_DEV_H
+#define I2C_DEV_H
+
+#include "i2c_async.h"
+
+#define I2C_DEV_MAX_MSGS 42                         //I2C_RDWR_IOCTL_MAX_MSGS of the kernel
+#define I2C_DEV_BATCH_BYTES 1024
+#define I2C_DEV_ERR_SYSTEM -9                       //open or a system call failed for another reason than the bus
+#define I2C_DEV_SCL_HZ 100000                       //clock-frequency of I2C2 in the Beaglebone Black device tree
+
+typedef struct {
+	int fd;                             //-1 while closed
+	unsigned int adapter;               //N of /dev/i2c-N
+	int slave;                          //bound with I2C_SLAVE for write(), -1 for none
+	unsigned int loopback;
+
+	//the batch: message n is length[n] bytes at data + offset[n]
+	unsigned int count;
+	unsigned int used;                  //bytes of data taken
+	unsigned short msg_slave[I2C_DEV_MAX_MSGS];
+	unsigned short msg_offset[I2C_DEV_MAX_MSGS];
+	unsigned short msg_length[I2C_DEV_MAX_MSGS];
+	I2C_CALLBACK callback[I2C_DEV_MAX_MSGS];
+	void *context[I2C_DEV_MAX_MSGS];
+	unsigned char data[I2C_DEV_BATCH_BYTES];
+
+	//loopback PCA9685
+	unsigned char regs[256];
+
+	//statistics
+	unsigned int syscalls;              //write(), ioctl() and their loopback stand-ins
+	unsigned int binds;                 //I2C_SLAVE ioctls
+	unsigned int batches;               //I2C_RDWR ioctls
+	unsigned int messages;              //transactions sent, written or batched
+	unsigned int bytes;                 //bytes of the transactions, without the address byte
+	unsigned int failed;                //write() or I2C_RDWR calls that failed
+} I2C_DEV;
+
+//open /dev/i2c-adapter and keep it open, I2C_OK or I2C_DEV_ERR_SYSTEM
+int I2C_DEV_OPEN ( I2C_DEV *dev, unsigned int adapter );
+
+//the stand-in device on /dev/null
+int I2C_DEV_LOOPBACK ( I2C_DEV *dev );
+
+void I2C_DEV_CLOSE ( I2C_DEV *dev );
+
+//one transaction as one write(), bound to slave first when it is another one; I2C_OK, I2C_ERR_NACK,
+//I2C_ERR_TIMEOUT, I2C_ERR_AL or I2C_DEV_ERR_SYSTEM
+int I2C_DEV_WRITE ( I2C_DEV *dev, unsigned int slave, const unsigned char *bytes, unsigned int length );
+
+//add one transaction to the batch, returns at once unless a full batch has to go first; the callback runs from
+//I2C_DEV_FLUSH with the result of the batch. I2C_ERR_LENGTH when it could never fit
+int I2C_DEV_QUEUE ( I2C_DEV *dev, unsigned int slave, const unsigned char *bytes, unsigned int length,
+                    I2C_CALLBACK callback, void *context );
+
+//send the batch with one I2C_RDWR ioctl, I2C_OK when it is empty
+int I2C_DEV_FLUSH ( I2C_DEV *dev );
+
+//count registers from reg, after the batch has gone: the register byte and a repeated START read in one I2C_RDWR
+int I2C_DEV_READ ( I2C_DEV *dev, unsigned int slave, unsigned char reg, unsigned char *values, unsigned int count );
+
+#endif
@@ -0,0 +1,87 @@
+/**********************************************************************************************************************
+*   EDMA3 transmit backend                                                                                            *
+*                                                                                                                     *
+*   Only the parts of the EDMA3 channel controller the I2C transmit path needs: one channel per controller, mapped    *
+*   to the PaRAM set of the same number, with its events and completion code owned by shadow region 0.                *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "intc.h"
+#include "i2c_dma.h"
+
+#define EDMA_CHANNEL_BIT(dma) ( 1u << (dma)->channel )
+
+I2C_DMA I2C2_DMA = { .channel = EDMA_I2C2_TX_CHANNEL, .event = EDMA_XBAR_I2C2_TX, .param = EDMA_I2C2_TX_CHANNEL };
+
+void I2C_DMA_INIT ( I2C_DMA *dma, I2C_BUS *bus ){
+
+	unsigned int shift = 8 * ( dma->channel % 4 );
+	unsigned int mux;
+
+	//turn on the channel controller and transfer controller 0
+	REG_WRITE ( CM_PER_ADDRESS + CM_PER_TPCC_CLKCTRL, 0x02 );
+	REG_WRITE ( CM_PER_ADDRESS + CM_PER_TPTC0_CLKCTRL, 0x02 );
+
+	//route the controller transmit event to the channel, the other three channels in the register keep theirs
+	mux = REG_READ ( CNTRL_MODULE + TPCC_EVT_MUX ( dma->channel ) );
+	REG_WRITE ( CNTRL_MODULE + TPCC_EVT_MUX ( dma->channel ), ( mux & ~( 0xFFu << shift ) ) | ( dma->event << shift ) );
+
+	//channel to PaRAM set, region 0 owns the channel, nothing left over from before
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_DCHMAP ( dma->channel ), dma->param << 5 );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_DRAE0, REG_READ ( EDMA_BASE_ADDRESS + EDMA_DRAE0 ) | EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_ECR, EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_SECR, EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_EMCR, EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_ICR, EDMA_CHANNEL_BIT ( dma ) );
+
+	//the event starts transfers from now on, the completion code raises EDMACOMPINT
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_EESR, EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_IESR, EDMA_CHANNEL_BIT ( dma ) );
+	if ( dma == &I2C2_DMA ) {
+		INTC_REGISTER ( EDMA_COMPLETION_INT, EDMA_COMPLETION_IRQ_HANDLER );
+	}
+
+	//I2C_INIT turns the request line back on after every reset
+	bus->dma = dma;
+	REG_WRITE ( bus->base + DMATXENABLE_SET, I2C_DMATX_ENABLE );
+}
+
+//one event moves threshold bytes into DATA, CCNT events move the whole transfer
+void I2C_DMA_START ( I2C_DMA *dma, I2C_BUS *bus, const unsigned char *bytes, unsigned int length, unsigned int threshold ){
+
+	unsigned int set = EDMA_BASE_ADDRESS + EDMA_PARAM ( dma->param );
+
+	//a transfer that failed half way may have left an event or a completion behind
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_ECR, EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_EMCR, EDMA_CHANNEL_BIT ( dma ) );
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_ICR, EDMA_CHANNEL_BIT ( dma ) );
+
+	REG_WRITE ( set + EDMA_OPT, EDMA_OPT_TCINTEN | EDMA_OPT_TCC ( dma->channel ) | EDMA_OPT_SYNCDIM );
+	REG_WRITE ( set + EDMA_SRC, DMA_ADDRESS ( bytes, length ) );
+	REG_WRITE ( set + EDMA_A_B_CNT, ( threshold << 16 ) | 1 );
+	REG_WRITE ( set + EDMA_DST, bus->base + DATA );
+	REG_WRITE ( set + EDMA_SRC_DST_BIDX, 1 );               //source steps a byte, DATA stays put
+	REG_WRITE ( set + EDMA_LINK_BCNTRLD, EDMA_LINK_NULL );
+	REG_WRITE ( set + EDMA_SRC_DST_CIDX, threshold );       //next event starts after the last threshold
+	REG_WRITE ( set + EDMA_CCNT, length / threshold );
+
+	dma->started++;
+	dma->bytes += length;
+}
+
+void I2C_DMA_IRQ ( I2C_DMA *dma ){
+
+	if ( REG_READ ( EDMA_BASE_ADDRESS + EDMA_IPR ) & EDMA_CHANNEL_BIT ( dma ) ) {
+		REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_ICR, EDMA_CHANNEL_BIT ( dma ) );
+		dma->completed++;
+	}
+
+	//a completion that came in meanwhile raises the interrupt again
+	REG_WRITE ( EDMA_BASE_ADDRESS + EDMA_IEVAL, EDMA_IEVAL_EVAL );
+}
+
+void EDMA_COMPLETION_IRQ_HANDLER ( ){
+
+	I2C_DMA_IRQ ( &I2C2_DMA );
+}
@@ -0,0 +1,46 @@
+/**********************************************************************************************************************
+*   EDMA3 transmit backend for the I2C controller                                                                     *
+*                                                                                                                     *
+*   With a backend attached to an I2C_BUS, I2C_WRITE and the interrupt driven queue hand the bytes of a transfer to   *
+*   an EDMA3 channel instead of writing DATA on every XRDY. The controller raises its transmit DMA request (routed to *
+*   the channel through the control module crossbar) whenever the FIFO has room for a threshold, and each request     *
+*   moves one threshold of bytes from the buffer into DATA. The threshold is picked to divide the transfer length, so *
+*   the whole transfer is a single AB synchronized PaRAM set with CCNT thresholds.                                    *
+*                                                                                                                     *
+*   When the last threshold has been moved the completion code raises EDMACOMPINT; the buffer may be reused from      *
+*   then on. The transaction itself still ends on ARDY, which carries the NACK / AL result from the bus.              *
+*                                                                                                                     *
+*   The buffer is read straight from memory, the programs run without the data cache so it needs no cleaning.         *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef I2C_DMA_H
+#define I2C_DMA_H
+
+#include "i2c.h"
+
+#define I2C_DMATX_ENABLE ( 1 << 0 )                 //DMATXENABLE_SET / _CLR transmit request bit
+
+typedef struct I2C_DMA {
+	unsigned int channel;               //EDMA channel the transmit event is routed to, also its completion code
+	unsigned int event;                 //crossbar input of the controller transmit event
+	unsigned int param;                 //PaRAM set of the channel
+
+	//statistics
+	unsigned int started;               //transfers handed to the EDMA
+	volatile unsigned int completed;    //completion interrupts taken
+	unsigned long long bytes;
+} I2C_DMA;
+
+extern I2C_DMA I2C2_DMA;                            //I2C2 transmit event on EDMA_I2C2_TX_CHANNEL
+
+//turn on the EDMA, route the event to the channel and attach the backend to the bus
+void I2C_DMA_INIT ( I2C_DMA *dma, I2C_BUS *bus );
+
+//program the PaRAM set for length bytes in threshold sized events, called before the START
+void I2C_DMA_START ( I2C_DMA *dma, I2C_BUS *bus, const unsigned char *bytes, unsigned int length, unsigned int threshold );
+
+void I2C_DMA_IRQ ( I2C_DMA *dma );                  //acknowledge the completion code, called from the interrupt
+void EDMA_COMPLETION_IRQ_HANDLER ( );               //INTC handler for EDMACOMPINT
+
+#endif
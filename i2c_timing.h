@@ -0,0 +1,80 @@
+/**********************************************************************************************************************
+*   I2C bus timing                                                                                                    *
+*                                                                                                                     *
+*   PSC, SCLL and SCLH computed at compile time from the functional clock and the SCL rate, instead of values worked  *
+*   out by hand. The controller divides the functional clock by PSC + 1 to get its internal clock; SCL is then low    *
+*   for SCLL + 7 and high for SCLH + 5 internal clocks.                                                               *
+*                                                                                                                     *
+*   The internal clock follows the manual's recommendation: about 4 MHz for standard mode and 12 MHz for fast mode.   *
+*   Fast-mode Plus needs 24 MHz to leave enough clocks for the low time. The period is split between low and high     *
+*   in the ratio of the minimum low and high times of the mode, so both stay inside the I2C specification.            *
+*                                                                                                                     *
+*   I2C_TIMING_CHECK fails the build when a rate cannot be reached: a divider out of range, a low or high time        *
+*   below the specification, or an achieved rate more than 10% below the target.                                      *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef I2C_TIMING_H
+#define I2C_TIMING_H
+
+#define I2C_FCLK_HZ 48000000                        //functional clock of the I2C modules (PER_CLKOUTM2 / 4)
+
+#define I2C_RATE_STANDARD 100000
+#define I2C_RATE_FAST 400000
+#define I2C_RATE_FAST_PLUS 1000000
+
+//fastest rate the PCA9685 accepts (Fm+); the AM335x manual only specifies the controller up to 400 kbps,
+//so check SCL on a scope before using it on the board
+#define I2C_RATE_FASTEST I2C_RATE_FAST_PLUS
+
+#ifndef I2C0_RATE_HZ
+#define I2C0_RATE_HZ I2C_RATE_FAST                  //rate of I2C0, can be changed with -DI2C0_RATE_HZ=...
+#endif
+#ifndef I2C1_RATE_HZ
+#define I2C1_RATE_HZ I2C_RATE_FAST
+#endif
+#ifndef I2C2_RATE_HZ
+#define I2C2_RATE_HZ I2C_RATE_FAST                  //rate of I2C2, can be changed with -DI2C2_RATE_HZ=...
+#endif
+
+//minimum SCL low and high times of the mode the rate falls in
+#define I2C_TLOW_MIN_NS(rate) ( (rate) <= I2C_RATE_STANDARD ? 4700 : (rate) <= I2C_RATE_FAST ? 1300 : 500 )
+#define I2C_THIGH_MIN_NS(rate) ( (rate) <= I2C_RATE_STANDARD ? 4000 : (rate) <= I2C_RATE_FAST ? 600 : 260 )
+
+//internal clock to aim for, and the prescaler that gives it
+#define I2C_ICLK_TARGET_HZ(rate) ( (rate) <= I2C_RATE_STANDARD ? 4000000 : (rate) <= I2C_RATE_FAST ? 12000000 : 24000000 )
+#define I2C_PSC(fclk, rate) ( (fclk) / I2C_ICLK_TARGET_HZ ( rate ) - 1 )
+#define I2C_ICLK_HZ(fclk, rate) ( (fclk) / ( I2C_PSC ( fclk, rate ) + 1 ) )
+
+//internal clocks in one SCL period, and the low part of it rounded up
+#define I2C_PERIOD_CLOCKS(fclk, rate) ( I2C_ICLK_HZ ( fclk, rate ) / (rate) )
+#define I2C_LOW_CLOCKS(fclk, rate) \
+	( ( I2C_PERIOD_CLOCKS ( fclk, rate ) * I2C_TLOW_MIN_NS ( rate ) + I2C_TLOW_MIN_NS ( rate ) + I2C_THIGH_MIN_NS ( rate ) - 1 ) \
+	  / ( I2C_TLOW_MIN_NS ( rate ) + I2C_THIGH_MIN_NS ( rate ) ) )
+#define I2C_HIGH_CLOCKS(fclk, rate) ( I2C_PERIOD_CLOCKS ( fclk, rate ) - I2C_LOW_CLOCKS ( fclk, rate ) )
+
+//the register values
+#define I2C_SCLL(fclk, rate) ( I2C_LOW_CLOCKS ( fclk, rate ) - 7 )
+#define I2C_SCLH(fclk, rate) ( I2C_HIGH_CLOCKS ( fclk, rate ) - 5 )
+
+//what the bus will actually run at
+#define I2C_CLOCKS_NS(fclk, rate, clocks) ( (clocks) * 1000000000ULL / I2C_ICLK_HZ ( fclk, rate ) )
+#define I2C_ACHIEVED_HZ(fclk, rate) ( I2C_ICLK_HZ ( fclk, rate ) / ( I2C_LOW_CLOCKS ( fclk, rate ) + I2C_HIGH_CLOCKS ( fclk, rate ) ) )
+
+//designated initializers for an I2C_BUS
+#define I2C_TIMING(fclk, rate) \
+	.psc = I2C_PSC ( fclk, rate ), .scll = I2C_SCLL ( fclk, rate ), .sclh = I2C_SCLH ( fclk, rate )
+
+//stop the build when the rate cannot be reached with this functional clock
+#define I2C_TIMING_CHECK(fclk, rate) \
+	_Static_assert ( (rate) > 0 && (rate) <= I2C_RATE_FAST_PLUS, "I2C rate above Fast-mode Plus" ); \
+	_Static_assert ( I2C_PSC ( fclk, rate ) >= 0 && I2C_PSC ( fclk, rate ) <= 0xFF, "I2C PSC out of range" ); \
+	_Static_assert ( I2C_SCLL ( fclk, rate ) >= 0 && I2C_SCLL ( fclk, rate ) <= 0xFF, "I2C SCLL out of range" ); \
+	_Static_assert ( I2C_SCLH ( fclk, rate ) >= 0 && I2C_SCLH ( fclk, rate ) <= 0xFF, "I2C SCLH out of range" ); \
+	_Static_assert ( I2C_CLOCKS_NS ( fclk, rate, I2C_LOW_CLOCKS ( fclk, rate ) ) >= I2C_TLOW_MIN_NS ( rate ), \
+	                 "I2C SCL low time below the specification" ); \
+	_Static_assert ( I2C_CLOCKS_NS ( fclk, rate, I2C_HIGH_CLOCKS ( fclk, rate ) ) >= I2C_THIGH_MIN_NS ( rate ), \
+	                 "I2C SCL high time below the specification" ); \
+	_Static_assert ( I2C_ACHIEVED_HZ ( fclk, rate ) >= (rate) - (rate) / 10, "I2C rate not reachable within 10%" )
+
+#endif
@@ -0,0 +1,109 @@
+/**********************************************************************************************************************
+*   I2C phase trace                                                                                                   *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "i2c_trace.h"
+
+#ifdef I2C_TRACING
+
+#include <string.h>
+
+//the entry has to be in memory before head says so, the reader may be the other context
+#define TRACE_PUBLISH() asm volatile ( "" : : : "memory" )
+
+I2C_TRACE I2C2_TRACE;
+
+static void TRACE_PUT32 ( unsigned char *out, unsigned int value ){
+
+	out[0] = value & 0xFF;
+	out[1] = ( value >> 8 ) & 0xFF;
+	out[2] = ( value >> 16 ) & 0xFF;
+	out[3] = value >> 24;
+}
+
+void I2C_TRACE_INIT ( I2C_TRACE *trace, I2C_BUS *bus ){
+
+	bus->trace = trace;
+	if ( !trace ) {
+		return;
+	}
+
+	memset ( trace, 0, sizeof ( *trace ) );
+	for ( unsigned int phase = 0; phase < I2C_TRACE_PHASES; phase++ ) {
+		trace->phase[phase].min = ~0u;
+	}
+	switch ( bus->base ) {
+	case I2C0_BASE_ADDRESS: trace->bus = 0; break;
+	case I2C1_BASE_ADDRESS: trace->bus = 1; break;
+	default: trace->bus = 2; break;
+	}
+	trace->mark = CYCLE_COUNT ( );
+}
+
+void I2C_TRACE_RECORD ( I2C_TRACE *trace, unsigned int phase ){
+
+	unsigned int now = CYCLE_COUNT ( );
+	unsigned int cycles = now - trace->mark;
+	I2C_TRACE_STATS *stats = &trace->phase[phase];
+	unsigned int head = trace->head;
+
+	trace->mark = now;
+
+	stats->count++;
+	stats->sum += cycles;
+	if ( cycles < stats->min ) {
+		stats->min = cycles;
+	}
+	if ( cycles > stats->max ) {
+		stats->max = cycles;
+	}
+	stats->histogram[I2C_TRACE_BUCKET ( cycles )]++;
+
+	if ( head - trace->tail == I2C_TRACE_DEPTH ) {
+		trace->dropped++;
+		return;
+	}
+	trace->ring[head % I2C_TRACE_DEPTH].stamp = now;
+	trace->ring[head % I2C_TRACE_DEPTH].info = I2C_TRACE_INFO ( cycles, phase, trace->bus );
+	TRACE_PUBLISH ( );
+	trace->head = head + 1;
+}
+
+unsigned int I2C_TRACE_DUMP ( I2C_TRACE *trace, unsigned char *out, unsigned int size ){
+
+	unsigned int tail = trace->tail;
+	unsigned int count = trace->head - tail;
+	unsigned int dropped = trace->dropped;
+	unsigned char *entry;
+
+	if ( size < I2C_TRACE_HEADER_BYTES ) {
+		return 0;
+	}
+	if ( count > ( size - I2C_TRACE_HEADER_BYTES ) / I2C_TRACE_ENTRY_BYTES ) {
+		count = ( size - I2C_TRACE_HEADER_BYTES ) / I2C_TRACE_ENTRY_BYTES;
+	}
+
+	memcpy ( out, I2C_TRACE_MAGIC, 4 );
+	out[4] = I2C_TRACE_VERSION;
+	out[5] = (unsigned char) trace->bus;
+	out[6] = CPU_MHZ & 0xFF;
+	out[7] = ( CPU_MHZ >> 8 ) & 0xFF;
+	TRACE_PUT32 ( out + 8, count );
+	TRACE_PUT32 ( out + 12, dropped - trace->dumped_dropped );
+	trace->dumped_dropped = dropped;
+
+	entry = out + I2C_TRACE_HEADER_BYTES;
+	for ( unsigned int i = 0; i < count; i++ ) {
+		TRACE_PUT32 ( entry, trace->ring[( tail + i ) % I2C_TRACE_DEPTH].stamp );
+		TRACE_PUT32 ( entry + 4, trace->ring[( tail + i ) % I2C_TRACE_DEPTH].info );
+		entry += I2C_TRACE_ENTRY_BYTES;
+	}
+
+	//the slots are free for the writer again
+	TRACE_PUBLISH ( );
+	trace->tail = tail + count;
+	return I2C_TRACE_HEADER_BYTES + count * I2C_TRACE_ENTRY_BYTES;
+}
+
+#endif
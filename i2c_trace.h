@@ -0,0 +1,113 @@
+/**********************************************************************************************************************
+*   I2C phase trace                                                                                                   *
+*                                                                                                                     *
+*   Cycle stamps for every wait phase of a transfer: the SYSS reset wait, BB clear before the START, each XRDY and    *
+*   RRDY, ARDY at the end, and the NOP delays of the original I2C2_TRANSMIT path. With a trace attached to an I2C_BUS *
+*   (I2C_TRACE_INIT), the end of each phase takes CYCLE_COUNT, the Cortex-A8 PMU cycle counter (simulated time on a   *
+*   host build), and the cycles since the end of the phase before it go into the per phase statistics and the ring.   *
+*                                                                                                                     *
+*   The ring is lock free for one writer and one reader: the transfer code (polled, or the queue interrupt handler)   *
+*   only moves head, I2C_TRACE_DUMP only moves tail. A full ring drops new entries and counts them. The statistics    *
+*   are plain counters updated by the writer; min, max, the sum for the mean and a log2 histogram per phase.          *
+*                                                                                                                     *
+*   I2C_TRACE_DUMP drains the ring into a byte buffer: a 16 byte header (I2C_TRACE_MAGIC, version, bus, CPU_MHZ,      *
+*   entry count, entries dropped since the last dump) followed by 8 byte entries, all little endian. Dumps can be     *
+*   concatenated; i2c_trace_decode.c reads them back on a host and prints every entry and the per phase statistics.   *
+*                                                                                                                     *
+*   Everything here only exists when built with -DI2C_TRACING. Without it I2C_TRACE_BEGIN and I2C_TRACE_PHASE are     *
+*   empty, I2C_BUS has no trace pointer and i2c_trace.c compiles to nothing. The dump format below is always visible  *
+*   so the decoder can be built on its own.                                                                           *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include "cpu.h"
+#include "i2c.h"
+
+//phases, the wait phases of i2c.h plus the NOP delays of the original path
+#define I2C_TRACE_SPIN I2C_PHASES                   //CPU_SPIN delay loop
+#define I2C_TRACE_PHASES ( I2C_PHASES + 1 )
+
+#define I2C_TRACE_DEPTH 256                         //entries in the ring, a power of two
+#define I2C_TRACE_BUCKETS 16                        //histogram bucket 0 is below 64 cycles, each next one doubles
+#define I2C_TRACE_BUCKET_SHIFT 6
+
+//dump format
+#define I2C_TRACE_MAGIC "I2CT"
+#define I2C_TRACE_VERSION 1
+#define I2C_TRACE_HEADER_BYTES 16                   //magic, version, bus, CPU MHz (16 bit), count, dropped
+#define I2C_TRACE_ENTRY_BYTES 8                     //stamp, cycles (24 bit) | phase << 24 | bus << 28
+#define I2C_TRACE_MAX_CYCLES 0xFFFFFF               //longer phases are saturated in the entry, not in the statistics
+
+#define I2C_TRACE_INFO(cycles, phase, bus) ( ( (cycles) > I2C_TRACE_MAX_CYCLES ? I2C_TRACE_MAX_CYCLES : (cycles) ) \
+                                             | ( (unsigned int) (phase) << 24 ) | ( (unsigned int) (bus) << 28 ) )
+#define I2C_TRACE_INFO_CYCLES(info) ( (info) & I2C_TRACE_MAX_CYCLES )
+#define I2C_TRACE_INFO_PHASE(info) ( ( (info) >> 24 ) & 0xF )
+#define I2C_TRACE_INFO_BUS(info) ( (info) >> 28 )
+
+//histogram bucket of a phase length
+static inline unsigned int I2C_TRACE_BUCKET ( unsigned int cycles )
+{
+	unsigned int bucket = 0;
+
+	cycles >>= I2C_TRACE_BUCKET_SHIFT;
+	while ( cycles && bucket < I2C_TRACE_BUCKETS - 1 ) {
+		cycles >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+#ifdef I2C_TRACING
+
+typedef struct {
+	unsigned int stamp;                 //CYCLE_COUNT at the end of the phase
+	unsigned int info;                  //I2C_TRACE_INFO
+} I2C_TRACE_ENTRY;
+
+typedef struct {
+	unsigned int count;
+	unsigned int min;
+	unsigned int max;
+	unsigned long long sum;             //mean is sum / count
+	unsigned int histogram[I2C_TRACE_BUCKETS];
+} I2C_TRACE_STATS;
+
+typedef struct I2C_TRACE {
+	unsigned int bus;                   //0 to 2 for I2C0 to I2C2, goes into every entry
+	unsigned int mark;                  //CYCLE_COUNT at the end of the last phase
+
+	I2C_TRACE_ENTRY ring[I2C_TRACE_DEPTH];
+	volatile unsigned int head;         //entries written, only the writer moves it
+	volatile unsigned int tail;         //entries dumped, only the reader moves it
+	volatile unsigned int dropped;      //entries lost to a full ring
+	unsigned int dumped_dropped;        //dropped at the last dump
+
+	I2C_TRACE_STATS phase[I2C_TRACE_PHASES];
+} I2C_TRACE;
+
+extern I2C_TRACE I2C2_TRACE;
+
+//clear the ring and statistics and attach the trace to the bus, a NULL trace detaches
+void I2C_TRACE_INIT ( I2C_TRACE *trace, I2C_BUS *bus );
+
+//one phase ended now, called through I2C_TRACE_PHASE
+void I2C_TRACE_RECORD ( I2C_TRACE *trace, unsigned int phase );
+
+//move as many entries as fit into out (header included), returns the bytes written, 0 when nothing fits
+unsigned int I2C_TRACE_DUMP ( I2C_TRACE *trace, unsigned char *out, unsigned int size );
+
+//a transfer starts, the first phase is counted from here
+#define I2C_TRACE_BEGIN(bus) do { if ( (bus)->trace ) { (bus)->trace->mark = CYCLE_COUNT ( ); } } while ( 0 )
+#define I2C_TRACE_PHASE(bus, phase) do { if ( (bus)->trace ) { I2C_TRACE_RECORD ( (bus)->trace, (phase) ); } } while ( 0 )
+
+#else
+
+#define I2C_TRACE_BEGIN(bus) do { } while ( 0 )
+#define I2C_TRACE_PHASE(bus, phase) do { } while ( 0 )
+
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+/**********************************************************************************************************************
+*   Interrupt controller                                                                                              *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "intc.h"
+
+static INTC_HANDLER INTC_HANDLERS [ INTC_LINES ];
+
+//hook the dispatcher and enable IRQs on the core
+void INTC_INIT ( ){
+
+#ifdef AM335X_SIM
+	//the simulated core has no vector table, it calls the dispatcher directly
+	SIM_SET_IRQ_VECTOR ( INTC_DISPATCH );
+#endif
+
+	IRQ_ENABLE ( );
+}
+
+//install a handler, route the line to IRQ at the highest priority and unmask it
+void INTC_REGISTER ( unsigned int line, INTC_HANDLER handler ){
+
+	INTC_HANDLERS[line] = handler;
+	REG_WRITE ( INTC_BASE_ADDRESS + INTC_ILR ( line ), 0x0 );
+	REG_WRITE ( INTC_BASE_ADDRESS + INTC_MIR_CLEAR ( line / 32 ), 1u << ( line % 32 ) );
+}
+
+//run the handler of the active line, then allow the next IRQ
+void INTC_DISPATCH ( ){
+
+	unsigned int line = REG_READ ( INTC_BASE_ADDRESS + INTC_SIR_IRQ ) & INTC_SIR_ACTIVEIRQ_MASK;
+
+	if ( INTC_HANDLERS[line] ) {
+		INTC_HANDLERS[line] ( );
+	}
+
+	REG_WRITE ( INTC_BASE_ADDRESS + INTC_CONTROL, INTC_CONTROL_NEWIRQAGR );
+}
@@ -0,0 +1,20 @@
+/**********************************************************************************************************************
+*   Interrupt controller                                                                                              *
+*                                                                                                                     *
+*   Handlers are registered per INTC line. The IRQ vector of the startup code calls INTC_DISPATCH, which reads the    *
+*   active line from SIR_IRQ, runs its handler and lets the INTC pick the next interrupt.                             *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef INTC_H
+#define INTC_H
+
+#include "am335x.h"
+
+typedef void ( *INTC_HANDLER ) ( void );
+
+void INTC_INIT ( );                                         //hook the dispatcher and enable IRQs on the core
+void INTC_REGISTER ( unsigned int line, INTC_HANDLER handler );   //install a handler and unmask its line
+void INTC_DISPATCH ( );                                     //called from the IRQ vector
+
+#endif
@@ -0,0 +1,113 @@
+/**********************************************************************************************************************
+*   PCA9685 servo controller                                                                                          *
+*                                                                                                                     *
+*   Register writes to the PCA9685 over I2C2. A servo move touches LEDn_ON_L, LEDn_ON_H, LEDn_OFF_L and LEDn_OFF_H,   *
+*   which are contiguous, so with auto-increment on it is sent as one 5 byte transfer (register plus four values)     *
+*   instead of four 2 byte transactions with their own START, address and STOP. Read-backs use the same pointer: one  *
+*   combined transaction sets it and reads the whole range.                                                           *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "pca9685.h"
+
+_Static_assert ( PCA9685_PRESCALE ( PCA9685_OSC_HZ, 50 ) == PCA9685_PRESCALE_50HZ, "PCA9685_PRESCALE does not give 0x79 for 50 Hz" );
+
+//write count registers starting at reg in one transaction
+int PCA9685_WRITE_BURST ( I2C_BUS *bus, unsigned int slave, unsigned char reg, const unsigned char *values, unsigned int count ){
+
+	unsigned char frame [ PCA9685_MAX_BURST + 1 ];
+
+	if ( count == 0 || count > PCA9685_MAX_BURST ) {
+		return I2C_ERR_LENGTH;
+	}
+
+	//the first byte selects the register, the rest are stored with the pointer auto-incrementing
+	frame[0] = reg;
+	for ( unsigned int i = 0; i < count; i++ ) {
+		frame[i + 1] = values[i];
+	}
+
+	return I2C_WRITE ( bus, slave, frame, count + 1 );
+}
+
+//queue the burst, the frame is copied into the ring so values can be reused at once
+int PCA9685_WRITE_BURST_ASYNC ( I2C_QUEUE *queue, unsigned int slave, unsigned char reg, const unsigned char *values,
+                                unsigned int count, volatile int *status ){
+
+	unsigned char frame [ PCA9685_MAX_BURST + 1 ];
+
+	if ( count == 0 || count > PCA9685_MAX_BURST ) {
+		return I2C_ERR_LENGTH;
+	}
+
+	frame[0] = reg;
+	for ( unsigned int i = 0; i < count; i++ ) {
+		frame[i + 1] = values[i];
+	}
+
+	return I2C_QUEUE_WRITE ( queue, slave, frame, count + 1, status, 0, 0 );
+}
+
+//the register address without a STOP, then the values after a repeated START
+int PCA9685_READ_BURST ( I2C_BUS *bus, unsigned int slave, unsigned char reg, unsigned char *values, unsigned int count ){
+
+	return I2C_READ ( bus, slave, &reg, 1, values, count );
+}
+
+//a general call with the SWRST byte, a device that ignores its own address still answers to it
+int PCA9685_SOFTWARE_RESET ( I2C_BUS *bus ){
+
+	unsigned char swrst = PCA9685_SWRST;
+
+	return I2C_WRITE ( bus, PCA9685_GENERAL_CALL_ADDRESS, &swrst, 1 );
+}
+
+//turn on auto-increment, read-modify-write so SLEEP, EXTCLK and the address enables stay as they are
+int PCA9685_ENABLE_AUTO_INCREMENT ( I2C_BUS *bus, unsigned int slave ){
+
+	unsigned char mode1 [ 2 ] = { MODE1, 0 };
+	int result;
+
+	if ( ( result = PCA9685_READ_BURST ( bus, slave, MODE1, &mode1[1], 1 ) ) != I2C_OK ) {
+		return result;
+	}
+
+	//RESTART reads 1 when PWM was stopped by SLEEP: written back it restarts the channels, but only once awake
+	if ( mode1[1] & MODE1_SLEEP ) {
+		mode1[1] &= ~MODE1_RESTART;
+	}
+	mode1[1] |= MODE1_AI;
+	return I2C_WRITE ( bus, slave, mode1, 2 );
+}
+
+//ON_L, ON_H, OFF_L, OFF_H of one channel in a single burst
+int PCA9685_SET_CHANNEL ( I2C_BUS *bus, unsigned int slave, unsigned int channel, unsigned int on, unsigned int off ){
+
+	unsigned char counts [ 4 ] = { on & 0xFF, ( on >> 8 ) & 0x1F, off & 0xFF, ( off >> 8 ) & 0x1F };
+
+	//past LED15 the burst would land on the reserved registers
+	if ( channel >= PCA9685_CHANNELS ) {
+		return PCA9685_ERR_REGISTER;
+	}
+	return PCA9685_WRITE_BURST ( bus, slave, LED_ON_L ( channel ), counts, 4 );
+}
+
+unsigned char PCA9685_PRESCALE_FOR ( unsigned int osc_hz, unsigned int rate_hz ){
+
+	unsigned long long prescale;
+
+	if ( rate_hz == 0 ) {
+		return PCA9685_PRESCALE_MAX;
+	}
+	prescale = ( osc_hz + 2048ULL * rate_hz ) / ( 4096ULL * rate_hz );
+	if ( prescale <= PCA9685_PRESCALE_MIN ) {
+		return PCA9685_PRESCALE_MIN;
+	}
+	return prescale - 1 > PCA9685_PRESCALE_MAX ? PCA9685_PRESCALE_MAX : (unsigned char) ( prescale - 1 );
+}
+
+//one period is 4096 * ( prescale + 1 ) oscillator clocks
+unsigned int PCA9685_OSC_FROM_PWM ( unsigned char prescale, unsigned int measured_millihz ){
+
+	return (unsigned int) ( ( (unsigned long long) measured_millihz * 4096 * ( prescale + 1 ) + 500 ) / 1000 );
+}
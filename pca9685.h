@@ -0,0 +1,118 @@
+/**********************************************************************************************************************
+*   PCA9685 register map                                                                                              *
+*                                                                                                                     *
+*   Register addresses and bits of the PCA9685 16 channel PWM controller used to drive the servos. The device sits    *
+*   at slave address 0x40 because A5-A0 are grounded in the schematic and the MSB is always a 1.                      *
+*                                                                                                                     *
+*   With the MODE1 auto-increment bit set the register pointer advances after every byte, so a run of registers can   *
+*   be written as "reg, b0, b1, ... bn" in a single I2C transaction instead of one transaction per register. Reads    *
+*   work the same way: the register address is written, and after a repeated START the device sends that register and *
+*   the ones after it for as long as the master keeps reading.                                                        *
+*                                                                                                                     *
+*   PCA9685_SOFTWARE_RESET sends SWRST to the general call address. Every PCA9685 on the bus takes it, whatever its   *
+*   address, and goes back to its power on registers: asleep, auto-increment off, all channels FULL_OFF.              *
+*                                                                                                                     *
+*   The PWM period is 4096 counts of ( PRE_SCALE + 1 ) oscillator clocks. The internal oscillator is only specified   *
+*   to 25 MHz +- a few percent, so a rate that matters is worked out from a calibrated oscillator frequency:          *
+*   PCA9685_OSC_FROM_PWM takes a PWM frequency measured on an output and gives the oscillator that produced it.       *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef PCA9685_H
+#define PCA9685_H
+
+#include "i2c_async.h"
+
+#define PCA9685_ADDRESS 0x40            //slave address with A5-A0 grounded
+#define PCA9685_ALLCALL_ADDRESS 0x70    //LED All Call address after power on (ALLCALLADR 0xE0)
+#define PCA9685_GENERAL_CALL_ADDRESS 0x00
+#define PCA9685_SWRST 0x06              //general call data byte: software reset to the power on registers
+
+//PCA9685 addresses
+
+#define MODE1 0x00                      //address to enable bits for SLEEP, ALLCALL, RESTART, etc
+#define MODE2 0x01                      //address to enable totem pole structure and non-inverted
+#define SUBADR1 0x02                    //I2C bus subaddress 1
+#define SUBADR2 0x03                    //I2C bus subaddress 2
+#define SUBADR3 0x04                    //I2C bus subaddress 3
+#define ALLCALLADR 0x05                 //LED All Call I2C bus address
+
+#define LED0_ON_L 0x06                  //first LED register, each channel has ON_L, ON_H, OFF_L, OFF_H
+#define LED_ON_L(n) ( LED0_ON_L + 4 * (n) )
+#define LED_ON_H(n) ( LED0_ON_L + 4 * (n) + 1 )
+#define LED_OFF_L(n) ( LED0_ON_L + 4 * (n) + 2 )
+#define LED_OFF_H(n) ( LED0_ON_L + 4 * (n) + 3 )
+
+#define LED8_ON_L 0x26                  //address for LED8 on low
+#define LED8_ON_H 0x27                  //address for LED8 on high
+#define LED8_OFF_L 0x28                 //address for LED8 off low
+#define LED8_OFF_H 0x29                 //address for LED8 off high
+
+#define LED15_ON_H 0x43                 //address for LED15 FULL_ON (going to be enabled using a 1)
+#define LED15_OFF_H 0x45                //address for LED15 FULL_OFF (going to be disabled by writing a 0)
+
+#define ALL_LED_ON_L 0xFA               //writes to the ALL_LED registers load every channel at once
+#define ALL_LED_ON_H 0xFB
+#define ALL_LED_OFF_L 0xFC
+#define ALL_LED_OFF_H 0xFD
+#define PRE_SCALE_SERVO 0xFE            //prescale address for servo
+
+//MODE1 bits
+
+#define MODE1_ALLCALL ( 1 << 0 )        //respond to the LED All Call address
+#define MODE1_SUB3 ( 1 << 1 )
+#define MODE1_SUB2 ( 1 << 2 )
+#define MODE1_SUB1 ( 1 << 3 )
+#define MODE1_SLEEP ( 1 << 4 )          //low power mode, oscillator off
+#define MODE1_AI ( 1 << 5 )             //register auto-increment
+#define MODE1_EXTCLK ( 1 << 6 )
+#define MODE1_RESTART ( 1 << 7 )
+
+//MODE2 bits
+
+#define MODE2_OUTDRV ( 1 << 2 )         //totem pole outputs, the power on value
+
+#define LED_FULL ( 1 << 4 )             //FULL_ON / FULL_OFF bit in LEDn_ON_H / LEDn_OFF_H
+
+#define PCA9685_CHANNELS 16
+#define PCA9685_MAX_BURST 64            //data bytes in one burst, enough for all 16 channels
+#define PCA9685_ERR_REGISTER -5         //reserved or test mode register, or a channel past 15
+
+#define PCA9685_OSC_HZ 25000000         //internal oscillator, nominal
+#define PCA9685_OSC_US 500              //oscillator start up after SLEEP is cleared
+#define PCA9685_PRESCALE_50HZ 0x79      //PRE_SCALE for a 50 Hz servo period: 25 MHz / ( 4096 * ( 0x79 + 1 ) )
+#define PCA9685_PRESCALE_MIN 0x03       //the device takes nothing lower, 1526 Hz at 25 MHz
+#define PCA9685_PRESCALE_MAX 0xFF       //24 Hz at 25 MHz
+
+//PRE_SCALE for a PWM rate in Hz, rounded to the nearest: osc / ( 4096 * rate ) - 1
+#define PCA9685_PRESCALE(osc_hz, rate_hz) ( ( (osc_hz) + 2048ULL * (rate_hz) ) / ( 4096ULL * (rate_hz) ) - 1 )
+
+//PCA9685_PRESCALE at run time, clamped to PCA9685_PRESCALE_MIN to PCA9685_PRESCALE_MAX
+unsigned char PCA9685_PRESCALE_FOR ( unsigned int osc_hz, unsigned int rate_hz );
+
+//the oscillator frequency that puts out measured_millihz (PWM frequency in thousandths of a Hz) at prescale
+unsigned int PCA9685_OSC_FROM_PWM ( unsigned char prescale, unsigned int measured_millihz );
+
+//write count registers starting at reg in one transaction, MODE1 must have MODE1_AI set; I2C_ERR_LENGTH unless
+//count is 1 to PCA9685_MAX_BURST
+int PCA9685_WRITE_BURST ( I2C_BUS *bus, unsigned int slave, unsigned char reg, const unsigned char *values, unsigned int count );
+
+//the same burst through the interrupt driven queue, returns at once, status turns from I2C_PENDING to the result;
+//I2C_ERR_LENGTH without queueing anything unless count is 1 to PCA9685_MAX_BURST
+int PCA9685_WRITE_BURST_ASYNC ( I2C_QUEUE *queue, unsigned int slave, unsigned char reg, const unsigned char *values,
+                                unsigned int count, volatile int *status );
+
+//read count registers starting at reg in one transaction (register address, repeated START, data), more than one
+//register needs MODE1_AI set
+int PCA9685_READ_BURST ( I2C_BUS *bus, unsigned int slave, unsigned char reg, unsigned char *values, unsigned int count );
+
+//SWRST through the general call, resets every PCA9685 on the bus
+int PCA9685_SOFTWARE_RESET ( I2C_BUS *bus );
+
+//set the MODE1 auto-increment bit on top of what MODE1 reads, a PWM stopped by SLEEP is restarted once awake
+int PCA9685_ENABLE_AUTO_INCREMENT ( I2C_BUS *bus, unsigned int slave );
+
+//load ON and OFF counts of one channel as a single 5 byte transfer; PCA9685_ERR_REGISTER for a channel past 15
+int PCA9685_SET_CHANNEL ( I2C_BUS *bus, unsigned int slave, unsigned int channel, unsigned int on, unsigned int off );
+
+#endif
@@ -0,0 +1,252 @@
+/**********************************************************************************************************************
+*   Bank of PCA9685 controllers on several buses                                                                      *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include <string.h>
+
+#include "cpu.h"
+#include "pca9685_bank.h"
+
+void PCA9685_BANK_INIT ( PCA9685_BANK *bank ){
+
+	bank->count = 0;
+	bank->channels = 0;
+	bank->frames = bank->all_call_frames = 0;
+	bank->broadcasts = bank->broadcast_transactions = bank->fallbacks = bank->broadcast_failures = 0;
+}
+
+int PCA9685_BANK_ADD ( PCA9685_BANK *bank, PCA9685_CACHE *device ){
+
+	if ( bank->count == PCA9685_BANK_DEVICES ) {
+		return -1;
+	}
+	bank->device[bank->count++] = device;
+	bank->channels += PCA9685_CHANNELS;
+	return (int) ( bank->channels - PCA9685_CHANNELS );
+}
+
+//the first board added on the same queue, the same polled bus or the same i2c-dev that answers address: the one that
+//sends the broadcast for all of them
+static unsigned int BANK_SENDER ( const PCA9685_BANK *bank, unsigned int index, unsigned int address ){
+
+	const PCA9685_CACHE *device = bank->device[index];
+
+	for ( unsigned int i = 0; i < index; i++ ) {
+		if ( PCA9685_CACHE_ANSWERS ( bank->device[i], address ) && bank->device[i]->bus == device->bus
+		     && bank->device[i]->dev == device->dev ) {
+			return i;
+		}
+	}
+	return index;
+}
+
+//a broadcast that failed leaves every board on that bus that answers it in an unknown state; the boards are found
+//before any mirror is cleared, a cleared MODE1 would hide the subaddresses
+static void BANK_BROADCAST_DONE ( void *context, int result ){
+
+	PCA9685_BANK_SENT *sent = context;
+	PCA9685_BANK *bank = sent->bank;
+	const PCA9685_CACHE *device = bank->device[sent->index];
+	unsigned int lost = 0;
+
+	if ( result != I2C_OK ) {
+		bank->broadcast_failures++;
+		for ( unsigned int i = 0; i < bank->count; i++ ) {
+			if ( bank->device[i]->bus == device->bus && bank->device[i]->dev == device->dev
+			     && ( sent->any || PCA9685_CACHE_ANSWERS ( bank->device[i], sent->address ) ) ) {
+				lost |= 1u << i;
+			}
+		}
+		for ( unsigned int i = 0; i < bank->count; i++ ) {
+			if ( lost & ( 1u << i ) ) {
+				memset ( bank->device[i]->valid, 0, sizeof ( bank->device[i]->valid ) );
+			}
+		}
+	}
+	if ( --sent->pending == 0 ) {
+		sent->any = 0;
+	}
+}
+
+//the board sends the broadcast for its bus, the callback knows where it went
+static int BANK_BROADCAST_SEND ( PCA9685_BANK *bank, unsigned int index, unsigned int address,
+                                 const unsigned char *frame, unsigned int length ){
+
+	PCA9685_CACHE *device = bank->device[index];
+	PCA9685_BANK_SENT *sent = &bank->sent[index];
+	unsigned int state = IRQ_SAVE ( );
+	int result;
+
+	if ( sent->pending && sent->address != address ) {
+		sent->any = 1;
+	}
+	sent->bank = bank;
+	sent->index = index;
+	sent->address = address;
+	sent->pending++;
+	IRQ_RESTORE ( state );
+
+	result = PCA9685_CACHE_TRANSFER ( device, address, frame, length, BANK_BROADCAST_DONE, sent );
+
+	//polled, or refused before it was queued: the callback does not run
+	if ( result != I2C_OK || ( !device->queue && !device->dev ) ) {
+		state = IRQ_SAVE ( );
+		BANK_BROADCAST_DONE ( sent, result );
+		IRQ_RESTORE ( state );
+	}
+	return result;
+}
+
+int PCA9685_BANK_BROADCAST ( PCA9685_BANK *bank, unsigned int address, unsigned char reg, const unsigned char *values,
+                             unsigned int count ){
+
+	unsigned char frame [ PCA9685_MAX_BURST + 1 ];
+	PCA9685_CACHE *device;
+	unsigned int took = 0;
+	int result;
+
+	if ( count == 0 || count > PCA9685_MAX_BURST ) {
+		return PCA9685_ERR_REGISTER;
+	}
+	bank->broadcasts++;
+
+	//every board that answers has to step its register pointer the same way
+	for ( unsigned int i = 0; i < bank->count && count > 1; i++ ) {
+		device = bank->device[i];
+		if ( PCA9685_CACHE_ANSWERS ( device, address ) && !( device->valid[MODE1] && ( device->regs[MODE1] & MODE1_AI ) ) ) {
+			bank->fallbacks++;
+			for ( i = 0; i < bank->count; i++ ) {
+				device = bank->device[i];
+				if ( PCA9685_CACHE_ANSWERS ( device, address ) ) {
+					PCA9685_CACHE_WRITE_BURST ( device, reg, values, count );
+					if ( ( result = PCA9685_CACHE_FLUSH ( device ) ) != I2C_OK ) {
+						return result;
+					}
+				}
+			}
+			return I2C_OK;
+		}
+	}
+
+	frame[0] = reg;
+	for ( unsigned int i = 0; i < count; i++ ) {
+		frame[i + 1] = values[i];
+	}
+	for ( unsigned int i = 0; i < bank->count; i++ ) {
+		device = bank->device[i];
+		if ( !PCA9685_CACHE_ANSWERS ( device, address ) || BANK_SENDER ( bank, i, address ) != i ) {
+			continue;
+		}
+		if ( ( result = BANK_BROADCAST_SEND ( bank, i, address, frame, count + 1 ) ) != I2C_OK ) {
+
+			//the buses before this one took the values and the mirrors of their boards do not hold them yet
+			for ( unsigned int j = 0; j < bank->count; j++ ) {
+				if ( PCA9685_CACHE_ANSWERS ( bank->device[j], address ) && BANK_SENDER ( bank, j, address ) < i ) {
+					took |= 1u << j;
+				}
+			}
+			for ( unsigned int j = 0; j < bank->count; j++ ) {
+				if ( took & ( 1u << j ) ) {
+					PCA9685_CACHE_FORGET ( bank->device[j], reg, count );
+				}
+			}
+			return result;
+		}
+		bank->broadcast_transactions++;
+	}
+
+	//every board on those buses that answers the address took the values
+	for ( unsigned int i = 0; i < bank->count; i++ ) {
+		if ( PCA9685_CACHE_ANSWERS ( bank->device[i], address ) ) {
+			PCA9685_CACHE_ASSUME ( bank->device[i], reg, values, count );
+		}
+	}
+	return I2C_OK;
+}
+
+int PCA9685_BANK_WRITE_FRAME ( PCA9685_BANK *bank, const unsigned short *width ){
+
+	unsigned char all [ 4 ] = { 0x00, 0x00, 0x00, 0x00 };
+	unsigned int same = 1, all_call = 1, held = 1;
+	const PCA9685_CACHE *device;
+	int result;
+
+	bank->frames++;
+	for ( unsigned int channel = 1; channel < bank->channels && same; channel++ ) {
+		same = width[channel] == width[0];
+	}
+
+	//one width everywhere: ALL_LED through ALLCALL, once per bus, unless every board holds it already
+	if ( same && bank->channels > PCA9685_CHANNELS ) {
+		if ( width[0] >= PCA9685_FULL_ON ) {
+			all[1] = LED_FULL;
+		}
+		else {
+			all[2] = width[0] & 0xFF;
+			all[3] = ( width[0] >> 8 ) & 0x0F;
+		}
+		for ( unsigned int i = 0; i < bank->count; i++ ) {
+			device = bank->device[i];
+			all_call = all_call && PCA9685_CACHE_ANSWERS ( device, PCA9685_ALLCALL_ADDRESS );
+			for ( unsigned int channel = 0; channel < PCA9685_CHANNELS && held; channel++ ) {
+				for ( unsigned int b = 0; b < 4; b++ ) {
+					held = held && device->valid[LED_ON_L ( channel ) + b] && !device->dirty[LED_ON_L ( channel ) + b]
+					       && device->regs[LED_ON_L ( channel ) + b] == all[b];
+				}
+			}
+		}
+		if ( held ) {
+			return I2C_OK;
+		}
+		if ( all_call ) {
+			bank->all_call_frames++;
+			return PCA9685_BANK_BROADCAST ( bank, PCA9685_ALLCALL_ADDRESS, ALL_LED_ON_L, all, 4 );
+		}
+	}
+
+	//otherwise each board sends the channels that changed, the buses work in parallel
+	for ( unsigned int i = 0; i < bank->count; i++ ) {
+		if ( ( result = PCA9685_CACHE_WRITE_FRAME ( bank->device[i], width + i * PCA9685_CHANNELS ) ) != I2C_OK ) {
+			return result;
+		}
+	}
+	return I2C_OK;
+}
+
+int PCA9685_BANK_SUBADDRESS ( PCA9685_BANK *bank, unsigned int mask, unsigned int n, unsigned int address ){
+
+	static const unsigned char SUB_BIT [ ] = { MODE1_SUB1, MODE1_SUB2, MODE1_SUB3 };
+	PCA9685_CACHE *device;
+	unsigned char mode1;
+	int result;
+
+	if ( n < 1 || n > 3 ) {
+		return PCA9685_ERR_REGISTER;
+	}
+	for ( unsigned int i = 0; i < bank->count; i++ ) {
+		device = bank->device[i];
+		mode1 = device->valid[MODE1] ? device->regs[MODE1] : MODE1_AI | MODE1_ALLCALL;
+		mode1 &= ~MODE1_RESTART;
+		if ( mask & ( 1u << i ) ) {
+			PCA9685_CACHE_WRITE ( device, (unsigned char) ( SUBADR1 + n - 1 ), (unsigned char) ( address << 1 ) );
+			PCA9685_CACHE_WRITE ( device, MODE1, mode1 | SUB_BIT[n - 1] );
+		}
+		else if ( device->valid[MODE1] ) {
+			PCA9685_CACHE_WRITE ( device, MODE1, mode1 & ~SUB_BIT[n - 1] );
+		}
+		if ( ( result = PCA9685_CACHE_FLUSH ( device ) ) != I2C_OK ) {
+			return result;
+		}
+	}
+	return I2C_OK;
+}
+
+void PCA9685_BANK_WAIT ( PCA9685_BANK *bank ){
+
+	for ( unsigned int i = 0; i < bank->count; i++ ) {
+		if ( bank->device[i]->queue ) {
+			I2C_QUEUE_FLUSH ( bank->device[i]->queue );
+		}
+	}
+}
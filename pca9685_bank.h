@@ -0,0 +1,68 @@
+/**********************************************************************************************************************
+*   Bank of PCA9685 controllers on several buses                                                                      *
+*                                                                                                                     *
+*   Servo channels numbered across many PCA9685 boards, at addresses 0x40 to 0x7F on I2C0, I2C1 and I2C2. Every board *
+*   is a PCA9685_CACHE with its own slave address, bus and queue, so a frame for the whole bank queues one burst per  *
+*   board that changed and the three buses send their share at the same time.                                         *
+*                                                                                                                     *
+*   Settings that are the same on every board go out once per bus through the LED All Call address (0x70, enabled by  *
+*   MODE1 ALLCALL) or a subaddress, and the mirrors of the boards that answer that address take the values; the       *
+*   mirrors on a bus where the transaction failed are invalidated. A broadcast of more than one register needs        *
+*   auto-increment on every board that answers; when a mirror does not know that, the registers are written to each   *
+*   board instead.                                                                                                    *
+*                                                                                                                     *
+*   PCA9685_BANK_SUBADDRESS puts some of the boards in a group of their own: it sets SUBADRn and the MODE1 SUBn bit   *
+*   of the boards in the mask, so a broadcast to that address reaches only them.                                      *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef PCA9685_BANK_H
+#define PCA9685_BANK_H
+
+#include "pca9685_cache.h"
+
+#define PCA9685_BANK_DEVICES 32                     //boards in one bank, 512 channels
+
+//the broadcast a board sent for its bus, for the callback; a bus with broadcasts to different addresses on their way
+//at once loses the mirrors of every board on it when one fails
+typedef struct {
+	struct PCA9685_BANK *bank;
+	unsigned int index;                 //the board that sent it
+	unsigned int address;
+	unsigned int any;
+	volatile unsigned int pending;      //broadcasts on their way
+} PCA9685_BANK_SENT;
+
+typedef struct PCA9685_BANK {
+	PCA9685_CACHE *device[PCA9685_BANK_DEVICES];
+	PCA9685_BANK_SENT sent[PCA9685_BANK_DEVICES];
+	unsigned int count;
+	unsigned int channels;              //16 per board, numbered in the order the boards were added
+
+	//statistics
+	unsigned int frames;
+	unsigned int all_call_frames;       //frames sent as one ALL_LED broadcast per bus
+	unsigned int broadcasts;
+	unsigned int broadcast_transactions;
+	unsigned int fallbacks;             //broadcasts written board by board
+	unsigned int broadcast_failures;    //transactions that failed, the mirrors of the boards they were for are lost
+} PCA9685_BANK;
+
+void PCA9685_BANK_INIT ( PCA9685_BANK *bank );
+
+//add a board whose cache is initialized, returns its first channel or -1 when the bank is full
+int PCA9685_BANK_ADD ( PCA9685_BANK *bank, PCA9685_CACHE *device );
+
+//count registers from reg to every board answering address, one transaction per bus
+int PCA9685_BANK_BROADCAST ( PCA9685_BANK *bank, unsigned int address, unsigned char reg, const unsigned char *values,
+                             unsigned int count );
+
+//the width of every channel of the bank, one entry per channel; a bank wide identical width is one ALLCALL write
+int PCA9685_BANK_WRITE_FRAME ( PCA9685_BANK *bank, const unsigned short *width );
+
+//SUBADRn ( n = 1 to 3 ) of the boards in mask (bit i is the i-th board added) answers address
+int PCA9685_BANK_SUBADDRESS ( PCA9685_BANK *bank, unsigned int mask, unsigned int n, unsigned int address );
+
+void PCA9685_BANK_WAIT ( PCA9685_BANK *bank );      //sleep until the queues of every board are empty
+
+#endif
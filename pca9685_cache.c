@@ -0,0 +1,659 @@
+/**********************************************************************************************************************
+*   PCA9685 shadow register cache                                                                                     *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include <string.h>
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "pca9685_cache.h"
+
+//auto-increment rolls over from LED15_OFF_H to MODE1, so a burst never crosses into the reserved block
+#define CACHE_BLOCK_END(reg) ( (reg) <= LED15_OFF_H ? LED15_OFF_H : PRE_SCALE_SERVO )
+
+static int CACHE_RESERVED ( unsigned int reg ){
+
+	return ( reg > LED15_OFF_H && reg < ALL_LED_ON_L ) || reg > PRE_SCALE_SERVO;
+}
+
+//value a register will have once the staged writes are out
+static unsigned char CACHE_VALUE ( const PCA9685_CACHE *cache, unsigned int reg ){
+
+	return cache->dirty[reg] ? cache->pending[reg] : cache->regs[reg];
+}
+
+//the device took the value: RESTART is self clearing, so it is not kept in the mirror
+static void CACHE_COMMIT ( PCA9685_CACHE *cache, unsigned int reg, unsigned char value ){
+
+	cache->regs[reg] = reg == MODE1 ? value & ~MODE1_RESTART : value;
+	cache->valid[reg] = 1;
+	cache->dirty[reg] = 0;
+}
+
+//a queued burst that failed leaves the device in an unknown state
+static void CACHE_QUEUE_DONE ( void *context, int result ){
+
+	PCA9685_CACHE *cache = context;
+
+	if ( result != I2C_OK ) {
+		cache->failed++;
+		memset ( cache->valid, 0, sizeof ( cache->valid ) );
+	}
+}
+
+int PCA9685_CACHE_TRANSFER ( PCA9685_CACHE *cache, unsigned int address, const unsigned char *bytes, unsigned int length,
+                             I2C_CALLBACK callback, void *context ){
+
+#ifdef __linux__
+	if ( cache->dev ) {
+		return I2C_DEV_QUEUE ( cache->dev, address, bytes, length, callback, context );
+	}
+#endif
+	if ( cache->queue ) {
+		return I2C_QUEUE_WRITE ( cache->queue, address, bytes, length, 0, callback, context );
+	}
+	return I2C_WRITE ( cache->bus, address, bytes, length );
+}
+
+//one transaction on the device before this returns: polled on the bus, or after the batch in an I2C_RDWR of its own
+static int CACHE_WRITE_NOW ( PCA9685_CACHE *cache, unsigned int address, const unsigned char *bytes, unsigned int length ){
+
+#ifdef __linux__
+	int result;
+
+	if ( cache->dev ) {
+		if ( ( result = I2C_DEV_QUEUE ( cache->dev, address, bytes, length, 0, 0 ) ) != I2C_OK ) {
+			return result;
+		}
+		return I2C_DEV_FLUSH ( cache->dev );
+	}
+#endif
+	return I2C_WRITE ( cache->bus, address, bytes, length );
+}
+
+static int CACHE_READ ( PCA9685_CACHE *cache, unsigned char reg, unsigned char *values, unsigned int count ){
+
+#ifdef __linux__
+	if ( cache->dev ) {
+		return I2C_DEV_READ ( cache->dev, cache->slave, reg, values, count );
+	}
+#endif
+	return PCA9685_READ_BURST ( cache->bus, cache->slave, reg, values, count );
+}
+
+//one transaction of registers first to last, committed once it is on its way
+static int CACHE_SEND ( PCA9685_CACHE *cache, unsigned int first, unsigned int last ){
+
+	unsigned char frame [ PCA9685_MAX_BURST + 1 ];
+	unsigned int count = last - first + 1;
+	unsigned int bridged = 0;
+	int result;
+
+	frame[0] = (unsigned char) first;
+	for ( unsigned int i = 0; i < count; i++ ) {
+		frame[i + 1] = CACHE_VALUE ( cache, first + i );
+		if ( !cache->dirty[first + i] ) {
+			bridged++;
+		}
+	}
+
+	result = PCA9685_CACHE_TRANSFER ( cache, cache->slave, frame, count + 1, CACHE_QUEUE_DONE, cache );
+	if ( result != I2C_OK ) {
+		cache->failed++;
+		return result;
+	}
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		CACHE_COMMIT ( cache, first + i, frame[i + 1] );
+	}
+	cache->bursts++;
+	cache->bytes += count;
+	cache->bridged += bridged;
+	return I2C_OK;
+}
+
+void PCA9685_CACHE_INIT ( PCA9685_CACHE *cache, I2C_BUS *bus, I2C_QUEUE *queue, unsigned int slave ){
+
+	memset ( cache, 0, sizeof ( *cache ) );
+	cache->bus = bus;
+	cache->queue = queue;
+	cache->slave = slave;
+	cache->osc_hz = PCA9685_OSC_HZ;
+}
+
+void PCA9685_CACHE_INVALIDATE ( PCA9685_CACHE *cache ){
+
+	memset ( cache->valid, 0, sizeof ( cache->valid ) );
+	memset ( cache->dirty, 0, sizeof ( cache->dirty ) );
+}
+
+int PCA9685_CACHE_WRITE ( PCA9685_CACHE *cache, unsigned char reg, unsigned char value ){
+
+	if ( CACHE_RESERVED ( reg ) ) {
+		return PCA9685_ERR_REGISTER;
+	}
+
+	//ALL_LED is the same register of every channel
+	if ( reg >= ALL_LED_ON_L && reg <= ALL_LED_OFF_H ) {
+		for ( unsigned int channel = 0; channel < 16; channel++ ) {
+			PCA9685_CACHE_WRITE ( cache, LED_ON_L ( channel ) + ( reg - ALL_LED_ON_L ), value );
+		}
+		return I2C_OK;
+	}
+
+	cache->writes++;
+
+	//already in the device and nothing else staged: drop it
+	if ( cache->valid[reg] && cache->regs[reg] == value && !( reg == MODE1 && ( value & MODE1_RESTART ) ) ) {
+		if ( !cache->dirty[reg] ) {
+			cache->dropped++;
+		}
+		cache->dirty[reg] = 0;
+		return I2C_OK;
+	}
+
+	cache->pending[reg] = value;
+	cache->dirty[reg] = 1;
+	return I2C_OK;
+}
+
+int PCA9685_CACHE_WRITE_BURST ( PCA9685_CACHE *cache, unsigned char reg, const unsigned char *values, unsigned int count ){
+
+	int result;
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		if ( ( result = PCA9685_CACHE_WRITE ( cache, (unsigned char) ( reg + i ), values[i] ) ) != I2C_OK ) {
+			return result;
+		}
+	}
+	return I2C_OK;
+}
+
+int PCA9685_CACHE_FLUSH ( PCA9685_CACHE *cache ){
+
+	unsigned int first, last, next, gap, end;
+	int auto_increment;
+	int result;
+
+	cache->flushes++;
+
+	//MODE1 goes first and on its own, the bursts after it depend on its AI bit
+	if ( cache->dirty[MODE1] && ( result = CACHE_SEND ( cache, MODE1, MODE1 ) ) != I2C_OK ) {
+		return result;
+	}
+	auto_increment = cache->valid[MODE1] && ( cache->regs[MODE1] & MODE1_AI );
+
+	for ( first = 0; first < 256; first = last + 1 ) {
+
+		if ( !cache->dirty[first] ) {
+			last = first;
+			continue;
+		}
+
+		//grow the burst over dirty registers and over short gaps of known ones
+		last = first;
+		end = CACHE_BLOCK_END ( first );
+		while ( auto_increment && last < end && last - first + 1 < PCA9685_MAX_BURST ) {
+			next = last + 1;
+			for ( gap = 0; next <= end && !cache->dirty[next] && cache->valid[next] && gap <= PCA9685_CACHE_MAX_GAP; gap++ ) {
+				next++;
+			}
+			if ( next > end || !cache->dirty[next] || gap > PCA9685_CACHE_MAX_GAP || next - first + 1 > PCA9685_MAX_BURST ) {
+				break;
+			}
+			last = next;
+		}
+
+		if ( ( result = CACHE_SEND ( cache, first, last ) ) != I2C_OK ) {
+			return result;
+		}
+	}
+	return I2C_OK;
+}
+
+//the counts of every known channel for the new PRE_SCALE, FULL_ON and FULL_OFF channels keep theirs
+static void CACHE_RESCALE ( PCA9685_CACHE *cache, unsigned int from, unsigned int to ){
+
+	unsigned int reg, count, known;
+
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		reg = LED_ON_L ( channel );
+		known = 1;
+		for ( unsigned int i = 0; i < 4; i++ ) {
+			known &= cache->valid[reg + i] || cache->dirty[reg + i];
+		}
+		if ( !known || ( CACHE_VALUE ( cache, reg + 1 ) & LED_FULL ) || ( CACHE_VALUE ( cache, reg + 3 ) & LED_FULL ) ) {
+			continue;
+		}
+
+		//ON then OFF, each rounded to the nearest count of the new period
+		for ( unsigned int i = 0; i < 4; i += 2 ) {
+			count = ( ( CACHE_VALUE ( cache, reg + i + 1 ) & 0x0F ) << 8 ) | CACHE_VALUE ( cache, reg + i );
+			count = ( count * from + to / 2 ) / to;
+			if ( count > 4095 ) {
+				count = 4095;
+			}
+			PCA9685_CACHE_WRITE ( cache, (unsigned char) ( reg + i ), count & 0xFF );
+			PCA9685_CACHE_WRITE ( cache, (unsigned char) ( reg + i + 1 ), ( count >> 8 ) & 0x0F );
+		}
+		cache->rescaled++;
+	}
+}
+
+//flush and, with a queue or a batch, wait until it is on the bus, so the time taken after it is the time the device saw it
+static int CACHE_FLUSH_NOW ( PCA9685_CACHE *cache ){
+
+	int result = PCA9685_CACHE_FLUSH ( cache );
+
+	if ( result == I2C_OK && cache->queue ) {
+		I2C_QUEUE_FLUSH ( cache->queue );
+	}
+#ifdef __linux__
+	if ( result == I2C_OK && cache->dev ) {
+		result = I2C_DEV_FLUSH ( cache->dev );
+	}
+#endif
+	return result;
+}
+
+int PCA9685_CACHE_SET_PRESCALE ( PCA9685_CACHE *cache, unsigned char prescale ){
+
+	unsigned char awake;
+	int result;
+
+	if ( cache->valid[PRE_SCALE_SERVO] && !cache->dirty[PRE_SCALE_SERVO] && cache->regs[PRE_SCALE_SERVO] == prescale ) {
+		cache->writes++;
+		cache->dropped++;
+		return I2C_OK;
+	}
+
+	//the MODE1 value to come back to, auto-increment and ALLCALL when nothing is known
+	awake = cache->valid[MODE1] || cache->dirty[MODE1] ? CACHE_VALUE ( cache, MODE1 ) : MODE1_AI | MODE1_ALLCALL;
+	awake &= ~( MODE1_SLEEP | MODE1_RESTART );
+
+	PCA9685_CACHE_WRITE ( cache, MODE1, awake | MODE1_SLEEP );
+	if ( ( result = PCA9685_CACHE_FLUSH ( cache ) ) != I2C_OK ) {
+		return result;
+	}
+
+	//counts written under the old PRE_SCALE are only rescaled when it is known
+	if ( cache->valid[PRE_SCALE_SERVO] ) {
+		CACHE_RESCALE ( cache, cache->regs[PRE_SCALE_SERVO] + 1u, prescale + 1u );
+	}
+	PCA9685_CACHE_WRITE ( cache, PRE_SCALE_SERVO, prescale );
+	if ( ( result = PCA9685_CACHE_FLUSH ( cache ) ) != I2C_OK ) {
+		return result;
+	}
+
+	//a flush sends MODE1 ahead of everything else, so the wake up is a flush of its own
+	PCA9685_CACHE_WRITE ( cache, MODE1, awake );
+	if ( ( result = CACHE_FLUSH_NOW ( cache ) ) != I2C_OK ) {
+		return result;
+	}
+	cache->woken = CYCLE_COUNT ( );
+
+	//RESTART only takes once the oscillator is running
+	while ( CYCLE_COUNT ( ) - cache->woken < PCA9685_OSC_US * CPU_MHZ ) {
+		CPU_SPIN ( 100 );
+	}
+	PCA9685_CACHE_WRITE ( cache, MODE1, awake | MODE1_RESTART );
+	return PCA9685_CACHE_FLUSH ( cache );
+}
+
+int PCA9685_CACHE_SET_RATE ( PCA9685_CACHE *cache, unsigned int rate_hz ){
+
+	return PCA9685_CACHE_SET_PRESCALE ( cache, PCA9685_PRESCALE_FOR ( cache->osc_hz, rate_hz ) );
+}
+
+int PCA9685_CACHE_CALIBRATE ( PCA9685_CACHE *cache, unsigned int measured_millihz ){
+
+	if ( !cache->valid[PRE_SCALE_SERVO] || measured_millihz == 0 ) {
+		return PCA9685_ERR_REGISTER;
+	}
+	cache->osc_hz = PCA9685_OSC_FROM_PWM ( cache->regs[PRE_SCALE_SERVO], measured_millihz );
+	return I2C_OK;
+}
+
+//ON_L, ON_H, OFF_L, OFF_H of one channel for a frame width
+static void CACHE_CHANNEL_BYTES ( unsigned short width, unsigned char bytes[4] ){
+
+	if ( width >= PCA9685_FULL_ON ) {
+		bytes[0] = 0x00;
+		bytes[1] = LED_FULL;
+		bytes[2] = 0x00;
+		bytes[3] = 0x00;
+	}
+	else {
+		bytes[0] = 0x00;
+		bytes[1] = 0x00;
+		bytes[2] = width & 0xFF;
+		bytes[3] = ( width >> 8 ) & 0x0F;
+	}
+}
+
+//stage a frame and send the channels that changed
+static int CACHE_FRAME ( PCA9685_CACHE *cache, const unsigned short width[PCA9685_CHANNELS] ){
+
+	unsigned char bytes [ PCA9685_CHANNELS ] [ 4 ];
+	unsigned int first = PCA9685_CHANNELS, last = 0, changed = 0, same = 1;
+	unsigned int reg;
+	int result;
+
+	//which channels differ from what the device holds
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		CACHE_CHANNEL_BYTES ( width[channel], bytes[channel] );
+		same = same && width[channel] == width[0];
+		for ( unsigned int i = 0; i < 4; i++ ) {
+			reg = LED_ON_L ( channel ) + i;
+			cache->writes++;
+			if ( !cache->valid[reg] || cache->dirty[reg] || cache->regs[reg] != bytes[channel][i] ) {
+				cache->pending[reg] = bytes[channel][i];
+				cache->dirty[reg] = 1;
+				if ( changed == 0 || channel != last ) {
+					changed++;
+				}
+				first = channel < first ? channel : first;
+				last = channel;
+			}
+			else {
+				cache->dropped++;
+			}
+		}
+	}
+	if ( changed == 0 ) {
+		return I2C_OK;
+	}
+	cache->frames++;
+
+	//a staged MODE1 decides whether auto-increment is on
+	if ( cache->dirty[MODE1] && ( result = CACHE_SEND ( cache, MODE1, MODE1 ) ) != I2C_OK ) {
+		return result;
+	}
+
+	//without auto-increment every register is its own transaction, the flush knows how to do that
+	if ( !cache->valid[MODE1] || !( cache->regs[MODE1] & MODE1_AI ) ) {
+		return PCA9685_CACHE_FLUSH ( cache );
+	}
+
+	//the same width everywhere: four bytes through ALL_LED, then the mirror takes them for every channel
+	if ( same && changed > 1 ) {
+		for ( unsigned int i = 0; i < 4; i++ ) {
+			cache->pending[ALL_LED_ON_L + i] = bytes[0][i];
+			cache->dirty[ALL_LED_ON_L + i] = 1;
+		}
+		if ( ( result = CACHE_SEND ( cache, ALL_LED_ON_L, ALL_LED_OFF_H ) ) != I2C_OK ) {
+			return result;
+		}
+		for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+			for ( unsigned int i = 0; i < 4; i++ ) {
+				CACHE_COMMIT ( cache, LED_ON_L ( channel ) + i, bytes[0][i] );
+			}
+		}
+		for ( unsigned int i = 0; i < 4; i++ ) {
+			cache->valid[ALL_LED_ON_L + i] = 0;
+		}
+		cache->all_led_frames++;
+		return I2C_OK;
+	}
+
+	//otherwise one burst over the changed range, unchanged channels inside it are resent as they are
+	return CACHE_SEND ( cache, LED_ON_L ( first ), LED_OFF_H ( last ) );
+}
+
+int PCA9685_CACHE_WRITE_FRAME ( PCA9685_CACHE *cache, const unsigned short width[PCA9685_CHANNELS] ){
+
+	unsigned int frames = cache->frames;
+	int result;
+
+	if ( ( result = CACHE_FRAME ( cache, width ) ) != I2C_OK || !cache->verify || cache->frames == frames ) {
+		return result;
+	}
+
+	//the 64 channel registers in one read, the mirror then knows which channels did not take
+	if ( ( result = PCA9685_CACHE_VERIFY ( cache, LED0_ON_L, 4 * PCA9685_CHANNELS ) ) > 0 ) {
+		cache->repairs++;
+		return CACHE_FRAME ( cache, width );
+	}
+	return result < 0 ? result : I2C_OK;
+}
+
+//the device is put to sleep first whatever state it is in, so PRE_SCALE takes; RESTART is never needed, because the
+//STOP of a transaction that writes PWM registers also clears a RESTART a running device was left with
+int PCA9685_CACHE_BOOT ( PCA9685_CACHE *cache, unsigned char prescale, const unsigned short width[PCA9685_CHANNELS] ){
+
+	I2C_BUS *bus = cache->bus;
+	unsigned char sleep [ 2 ] = { MODE1, MODE1_SLEEP | MODE1_AI | MODE1_ALLCALL };
+	unsigned char scale [ 2 ] = { PRE_SCALE_SERVO, prescale };
+	unsigned char wake [ 3 ] = { MODE1, MODE1_AI | MODE1_ALLCALL, MODE2_OUTDRV };
+	unsigned char burst [ 1 + 4 * PCA9685_CHANNELS + 2 ];
+	unsigned char *frame = &burst[1];
+	unsigned long long scl_ns, frame_ns;
+	unsigned int same = 1, length, transactions = 3;
+	int result;
+
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		CACHE_CHANNEL_BYTES ( width[channel], &frame[4 * channel] );
+		same &= width[channel] == width[0];
+	}
+	length = same ? 4 : 4 * PCA9685_CHANNELS;
+
+	//the frame with its address and register bytes, and the rest of the wake up transaction, on this bus
+	if ( bus ) {
+		scl_ns = ( bus->psc + 1ULL ) * ( bus->scll + 7 + bus->sclh + 5 ) * 1000000000ULL / I2C_FCLK_HZ;
+	}
+	else {
+		scl_ns = 1000000000ULL / I2C_DEV_SCL_HZ;
+	}
+	frame_ns = ( length + 4 ) * 9 * scl_ns;
+
+	if ( ( result = CACHE_WRITE_NOW ( cache, cache->slave, sleep, sizeof ( sleep ) ) ) != I2C_OK ) {
+		return result;
+	}
+
+	//a frame that is on the bus before the oscillator is up goes after the wake up, so the oscillator starts sooner
+	if ( frame_ns < PCA9685_OSC_US * 1000ULL ) {
+		burst[0] = same ? ALL_LED_ON_L : LED0_ON_L;
+		if ( ( result = CACHE_WRITE_NOW ( cache, cache->slave, scale, sizeof ( scale ) ) ) == I2C_OK &&
+		     ( result = CACHE_WRITE_NOW ( cache, cache->slave, wake, sizeof ( wake ) ) ) == I2C_OK ) {
+			cache->woken = CYCLE_COUNT ( );
+			result = CACHE_WRITE_NOW ( cache, cache->slave, burst, length + 1 );
+		}
+		transactions = 4;
+	}
+
+	//otherwise before it: ALL_LED_ON_L to ALL_LED_OFF_H run on into PRE_SCALE, then the wake up
+	else if ( same ) {
+		burst[0] = ALL_LED_ON_L;
+		burst[1 + length] = prescale;
+		if ( ( result = CACHE_WRITE_NOW ( cache, cache->slave, burst, length + 2 ) ) == I2C_OK ) {
+			result = CACHE_WRITE_NOW ( cache, cache->slave, wake, sizeof ( wake ) );
+			cache->woken = CYCLE_COUNT ( );
+		}
+	}
+
+	//or LED0_ON_L to LED15_OFF_H, where the pointer rolls over to MODE1 and MODE2 for the wake up
+	else {
+		burst[0] = LED0_ON_L;
+		burst[1 + length] = wake[1];
+		burst[2 + length] = wake[2];
+		if ( ( result = CACHE_WRITE_NOW ( cache, cache->slave, scale, sizeof ( scale ) ) ) == I2C_OK ) {
+			result = CACHE_WRITE_NOW ( cache, cache->slave, burst, length + 3 );
+			cache->woken = CYCLE_COUNT ( );
+		}
+	}
+	if ( result != I2C_OK ) {
+		return result;
+	}
+
+	cache->bursts += transactions;
+	cache->bytes += 1 + 1 + length + 2;
+	PCA9685_CACHE_ASSUME ( cache, PRE_SCALE_SERVO, &prescale, 1 );
+	PCA9685_CACHE_ASSUME ( cache, same ? ALL_LED_ON_L : LED0_ON_L, frame, length );
+	PCA9685_CACHE_ASSUME ( cache, MODE1, &wake[1], 2 );
+	return I2C_OK;
+}
+
+int PCA9685_CACHE_VERIFY ( PCA9685_CACHE *cache, unsigned char reg, unsigned int count ){
+
+	unsigned char values [ LED15_OFF_H + 1 ];
+	unsigned int mismatches = 0;
+	unsigned int r;
+	unsigned char value;
+	int result = I2C_OK;
+
+	if ( count == 0 || CACHE_RESERVED ( reg ) || reg + count - 1 > CACHE_BLOCK_END ( reg ) ) {
+		return PCA9685_ERR_REGISTER;
+	}
+
+	//the read is polled, so the queued bursts go out first and the bus is left to it
+	if ( cache->queue ) {
+		I2C_QUEUE_FLUSH ( cache->queue );
+	}
+
+	//without auto-increment the pointer stays on reg, every register is its own read
+	if ( cache->valid[MODE1] && ( cache->regs[MODE1] & MODE1_AI ) ) {
+		result = CACHE_READ ( cache, reg, values, count );
+	}
+	else {
+		for ( unsigned int i = 0; i < count && result == I2C_OK; i++ ) {
+			result = CACHE_READ ( cache, (unsigned char) ( reg + i ), &values[i], 1 );
+		}
+	}
+	if ( result != I2C_OK ) {
+		cache->failed++;
+		return result;
+	}
+	cache->verifies++;
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		r = reg + i;
+		//ALL_LED reads back as 0, the channels hold what was written through it
+		if ( r >= ALL_LED_ON_L && r <= ALL_LED_OFF_H ) {
+			continue;
+		}
+		value = r == MODE1 ? values[i] & ~MODE1_RESTART : values[i];
+		if ( cache->valid[r] && cache->regs[r] != value ) {
+			mismatches++;
+		}
+		cache->regs[r] = value;
+		cache->valid[r] = 1;
+	}
+	cache->mismatches += mismatches;
+	return (int) mismatches;
+}
+
+int PCA9685_CACHE_RESTORE ( PCA9685_CACHE *cache ){
+
+	I2C_QUEUE *queue = cache->queue;
+	unsigned char swrst = PCA9685_SWRST;
+	unsigned char awake;
+	int result;
+
+	//every known register is staged again, the ones already staged keep their new value
+	for ( unsigned int reg = 0; reg < 256; reg++ ) {
+		if ( cache->valid[reg] && !cache->dirty[reg] ) {
+			cache->pending[reg] = cache->regs[reg];
+			cache->dirty[reg] = 1;
+		}
+	}
+	awake = cache->dirty[MODE1] ? cache->pending[MODE1] : MODE1_AI | MODE1_ALLCALL;
+	awake &= ~( MODE1_SLEEP | MODE1_RESTART );
+	memset ( cache->valid, 0, sizeof ( cache->valid ) );
+	cache->restores++;
+
+	//the ladder runs polled, so the queue is left out of it
+	if ( queue ) {
+		I2C_QUEUE_FLUSH ( queue );
+		cache->queue = 0;
+	}
+
+	//after SWRST the device sleeps, so everything including PRE_SCALE goes out before the wake up
+	result = CACHE_WRITE_NOW ( cache, PCA9685_GENERAL_CALL_ADDRESS, &swrst, 1 );
+	if ( result == I2C_OK ) {
+		PCA9685_CACHE_WRITE ( cache, MODE1, awake | MODE1_SLEEP );
+		result = PCA9685_CACHE_FLUSH ( cache );
+	}
+	if ( result == I2C_OK ) {
+		PCA9685_CACHE_WRITE ( cache, MODE1, awake );
+		result = CACHE_FLUSH_NOW ( cache );
+	}
+	cache->queue = queue;
+	return result;
+}
+
+void PCA9685_CACHE_ATTACH_DEV ( PCA9685_CACHE *cache, I2C_DEV *dev ){
+
+	cache->dev = dev;
+	cache->bus = 0;
+	cache->queue = 0;
+}
+
+static int CACHE_REINIT ( void *context ){
+
+	return PCA9685_CACHE_RESTORE ( context );
+}
+
+int PCA9685_CACHE_ATTACH_RECOVERY ( PCA9685_CACHE *cache ){
+
+	//the adapter driver recovers an i2c-dev bus itself, there is no ladder to take a step
+	if ( cache->dev ) {
+		return PCA9685_ERR_TRANSPORT;
+	}
+	cache->bus->reinit = CACHE_REINIT;
+	cache->bus->reinit_context = cache;
+	return I2C_OK;
+}
+
+//known value of a register, or what it holds after power on
+static unsigned char CACHE_KNOWN ( const PCA9685_CACHE *cache, unsigned int reg ){
+
+	static const unsigned char POWER_ON [ ] = { MODE1_SLEEP | MODE1_ALLCALL, 0x04, 0xE2, 0xE4, 0xE8, 0xE0 };
+
+	return cache->valid[reg] ? cache->regs[reg] : POWER_ON[reg];
+}
+
+int PCA9685_CACHE_ANSWERS ( const PCA9685_CACHE *cache, unsigned int address ){
+
+	unsigned char mode1 = CACHE_KNOWN ( cache, MODE1 );
+
+	return address == cache->slave
+	       || ( ( mode1 & MODE1_ALLCALL ) && address == (unsigned int) ( CACHE_KNOWN ( cache, ALLCALLADR ) >> 1 ) )
+	       || ( ( mode1 & MODE1_SUB1 ) && address == (unsigned int) ( CACHE_KNOWN ( cache, SUBADR1 ) >> 1 ) )
+	       || ( ( mode1 & MODE1_SUB2 ) && address == (unsigned int) ( CACHE_KNOWN ( cache, SUBADR2 ) >> 1 ) )
+	       || ( ( mode1 & MODE1_SUB3 ) && address == (unsigned int) ( CACHE_KNOWN ( cache, SUBADR3 ) >> 1 ) );
+}
+
+void PCA9685_CACHE_ASSUME ( PCA9685_CACHE *cache, unsigned char reg, const unsigned char *values, unsigned int count ){
+
+	unsigned int r;
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		r = reg + i;
+		if ( r >= ALL_LED_ON_L && r <= ALL_LED_OFF_H ) {
+			for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+				CACHE_COMMIT ( cache, LED_ON_L ( channel ) + ( r - ALL_LED_ON_L ), values[i] );
+			}
+		}
+		else if ( r < 256 && !CACHE_RESERVED ( r ) ) {
+			CACHE_COMMIT ( cache, r, values[i] );
+		}
+	}
+}
+
+void PCA9685_CACHE_FORGET ( PCA9685_CACHE *cache, unsigned char reg, unsigned int count ){
+
+	unsigned int r;
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		r = reg + i;
+		if ( r >= ALL_LED_ON_L && r <= ALL_LED_OFF_H ) {
+			for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+				cache->valid[LED_ON_L ( channel ) + ( r - ALL_LED_ON_L )] = 0;
+			}
+		}
+		else if ( r < 256 ) {
+			cache->valid[r] = 0;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/**********************************************************************************************************************
+*   PCA9685 shadow register cache                                                                                     *
+*                                                                                                                     *
+*   A mirror of the 256 PCA9685 registers on the host side: writes are staged, a value the device already holds is    *
+*   dropped, and the rest goes out as the fewest auto-increment bursts, polled, queued or through i2c-dev.            *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef PCA9685_CACHE_H
+#define PCA9685_CACHE_H
+
+#include "pca9685.h"
+#include "i2c_dev.h"
+
+#define PCA9685_CACHE_MAX_GAP 2                     //clean registers worth resending to join two bursts
+#define PCA9685_ERR_TRANSPORT -10                   //not available on the transport the cache is attached to
+
+#define PCA9685_FULL_ON 4096                        //frame width that sets the FULL_ON bit instead of a count
+
+typedef struct {
+	I2C_BUS *bus;                       //flushes are polled on this bus
+	I2C_QUEUE *queue;                   //when set, flushes are queued here instead and return at once
+	I2C_DEV *dev;                       //when set, flushes are batched here instead, I2C_DEV_FLUSH sends them
+	unsigned int slave;
+	unsigned int verify;                //read every frame back after it is sent
+	unsigned char regs[256];            //value the device holds
+	unsigned char pending[256];         //value waiting for the next flush
+	unsigned char valid[256];           //regs is known for this register
+	unsigned char dirty[256];           //pending has to be sent
+	unsigned int woken;                 //CYCLE_COUNT when the last wake up was sent
+	unsigned int osc_hz;                //oscillator PRE_SCALE is worked out for, PCA9685_OSC_HZ until calibrated
+
+	//statistics
+	unsigned int writes;                //register writes staged
+	unsigned int dropped;               //writes that did not change the device
+	unsigned int flushes;
+	unsigned int bursts;                //transactions sent
+	unsigned int bytes;                 //register values sent, including the ones resent to join bursts
+	unsigned int bridged;               //clean values resent to join bursts
+	unsigned int failed;                //flushes that did not reach the device
+	unsigned int frames;                //frames that changed at least one channel
+	unsigned int all_led_frames;        //frames sent through ALL_LED
+	unsigned int verifies;              //read-backs done
+	unsigned int mismatches;            //known registers the device did not hold
+	unsigned int repairs;               //frames sent again after a read-back
+	unsigned int restores;              //software resets with the mirror sent back
+	unsigned int rescaled;              //channels whose counts were rescaled for a new PRE_SCALE
+} PCA9685_CACHE;
+
+//an empty mirror for the device at slave, queue may be NULL for polled flushes
+void PCA9685_CACHE_INIT ( PCA9685_CACHE *cache, I2C_BUS *bus, I2C_QUEUE *queue, unsigned int slave );
+
+//forget every value: the mirror only knows what was written through it, so after a power cycle or a software reset
+//through the general call the next writes have to be sent again
+void PCA9685_CACHE_INVALIDATE ( PCA9685_CACHE *cache );
+
+//stage one register or a run of registers, returns I2C_OK or PCA9685_ERR_REGISTER; ALL_LED writes are spread over
+//the 16 channels so only the channels that change are sent, and a MODE1 write with RESTART set is an action rather
+//than a value, so it is always sent. PRE_SCALE only takes while the oscillator is off, see PCA9685_CACHE_SET_PRESCALE
+int PCA9685_CACHE_WRITE ( PCA9685_CACHE *cache, unsigned char reg, unsigned char value );
+int PCA9685_CACHE_WRITE_BURST ( PCA9685_CACHE *cache, unsigned char reg, const unsigned char *values, unsigned int count );
+
+//send the staged registers, returns I2C_OK or the first error; dirty registers a few addresses apart are joined into
+//one burst by resending the known values in between, when that is cheaper than another START, address and register
+int PCA9685_CACHE_FLUSH ( PCA9685_CACHE *cache );
+
+//all 16 channels at once, width is the OFF count (0 to 4095, ON count 0) or PCA9685_FULL_ON; sent right away. The
+//channels that differ from the mirror, LEDa to LEDb, go out as one burst from LEDa_ON_L to LEDb_OFF_H, or as one
+//write of the four ALL_LED registers when they all get the same width
+int PCA9685_CACHE_WRITE_FRAME ( PCA9685_CACHE *cache, const unsigned short width[PCA9685_CHANNELS] );
+
+//SLEEP, PRE_SCALE with the rescaled channel counts, wake, RESTART after PCA9685_OSC_US, flushed in that order and
+//waited for, so it blocks for the 500 us; nothing is sent when the value is already set. The ON and OFF counts of
+//every channel the mirror knows are scaled by ( old + 1 ) / ( new + 1 ), so the pulses keep their width
+int PCA9685_CACHE_SET_PRESCALE ( PCA9685_CACHE *cache, unsigned char prescale );
+
+//PCA9685_CACHE_SET_PRESCALE for a PWM rate in Hz at the oscillator frequency of the cache, clamped to what PRE_SCALE
+//can do; a servo that takes 333 Hz sees a new position up to 6 times sooner than at 50 Hz
+int PCA9685_CACHE_SET_RATE ( PCA9685_CACHE *cache, unsigned int rate_hz );
+
+//the PWM frequency measured on an output, in thousandths of a Hz, corrects the oscillator frequency the rates are
+//worked out for; the PRE_SCALE it was measured at must be known, PCA9685_ERR_REGISTER otherwise
+int PCA9685_CACHE_CALIBRATE ( PCA9685_CACHE *cache, unsigned int measured_millihz );
+
+//MODE1 asleep with auto-increment, PRE_SCALE, the frame, MODE1 awake and MODE2, always polled; the first PWM period
+//starts with the frame once the oscillator is up, 500 us after the wake up. A frame that fits in those 500 us (the
+//ALL_LED registers at 400 kbps) follows the wake up; a longer one goes before it in the same transaction, rolling
+//over into PRE_SCALE or MODE1, instead of waiting a whole period after it
+int PCA9685_CACHE_BOOT ( PCA9685_CACHE *cache, unsigned char prescale, const unsigned short width[PCA9685_CHANNELS] );
+
+//read registers reg to reg + count - 1 back in one transaction (one per register without auto-increment) and take
+//the values into the mirror, so the next writes send exactly what is wrong; returns how many known registers the
+//device did not hold, PCA9685_ERR_REGISTER for a reserved register or a run across a block, or an I2C error. The
+//read is polled, a queue is drained first. With verify set every frame is read back and repaired once
+int PCA9685_CACHE_VERIFY ( PCA9685_CACHE *cache, unsigned char reg, unsigned int count );
+
+//software reset through the general call, then the known registers sent back, PRE_SCALE while the oscillator is
+//still off, and the device woken; always polled
+int PCA9685_CACHE_RESTORE ( PCA9685_CACHE *cache );
+
+//queue the bursts of every flush into the i2c-dev batch, from a Linux process, so a frame or the frames of several
+//boards go out in one I2C_RDWR ioctl; PCA9685_CACHE_BOOT, VERIFY and RESTORE send the batch first and wait for each
+//of their transactions
+void PCA9685_CACHE_ATTACH_DEV ( PCA9685_CACHE *cache, I2C_DEV *dev );
+
+//make PCA9685_CACHE_RESTORE the re-init step of the bus recovery ladder, for a device that stopped answering;
+//PCA9685_ERR_TRANSPORT on i2c-dev. The general call resets every PCA9685 on the bus, so with more than one board
+//attach a bank that restores all of them instead
+int PCA9685_CACHE_ATTACH_RECOVERY ( PCA9685_CACHE *cache );
+
+//one transaction to address the way the cache sends its bursts: into the i2c-dev batch or onto the queue, where the
+//callback runs once it is done, or polled on the bus, where it does not run
+int PCA9685_CACHE_TRANSFER ( PCA9685_CACHE *cache, unsigned int address, const unsigned char *bytes, unsigned int length,
+                             I2C_CALLBACK callback, void *context );
+
+//does the device answer to a 7 bit address: its own, or ALLCALL / SUBADRn when MODE1 enables them; registers the
+//mirror does not know are taken at their power on values
+int PCA9685_CACHE_ANSWERS ( const PCA9685_CACHE *cache, unsigned int address );
+
+//registers the device received in a transaction that did not go through this cache (a broadcast)
+void PCA9685_CACHE_ASSUME ( PCA9685_CACHE *cache, unsigned char reg, const unsigned char *values, unsigned int count );
+
+//the registers ASSUME would take are no longer known: the device may or may not have received them
+void PCA9685_CACHE_FORGET ( PCA9685_CACHE *cache, unsigned char reg, unsigned int count );
+
+#endif
@@ -0,0 +1,204 @@
+/**********************************************************************************************************************
+*   Idle power policy                                                                                                 *
+*                                                                                                                     *
+*   The hook runs with IRQs masked and must not wait, so it only gates clocks and posts the task; the MODE1 writes    *
+*   go out from the task, queued behind the frames. The task does nothing when it runs in POWER_AWAKE or              *
+*   POWER_ASLEEP: it was posted by the threshold timer, and the hook that runs after it looks again.                  *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "power.h"
+
+//MODE1 of the running device: what the mirror holds without SLEEP and RESTART
+static unsigned char POWER_MODE1 ( const PCA9685_CACHE *pca ){
+
+	unsigned char mode1 = pca->valid[MODE1] ? pca->regs[MODE1] : MODE1_AI | MODE1_ALLCALL;
+
+	return mode1 & ~( MODE1_SLEEP | MODE1_RESTART );
+}
+
+//the MODE1 write is done: only a write the device acknowledged goes into the mirror, so the bursts the cache counts
+//stay the frames; the task is posted with the result. From the queue or the batch, or straight from POWER_SEND
+static void POWER_DONE ( void *context, int result ){
+
+	POWER *power = context;
+
+	if ( result == I2C_OK ) {
+		PCA9685_CACHE_ASSUME ( power->pca, MODE1, &power->mode1, 1 );
+	}
+	else {
+		power->failed++;
+	}
+	power->pending = 0;
+	SCHED_I2C_DONE ( &power->task, result );
+}
+
+//one MODE1 write the way the cache sends its bursts, the task runs again with the result in task.result once it is
+//done; I2C_ERR_FULL when the ring is full, the task is posted to send it again
+static int POWER_SEND ( POWER *power, unsigned char mode1 ){
+
+	PCA9685_CACHE *pca = power->pca;
+	unsigned char bytes [ 2 ] = { MODE1, mode1 };
+	int result;
+
+	power->mode1 = mode1;
+	power->pending = 1;
+	result = PCA9685_CACHE_TRANSFER ( pca, pca->slave, bytes, 2, POWER_DONE, power );
+
+	if ( result == I2C_ERR_FULL ) {
+		power->pending = 0;
+		SCHED_POST ( &power->task );
+		return result;
+	}
+
+	//polled, or refused before it was queued: the callback does not run
+	if ( result != I2C_OK || ( !pca->queue && !pca->dev ) ) {
+		POWER_DONE ( power, result );
+	}
+	return I2C_OK;
+}
+
+static void POWER_TASK ( void *context ){
+
+	POWER *power = context;
+	PCA9685_CACHE *pca = power->pca;
+	unsigned int cycles;
+
+	//a state that waits for a MODE1 write does nothing until it is done
+	if ( power->pending ) {
+		return;
+	}
+
+	switch ( power->state ) {
+
+	case POWER_SLEEPING:
+		TIMER_CANCEL ( power->timers, &power->timer );
+		if ( POWER_SEND ( power, POWER_MODE1 ( pca ) | MODE1_SLEEP ) == I2C_OK ) {
+			power->state = POWER_SUSPENDING;
+		}
+		break;
+
+	//a device that did not take SLEEP is still awake, the threshold starts again
+	case POWER_SUSPENDING:
+		if ( power->task.result == I2C_OK ) {
+			power->slept_at = TIMER_NOW ( power->timers );
+			power->pca_sleeps++;
+			power->state = POWER_ASLEEP;
+		}
+		else {
+			power->changed = TIMER_NOW ( power->timers );
+			power->state = POWER_AWAKE;
+		}
+		break;
+
+	//the registers were written while it slept, they only need the oscillator and the restart
+	case POWER_WAKING:
+		if ( POWER_SEND ( power, POWER_MODE1 ( pca ) ) == I2C_OK ) {
+			power->state = POWER_STARTING;
+		}
+		break;
+
+	//the oscillator starts when the device takes the write, not when it is queued; when the wake up does not take,
+	//the device counts as asleep again and the next burst tries once more
+	case POWER_STARTING:
+		if ( power->task.result == I2C_OK ) {
+			power->state = POWER_RESTARTING;
+			TIMER_START ( power->timers, &power->timer, TIMER_US ( PCA9685_OSC_US ), 0, SCHED_WAKE, &power->task );
+		}
+		else {
+			power->slept_at = TIMER_NOW ( power->timers );
+			power->state = POWER_ASLEEP;
+		}
+		break;
+
+	case POWER_RESTARTING:
+		if ( POWER_SEND ( power, POWER_MODE1 ( pca ) | MODE1_RESTART ) == I2C_OK ) {
+			power->state = POWER_RESUMING;
+		}
+		break;
+
+	case POWER_RESUMING:
+		if ( power->task.result == I2C_OK ) {
+			cycles = CYCLE_COUNT ( ) - power->woken_at;
+			power->wake_cycles += cycles;
+			if ( cycles > power->wake_max_cycles ) {
+				power->wake_max_cycles = cycles;
+			}
+			power->pca_wakes++;
+			power->changed = TIMER_NOW ( power->timers );
+			power->state = POWER_AWAKE;
+		}
+		else {
+			power->slept_at = TIMER_NOW ( power->timers );
+			power->state = POWER_ASLEEP;
+		}
+		break;
+	}
+}
+
+void POWER_INIT ( POWER *power, SCHEDULER *scheduler, I2C_QUEUE *queue, TIMER_SERVICE *timers, PCA9685_CACHE *pca,
+                  unsigned int idle_us ){
+
+	power->scheduler = scheduler;
+	power->queue = queue;
+	power->timers = timers;
+	power->pca = pca;
+	power->idle_ticks = TIMER_US ( idle_us );
+	power->timer.active = 0;
+	power->state = POWER_AWAKE;
+	power->pending = 0;
+	power->bursts = pca ? pca->bursts : 0;
+	power->changed = pca ? TIMER_NOW ( timers ) : 0;
+	power->idles = power->pca_sleeps = power->pca_wakes = power->failed = 0;
+	power->pca_asleep_ticks = power->wake_cycles = 0;
+	power->wake_max_cycles = 0;
+	SCHED_TASK_INIT ( &power->task, scheduler, POWER_TASK, power );
+	scheduler->idle = POWER_IDLE;
+	scheduler->idle_context = power;
+}
+
+void POWER_IDLE ( void *context ){
+
+	POWER *power = context;
+	PCA9685_CACHE *pca = power->pca;
+	unsigned long long now, elapsed;
+
+	power->idles++;
+
+	if ( pca ) {
+		now = TIMER_NOW ( power->timers );
+		//a frame sent while SLEEP is on its way is only seen once the device is asleep, it has to wake it then
+		if ( pca->bursts != power->bursts && power->state != POWER_SUSPENDING ) {
+			power->bursts = pca->bursts;
+			power->changed = now;
+
+			//a frame went to a sleeping device
+			if ( power->state == POWER_ASLEEP ) {
+				power->pca_asleep_ticks += now - power->slept_at;
+				power->woken_at = CYCLE_COUNT ( );
+				power->state = POWER_WAKING;
+				SCHED_POST ( &power->task );
+				return;
+			}
+		}
+		if ( power->state == POWER_AWAKE && power->idle_ticks ) {
+			elapsed = now - power->changed;
+			if ( elapsed >= power->idle_ticks ) {
+				power->state = POWER_SLEEPING;
+				SCHED_POST ( &power->task );
+				return;
+			}
+
+			//the core has to wake up for the threshold, a burst before it only moves it on
+			if ( !power->timer.active ) {
+				TIMER_START ( power->timers, &power->timer, power->idle_ticks - elapsed, 0, SCHED_WAKE, &power->task );
+			}
+		}
+	}
+
+	if ( power->queue && power->queue->count == 0 ) {
+		I2C_GATE ( power->queue->bus );
+	}
+}
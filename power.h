@@ -0,0 +1,76 @@
+/**********************************************************************************************************************
+*   Idle power policy                                                                                                 *
+*                                                                                                                     *
+*   POWER_INIT makes POWER_IDLE the idle hook of a scheduler, so it runs each time there is no task left and the      *
+*   core is about to go to WFI. From there the peripherals follow the core down:                                      *
+*                                                                                                                     *
+*       the I2C module clock is turned off when the queue is empty, the next transfer turns it back on (I2C_GATE);    *
+*       Timer2 keeps running, TIMER_NOW is the time base of every armed timer                                         *
+*                                                                                                                     *
+*       the PCA9685 is put to sleep (MODE1 SLEEP) once the cache has sent nothing to it for the idle threshold, a     *
+*       one-shot timer wakes the core for it. A burst the cache sends while it sleeps wakes it: SLEEP is cleared,     *
+*       and RESTART goes out once the oscillator has had its 500 us, from the task and the same timer, so nothing     *
+*       waits in between                                                                                              *
+*                                                                                                                     *
+*   A sleeping PCA9685 drives no outputs, so a servo holding a position against a load goes limp; the threshold is    *
+*   for boards whose channels can stop, 0 leaves the device awake.                                                    *
+*                                                                                                                     *
+*   The duty cycle of the core is in the scheduler (busy and idle cycles). The policy counts the time the PCA9685     *
+*   slept and the wake latency, from the burst that woke it to the RESTART; the bus counts its gated time and the     *
+*   cycles from clock on to ready for the first byte.                                                                 *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef POWER_H
+#define POWER_H
+
+#include "pca9685_cache.h"
+#include "scheduler.h"
+#include "timer.h"
+
+//state of the PCA9685
+#define POWER_AWAKE 0
+#define POWER_SLEEPING 1                            //the task sends SLEEP
+#define POWER_ASLEEP 2
+#define POWER_WAKING 3                              //the task clears SLEEP
+#define POWER_STARTING 4                            //SLEEP clear is on the bus
+#define POWER_RESTARTING 5                          //the oscillator is starting, the task sends RESTART when it is up
+#define POWER_SUSPENDING 6                          //SLEEP is on the bus
+#define POWER_RESUMING 7                            //RESTART is on the bus
+
+typedef struct {
+	SCHEDULER *scheduler;
+	I2C_QUEUE *queue;                   //its bus is gated while it is empty, may be NULL
+	TIMER_SERVICE *timers;              //times the threshold and the wake up
+	PCA9685_CACHE *pca;                 //put to sleep when idle, may be NULL
+	unsigned long long idle_ticks;      //TIMER_NOW ticks without a burst before the PCA9685 sleeps, 0 never
+
+	SCHED_TASK task;
+	TIMER timer;
+	volatile unsigned int state;
+	volatile unsigned int pending;      //a MODE1 write is on its way, the task waits for its result
+	unsigned char mode1;                //value of that write, into the mirror once the device took it
+	unsigned int bursts;                //pca->bursts when the hook last looked
+	unsigned long long changed;         //TIMER_NOW of the last burst
+	unsigned long long slept_at;        //TIMER_NOW
+	unsigned int woken_at;              //CYCLE_COUNT when the burst that wakes it was seen
+
+	//statistics
+	unsigned int idles;                 //runs of the hook
+	unsigned int pca_sleeps;
+	unsigned int pca_wakes;
+	unsigned int failed;                //MODE1 writes the device did not take
+	unsigned long long pca_asleep_ticks;
+	unsigned long long wake_cycles;     //burst seen to RESTART sent, summed over the wake ups
+	unsigned int wake_max_cycles;
+} POWER;
+
+//the policy as the idle hook of scheduler; queue, pca may be NULL, timers may only be NULL without a pca; the
+//PCA9685 sleeps after idle_us without a burst, never when it is 0
+void POWER_INIT ( POWER *power, SCHEDULER *scheduler, I2C_QUEUE *queue, TIMER_SERVICE *timers, PCA9685_CACHE *pca,
+                  unsigned int idle_us );
+
+//the idle hook, IRQs masked
+void POWER_IDLE ( void *power );
+
+#endif
@@ -0,0 +1,130 @@
+/**********************************************************************************************************************
+*   Cooperative run-to-completion scheduler                                                                           *
+*                                                                                                                     *
+*   The FIFO is shared with the interrupt handlers, so it is only touched with IRQs masked. The loop checks for work  *
+*   and goes to sleep with IRQs still masked: WFI wakes on a pending interrupt anyway, and an interrupt that posts a  *
+*   task between the check and the WFI cannot be lost.                                                                *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "cpu.h"
+#include "scheduler.h"
+
+void SCHED_INIT ( SCHEDULER *scheduler ){
+
+	scheduler->head = scheduler->tail = 0;
+	scheduler->depth = 0;
+	scheduler->stop = 0;
+	scheduler->idle = 0;
+	scheduler->posted = scheduler->coalesced = scheduler->runs = scheduler->sleeps = 0;
+	scheduler->max_depth = scheduler->max_task_cycles = 0;
+	scheduler->busy_cycles = scheduler->idle_cycles = 0;
+}
+
+void SCHED_TASK_INIT ( SCHED_TASK *task, SCHEDULER *scheduler, SCHED_FUNCTION function, void *context ){
+
+	task->function = function;
+	task->context = context;
+	task->scheduler = scheduler;
+	task->next = 0;
+	task->queued = 0;
+	task->state = 0;
+	task->result = 0;
+	task->runs = 0;
+}
+
+void SCHED_POST ( SCHED_TASK *task ){
+
+	SCHEDULER *scheduler = task->scheduler;
+	unsigned int state = IRQ_SAVE ( );
+
+	if ( task->queued ) {
+		scheduler->coalesced++;
+		IRQ_RESTORE ( state );
+		return;
+	}
+	task->queued = 1;
+	task->next = 0;
+	if ( scheduler->tail ) {
+		scheduler->tail->next = task;
+	}
+	else {
+		scheduler->head = task;
+	}
+	scheduler->tail = task;
+	scheduler->posted++;
+	if ( ++scheduler->depth > scheduler->max_depth ) {
+		scheduler->max_depth = scheduler->depth;
+	}
+	IRQ_RESTORE ( state );
+}
+
+void SCHED_WAKE ( void *task ){
+
+	SCHED_POST ( (SCHED_TASK *) task );
+}
+
+void SCHED_I2C_DONE ( void *task, int result ){
+
+	( (SCHED_TASK *) task )->result = result;
+	SCHED_POST ( (SCHED_TASK *) task );
+}
+
+void SCHED_RUN ( SCHEDULER *scheduler ){
+
+	SCHED_TASK *task;
+	unsigned int state, begin, cycles;
+
+	for ( ;; ) {
+		state = IRQ_SAVE ( );
+		task = scheduler->head;
+		if ( task == 0 ) {
+			if ( scheduler->stop ) {
+				scheduler->stop = 0;
+				IRQ_RESTORE ( state );
+				return;
+			}
+
+			//the hook may have found work
+			if ( scheduler->idle ) {
+				scheduler->idle ( scheduler->idle_context );
+				if ( scheduler->head ) {
+					IRQ_RESTORE ( state );
+					continue;
+				}
+			}
+
+			//the interrupt that wakes the core is taken when IRQs are restored
+			begin = CYCLE_COUNT ( );
+			CPU_WAIT_FOR_INTERRUPT ( );
+			IRQ_RESTORE ( state );
+			scheduler->idle_cycles += CYCLE_COUNT ( ) - begin;
+			scheduler->sleeps++;
+			continue;
+		}
+
+		//off the FIFO before it runs, so the task can post itself again
+		scheduler->head = task->next;
+		if ( scheduler->head == 0 ) {
+			scheduler->tail = 0;
+		}
+		scheduler->depth--;
+		task->queued = 0;
+		IRQ_RESTORE ( state );
+
+		begin = CYCLE_COUNT ( );
+		task->function ( task->context );
+		cycles = CYCLE_COUNT ( ) - begin;
+		task->runs++;
+		scheduler->runs++;
+		scheduler->busy_cycles += cycles;
+		if ( cycles > scheduler->max_task_cycles ) {
+			scheduler->max_task_cycles = cycles;
+		}
+	}
+}
+
+void SCHED_STOP ( SCHEDULER *scheduler ){
+
+	scheduler->stop = 1;
+}
@@ -0,0 +1,66 @@
+/**********************************************************************************************************************
+*   Cooperative run-to-completion scheduler                                                                           *
+*                                                                                                                     *
+*   A task is a function and its context. SCHED_POST puts it on the scheduler's FIFO; SCHED_RUN takes tasks off the   *
+*   FIFO and runs each one to completion, and sleeps in WFI when the FIFO is empty. Interrupt handlers never do the   *
+*   work themselves, they post the task that does: SCHED_WAKE is a TIMER_CALLBACK and SCHED_I2C_DONE an I2C_CALLBACK  *
+*   that post the task passed as their context. A task that is already queued is not queued twice.                    *
+*                                                                                                                     *
+*   Longer flows are written as state machines: the task keeps its step in state, does one step, starts whatever it   *
+*   waits for (a transfer, a timer) with itself as the callback context, and returns.                                 *
+*                                                                                                                     *
+*   The loop counts the cycles spent in tasks and asleep, so utilization is busy / ( busy + idle ).                   *
+*                                                                                                                     *
+*   An idle hook, when set, runs every time the FIFO is found empty, before the core sleeps. It may post tasks, and   *
+*   the loop runs them instead of sleeping; otherwise it is the place to put the peripherals to sleep too (power.h).  *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+struct SCHEDULER;
+
+typedef void ( *SCHED_FUNCTION ) ( void *context );
+
+typedef struct SCHED_TASK {
+	SCHED_FUNCTION function;
+	void *context;
+	struct SCHEDULER *scheduler;
+	struct SCHED_TASK *next;
+	volatile unsigned int queued;
+	unsigned int state;                 //step of a state machine task, free for the task to use
+	volatile int result;                //result handed over by SCHED_I2C_DONE
+	unsigned int runs;
+} SCHED_TASK;
+
+typedef struct SCHEDULER {
+	SCHED_TASK *head;
+	SCHED_TASK *tail;
+	unsigned int depth;
+	volatile unsigned int stop;
+	void ( *idle ) ( void *context );   //called with IRQs masked before WFI, may be NULL
+	void *idle_context;
+
+	//statistics
+	unsigned int posted;
+	unsigned int coalesced;             //posts of a task that was already queued
+	unsigned int runs;
+	unsigned int sleeps;
+	unsigned int max_depth;
+	unsigned int max_task_cycles;
+	unsigned long long busy_cycles;     //running tasks
+	unsigned long long idle_cycles;     //asleep in WFI, including the interrupts that woke the core
+} SCHEDULER;
+
+void SCHED_INIT ( SCHEDULER *scheduler );
+void SCHED_TASK_INIT ( SCHED_TASK *task, SCHEDULER *scheduler, SCHED_FUNCTION function, void *context );
+
+void SCHED_POST ( SCHED_TASK *task );               //queue the task, safe from interrupt handlers
+void SCHED_WAKE ( void *task );                     //TIMER_CALLBACK that posts the task
+void SCHED_I2C_DONE ( void *task, int result );     //I2C_CALLBACK that stores the result and posts the task
+
+void SCHED_RUN ( SCHEDULER *scheduler );            //run tasks until SCHED_STOP, sleep when there are none
+void SCHED_STOP ( SCHEDULER *scheduler );           //SCHED_RUN returns once the queued tasks are done
+
+#endif
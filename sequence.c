@@ -0,0 +1,265 @@
+/**********************************************************************************************************************
+*   Byte coded command sequences                                                                                      *
+*                                                                                                                     *
+*   One pass of SEQ_RUN is a loop over the opcodes. Operands are checked against the program length before they are   *
+*   used, so a damaged program stops with SEQ_ERR_PROGRAM instead of running off its end.                             *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "sequence.h"
+
+//bytes of each operation, a write adds its values
+static const unsigned char SEQ_SIZE [ ] = { 1, 4, 4, 5, 5, 2, 2, 1 };
+
+static unsigned int SEQ_LE ( const unsigned char *p, unsigned int bytes ){
+
+	unsigned int value = 0;
+
+	while ( bytes-- ) {
+		value = ( value << 8 ) | p[bytes];
+	}
+	return value;
+}
+
+//a queued write is done: keep the first error, wake a task waiting for the queue to drain
+static void SEQ_I2C_DONE ( void *context, int result ){
+
+	SEQUENCE *sequence = context;
+
+	if ( result != I2C_OK && sequence->result == I2C_OK ) {
+		sequence->result = result;
+	}
+	if ( sequence->queue->count == 0 ) {
+		SEQ_SIGNAL ( sequence, SEQ_EVENT_I2C_IDLE );
+	}
+}
+
+//the delay of a task is over
+static void SEQ_DELAY_DONE ( void *context ){
+
+	SEQUENCE *sequence = context;
+
+	sequence->delayed = 0;
+	SCHED_POST ( sequence->task );
+}
+
+//has the event happened, consumes it; the queue being empty is a state, not a signal
+static unsigned int SEQ_TAKE ( SEQUENCE *sequence, unsigned int event ){
+
+	unsigned int bit = 1u << event;
+
+	if ( event == SEQ_EVENT_I2C_IDLE ) {
+		sequence->events &= ~bit;
+		return sequence->queue == 0 || sequence->queue->count == 0;
+	}
+	if ( sequence->events & bit ) {
+		sequence->events &= ~bit;
+		return 1;
+	}
+	return 0;
+}
+
+void SEQ_INIT ( SEQUENCE *sequence, const unsigned char *program, unsigned int length, I2C_BUS *bus, I2C_QUEUE *queue,
+                unsigned int gpio, TIMER_SERVICE *timers, SCHED_TASK *task ){
+
+	sequence->program = program;
+	sequence->length = length;
+	sequence->bus = bus;
+	sequence->queue = queue;
+	sequence->gpio = gpio;
+	sequence->timers = timers;
+	sequence->task = task;
+	sequence->timer.active = 0;
+	sequence->events = 0;
+	sequence->ops = sequence->writes = sequence->bytes = 0;
+	sequence->delays = sequence->waits = sequence->blocks = 0;
+	SEQ_RESTART ( sequence );
+}
+
+void SEQ_RESTART ( SEQUENCE *sequence ){
+
+	if ( sequence->delayed && sequence->timers ) {
+		TIMER_CANCEL ( sequence->timers, &sequence->timer );
+	}
+	sequence->pc = 0;
+	sequence->loops = 0;
+	sequence->waiting = 0;
+	sequence->delayed = 0;
+	sequence->result = I2C_OK;
+}
+
+void SEQ_TASK ( void *sequence ){
+
+	SEQUENCE *self = sequence;
+
+	self->task->result = SEQ_RUN ( self );
+}
+
+void SEQ_SIGNAL ( SEQUENCE *sequence, unsigned int event ){
+
+	unsigned int bit = 1u << event;
+	unsigned int state = IRQ_SAVE ( );
+
+	sequence->events |= bit;
+	if ( sequence->waiting & bit ) {
+		sequence->waiting = 0;
+		if ( sequence->task ) {
+			SCHED_POST ( sequence->task );
+		}
+	}
+	IRQ_RESTORE ( state );
+}
+
+int SEQ_RUN ( SEQUENCE *sequence ){
+
+	const unsigned char *p;
+	unsigned int size, value, state;
+	int result;
+
+	//a task posted by something else while its delay is still running
+	if ( sequence->delayed ) {
+		return SEQ_BLOCKED;
+	}
+
+	for ( ;; ) {
+
+		if ( sequence->result != I2C_OK ) {
+			return sequence->result;
+		}
+		if ( sequence->pc >= sequence->length || sequence->program[sequence->pc] > SEQ_OP_NEXT ) {
+			return SEQ_ERR_PROGRAM;
+		}
+		p = &sequence->program[sequence->pc];
+		size = SEQ_SIZE[p[0]];
+		if ( p[0] == SEQ_OP_WRITE && sequence->pc + 2 < sequence->length ) {
+			size += p[2];
+		}
+		if ( sequence->pc + size > sequence->length ) {
+			return SEQ_ERR_PROGRAM;
+		}
+
+		switch ( p[0] ) {
+
+		case SEQ_OP_END:
+			return I2C_OK;
+
+		//the register byte and the values go to the bus straight from the program
+		case SEQ_OP_WRITE:
+			if ( p[2] == 0 ) {
+				return SEQ_ERR_PROGRAM;
+			}
+			if ( sequence->queue ) {
+				result = I2C_QUEUE_WRITE ( sequence->queue, p[1], &p[3], p[2] + 1u, 0, SEQ_I2C_DONE, sequence );
+
+				//a full ring: wait for it to drain and write again
+				if ( result == I2C_ERR_FULL ) {
+					if ( sequence->task ) {
+						sequence->waiting = 1u << SEQ_EVENT_I2C_IDLE;
+						if ( !SEQ_TAKE ( sequence, SEQ_EVENT_I2C_IDLE ) ) {
+							sequence->blocks++;
+							return SEQ_BLOCKED;
+						}
+						sequence->waiting = 0;
+					}
+					else {
+						I2C_QUEUE_FLUSH ( sequence->queue );
+					}
+					continue;
+				}
+			}
+			else {
+				result = I2C_WRITE ( sequence->bus, p[1], &p[3], p[2] + 1u );
+			}
+			if ( result != I2C_OK ) {
+				return result;
+			}
+			sequence->writes++;
+			sequence->bytes += p[2] + 1u;
+			break;
+
+		case SEQ_OP_DELAY:
+			value = SEQ_LE ( &p[1], 3 );
+			sequence->delays++;
+			if ( sequence->task && sequence->timers ) {
+				sequence->pc += size;
+				sequence->ops++;
+				sequence->delayed = 1;
+				sequence->blocks++;
+				TIMER_START ( sequence->timers, &sequence->timer, TIMER_US ( value ), 0, SEQ_DELAY_DONE, sequence );
+				return SEQ_BLOCKED;
+			}
+			if ( sequence->timers ) {
+				TIMER_DELAY ( sequence->timers, TIMER_US ( value ) );
+			}
+			else {
+				//a NOP loop iteration is about 2 cycles, a millisecond at a time so the count does not overflow
+				for ( ; value >= 1000; value -= 1000 ) {
+					CPU_SPIN ( 1000 * ( CPU_MHZ / 2 ) );
+				}
+				CPU_SPIN ( (int) ( value * ( CPU_MHZ / 2 ) ) );
+			}
+			break;
+
+		case SEQ_OP_GPIO_SET:
+			REG_WRITE ( sequence->gpio + SETDATAOUT, SEQ_LE ( &p[1], 4 ) );
+			break;
+
+		case SEQ_OP_GPIO_CLEAR:
+			REG_WRITE ( sequence->gpio + CLEARDATAOUT, SEQ_LE ( &p[1], 4 ) );
+			break;
+
+		//the wait stays the next operation until the event is there, a blocked task finds it again
+		case SEQ_OP_WAIT:
+			if ( p[1] >= SEQ_EVENTS ) {
+				return SEQ_ERR_PROGRAM;
+			}
+			state = IRQ_SAVE ( );
+			if ( !SEQ_TAKE ( sequence, p[1] ) ) {
+				sequence->waits++;
+				if ( sequence->task ) {
+					sequence->waiting = 1u << p[1];
+					sequence->blocks++;
+					IRQ_RESTORE ( state );
+					return SEQ_BLOCKED;
+				}
+
+				//WFI with IRQs masked still wakes on the interrupt, which is taken once they are restored
+				do {
+					CPU_WAIT_FOR_INTERRUPT ( );
+					IRQ_RESTORE ( state );
+					state = IRQ_SAVE ( );
+				} while ( !SEQ_TAKE ( sequence, p[1] ) );
+			}
+			IRQ_RESTORE ( state );
+			break;
+
+		case SEQ_OP_LOOP:
+			if ( sequence->loops == SEQ_LOOP_DEPTH ) {
+				return SEQ_ERR_PROGRAM;
+			}
+			sequence->loop_pc[sequence->loops] = sequence->pc + size;
+			sequence->loop_left[sequence->loops] = p[1];
+			sequence->loops++;
+			break;
+
+		//back to the top of the innermost loop until its count runs out, a count of 0 never does
+		case SEQ_OP_NEXT:
+			if ( sequence->loops == 0 ) {
+				return SEQ_ERR_PROGRAM;
+			}
+			value = sequence->loops - 1;
+			if ( sequence->loop_left[value] == 0 || --sequence->loop_left[value] > 0 ) {
+				sequence->pc = sequence->loop_pc[value];
+				sequence->ops++;
+				continue;
+			}
+			sequence->loops--;
+			break;
+		}
+
+		sequence->pc += size;
+		sequence->ops++;
+	}
+}
@@ -0,0 +1,121 @@
+/**********************************************************************************************************************
+*   Byte coded command sequences                                                                                      *
+*                                                                                                                     *
+*   A sequence is a const unsigned char array built at compile time with the SEQ_* macros below and run by one        *
+*   interpreter, SEQ_RUN. Every operation is an opcode byte and its operands:                                         *
+*                                                                                                                     *
+*       SEQ_WRITE ( slave, reg, v0, ... vn )    one I2C transaction: the register byte and 1 to 64 values             *
+*       SEQ_DELAY_US ( us ), SEQ_DELAY_MS ( ms ) wait, up to 16.7 seconds                                             *
+*       SEQ_GPIO_SET ( mask ), SEQ_GPIO_CLEAR ( mask )  one SETDATAOUT or CLEARDATAOUT write on the GPIO module       *
+*       SEQ_WAIT ( event )                      wait until event 0 to 31 has been signalled, then consume it          *
+*       SEQ_LOOP ( count ) ... SEQ_NEXT         run the operations in between count times, 0 for ever; 4 levels deep  *
+*       SEQ_END                                                                                                       *
+*                                                                                                                     *
+*   A register write is 5 bytes and one more per extra value, where a register/value pair table of unsigned int takes *
+*   8 bytes per register. The register byte and the values already sit in the program in bus order, so the            *
+*   interpreter hands them to I2C_WRITE (or the queue, which copies them into its ring) as they are. Operand counts   *
+*   and ranges are checked by the compiler: a SEQ_WRITE of more than 64 values or a delay that does not fit does not  *
+*   build.                                                                                                            *
+*                                                                                                                     *
+*   With a queue the writes are queued and the interpreter goes on at once; SEQ_EVENT_I2C_IDLE is signalled whenever  *
+*   the queue has drained, so SEQ_WAIT ( SEQ_EVENT_I2C_IDLE ) waits for the writes before it. Without a queue they    *
+*   are polled.                                                                                                       *
+*                                                                                                                     *
+*   Without a task, SEQ_RUN blocks until SEQ_END: delays sleep on the timer service (or spin when there is none) and  *
+*   waits sleep in WFI. With a task it is a step of the cooperative scheduler: it runs until a delay or a wait that   *
+*   is not yet met, starts a timer or leaves the task to be posted by SEQ_SIGNAL, and returns SEQ_BLOCKED; the task   *
+*   calls SEQ_RUN again when it runs.                                                                                 *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include "i2c_async.h"
+#include "timer.h"
+#include "scheduler.h"
+
+#define SEQ_BLOCKED 1                               //SEQ_RUN returns before the end, waiting for a delay or event
+#define SEQ_ERR_PROGRAM -8                          //unknown opcode, operands past the end or loops out of balance
+
+#define SEQ_LOOP_DEPTH 4
+#define SEQ_EVENTS 32
+#define SEQ_EVENT_I2C_IDLE 0                        //signalled by the interpreter when the queue is empty
+#define SEQ_MAX_WRITE 64                            //values in one SEQ_WRITE
+
+//opcodes
+#define SEQ_OP_END 0x00
+#define SEQ_OP_WRITE 0x01                           //slave, count, reg, count values
+#define SEQ_OP_DELAY 0x02                           //microseconds, 24 bit little endian
+#define SEQ_OP_GPIO_SET 0x03                        //mask, 32 bit little endian
+#define SEQ_OP_GPIO_CLEAR 0x04
+#define SEQ_OP_WAIT 0x05                            //event
+#define SEQ_OP_LOOP 0x06                            //count, 0 for ever
+#define SEQ_OP_NEXT 0x07
+
+//builders, every one expands to the bytes of one operation; a failed check is a negative array size
+#define SEQ_CHECK(ok) ( 0 * sizeof ( char [ (ok) ? 1 : -1 ] ) )
+#define SEQ_ARGS(...) ( sizeof ( ( unsigned char [ ] ) { __VA_ARGS__ } ) )
+#define SEQ_LE16(v) ( (unsigned char) ( (v) & 0xFF ) ), ( (unsigned char) ( ( (v) >> 8 ) & 0xFF ) )
+#define SEQ_LE24(v) SEQ_LE16 ( v ), ( (unsigned char) ( ( (v) >> 16 ) & 0xFF ) )
+#define SEQ_LE32(v) SEQ_LE24 ( v ), ( (unsigned char) ( ( (v) >> 24 ) & 0xFF ) )
+
+#define SEQ_END SEQ_OP_END
+#define SEQ_WRITE(slave, reg, ...) SEQ_OP_WRITE, (unsigned char) (slave), \
+	(unsigned char) ( SEQ_ARGS ( __VA_ARGS__ ) + SEQ_CHECK ( SEQ_ARGS ( __VA_ARGS__ ) <= SEQ_MAX_WRITE ) ), \
+	(unsigned char) (reg), __VA_ARGS__
+#define SEQ_DELAY_US(us) SEQ_OP_DELAY, SEQ_LE24 ( (us) + SEQ_CHECK ( (us) < ( 1UL << 24 ) ) )
+#define SEQ_DELAY_MS(ms) SEQ_DELAY_US ( (ms) * 1000UL )
+#define SEQ_GPIO_SET(mask) SEQ_OP_GPIO_SET, SEQ_LE32 ( (unsigned long) (mask) )
+#define SEQ_GPIO_CLEAR(mask) SEQ_OP_GPIO_CLEAR, SEQ_LE32 ( (unsigned long) (mask) )
+#define SEQ_WAIT(event) SEQ_OP_WAIT, (unsigned char) ( (event) + SEQ_CHECK ( (event) < SEQ_EVENTS ) )
+#define SEQ_LOOP(count) SEQ_OP_LOOP, (unsigned char) ( (count) + SEQ_CHECK ( (count) < 256 ) )
+#define SEQ_NEXT SEQ_OP_NEXT
+
+typedef struct {
+	const unsigned char *program;
+	unsigned int length;
+	unsigned int pc;                    //offset of the next operation
+
+	I2C_BUS *bus;                       //writes are polled on this bus
+	I2C_QUEUE *queue;                   //when set, writes are queued here instead
+	unsigned int gpio;                  //GPIO module base of SEQ_GPIO_SET / SEQ_GPIO_CLEAR
+	TIMER_SERVICE *timers;              //delays, NULL to spin
+	SCHED_TASK *task;                   //run as a scheduler step, NULL to block in SEQ_RUN
+
+	TIMER timer;
+	volatile unsigned int events;       //signalled, not yet consumed
+	volatile unsigned int waiting;      //event mask of the SEQ_WAIT the task is blocked in
+	volatile unsigned int delayed;      //a delay is running
+	volatile int result;                //first error of a queued write
+	unsigned int loop_pc[SEQ_LOOP_DEPTH];
+	unsigned int loop_left[SEQ_LOOP_DEPTH];
+	unsigned int loops;                 //loop levels open
+
+	//statistics
+	unsigned int ops;                   //operations run
+	unsigned int writes;
+	unsigned int bytes;                 //register bytes and values handed to the bus
+	unsigned int delays;
+	unsigned int waits;                 //SEQ_WAIT that had to wait
+	unsigned int blocks;                //times SEQ_RUN returned SEQ_BLOCKED
+} SEQUENCE;
+
+//a sequence over length bytes of program, I2C writes on bus (queued on queue when it is not NULL), GPIO writes to
+//the module at gpio; timers and task may be NULL
+void SEQ_INIT ( SEQUENCE *sequence, const unsigned char *program, unsigned int length, I2C_BUS *bus, I2C_QUEUE *queue,
+                unsigned int gpio, TIMER_SERVICE *timers, SCHED_TASK *task );
+
+//start the program over, pending events are kept
+void SEQ_RESTART ( SEQUENCE *sequence );
+
+//run from where the sequence stopped: I2C_OK at SEQ_END, SEQ_BLOCKED in task mode, or the first error
+int SEQ_RUN ( SEQUENCE *sequence );
+
+//SCHED_FUNCTION for a task whose context is the sequence, the result of each run goes to the task's result
+void SEQ_TASK ( void *sequence );
+
+//signal an event, safe from interrupt handlers; posts the task when it waits for it
+void SEQ_SIGNAL ( SEQUENCE *sequence, unsigned int event );
+
+#endif
@@ -0,0 +1,119 @@
+/**********************************************************************************************************************
+*   Servo angle to PWM                                                                                                *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "servo.h"
+
+//position within the travel at table index i, Q16, worked out by the compiler; the last entry lies past +90
+//degrees so the final, shorter segment interpolates on the same line
+#define SERVO_TABLE_ENTRY(i) ( (unsigned int) ( ( ( (i) << SERVO_TABLE_SHIFT ) * 65536ULL + SERVO_RANGE / 2 ) / SERVO_RANGE ) )
+
+static const unsigned int SERVO_POSITION [ SERVO_TABLE_SIZE ] = {
+	SERVO_TABLE_ENTRY ( 0 ), SERVO_TABLE_ENTRY ( 1 ), SERVO_TABLE_ENTRY ( 2 ), SERVO_TABLE_ENTRY ( 3 ),
+	SERVO_TABLE_ENTRY ( 4 ), SERVO_TABLE_ENTRY ( 5 ), SERVO_TABLE_ENTRY ( 6 ), SERVO_TABLE_ENTRY ( 7 ),
+	SERVO_TABLE_ENTRY ( 8 ), SERVO_TABLE_ENTRY ( 9 ), SERVO_TABLE_ENTRY ( 10 ), SERVO_TABLE_ENTRY ( 11 ),
+	SERVO_TABLE_ENTRY ( 12 ), SERVO_TABLE_ENTRY ( 13 ), SERVO_TABLE_ENTRY ( 14 ), SERVO_TABLE_ENTRY ( 15 ),
+};
+
+_Static_assert ( SERVO_TABLE_SIZE == 16, "SERVO_POSITION initializer does not match SERVO_TABLE_SIZE" );
+
+//base and span of one channel for the current PRE_SCALE, the divisions are paid here and not per angle; 64 bit,
+//a width of 0xFFFF us is 2^35 at the fastest PRE_SCALE in Q16
+static void SERVO_SCALE ( SERVO_MAP *map, unsigned int channel ){
+
+	map->base_q16[channel] = (unsigned long long) map->min_us[channel] * map->counts_per_us_q16;
+	map->span_q16[channel] = (unsigned long long) ( map->max_us[channel] - map->min_us[channel] ) * map->counts_per_us_q16;
+}
+
+void SERVO_INIT ( SERVO_MAP *map, unsigned char prescale ){
+
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		map->min_us[channel] = SERVO_MIN_US;
+		map->max_us[channel] = SERVO_MAX_US;
+	}
+	map->osc_hz = PCA9685_OSC_HZ;
+	SERVO_SET_PRESCALE ( map, prescale );
+}
+
+int SERVO_CALIBRATE ( SERVO_MAP *map, unsigned int channel, unsigned int min_us, unsigned int max_us ){
+
+	//the widths are kept as unsigned short, a larger one would be stored cut short
+	if ( channel >= PCA9685_CHANNELS || max_us < min_us || max_us > 0xFFFF ) {
+		return SERVO_ERR_RANGE;
+	}
+	map->min_us[channel] = (unsigned short) min_us;
+	map->max_us[channel] = (unsigned short) max_us;
+	SERVO_SCALE ( map, channel );
+	return I2C_OK;
+}
+
+void SERVO_SET_PRESCALE ( SERVO_MAP *map, unsigned char prescale ){
+
+	//one count is ( PRE_SCALE + 1 ) oscillator clocks
+	map->prescale = prescale;
+	map->counts_per_us_q16 = (unsigned int) ( ( (unsigned long long) map->osc_hz << 16 ) / 1000000 / ( prescale + 1 ) );
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		SERVO_SCALE ( map, channel );
+	}
+}
+
+void SERVO_SET_OSCILLATOR ( SERVO_MAP *map, unsigned int osc_hz ){
+
+	map->osc_hz = osc_hz;
+	SERVO_SET_PRESCALE ( map, map->prescale );
+}
+
+int SERVO_ANGLE_TO_PWM ( const SERVO_MAP *map, unsigned int channel, int angle, unsigned short *on, unsigned short *off ){
+
+	unsigned int offset, index, weight, position;
+	unsigned int count;
+
+	if ( channel >= PCA9685_CHANNELS ) {
+		return SERVO_ERR_RANGE;
+	}
+	if ( angle < SERVO_ANGLE_MIN ) {
+		angle = SERVO_ANGLE_MIN;
+	}
+	else if ( angle > SERVO_ANGLE_MAX ) {
+		angle = SERVO_ANGLE_MAX;
+	}
+
+	//table lookup and linear interpolation between the two entries
+	offset = (unsigned int) ( angle - SERVO_ANGLE_MIN );
+	index = offset >> SERVO_TABLE_SHIFT;
+	weight = offset & ( ( 1 << SERVO_TABLE_SHIFT ) - 1 );
+	position = SERVO_POSITION[index] + ( ( ( SERVO_POSITION[index + 1] - SERVO_POSITION[index] ) * weight ) >> SERVO_TABLE_SHIFT );
+
+	//into the channel's range, rounded to the nearest count
+	count = (unsigned int) ( ( map->base_q16[channel] + ( ( map->span_q16[channel] * position ) >> 16 ) + 0x8000 ) >> 16 );
+
+	*on = 0;
+	*off = count > 4095 ? 4095 : (unsigned short) count;
+	return I2C_OK;
+}
+
+int SERVO_MOVE ( PCA9685_CACHE *cache, const SERVO_MAP *map, unsigned int channel, int angle ){
+
+	unsigned short on, off;
+	unsigned char counts [ 4 ];
+	int result;
+
+	if ( ( result = SERVO_ANGLE_TO_PWM ( map, channel, angle, &on, &off ) ) != I2C_OK ) {
+		return result;
+	}
+	counts[0] = on & 0xFF;
+	counts[1] = ( on >> 8 ) & 0x0F;
+	counts[2] = off & 0xFF;
+	counts[3] = ( off >> 8 ) & 0x0F;
+	return PCA9685_CACHE_WRITE_BURST ( cache, LED_ON_L ( channel ), counts, 4 );
+}
+
+void SERVO_FRAME ( const SERVO_MAP *map, const int angles[PCA9685_CHANNELS], unsigned short widths[PCA9685_CHANNELS] ){
+
+	unsigned short on;
+
+	for ( unsigned int channel = 0; channel < PCA9685_CHANNELS; channel++ ) {
+		SERVO_ANGLE_TO_PWM ( map, channel, angles[channel], &on, &widths[channel] );
+	}
+}
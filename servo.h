@@ -0,0 +1,74 @@
+/**********************************************************************************************************************
+*   Servo angle to PWM                                                                                                *
+*                                                                                                                     *
+*   Angles are in tenths of a degree, -900 to +900. A servo position is the OFF count of its PCA9685 channel with     *
+*   the ON count at 0, so the pulse is OFF counts of the PWM clock long. With the 25 MHz oscillator one count is      *
+*   ( PRE_SCALE + 1 ) / 25 us, 4.88 us at the 50 Hz PRE_SCALE of 0x79.                                                *
+*                                                                                                                     *
+*   SERVO_POSITION is a table built at compile time: the position within the servo's travel, in Q16, every 12.8       *
+*   degrees. It is linear for the servos we use; a servo with a measured curve only needs a different table. Each     *
+*   channel is calibrated with the pulse widths it needs at -90 and +90 degrees, which are turned into a base count   *
+*   and a span for the current PRE_SCALE when the calibration or PRE_SCALE changes. The oscillator frequency the      *
+*   counts are worked out for is PCA9685_OSC_HZ until SERVO_SET_OSCILLATOR gives the calibrated one.                  *
+*                                                                                                                     *
+*   SERVO_ANGLE_TO_PWM looks up the two table entries around the angle, interpolates between them with a shift,       *
+*   and scales the result into the channel's range with one multiply. There is no floating point and no division      *
+*   on that path.                                                                                                     *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef SERVO_H
+#define SERVO_H
+
+#include "pca9685_cache.h"
+
+#define SERVO_ANGLE(degrees) ( (degrees) * 10 )    //tenths of a degree
+#define SERVO_ANGLE_MIN SERVO_ANGLE ( -90 )
+#define SERVO_ANGLE_MAX SERVO_ANGLE ( 90 )
+#define SERVO_RANGE ( SERVO_ANGLE_MAX - SERVO_ANGLE_MIN )
+
+#define SERVO_MIN_US 1000                           //default pulse at -90 degrees
+#define SERVO_MAX_US 2000                           //default pulse at +90 degrees
+#define SERVO_ERR_RANGE -11                         //channel past the last one, or a pulse width that does not fit
+
+//OFF count of a pulse at the nominal oscillator, for widths that are needed before SERVO_INIT has run
+#define SERVO_COUNT(us, prescale) ( ( (us) * ( PCA9685_OSC_HZ / 1000000 ) + ( (prescale) + 1 ) / 2 ) / ( (prescale) + 1 ) )
+
+//table step of 2^7 tenths of a degree, so the index and the interpolation weight are a shift and a mask
+#define SERVO_TABLE_SHIFT 7
+#define SERVO_TABLE_SIZE ( ( SERVO_RANGE >> SERVO_TABLE_SHIFT ) + 2 )
+
+typedef struct {
+	unsigned int osc_hz;                //PCA9685 oscillator frequency
+	unsigned char prescale;
+	unsigned int counts_per_us_q16;     //PWM counts per microsecond at the current PRE_SCALE, Q16
+	unsigned short min_us[PCA9685_CHANNELS];
+	unsigned short max_us[PCA9685_CHANNELS];
+	unsigned long long base_q16[PCA9685_CHANNELS];  //OFF count at -90 degrees, Q16
+	unsigned long long span_q16[PCA9685_CHANNELS];  //OFF counts from -90 to +90 degrees, Q16
+} SERVO_MAP;
+
+//every channel at SERVO_MIN_US / SERVO_MAX_US for the given PRE_SCALE
+void SERVO_INIT ( SERVO_MAP *map, unsigned char prescale );
+
+//pulse widths one channel needs at -90 and +90 degrees; SERVO_ERR_RANGE, and the calibration left as it was, for a
+//channel past 15, max_us below min_us or a width over 0xFFFF
+int SERVO_CALIBRATE ( SERVO_MAP *map, unsigned int channel, unsigned int min_us, unsigned int max_us );
+
+//the PWM period changed, rescale every channel
+void SERVO_SET_PRESCALE ( SERVO_MAP *map, unsigned char prescale );
+
+//the oscillator was calibrated (PCA9685_CACHE_CALIBRATE), rescale every channel
+void SERVO_SET_OSCILLATOR ( SERVO_MAP *map, unsigned int osc_hz );
+
+//ON and OFF counts for an angle, angles outside -90 to +90 degrees are clamped; SERVO_ERR_RANGE for a channel past
+//15, on and off are not written then
+int SERVO_ANGLE_TO_PWM ( const SERVO_MAP *map, unsigned int channel, int angle, unsigned short *on, unsigned short *off );
+
+//stage the four LED registers of the channel in the cache, the caller flushes; SERVO_ERR_RANGE for a channel past 15
+int SERVO_MOVE ( PCA9685_CACHE *cache, const SERVO_MAP *map, unsigned int channel, int angle );
+
+//widths for PCA9685_CACHE_WRITE_FRAME from 16 angles
+void SERVO_FRAME ( const SERVO_MAP *map, const int angles[PCA9685_CHANNELS], unsigned short widths[PCA9685_CHANNELS] );
+
+#endif
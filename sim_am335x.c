@@ -0,0 +1,1799 @@
+/**********************************************************************************************************************
+*   Simulated AM335x register backend                                                                                 *
+*                                                                                                                     *
+*   The I2C2 model follows the master transmitter sequence from the Sitara manual. Writing CON with STT set puts a    *
+*   START on the bus and sets BB, then the address byte and CNT data bytes are clocked out, nine SCL cycles each.     *
+*   Data bytes come out of the transmit FIFO which the CPU fills through DATA; if the FIFO runs dry the model holds   *
+*   SCL low (clock stretching) until the next byte arrives. When the count reaches zero a STOP is sent if STP was     *
+*   set, otherwise the bus is held for a repeated start. ARDY, BF, NACK, XUDF are events that stay set in             *
+*   IRQSTATUS_RAW until they are cleared through IRQSTATUS, XRDY and XDR are re-raised while the FIFO condition       *
+*   holds. Writing a 1 to IRQSTATUS_RAW sets the bit, exactly like the hardware.                                      *
+*                                                                                                                     *
+*   The SCL period comes from the registers: the internal clock is 48MHz / (PSC + 1), the low time is SCLL + 7 and    *
+*   the high time is SCLH + 5 internal clocks. A soft reset clears PSC, SCLL and SCLH like the real module does.      *
+*                                                                                                                     *
+*   With BUF XDMA_EN and DMATXENABLE set the controller raises its transmit DMA request instead of XRDY / XDR, and    *
+*   only for full thresholds, so a DMA transfer must be a whole number of thresholds long.                            *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "am335x.h"
+#include "pca9685.h"
+#include "sim_am335x.h"
+
+#define SIM_MAX_PCA 16                  //PCA9685 devices that can be attached to one bus
+#define SIM_I2C_BUSES 3
+#define SIM_MEMORY_WORDS 256            //registers of modules that are not modelled
+#define SIM_DMA_REGIONS 32              //host buffers with a bus address for the EDMA
+#define SIM_DMA_BASE 0x80000000         //bus addresses handed out from the start of DDR
+#define SIM_TIMER_NEVER ( ~0ULL )
+#define SIM_TIMER_WRAP 0x100000000ULL
+#define SIM_CLOCKS 6                    //module clocks with an IDLEST, see CLOCK_GATES
+
+//phases of the I2C2 bus state machine
+
+#define PHASE_IDLE 0
+#define PHASE_START 1
+#define PHASE_ADDRESS 2
+#define PHASE_DATA 3
+#define PHASE_STALL 4                   //SCL held low, waiting for the transmit FIFO
+#define PHASE_HOLD 5                    //count reached zero without STP, waiting for a repeated start
+#define PHASE_STOP 6
+
+typedef struct {
+	unsigned char address;
+	unsigned char regs[256];
+	unsigned char pointer;              //register selected by the first data byte
+	unsigned char pointer_set;
+	unsigned char selected;             //acknowledged the current transaction
+	unsigned char general_call;         //selected through the general call address
+	unsigned char wedged;               //NACKs its addresses until a general call software reset
+	unsigned char touched[256];         //written during the current transaction
+	unsigned long long latch_ns[256];   //time each register last latched (on STOP)
+	unsigned long long osc_ready_ns;
+	unsigned int osc_hz;                //the device's own oscillator, kept through a software reset
+} SIM_PCA9685;
+
+typedef struct {
+	unsigned int base;
+	unsigned int con, psc, scll, sclh, buf, cnt, sa, oa, raw, enable;
+	unsigned int dmatx;                 //transmit DMA request line enabled
+	unsigned int syss;
+	unsigned int reset_pending;
+	unsigned long long rdone_ns;
+
+	unsigned char txfifo[I2C_FIFO_DEPTH];
+	unsigned int tx_head, tx_count;
+	unsigned char rxfifo[I2C_FIFO_DEPTH];
+	unsigned int rx_head, rx_count;
+	unsigned int receiving;             //the current or last transfer ran with TRX clear
+
+	unsigned int phase;
+	unsigned long long phase_end_ns;
+	unsigned long long phase_start_ns;
+	unsigned long long busy_since_ns;
+	unsigned long long free_since_ns;
+	unsigned int cnt_total;             //CNT latched at START
+	unsigned int remaining;             //bytes still to go on the bus
+	unsigned int loaded;                //bytes the CPU handed over for this transfer
+	unsigned char shift;                //byte being clocked out
+	unsigned int bit_ns;                //SCL period latched at START
+
+	SIM_PCA9685 pca[SIM_MAX_PCA];
+	unsigned int pca_count;
+
+	unsigned int systest;
+	unsigned int inject_nacks;          //address bytes still to be left unacknowledged
+	unsigned int inject_al;             //transactions still to lose arbitration to another master
+	unsigned int sda_stuck;             //SCL clocks a slave needs before it lets go of SDA, 0 when released
+	unsigned int hung;                  //the state machine stopped, only a soft reset gets it going
+} SIM_I2C;
+
+typedef struct {
+	unsigned int er, eer, ier, ipr, emr, drae;
+	unsigned int dchmap[32];
+	unsigned int param[EDMA_PARAM_SETS][8];
+} SIM_EDMA;
+
+typedef struct {
+	unsigned int tclr, tldr, tmar, raw, enable;
+	unsigned int origin_count;          //TCRR at origin_ns, the counter runs on from there
+	unsigned long long origin_ns;
+	unsigned long long hz;              //functional clock latched when the timer is started
+	unsigned long long next_overflow;   //tick after origin_ns of the next overflow, SIM_TIMER_NEVER when stopped
+	unsigned long long next_match;
+	unsigned int stopped;               //the module clock is off, TCRR holds origin_count until it is back on
+} SIM_TIMER;
+
+typedef struct {
+	unsigned int oe, dataout;           //OE resets to all inputs
+} SIM_GPIO;
+
+typedef struct {
+	const unsigned char *host;
+	unsigned int bus;
+	unsigned int length;
+} SIM_DMA_REGION;
+
+typedef struct {
+	unsigned int address;
+	unsigned int value;
+} SIM_WORD;
+
+static SIM_STATS stats;
+static SIM_I2C i2c[SIM_I2C_BUSES];   //I2C0, I2C1, I2C2
+static SIM_EDMA edma;
+static SIM_TIMER timer2;
+static SIM_GPIO gpio1;
+static unsigned long long clock_ready_ns[SIM_CLOCKS];   //IDLEST reads functional from here, SIM_TIMER_NEVER when off
+static SIM_DMA_REGION dma_regions[SIM_DMA_REGIONS];
+static unsigned int dma_regions_used;
+static unsigned int dma_next_bus;
+static unsigned int intc_mir[INTC_LINES / 32];
+static unsigned int irq_enabled;        //I bit of the CPSR, cleared means interrupts are taken
+static unsigned int in_irq;
+static void ( *irq_vector ) ( void );
+static SIM_WORD memory[SIM_MEMORY_WORDS];
+static unsigned int memory_used;
+static unsigned long long time_limit_ns;
+static int initialized;
+
+/**********************************************************************************************************************
+*   PCA9685 slave                                                                                                     *
+**********************************************************************************************************************/
+
+//power on register values from the PCA9685 data sheet
+static void PCA_POWER_ON ( SIM_PCA9685 *pca, unsigned char address )
+{
+	memset ( pca, 0, sizeof ( *pca ) );
+	pca->address = address;
+	pca->regs[MODE1] = MODE1_SLEEP | MODE1_ALLCALL;
+	pca->regs[MODE2] = 0x04;
+	pca->regs[SUBADR1] = 0xE2;
+	pca->regs[SUBADR2] = 0xE4;
+	pca->regs[SUBADR3] = 0xE8;
+	pca->regs[ALLCALLADR] = 0xE0;
+	for ( unsigned int channel = 0; channel < 16; channel++ ) {
+		pca->regs[LED_OFF_H ( channel )] = LED_FULL;
+	}
+	pca->regs[PRE_SCALE_SERVO] = 0x1E;
+	pca->osc_hz = PCA9685_OSC_HZ;
+}
+
+//does the device answer to this 7 bit address
+static int PCA_MATCH ( const SIM_PCA9685 *pca, unsigned int address )
+{
+	unsigned char mode1 = pca->regs[MODE1];
+
+	//the general call is always acknowledged, it is the way out of a wedged state
+	if ( address == PCA9685_GENERAL_CALL_ADDRESS ) {
+		return 1;
+	}
+	if ( pca->wedged ) {
+		return 0;
+	}
+	if ( address == pca->address ) {
+		return 1;
+	}
+	if ( ( mode1 & MODE1_ALLCALL ) && address == ( pca->regs[ALLCALLADR] >> 1 ) ) {
+		return 1;
+	}
+	if ( ( mode1 & MODE1_SUB1 ) && address == ( pca->regs[SUBADR1] >> 1 ) ) {
+		return 1;
+	}
+	if ( ( mode1 & MODE1_SUB2 ) && address == ( pca->regs[SUBADR2] >> 1 ) ) {
+		return 1;
+	}
+	if ( ( mode1 & MODE1_SUB3 ) && address == ( pca->regs[SUBADR3] >> 1 ) ) {
+		return 1;
+	}
+	return 0;
+}
+
+static void PCA_STORE ( SIM_PCA9685 *pca, unsigned char reg, unsigned char value, unsigned long long t )
+{
+	if ( reg == MODE1 ) {
+		//clearing SLEEP starts the oscillator, writing RESTART clears it; RESTART before the oscillator is up is
+		//against the data sheet
+		if ( ( pca->regs[MODE1] & MODE1_SLEEP ) && !( value & MODE1_SLEEP ) ) {
+			pca->osc_ready_ns = t + SIM_PCA_OSC_NS;
+		}
+		if ( ( value & MODE1_RESTART ) && ( ( value & MODE1_SLEEP ) || t < pca->osc_ready_ns ) ) {
+			stats.pca_early_restarts++;
+		}
+		pca->regs[MODE1] = value & ~MODE1_RESTART;
+	}
+	else if ( reg == PRE_SCALE_SERVO ) {
+		//PRE_SCALE can only be written while the oscillator is off
+		if ( !( pca->regs[MODE1] & MODE1_SLEEP ) ) {
+			stats.pca_ignored++;
+			return;
+		}
+		pca->regs[reg] = value;
+	}
+	else if ( reg >= ALL_LED_ON_L && reg <= ALL_LED_OFF_H ) {
+		for ( unsigned int channel = 0; channel < 16; channel++ ) {
+			unsigned char target = LED_ON_L ( channel ) + ( reg - ALL_LED_ON_L );
+			pca->regs[target] = value;
+			pca->touched[target] = 1;
+		}
+	}
+	else if ( reg > LED15_OFF_H && reg < ALL_LED_ON_L ) {
+		stats.pca_ignored++;
+		return;
+	}
+	else {
+		pca->regs[reg] = value;
+	}
+	pca->touched[reg] = 1;
+	stats.pca_writes++;
+}
+
+//the byte a master receiver clocks in, from the pointer the write part of the transaction left
+static unsigned char PCA_READ_BYTE ( SIM_PCA9685 *pca )
+{
+	unsigned char value = pca->regs[pca->pointer];
+
+	if ( pca->regs[MODE1] & MODE1_AI ) {
+		pca->pointer = ( pca->pointer == LED15_OFF_H ) ? MODE1 : (unsigned char) ( pca->pointer + 1 );
+	}
+	stats.pca_reads++;
+	return value;
+}
+
+static void PCA_START ( SIM_PCA9685 *pca )
+{
+	pca->pointer_set = 0;
+}
+
+static void PCA_WRITE_BYTE ( SIM_PCA9685 *pca, unsigned char value, unsigned long long t )
+{
+	//SWRST through the general call: back to the power on registers
+	if ( pca->general_call ) {
+		if ( value == PCA9685_SWRST ) {
+			unsigned int osc_hz = pca->osc_hz;
+
+			PCA_POWER_ON ( pca, pca->address );
+			pca->osc_hz = osc_hz;
+			pca->selected = 1;
+			pca->general_call = 1;
+			stats.pca_resets++;
+		}
+		return;
+	}
+	if ( !pca->pointer_set ) {
+		pca->pointer = value;
+		pca->pointer_set = 1;
+		return;
+	}
+	PCA_STORE ( pca, pca->pointer, value, t );
+	if ( pca->regs[MODE1] & MODE1_AI ) {
+		//the LED block rolls over from LED15_OFF_H back to MODE1
+		pca->pointer = ( pca->pointer == LED15_OFF_H ) ? MODE1 : (unsigned char) ( pca->pointer + 1 );
+	}
+}
+
+//the PCA9685 updates its outputs on STOP (MODE2 OCH = 0)
+static void PCA_STOP ( SIM_PCA9685 *pca, unsigned long long t )
+{
+	for ( unsigned int reg = 0; reg < 256; reg++ ) {
+		if ( pca->touched[reg] ) {
+			pca->latch_ns[reg] = t;
+			pca->touched[reg] = 0;
+		}
+	}
+	pca->selected = 0;
+}
+
+static SIM_PCA9685 *PCA_FIND ( SIM_I2C *bus, unsigned char address )
+{
+	for ( unsigned int i = 0; bus && i < bus->pca_count; i++ ) {
+		if ( bus->pca[i].address == address ) {
+			return &bus->pca[i];
+		}
+	}
+	return NULL;
+}
+
+/**********************************************************************************************************************
+*   I2C controllers                                                                                                   *
+**********************************************************************************************************************/
+
+static void CTRL_SOFT_RESET ( SIM_I2C *bus )
+{
+	if ( bus->phase != PHASE_IDLE ) {
+		stats.bus_busy_ns += stats.now_ns - bus->busy_since_ns;
+	}
+	bus->con = bus->psc = bus->scll = bus->sclh = bus->buf = bus->cnt = bus->oa = 0;
+	bus->sa = 0x3FF;
+	bus->raw = bus->enable = bus->dmatx = 0;
+	bus->syss = 0;
+	bus->reset_pending = 1;
+	bus->tx_head = bus->tx_count = 0;
+	bus->rx_head = bus->rx_count = 0;
+	bus->receiving = 0;
+	bus->hung = 0;
+	bus->systest = 0;
+	bus->phase = PHASE_IDLE;
+
+	//the bus busy detector watches the lines, a reset does not make a held SDA go away
+	if ( bus->sda_stuck ) {
+		bus->raw |= I2C_IRQ_BB;
+	}
+	for ( unsigned int i = 0; i < bus->pca_count; i++ ) {
+		bus->pca[i].selected = 0;
+	}
+	stats.soft_resets++;
+}
+
+static unsigned int CTRL_BIT_NS ( const SIM_I2C *bus )
+{
+	unsigned long long clocks = ( bus->scll + 7 ) + ( bus->sclh + 5 );
+	return (unsigned int) ( clocks * ( bus->psc + 1 ) * 1000000000ULL / SIM_FCLK_HZ );
+}
+
+static void CTRL_CLOCK_BYTE ( SIM_I2C *bus, unsigned long long t )
+{
+	bus->phase_start_ns = t;
+	bus->phase_end_ns = t + 9ULL * bus->bit_ns;
+	stats.bus_bytes++;
+	stats.scl_cycles += 9;
+	if ( 1000000000ULL / bus->bit_ns > SIM_PCA_MAX_SCL_HZ ) {
+		stats.overspeed_bytes++;
+	}
+}
+
+static void CTRL_LOAD_NEXT ( SIM_I2C *bus, unsigned long long t )
+{
+	if ( bus->tx_count == 0 ) {
+		bus->phase = PHASE_STALL;
+		bus->phase_start_ns = t;
+		bus->raw |= I2C_IRQ_XUDF;
+		return;
+	}
+	bus->shift = bus->txfifo[bus->tx_head];
+	bus->tx_head = ( bus->tx_head + 1 ) % I2C_FIFO_DEPTH;
+	bus->tx_count--;
+	bus->phase = PHASE_DATA;
+	CTRL_CLOCK_BYTE ( bus, t );
+}
+
+//master receiver: clock the next byte in, or hold SCL low while the receive FIFO is full
+static void CTRL_RECEIVE_NEXT ( SIM_I2C *bus, unsigned long long t )
+{
+	if ( bus->rx_count == I2C_FIFO_DEPTH ) {
+		bus->phase = PHASE_STALL;
+		bus->phase_start_ns = t;
+		return;
+	}
+	bus->phase = PHASE_DATA;
+	CTRL_CLOCK_BYTE ( bus, t );
+}
+
+static void CTRL_FINISH ( SIM_I2C *bus, unsigned long long t )
+{
+	if ( bus->con & I2C_CON_STP ) {
+		bus->phase = PHASE_STOP;
+		bus->phase_end_ns = t + bus->bit_ns;
+		stats.scl_cycles++;
+	}
+	else {
+		bus->phase = PHASE_HOLD;
+		bus->raw |= I2C_IRQ_ARDY;
+	}
+}
+
+static void CTRL_BEGIN ( SIM_I2C *bus, unsigned long long t )
+{
+	int repeated = ( bus->phase == PHASE_HOLD );
+
+	if ( !repeated ) {
+		//respect the bus free time after the previous STOP
+		if ( t < bus->free_since_ns + bus->bit_ns ) {
+			t = bus->free_since_ns + bus->bit_ns;
+		}
+		bus->busy_since_ns = t;
+		stats.transactions++;
+		for ( unsigned int i = 0; i < bus->pca_count; i++ ) {
+			bus->pca[i].selected = 0;
+		}
+	}
+	bus->bit_ns = CTRL_BIT_NS ( bus );
+	bus->cnt_total = bus->cnt ? bus->cnt : 65536;
+	bus->remaining = bus->cnt_total;
+	bus->loaded = bus->tx_count;
+	bus->receiving = !( bus->con & I2C_CON_TRX );
+	bus->raw |= I2C_IRQ_BB;
+	bus->raw &= ~I2C_IRQ_BF;
+	bus->phase = PHASE_START;
+	bus->phase_end_ns = t + bus->bit_ns;
+	stats.starts++;
+	stats.scl_cycles++;
+
+	//a hung state machine takes the START and never gets any further
+	if ( bus->hung ) {
+		bus->phase = PHASE_STALL;
+		bus->phase_start_ns = t;
+	}
+}
+
+static int CTRL_DMA_MODE ( const SIM_I2C *bus )
+{
+	return ( bus->buf & I2C_BUF_XDMA_EN ) && bus->dmatx;
+}
+
+//the transmit DMA request: the FIFO has room for a full threshold and the transfer still needs one
+static int CTRL_DMA_REQUEST ( const SIM_I2C *bus )
+{
+	unsigned int threshold, to_load, space;
+
+	if ( !CTRL_DMA_MODE ( bus ) || bus->phase < PHASE_START || bus->phase > PHASE_STALL || !( bus->con & I2C_CON_TRX ) ) {
+		return 0;
+	}
+	threshold = ( bus->buf & I2C_BUF_TXTRSH_MASK ) + 1;
+	to_load = bus->cnt_total > bus->loaded ? bus->cnt_total - bus->loaded : 0;
+	space = I2C_FIFO_DEPTH - bus->tx_count;
+	return to_load >= threshold && space >= threshold;
+}
+
+//raise XRDY / XDR while the FIFO can take the next chunk of the transfer, in DMA mode the EDMA is asked instead;
+//a receiver raises RRDY with a threshold in the receive FIFO and RDR for the shorter tail once the transfer is done
+static void CTRL_UPDATE_REQUESTS ( SIM_I2C *bus )
+{
+	unsigned int threshold, to_load, space;
+
+	if ( bus->receiving && bus->rx_count > 0 ) {
+		threshold = ( ( bus->buf & I2C_BUF_RXTRSH_MASK ) >> I2C_BUF_RXTRSH_SHIFT ) + 1;
+		if ( bus->rx_count >= threshold ) {
+			bus->raw |= I2C_IRQ_RRDY;
+		}
+		else if ( bus->remaining == 0 ) {
+			bus->raw |= I2C_IRQ_RDR;
+		}
+	}
+
+	if ( bus->phase < PHASE_START || bus->phase > PHASE_STALL || !( bus->con & I2C_CON_TRX ) || CTRL_DMA_MODE ( bus ) ) {
+		return;
+	}
+	threshold = ( bus->buf & I2C_BUF_TXTRSH_MASK ) + 1;
+	to_load = bus->cnt_total > bus->loaded ? bus->cnt_total - bus->loaded : 0;
+	space = I2C_FIFO_DEPTH - bus->tx_count;
+	if ( to_load >= threshold && space >= threshold ) {
+		bus->raw |= I2C_IRQ_XRDY;
+	}
+	else if ( to_load > 0 && to_load < threshold && space >= to_load ) {
+		bus->raw |= I2C_IRQ_XDR;
+	}
+}
+
+static void CTRL_ADVANCE ( SIM_I2C *bus, unsigned long long to_ns )
+{
+	while ( ( bus->phase == PHASE_START || bus->phase == PHASE_ADDRESS || bus->phase == PHASE_DATA
+	          || bus->phase == PHASE_STOP ) && bus->phase_end_ns <= to_ns ) {
+
+		unsigned long long t = bus->phase_end_ns;
+
+		switch ( bus->phase ) {
+
+		case PHASE_START:
+			bus->con &= ~I2C_CON_STT;
+			for ( unsigned int i = 0; i < bus->pca_count; i++ ) {
+				bus->pca[i].selected = 0;
+			}
+			bus->phase = PHASE_ADDRESS;
+			CTRL_CLOCK_BYTE ( bus, t );
+			break;
+
+		case PHASE_ADDRESS: {
+			int acked = 0;
+
+			//another master wins the address byte: the controller drops out of master mode and the bus stays
+			//busy until the other transfer has its STOP, about two bytes later
+			if ( bus->inject_al ) {
+				bus->inject_al--;
+				stats.arbitration_lost++;
+				bus->raw |= I2C_IRQ_AL;
+				bus->con &= ~I2C_CON_MST;
+				bus->phase = PHASE_STOP;
+				bus->phase_end_ns = t + 18ULL * bus->bit_ns;
+				break;
+			}
+
+			for ( unsigned int i = 0; i < bus->pca_count && !bus->inject_nacks; i++ ) {
+				if ( PCA_MATCH ( &bus->pca[i], bus->sa & 0x7F ) ) {
+					bus->pca[i].selected = 1;
+					bus->pca[i].general_call = ( bus->sa & 0x7F ) == PCA9685_GENERAL_CALL_ADDRESS;
+					PCA_START ( &bus->pca[i] );
+					acked = 1;
+				}
+			}
+			if ( bus->inject_nacks ) {
+				bus->inject_nacks--;
+			}
+			if ( !acked ) {
+				stats.nacks++;
+				bus->raw |= I2C_IRQ_NACK;
+				CTRL_FINISH ( bus, t );
+			}
+			else if ( bus->receiving ) {
+				CTRL_RECEIVE_NEXT ( bus, t );
+			}
+			else {
+				CTRL_LOAD_NEXT ( bus, t );
+			}
+			break;
+		}
+
+		case PHASE_DATA:
+			if ( bus->receiving ) {
+				//selected slaves drive SDA together, the open drain line gives the AND of their bytes
+				unsigned char value = 0xFF;
+
+				for ( unsigned int i = 0; i < bus->pca_count; i++ ) {
+					if ( bus->pca[i].selected ) {
+						value &= PCA_READ_BYTE ( &bus->pca[i] );
+					}
+				}
+				bus->rxfifo[( bus->rx_head + bus->rx_count ) % I2C_FIFO_DEPTH] = value;
+				bus->rx_count++;
+			}
+			else {
+				for ( unsigned int i = 0; i < bus->pca_count; i++ ) {
+					if ( bus->pca[i].selected ) {
+						PCA_WRITE_BYTE ( &bus->pca[i], bus->shift, t );
+					}
+				}
+			}
+			bus->remaining--;
+			if ( bus->remaining == 0 ) {
+				CTRL_FINISH ( bus, t );
+			}
+			else if ( bus->receiving ) {
+				CTRL_RECEIVE_NEXT ( bus, t );
+			}
+			else {
+				CTRL_LOAD_NEXT ( bus, t );
+			}
+			break;
+
+		case PHASE_STOP:
+			for ( unsigned int i = 0; i < bus->pca_count; i++ ) {
+				if ( bus->pca[i].selected ) {
+					PCA_STOP ( &bus->pca[i], t );
+				}
+			}
+			bus->con &= ~( I2C_CON_STP | I2C_CON_STT );
+			bus->raw &= ~I2C_IRQ_BB;
+			bus->raw |= I2C_IRQ_ARDY | I2C_IRQ_BF;
+			bus->phase = PHASE_IDLE;
+			bus->free_since_ns = t;
+			stats.stops++;
+			stats.bus_busy_ns += t - bus->busy_since_ns;
+			break;
+		}
+	}
+
+	if ( bus->reset_pending && ( bus->con & I2C_CON_EN ) && bus->rdone_ns <= to_ns ) {
+		bus->reset_pending = 0;
+		bus->syss = I2C_SYSS_RDONE;
+	}
+
+	CTRL_UPDATE_REQUESTS ( bus );
+}
+
+static void CTRL_PUSH ( SIM_I2C *bus, unsigned char value )
+{
+	if ( bus->tx_count == I2C_FIFO_DEPTH ) {
+		return;
+	}
+	bus->txfifo[( bus->tx_head + bus->tx_count ) % I2C_FIFO_DEPTH] = value;
+	bus->tx_count++;
+	if ( bus->phase >= PHASE_START && bus->phase <= PHASE_STALL ) {
+		bus->loaded++;
+	}
+	if ( bus->phase == PHASE_STALL && !bus->receiving && !bus->hung ) {
+		stats.stretch_ns += stats.now_ns - bus->phase_start_ns;
+		CTRL_LOAD_NEXT ( bus, stats.now_ns );
+	}
+}
+
+//line levels: SCL and SDA are released (high) unless the CPU drives them low in IO mode or a slave holds SDA
+static unsigned int CTRL_SCL ( const SIM_I2C *bus )
+{
+	return !( ( bus->systest & I2C_SYSTEST_ST_EN ) && ( bus->systest & I2C_SYSTEST_TMODE_MASK ) == I2C_SYSTEST_TMODE_IO
+	          && !( bus->systest & I2C_SYSTEST_SCL_O ) );
+}
+
+static unsigned int CTRL_SDA ( const SIM_I2C *bus )
+{
+	if ( bus->sda_stuck ) {
+		return 0;
+	}
+	return !( ( bus->systest & I2C_SYSTEST_ST_EN ) && ( bus->systest & I2C_SYSTEST_TMODE_MASK ) == I2C_SYSTEST_TMODE_IO
+	          && !( bus->systest & I2C_SYSTEST_SDA_O ) );
+}
+
+static unsigned int CTRL_SYSTEST_READ ( const SIM_I2C *bus )
+{
+	unsigned int value = bus->systest & ~( I2C_SYSTEST_SCL_I | I2C_SYSTEST_SDA_I | I2C_SYSTEST_SCL_I_FUNC | I2C_SYSTEST_SDA_I_FUNC );
+
+	if ( CTRL_SCL ( bus ) ) {
+		value |= I2C_SYSTEST_SCL_I | I2C_SYSTEST_SCL_I_FUNC;
+	}
+	if ( CTRL_SDA ( bus ) ) {
+		value |= I2C_SYSTEST_SDA_I | I2C_SYSTEST_SDA_I_FUNC;
+	}
+	return value;
+}
+
+//SCL/SDA IO mode: a slave holding SDA low counts the SCL clocks, SDA rising while SCL is high is a STOP that frees
+//the bus, unless the controller itself is in the middle of a transfer
+static void CTRL_SYSTEST_WRITE ( SIM_I2C *bus, unsigned int value )
+{
+	unsigned int scl = CTRL_SCL ( bus ), sda = CTRL_SDA ( bus );
+
+	bus->systest = value & ( I2C_SYSTEST_ST_EN | I2C_SYSTEST_TMODE_MASK | I2C_SYSTEST_SCL_O | I2C_SYSTEST_SDA_O );
+	if ( !scl && CTRL_SCL ( bus ) ) {
+		stats.scl_cycles++;
+		if ( bus->sda_stuck ) {
+			bus->sda_stuck--;
+		}
+	}
+	if ( scl && CTRL_SCL ( bus ) && !sda && CTRL_SDA ( bus ) && bus->phase == PHASE_IDLE ) {
+		bus->raw &= ~I2C_IRQ_BB;
+		bus->raw |= I2C_IRQ_BF;
+		bus->free_since_ns = stats.now_ns;
+		stats.stops++;
+	}
+}
+
+//take the oldest received byte, a receiver held on a full FIFO goes on
+static unsigned int CTRL_POP ( SIM_I2C *bus )
+{
+	unsigned char value;
+
+	if ( bus->rx_count == 0 ) {
+		return 0;
+	}
+	value = bus->rxfifo[bus->rx_head];
+	bus->rx_head = ( bus->rx_head + 1 ) % I2C_FIFO_DEPTH;
+	bus->rx_count--;
+	if ( bus->phase == PHASE_STALL && bus->receiving ) {
+		stats.stretch_ns += stats.now_ns - bus->phase_start_ns;
+		CTRL_RECEIVE_NEXT ( bus, stats.now_ns );
+	}
+	return value;
+}
+
+static unsigned int CTRL_READ ( SIM_I2C *bus, unsigned int offset )
+{
+	unsigned int to_load;
+
+	switch ( offset ) {
+	case SYSC: return 0;
+	case IRQSTATUS_RAW: return bus->raw;
+	case IRQSTATUS: return bus->raw & bus->enable;
+	case IRQENABLE_SET:
+	case IRQENABLE_CLR: return bus->enable;
+	case DMATXENABLE_SET:
+	case DMATXENABLE_CLR: return bus->dmatx;
+	case SYSS: return bus->syss;
+	case BUF: return bus->buf;
+	case CNT: return bus->phase == PHASE_IDLE ? bus->cnt : bus->remaining;
+	case DATA: return CTRL_POP ( bus );
+	case CON: return bus->con;
+	case OA: return bus->oa;
+	case SA: return bus->sa;
+	case PSC: return bus->psc;
+	case SCLL: return bus->scll;
+	case SCLH: return bus->sclh;
+	case SYSTEST: return CTRL_SYSTEST_READ ( bus );
+	case BUFSTAT:
+		to_load = bus->cnt_total > bus->loaded ? bus->cnt_total - bus->loaded : 0;
+		return ( to_load & 0x3F ) | ( ( bus->rx_count & 0x3F ) << I2C_BUFSTAT_RXSTAT_SHIFT ) | ( 2 << 14 );
+	default: return 0;
+	}
+}
+
+static void CTRL_WRITE ( SIM_I2C *bus, unsigned int offset, unsigned int value )
+{
+	unsigned int was_enabled;
+
+	switch ( offset ) {
+	case SYSC:
+		if ( value & I2C_SYSC_SRST ) {
+			CTRL_SOFT_RESET ( bus );
+		}
+		break;
+	case IRQSTATUS_RAW: bus->raw |= value; break;
+	case IRQSTATUS: bus->raw &= ~( value & ~I2C_IRQ_BB ); break;
+	case IRQENABLE_SET: bus->enable |= value; break;
+	case IRQENABLE_CLR: bus->enable &= ~value; break;
+	case DMATXENABLE_SET: bus->dmatx |= value & 1; break;
+	case DMATXENABLE_CLR: bus->dmatx &= ~value & 1; break;
+	case BUF:
+		if ( value & I2C_BUF_TXFIFO_CLR ) {
+			bus->tx_head = bus->tx_count = 0;
+		}
+		if ( value & I2C_BUF_RXFIFO_CLR ) {
+			bus->rx_head = bus->rx_count = 0;
+		}
+		bus->buf = value & ~( I2C_BUF_TXFIFO_CLR | I2C_BUF_RXFIFO_CLR );
+		break;
+	case CNT: bus->cnt = value & 0xFFFF; break;
+	case DATA:
+		if ( bus->con & I2C_CON_EN ) {
+			CTRL_PUSH ( bus, (unsigned char) value );
+		}
+		break;
+	case CON:
+		was_enabled = bus->con & I2C_CON_EN;
+		bus->con = value;
+		if ( !was_enabled && ( value & I2C_CON_EN ) && bus->reset_pending ) {
+			bus->rdone_ns = stats.now_ns + SIM_RESET_NS;
+		}
+		//with SDA held low the START can not be generated, the controller waits for the bus
+		if ( ( value & ( I2C_CON_EN | I2C_CON_MST | I2C_CON_STT ) ) == ( I2C_CON_EN | I2C_CON_MST | I2C_CON_STT )
+		     && ( bus->phase == PHASE_IDLE || bus->phase == PHASE_HOLD ) && !bus->sda_stuck ) {
+			CTRL_BEGIN ( bus, stats.now_ns );
+		}
+		else if ( ( value & I2C_CON_STP ) && bus->phase == PHASE_HOLD ) {
+			bus->phase = PHASE_STOP;
+			bus->phase_end_ns = stats.now_ns + bus->bit_ns;
+			stats.scl_cycles++;
+		}
+		break;
+	case OA: bus->oa = value; break;
+	case SA: bus->sa = value & 0x3FF; break;
+	case PSC: bus->psc = value & 0xFF; break;
+	case SCLL: bus->scll = value & 0xFF; break;
+	case SCLH: bus->sclh = value & 0xFF; break;
+	case SYSTEST: CTRL_SYSTEST_WRITE ( bus, value ); break;
+	default: break;
+	}
+	CTRL_UPDATE_REQUESTS ( bus );
+}
+
+/**********************************************************************************************************************
+*   Plain memory for the modules that are not modelled                                                                *
+**********************************************************************************************************************/
+
+static void SIM_TICK ( unsigned long long ns );
+static void TIMER_CLOCK ( SIM_TIMER *timer, int on );
+
+static SIM_WORD *MEMORY_FIND ( unsigned int address, int create )
+{
+	for ( unsigned int i = 0; i < memory_used; i++ ) {
+		if ( memory[i].address == address ) {
+			return &memory[i];
+		}
+	}
+	if ( !create || memory_used == SIM_MEMORY_WORDS ) {
+		return NULL;
+	}
+	memory[memory_used].address = address;
+	memory[memory_used].value = 0;
+	return &memory[memory_used++];
+}
+
+/**********************************************************************************************************************
+*   Module clocks                                                                                                     *
+**********************************************************************************************************************/
+
+//CLKCTRL offset from CM_PER_ADDRESS and the registers of the module it gates
+static const struct {
+	unsigned int clkctrl, base, size;
+} CLOCK_GATES [ SIM_CLOCKS ] = {
+	{ CM_WKUP_I2C0_CLKCTRL, I2C0_BASE_ADDRESS, 0x1000 },
+	{ CM_PER_I2C1_CLKCTRL, I2C1_BASE_ADDRESS, 0x1000 },
+	{ I2C2_OFFSET, I2C2_BASE_ADDRESS, 0x1000 },
+	{ CM_PER_GPIO1_CLKCTRL, GPIO1_BASE_ADDRESS, 0x1000 },
+	{ CM_PER_TIMER2_CLKCTRL, TIMER2_BASE_ADDRESS, 0x1000 },
+	{ CM_PER_TPCC_CLKCTRL, EDMA_BASE_ADDRESS, 0x8000 },
+};
+
+static int CLOCK_AT ( unsigned int address )
+{
+	for ( int i = 0; i < SIM_CLOCKS; i++ ) {
+		if ( address == CM_PER_ADDRESS + CLOCK_GATES[i].clkctrl ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+//IDLEST: 3 while MODULEMODE is off, 1 (transition) until the clock is up, then 0
+static unsigned int CLOCK_READ ( int clock, unsigned int value )
+{
+	if ( ( value & 0x3 ) != CM_PER_MODULEMODE_ENABLE ) {
+		return value | CM_PER_IDLEST_MASK;
+	}
+	return stats.now_ns < clock_ready_ns[clock] ? value | ( 1 << 16 ) : value;
+}
+
+static void CLOCK_WRITE ( int clock, SIM_WORD *word, unsigned int value )
+{
+	value &= ~CM_PER_IDLEST_MASK;
+	if ( ( value & 0x3 ) != CM_PER_MODULEMODE_ENABLE ) {
+		clock_ready_ns[clock] = SIM_TIMER_NEVER;
+	}
+	else if ( ( word->value & 0x3 ) != CM_PER_MODULEMODE_ENABLE ) {
+		clock_ready_ns[clock] = stats.now_ns + SIM_CLOCK_NS;
+	}
+	word->value = value;
+
+	//the timer counts on its functional clock, it stands still while that is off
+	if ( CLOCK_GATES[clock].base == TIMER2_BASE_ADDRESS ) {
+		TIMER_CLOCK ( &timer2, ( value & 0x3 ) == CM_PER_MODULEMODE_ENABLE );
+	}
+}
+
+//an access to a module whose clock is not functional yet: while it is starting the interconnect holds the access
+//until it is, with the clock off the hardware would abort it and the model only counts it
+static void CLOCK_CHECK ( unsigned int address )
+{
+	for ( int i = 0; i < SIM_CLOCKS; i++ ) {
+		if ( address - CLOCK_GATES[i].base < CLOCK_GATES[i].size ) {
+			if ( stats.now_ns < clock_ready_ns[i] ) {
+				stats.unclocked++;
+				if ( clock_ready_ns[i] != SIM_TIMER_NEVER ) {
+					SIM_TICK ( clock_ready_ns[i] - stats.now_ns );
+				}
+			}
+			return;
+		}
+	}
+}
+
+/**********************************************************************************************************************
+*   Address decoding                                                                                                  *
+**********************************************************************************************************************/
+
+//controller at an address, NULL when the address is not in an I2C module
+static SIM_I2C *I2C_AT ( unsigned int address )
+{
+	for ( unsigned int i = 0; i < SIM_I2C_BUSES; i++ ) {
+		if ( address >= i2c[i].base && address < i2c[i].base + 0x1000 ) {
+			return &i2c[i];
+		}
+	}
+	return NULL;
+}
+
+static int IS_INTC ( unsigned int address )
+{
+	return address >= INTC_BASE_ADDRESS && address < INTC_BASE_ADDRESS + 0x1000;
+}
+
+static int IS_EDMA ( unsigned int address )
+{
+	return address >= EDMA_BASE_ADDRESS && address < EDMA_BASE_ADDRESS + 0x8000;
+}
+
+static int IS_TIMER2 ( unsigned int address )
+{
+	return address >= TIMER2_BASE_ADDRESS && address < TIMER2_BASE_ADDRESS + 0x1000;
+}
+
+static int IS_GPIO1 ( unsigned int address )
+{
+	return address >= GPIO1_BASE_ADDRESS && address < GPIO1_BASE_ADDRESS + 0x1000;
+}
+
+static int IS_POLL ( unsigned int offset )
+{
+	return offset == IRQSTATUS_RAW || offset == IRQSTATUS || offset == SYSS || offset == BUFSTAT;
+}
+
+/**********************************************************************************************************************
+*   EDMA3 channel controller                                                                                          *
+**********************************************************************************************************************/
+
+//byte at a bus address, from a mapped host buffer or plain memory
+static unsigned char DMA_LOAD ( unsigned int address )
+{
+	SIM_WORD *word;
+
+	for ( unsigned int i = 0; i < dma_regions_used; i++ ) {
+		if ( address >= dma_regions[i].bus && address - dma_regions[i].bus < dma_regions[i].length ) {
+			return dma_regions[i].host[address - dma_regions[i].bus];
+		}
+	}
+	word = MEMORY_FIND ( address & ~3u, 0 );
+	return word ? (unsigned char) ( word->value >> ( 8 * ( address & 3 ) ) ) : 0;
+}
+
+static void DMA_STORE ( unsigned int address, unsigned char value )
+{
+	SIM_WORD *word;
+	SIM_I2C *bus;
+
+	if ( ( bus = I2C_AT ( address ) ) != NULL ) {
+		CTRL_WRITE ( bus, address - bus->base, value );
+	}
+	else if ( ( word = MEMORY_FIND ( address, 1 ) ) != NULL ) {
+		word->value = value;
+	}
+}
+
+//channel the crossbar routes an event to, -1 when it is not routed
+static int EDMA_CROSSBAR_CHANNEL ( unsigned int event )
+{
+	SIM_WORD *word;
+
+	for ( unsigned int channel = 0; channel < 32; channel++ ) {
+		word = MEMORY_FIND ( CNTRL_MODULE + TPCC_EVT_MUX ( channel ), 0 );
+		if ( word && ( ( word->value >> ( 8 * ( channel % 4 ) ) ) & 0x3F ) == event ) {
+			return (int) channel;
+		}
+	}
+	return -1;
+}
+
+//one event on a channel: run one AB synchronized transfer of its PaRAM set
+static void EDMA_TRANSFER ( unsigned int channel )
+{
+	unsigned int *set = edma.param[( edma.dchmap[channel] >> 5 ) % EDMA_PARAM_SETS];
+	unsigned int opt = set[EDMA_OPT / 4];
+	unsigned int acnt = set[EDMA_A_B_CNT / 4] & 0xFFFF;
+	unsigned int bcnt = set[EDMA_A_B_CNT / 4] >> 16;
+	unsigned int link = set[EDMA_LINK_BCNTRLD / 4] & 0xFFFF;
+	short src_bidx = (short) ( set[EDMA_SRC_DST_BIDX / 4] & 0xFFFF );
+	short dst_bidx = (short) ( set[EDMA_SRC_DST_BIDX / 4] >> 16 );
+	short src_cidx = (short) ( set[EDMA_SRC_DST_CIDX / 4] & 0xFFFF );
+	short dst_cidx = (short) ( set[EDMA_SRC_DST_CIDX / 4] >> 16 );
+
+	if ( acnt == 0 || bcnt == 0 || set[EDMA_CCNT / 4] == 0 ) {
+		edma.emr |= 1u << channel;
+		stats.dma_missed++;
+		return;
+	}
+
+	for ( unsigned int b = 0; b < bcnt; b++ ) {
+		for ( unsigned int a = 0; a < acnt; a++ ) {
+			DMA_STORE ( set[EDMA_DST / 4] + b * dst_bidx + a, DMA_LOAD ( set[EDMA_SRC / 4] + b * src_bidx + a ) );
+		}
+	}
+	set[EDMA_SRC / 4] += src_cidx;
+	set[EDMA_DST / 4] += dst_cidx;
+	set[EDMA_CCNT / 4]--;
+	stats.dma_events++;
+	stats.dma_bytes += acnt * bcnt;
+
+	if ( set[EDMA_CCNT / 4] == 0 ) {
+		if ( opt & EDMA_OPT_TCINTEN ) {
+			edma.ipr |= 1u << ( ( opt >> 12 ) & 0x3F );
+		}
+		if ( link == EDMA_LINK_NULL ) {
+			memset ( set, 0, 8 * sizeof ( unsigned int ) );
+			set[EDMA_LINK_BCNTRLD / 4] = EDMA_LINK_NULL;
+		}
+		else {
+			memcpy ( set, edma.param[( ( link - EDMA_PARAM ( 0 ) ) / 0x20 ) % EDMA_PARAM_SETS], 8 * sizeof ( unsigned int ) );
+		}
+	}
+}
+
+//latch the I2C2 transmit request and run every enabled event until nothing is pending
+static void EDMA_RUN ( void )
+{
+	int channel;
+	unsigned int pending;
+
+	for ( unsigned int guard = 0; guard < 100000; guard++ ) {
+		if ( CTRL_DMA_REQUEST ( &i2c[2] ) && ( channel = EDMA_CROSSBAR_CHANNEL ( EDMA_XBAR_I2C2_TX ) ) >= 0
+		     && !( edma.emr & ( 1u << channel ) ) ) {
+			edma.er |= 1u << channel;
+		}
+		pending = edma.er & edma.eer;
+		if ( pending == 0 ) {
+			return;
+		}
+		channel = __builtin_ctz ( pending );
+		edma.er &= ~( 1u << channel );
+		EDMA_TRANSFER ( (unsigned int) channel );
+	}
+}
+
+static unsigned int EDMA_READ ( unsigned int offset )
+{
+	if ( offset >= EDMA_PARAM ( 0 ) && offset < EDMA_PARAM ( EDMA_PARAM_SETS ) ) {
+		return edma.param[( offset - EDMA_PARAM ( 0 ) ) / 0x20][( offset % 0x20 ) / 4];
+	}
+	if ( offset >= EDMA_DCHMAP ( 0 ) && offset < EDMA_DCHMAP ( 32 ) ) {
+		return edma.dchmap[( offset - EDMA_DCHMAP ( 0 ) ) / 4];
+	}
+	switch ( offset ) {
+	case EDMA_EMR: return edma.emr;
+	case EDMA_DRAE0: return edma.drae;
+	case EDMA_ER: return edma.er;
+	case EDMA_EER: return edma.eer;
+	case EDMA_IER: return edma.ier;
+	case EDMA_IPR: return edma.ipr;
+	default: return 0;
+	}
+}
+
+static void EDMA_WRITE ( unsigned int offset, unsigned int value )
+{
+	if ( offset >= EDMA_PARAM ( 0 ) && offset < EDMA_PARAM ( EDMA_PARAM_SETS ) ) {
+		edma.param[( offset - EDMA_PARAM ( 0 ) ) / 0x20][( offset % 0x20 ) / 4] = value;
+		return;
+	}
+	if ( offset >= EDMA_DCHMAP ( 0 ) && offset < EDMA_DCHMAP ( 32 ) ) {
+		edma.dchmap[( offset - EDMA_DCHMAP ( 0 ) ) / 4] = value;
+		return;
+	}
+	switch ( offset ) {
+	case EDMA_EMCR: edma.emr &= ~value; break;
+	case EDMA_DRAE0: edma.drae = value; break;
+	case EDMA_ECR: edma.er &= ~value; break;
+	case EDMA_ESR: edma.er |= value; break;
+	case EDMA_EECR: edma.eer &= ~value; break;
+	case EDMA_EESR: edma.eer |= value; break;
+	case EDMA_IECR: edma.ier &= ~value; break;
+	case EDMA_IESR: edma.ier |= value; break;
+	case EDMA_ICR: edma.ipr &= ~value; break;
+	default: break;
+	}
+}
+
+unsigned int SIM_DMA_MAP ( const void *buffer, unsigned int length )
+{
+	const unsigned char *host = buffer;
+	SIM_DMA_REGION *region;
+
+	for ( unsigned int i = 0; i < dma_regions_used; i++ ) {
+		region = &dma_regions[i];
+		if ( host >= region->host && host + length <= region->host + region->length ) {
+			return region->bus + (unsigned int) ( host - region->host );
+		}
+	}
+
+	//a new alias, the oldest one is reused when the table is full
+	region = &dma_regions[dma_regions_used < SIM_DMA_REGIONS ? dma_regions_used++ : dma_next_bus / 0x1000 % SIM_DMA_REGIONS];
+	region->host = host;
+	region->length = length;
+	region->bus = SIM_DMA_BASE + dma_next_bus;
+	dma_next_bus += 0x1000;
+	return region->bus;
+}
+
+/**********************************************************************************************************************
+*   DMTimer2                                                                                                          *
+**********************************************************************************************************************/
+
+//ticks of the functional clock between origin_ns and t
+static unsigned long long TIMER_TICKS ( const SIM_TIMER *timer, unsigned long long t )
+{
+	unsigned long long ns;
+
+	if ( !( timer->tclr & TIMER_TCLR_ST ) || timer->stopped || t < timer->origin_ns ) {
+		return 0;
+	}
+	ns = t - timer->origin_ns;
+	return ns / 1000000000ULL * timer->hz + ns % 1000000000ULL * timer->hz / 1000000000ULL;
+}
+
+//time of a tick after origin_ns, rounded up to the next ns
+static unsigned long long TIMER_TICK_NS ( const SIM_TIMER *timer, unsigned long long tick )
+{
+	return timer->origin_ns + tick / timer->hz * 1000000000ULL + ( tick % timer->hz * 1000000000ULL + timer->hz - 1 ) / timer->hz;
+}
+
+//TCRR after a number of ticks, wrapping to TLDR in auto-reload mode
+static unsigned int TIMER_COUNT ( const SIM_TIMER *timer, unsigned long long ticks )
+{
+	unsigned long long position = timer->origin_count + ticks;
+
+	if ( position < SIM_TIMER_WRAP ) {
+		return (unsigned int) position;
+	}
+	if ( !( timer->tclr & TIMER_TCLR_AR ) ) {
+		return 0;
+	}
+	return timer->tldr + (unsigned int) ( ( position - SIM_TIMER_WRAP ) % ( SIM_TIMER_WRAP - timer->tldr ) );
+}
+
+//next overflow and match from the current count
+static void TIMER_SCHEDULE ( SIM_TIMER *timer )
+{
+	unsigned long long now = TIMER_TICKS ( timer, stats.now_ns );
+	unsigned int count = TIMER_COUNT ( timer, now );
+
+	timer->next_overflow = timer->next_match = SIM_TIMER_NEVER;
+	if ( !( timer->tclr & TIMER_TCLR_ST ) || timer->stopped ) {
+		return;
+	}
+	timer->next_overflow = now + ( SIM_TIMER_WRAP - count );
+	if ( timer->tclr & TIMER_TCLR_CE ) {
+		if ( timer->tmar > count ) {
+			timer->next_match = now + ( timer->tmar - count );
+		}
+		else if ( ( timer->tclr & TIMER_TCLR_AR ) && timer->tmar >= timer->tldr ) {
+			timer->next_match = timer->next_overflow + ( timer->tmar - timer->tldr );
+		}
+	}
+}
+
+//restart the tick count from the current time, before anything that changes how the counter runs
+static void TIMER_REBASE ( SIM_TIMER *timer )
+{
+	unsigned long long ticks = TIMER_TICKS ( timer, stats.now_ns );
+
+	if ( timer->tclr & TIMER_TCLR_ST ) {
+		timer->origin_count = TIMER_COUNT ( timer, ticks );
+		timer->origin_ns = TIMER_TICK_NS ( timer, ticks );
+	}
+}
+
+static void TIMER_ADVANCE ( SIM_TIMER *timer, unsigned long long to_ns )
+{
+	unsigned long long ticks = TIMER_TICKS ( timer, to_ns );
+	unsigned long long period = SIM_TIMER_WRAP - timer->tldr;
+
+	while ( timer->next_match <= ticks ) {
+		timer->raw |= TIMER_IRQ_MAT;
+		timer->next_match = ( timer->tclr & TIMER_TCLR_AR ) ? timer->next_match + period : SIM_TIMER_NEVER;
+	}
+	while ( timer->next_overflow <= ticks ) {
+		timer->raw |= TIMER_IRQ_OVF;
+		if ( timer->tclr & TIMER_TCLR_AR ) {
+			timer->next_overflow += period;
+		}
+		else {
+			//one shot: the timer stops at the overflow
+			timer->tclr &= ~TIMER_TCLR_ST;
+			timer->origin_count = 0;
+			timer->next_overflow = timer->next_match = SIM_TIMER_NEVER;
+		}
+	}
+}
+
+//module clock off: the count so far is kept and nothing more happens; back on: it counts on from there
+static void TIMER_CLOCK ( SIM_TIMER *timer, int on )
+{
+	if ( !on && !timer->stopped ) {
+		TIMER_ADVANCE ( timer, stats.now_ns );
+		TIMER_REBASE ( timer );
+		timer->stopped = 1;
+	}
+	else if ( on && timer->stopped ) {
+		timer->stopped = 0;
+		timer->origin_ns = stats.now_ns;
+	}
+	TIMER_SCHEDULE ( timer );
+}
+
+//earliest enabled timer event, 0 when none
+static unsigned long long TIMER_NEXT_EVENT_NS ( const SIM_TIMER *timer )
+{
+	unsigned long long next = SIM_TIMER_NEVER;
+
+	if ( ( timer->enable & TIMER_IRQ_MAT ) && timer->next_match < next ) {
+		next = timer->next_match;
+	}
+	if ( ( timer->enable & TIMER_IRQ_OVF ) && timer->next_overflow < next ) {
+		next = timer->next_overflow;
+	}
+	return next == SIM_TIMER_NEVER ? 0 : TIMER_TICK_NS ( timer, next );
+}
+
+static void TIMER_RESET ( SIM_TIMER *timer )
+{
+	memset ( timer, 0, sizeof ( *timer ) );
+	timer->hz = 24000000;
+	timer->next_overflow = timer->next_match = SIM_TIMER_NEVER;
+}
+
+static unsigned int TIMER_READ ( SIM_TIMER *timer, unsigned int offset )
+{
+	switch ( offset ) {
+	case IRQSTATUS_RAW_TIMER2: return timer->raw;
+	case IRQSTATUS_TIMER2: return timer->raw & timer->enable;
+	case IRQENABLE_SET_TIMER2:
+	case IRQENABLE_CLR_TIMER2: return timer->enable;
+	case TCLR: return timer->tclr;
+	case TCRR: return TIMER_COUNT ( timer, TIMER_TICKS ( timer, stats.now_ns ) );
+	case TLDR: return timer->tldr;
+	case TMAR: return timer->tmar;
+	default: return 0;                  //TIOCP_CFG reset done, TWPS nothing pending: writes land at once
+	}
+}
+
+static void TIMER_WRITE ( SIM_TIMER *timer, unsigned int offset, unsigned int value )
+{
+	SIM_WORD *clksel;
+
+	switch ( offset ) {
+	case TIOCP_CFG:
+		if ( value & TIMER_TIOCP_SOFTRESET ) {
+			TIMER_RESET ( timer );
+		}
+		return;
+	case IRQSTATUS_RAW_TIMER2: timer->raw |= value & 0x7; return;
+	case IRQSTATUS_TIMER2: timer->raw &= ~value; return;
+	case IRQENABLE_SET_TIMER2: timer->enable |= value & 0x7; return;
+	case IRQENABLE_CLR_TIMER2: timer->enable &= ~value; return;
+	case TCLR:
+		TIMER_REBASE ( timer );
+		if ( ( value & TIMER_TCLR_ST ) && !( timer->tclr & TIMER_TCLR_ST ) ) {
+			//the clock mux is latched when the timer starts
+			clksel = MEMORY_FIND ( CM_PER_ADDRESS + PRCMCLKSEL_TIMER2, 0 );
+			timer->hz = clksel && clksel->value == CLKSEL_TIMER_32KHZ ? 32768 : 24000000;
+			timer->origin_ns = stats.now_ns;
+		}
+		timer->tclr = value;
+		break;
+	case TCRR:
+		timer->origin_count = value;
+		timer->origin_ns = stats.now_ns;
+		break;
+	case TLDR:
+		TIMER_REBASE ( timer );
+		timer->tldr = value;
+		break;
+	case TTGR:
+		timer->origin_count = timer->tldr;
+		timer->origin_ns = stats.now_ns;
+		break;
+	case TMAR:
+		timer->tmar = value;
+		break;
+	default:
+		return;
+	}
+	TIMER_SCHEDULE ( timer );
+}
+
+/**********************************************************************************************************************
+*   GPIO1                                                                                                             *
+**********************************************************************************************************************/
+
+static unsigned int GPIO_READ ( SIM_GPIO *gpio, unsigned int offset )
+{
+	stats.gpio_reads++;
+	switch ( offset ) {
+	case OUTPUT_ENABLE:
+		return gpio->oe;
+	case DATAOUT:
+	case SETDATAOUT:
+	case CLEARDATAOUT:
+		return gpio->dataout;
+	default:
+		return 0;
+	}
+}
+
+//SETDATAOUT and CLEARDATAOUT change only the pins written as 1, the pins that are outputs follow DATAOUT
+static void GPIO_WRITE ( SIM_GPIO *gpio, unsigned int offset, unsigned int value )
+{
+	unsigned int before = gpio->dataout & ~gpio->oe;
+
+	stats.gpio_writes++;
+	switch ( offset ) {
+	case OUTPUT_ENABLE:
+		gpio->oe = value;
+		break;
+	case DATAOUT:
+		gpio->dataout = value;
+		break;
+	case SETDATAOUT:
+		gpio->dataout |= value;
+		break;
+	case CLEARDATAOUT:
+		gpio->dataout &= ~value;
+		break;
+	}
+	stats.gpio_edges += (unsigned int) __builtin_popcount ( before ^ ( gpio->dataout & ~gpio->oe ) );
+}
+
+/**********************************************************************************************************************
+*   Register backend                                                                                                  *
+**********************************************************************************************************************/
+
+//move simulated time forward, letting the modelled modules catch up
+static void SIM_ADVANCE ( unsigned long long to_ns )
+{
+	stats.now_ns = to_ns;
+	if ( time_limit_ns && stats.now_ns > time_limit_ns ) {
+		fprintf ( stderr, "sim: time limit of %llu ns exceeded, the driver is stuck\n", time_limit_ns );
+		exit ( 2 );
+	}
+	for ( unsigned int i = 0; i < SIM_I2C_BUSES; i++ ) {
+		CTRL_ADVANCE ( &i2c[i], stats.now_ns );
+	}
+	TIMER_ADVANCE ( &timer2, stats.now_ns );
+	EDMA_RUN ( );
+}
+
+//time the CPU spends executing
+static void SIM_TICK ( unsigned long long ns )
+{
+	if ( !initialized ) {
+		SIM_RESET ( );
+	}
+	stats.cpu_ns += ns;
+	SIM_ADVANCE ( stats.now_ns + ns );
+}
+
+//earliest time a modelled module changes state by itself, 0 when nothing is in flight
+static unsigned long long SIM_NEXT_EVENT_NS ( void )
+{
+	unsigned long long next = 0;
+	unsigned long long timer;
+
+	for ( unsigned int i = 0; i < SIM_I2C_BUSES; i++ ) {
+		SIM_I2C *bus = &i2c[i];
+
+		if ( ( bus->phase == PHASE_START || bus->phase == PHASE_ADDRESS || bus->phase == PHASE_DATA || bus->phase == PHASE_STOP )
+		     && ( next == 0 || bus->phase_end_ns < next ) ) {
+			next = bus->phase_end_ns;
+		}
+		if ( bus->reset_pending && ( bus->con & I2C_CON_EN ) && ( next == 0 || bus->rdone_ns < next ) ) {
+			next = bus->rdone_ns;
+		}
+	}
+	timer = TIMER_NEXT_EVENT_NS ( &timer2 );
+	if ( timer && ( next == 0 || timer < next ) ) {
+		next = timer;
+	}
+	return next;
+}
+
+/**********************************************************************************************************************
+*   Interrupt controller                                                                                              *
+**********************************************************************************************************************/
+
+static int INTC_LINE_ASSERTED ( unsigned int line )
+{
+	switch ( line ) {
+	case I2C0_INT: return ( i2c[0].raw & i2c[0].enable ) != 0;
+	case I2C1_INT: return ( i2c[1].raw & i2c[1].enable ) != 0;
+	case I2C2_INT: return ( i2c[2].raw & i2c[2].enable ) != 0;
+	case EDMA_COMPLETION_INT: return ( edma.ipr & edma.ier & edma.drae ) != 0;
+	case TIMER2_INT: return ( timer2.raw & timer2.enable ) != 0;
+	default: return 0;
+	}
+}
+
+//lowest numbered line that is asserted and unmasked, -1 when there is none
+static int INTC_ACTIVE ( void )
+{
+	for ( unsigned int line = 0; line < INTC_LINES; line++ ) {
+		if ( !( intc_mir[line / 32] & ( 1u << ( line % 32 ) ) ) && INTC_LINE_ASSERTED ( line ) ) {
+			return (int) line;
+		}
+	}
+	return -1;
+}
+
+//take the IRQ exception while a line is pending and the CPU has interrupts enabled
+static void SIM_CHECK_IRQ ( void )
+{
+	unsigned int taken = 0;
+
+	while ( irq_enabled && !in_irq && irq_vector && INTC_ACTIVE ( ) >= 0 ) {
+		unsigned long long entry_ns = stats.now_ns;
+
+		in_irq = 1;
+		stats.irqs++;
+		SIM_TICK ( SIM_IRQ_ENTRY_NS );
+		irq_vector ( );
+		stats.irq_ns += stats.now_ns - entry_ns;
+		in_irq = 0;
+
+		if ( ++taken > 10000 ) {
+			fprintf ( stderr, "sim: interrupt line %d is never cleared by its handler\n", INTC_ACTIVE ( ) );
+			exit ( 2 );
+		}
+	}
+}
+
+static unsigned int INTC_READ ( unsigned int offset )
+{
+	int active;
+
+	if ( offset == INTC_SIR_IRQ ) {
+		active = INTC_ACTIVE ( );
+		return active < 0 ? 0x7F : (unsigned int) active;
+	}
+	for ( unsigned int n = 0; n < INTC_LINES / 32; n++ ) {
+		if ( offset == INTC_MIR ( n ) ) {
+			return intc_mir[n];
+		}
+	}
+	return 0;
+}
+
+static void INTC_WRITE ( unsigned int offset, unsigned int value )
+{
+	for ( unsigned int n = 0; n < INTC_LINES / 32; n++ ) {
+		if ( offset == INTC_MIR_CLEAR ( n ) ) {
+			intc_mir[n] &= ~value;
+		}
+		else if ( offset == INTC_MIR_SET ( n ) ) {
+			intc_mir[n] |= value;
+		}
+	}
+}
+
+unsigned int SIM_READ ( unsigned int address )
+{
+	SIM_WORD *word;
+	SIM_I2C *bus;
+	unsigned int value;
+	int clock;
+
+	SIM_TICK ( SIM_ACCESS_NS );
+	stats.reg_reads++;
+	CLOCK_CHECK ( address );
+	if ( ( bus = I2C_AT ( address ) ) != NULL ) {
+		if ( IS_POLL ( address - bus->base ) ) {
+			stats.poll_reads++;
+			stats.poll_ns += SIM_ACCESS_NS;
+		}
+		value = CTRL_READ ( bus, address - bus->base );
+	}
+	else if ( IS_INTC ( address ) ) {
+		value = INTC_READ ( address - INTC_BASE_ADDRESS );
+	}
+	else if ( IS_EDMA ( address ) ) {
+		value = EDMA_READ ( address - EDMA_BASE_ADDRESS );
+	}
+	else if ( IS_TIMER2 ( address ) ) {
+		value = TIMER_READ ( &timer2, address - TIMER2_BASE_ADDRESS );
+	}
+	else if ( IS_GPIO1 ( address ) ) {
+		value = GPIO_READ ( &gpio1, address - GPIO1_BASE_ADDRESS );
+	}
+	else {
+		word = MEMORY_FIND ( address, 0 );
+		value = word ? word->value : 0;
+		if ( ( clock = CLOCK_AT ( address ) ) >= 0 ) {
+			value = CLOCK_READ ( clock, value );
+		}
+	}
+
+	//an interrupt can come in right after the load
+	SIM_CHECK_IRQ ( );
+	return value;
+}
+
+void SIM_WRITE ( unsigned int address, unsigned int value )
+{
+	SIM_WORD *word;
+	SIM_I2C *bus;
+	int clock;
+
+	SIM_TICK ( SIM_ACCESS_NS );
+	stats.reg_writes++;
+	CLOCK_CHECK ( address );
+	if ( ( bus = I2C_AT ( address ) ) != NULL ) {
+		CTRL_WRITE ( bus, address - bus->base, value );
+	}
+	else if ( IS_INTC ( address ) ) {
+		INTC_WRITE ( address - INTC_BASE_ADDRESS, value );
+	}
+	else if ( IS_EDMA ( address ) ) {
+		EDMA_WRITE ( address - EDMA_BASE_ADDRESS, value );
+	}
+	else if ( IS_TIMER2 ( address ) ) {
+		TIMER_WRITE ( &timer2, address - TIMER2_BASE_ADDRESS, value );
+	}
+	else if ( IS_GPIO1 ( address ) ) {
+		GPIO_WRITE ( &gpio1, address - GPIO1_BASE_ADDRESS, value );
+	}
+	else if ( ( word = MEMORY_FIND ( address, 1 ) ) != NULL ) {
+		if ( ( clock = CLOCK_AT ( address ) ) >= 0 ) {
+			CLOCK_WRITE ( clock, word, value );
+		}
+		else {
+			word->value = value;
+		}
+	}
+	EDMA_RUN ( );
+	SIM_CHECK_IRQ ( );
+}
+
+void SIM_SPIN ( unsigned int iterations )
+{
+	unsigned long long ns = (unsigned long long) iterations * SIM_SPIN_NS;
+
+	SIM_TICK ( ns );
+	stats.spin_ns += ns;
+	SIM_CHECK_IRQ ( );
+}
+
+/**********************************************************************************************************************
+*   CPU: interrupt mask, WFI and the cycle counter                                                                    *
+**********************************************************************************************************************/
+
+void SIM_SET_IRQ_VECTOR ( void ( *vector ) ( void ) )
+{
+	irq_vector = vector;
+}
+
+unsigned int SIM_IRQ_SAVE ( void )
+{
+	unsigned int state = irq_enabled;
+
+	irq_enabled = 0;
+	return state;
+}
+
+void SIM_IRQ_RESTORE ( unsigned int state )
+{
+	irq_enabled = state;
+	SIM_CHECK_IRQ ( );
+}
+
+//sleep until an interrupt line is pending, the time spent asleep is not CPU time
+void SIM_WFI ( void )
+{
+	unsigned long long next;
+
+	if ( !initialized ) {
+		SIM_RESET ( );
+	}
+	stats.wfis++;
+	while ( INTC_ACTIVE ( ) < 0 ) {
+		next = SIM_NEXT_EVENT_NS ( );
+		if ( next == 0 ) {
+			//nothing in flight can wake the core, return instead of sleeping forever
+			return;
+		}
+		if ( next > stats.now_ns ) {
+			stats.idle_ns += next - stats.now_ns;
+			SIM_ADVANCE ( next );
+		}
+		else {
+			SIM_ADVANCE ( stats.now_ns );
+		}
+	}
+	SIM_CHECK_IRQ ( );
+}
+
+unsigned int SIM_CYCLES ( void )
+{
+	return (unsigned int) ( stats.now_ns * SIM_CPU_MHZ / 1000 );
+}
+
+void SIM_RESET ( void )
+{
+	initialized = 1;
+	memset ( &stats, 0, sizeof ( stats ) );
+	memset ( i2c, 0, sizeof ( i2c ) );
+	memset ( &edma, 0, sizeof ( edma ) );
+	TIMER_RESET ( &timer2 );
+	gpio1.oe = 0xFFFFFFFF;
+	gpio1.dataout = 0;
+	for ( unsigned int i = 0; i < SIM_CLOCKS; i++ ) {
+		clock_ready_ns[i] = SIM_TIMER_NEVER;
+	}
+	dma_regions_used = 0;
+	dma_next_bus = 0;
+	memory_used = 0;
+	time_limit_ns = 0;
+	memset ( intc_mir, 0xFF, sizeof ( intc_mir ) );
+	irq_enabled = 0;
+	in_irq = 0;
+	irq_vector = NULL;
+
+	i2c[0].base = I2C0_BASE_ADDRESS;
+	i2c[1].base = I2C1_BASE_ADDRESS;
+	i2c[2].base = I2C2_BASE_ADDRESS;
+	for ( unsigned int i = 0; i < SIM_I2C_BUSES; i++ ) {
+		i2c[i].sa = 0x3FF;
+		i2c[i].syss = I2C_SYSS_RDONE;
+		i2c[i].raw = I2C_IRQ_BF;
+	}
+	i2c[2].pca_count = 1;
+	PCA_POWER_ON ( &i2c[2].pca[0], PCA9685_ADDRESS );
+}
+
+void SIM_SET_TIME_LIMIT ( unsigned long long limit_ns )
+{
+	time_limit_ns = limit_ns;
+}
+
+/**********************************************************************************************************************
+*   Measurement                                                                                                       *
+**********************************************************************************************************************/
+
+unsigned long long SIM_NOW_NS ( void )
+{
+	return stats.now_ns;
+}
+
+SIM_STATS SIM_GET_STATS ( void )
+{
+	return stats;
+}
+
+SIM_STATS SIM_STATS_DELTA ( const SIM_STATS *after, const SIM_STATS *before )
+{
+	//every field is a running counter, so the delta is a field by field subtraction
+	SIM_STATS delta;
+	const unsigned long long *a = (const unsigned long long *) after;
+	const unsigned long long *b = (const unsigned long long *) before;
+	unsigned long long *d = (unsigned long long *) &delta;
+
+	for ( unsigned int i = 0; i < sizeof ( SIM_STATS ) / sizeof ( unsigned long long ); i++ ) {
+		d[i] = a[i] - b[i];
+	}
+	return delta;
+}
+
+void SIM_PRINT_STATS ( FILE *out, const char *label, const SIM_STATS *s )
+{
+	fprintf ( out, "%s.time_ns %llu\n", label, s->now_ns );
+	fprintf ( out, "%s.cpu_cycles %llu\n", label, s->cpu_ns * SIM_CPU_MHZ / 1000 );
+	fprintf ( out, "%s.spin_cycles %llu\n", label, s->spin_ns * SIM_CPU_MHZ / 1000 );
+	fprintf ( out, "%s.poll_cycles %llu\n", label, s->poll_ns * SIM_CPU_MHZ / 1000 );
+	fprintf ( out, "%s.reg_reads %llu\n", label, s->reg_reads );
+	fprintf ( out, "%s.reg_writes %llu\n", label, s->reg_writes );
+	fprintf ( out, "%s.poll_reads %llu\n", label, s->poll_reads );
+	fprintf ( out, "%s.soft_resets %llu\n", label, s->soft_resets );
+	fprintf ( out, "%s.irqs %llu\n", label, s->irqs );
+	fprintf ( out, "%s.irq_cycles %llu\n", label, s->irq_ns * SIM_CPU_MHZ / 1000 );
+	fprintf ( out, "%s.wfis %llu\n", label, s->wfis );
+	fprintf ( out, "%s.idle_ns %llu\n", label, s->idle_ns );
+	fprintf ( out, "%s.transactions %llu\n", label, s->transactions );
+	fprintf ( out, "%s.starts %llu\n", label, s->starts );
+	fprintf ( out, "%s.stops %llu\n", label, s->stops );
+	fprintf ( out, "%s.bus_bytes %llu\n", label, s->bus_bytes );
+	fprintf ( out, "%s.scl_cycles %llu\n", label, s->scl_cycles );
+	fprintf ( out, "%s.bus_busy_ns %llu\n", label, s->bus_busy_ns );
+	fprintf ( out, "%s.stretch_ns %llu\n", label, s->stretch_ns );
+	fprintf ( out, "%s.nacks %llu\n", label, s->nacks );
+	fprintf ( out, "%s.overspeed_bytes %llu\n", label, s->overspeed_bytes );
+	fprintf ( out, "%s.pca_writes %llu\n", label, s->pca_writes );
+	fprintf ( out, "%s.pca_ignored %llu\n", label, s->pca_ignored );
+	fprintf ( out, "%s.pca_reads %llu\n", label, s->pca_reads );
+	fprintf ( out, "%s.pca_resets %llu\n", label, s->pca_resets );
+	fprintf ( out, "%s.pca_early_restarts %llu\n", label, s->pca_early_restarts );
+	fprintf ( out, "%s.arbitration_lost %llu\n", label, s->arbitration_lost );
+	fprintf ( out, "%s.dma_events %llu\n", label, s->dma_events );
+	fprintf ( out, "%s.dma_bytes %llu\n", label, s->dma_bytes );
+	fprintf ( out, "%s.dma_missed %llu\n", label, s->dma_missed );
+	fprintf ( out, "%s.gpio_reads %llu\n", label, s->gpio_reads );
+	fprintf ( out, "%s.gpio_writes %llu\n", label, s->gpio_writes );
+	fprintf ( out, "%s.gpio_edges %llu\n", label, s->gpio_edges );
+	fprintf ( out, "%s.unclocked %llu\n", label, s->unclocked );
+}
+
+int SIM_ATTACH_PCA ( unsigned int bus_base, unsigned char address )
+{
+	SIM_I2C *bus;
+
+	if ( !initialized ) {
+		SIM_RESET ( );
+	}
+	bus = I2C_AT ( bus_base );
+	if ( bus == NULL || bus->pca_count == SIM_MAX_PCA || PCA_FIND ( bus, address ) ) {
+		return 0;
+	}
+	PCA_POWER_ON ( &bus->pca[bus->pca_count++], address );
+	return 1;
+}
+
+void SIM_INJECT_NACK ( unsigned int bus_base, unsigned int count )
+{
+	SIM_I2C *bus = I2C_AT ( bus_base );
+
+	if ( bus ) {
+		bus->inject_nacks = count;
+	}
+}
+
+void SIM_INJECT_ARBITRATION_LOSS ( unsigned int bus_base, unsigned int count )
+{
+	SIM_I2C *bus = I2C_AT ( bus_base );
+
+	if ( bus ) {
+		bus->inject_al = count;
+	}
+}
+
+//a slave that lost track in the middle of a byte holds SDA low, the bus reads busy
+void SIM_INJECT_SDA_STUCK ( unsigned int bus_base, unsigned int clocks )
+{
+	SIM_I2C *bus = I2C_AT ( bus_base );
+
+	if ( bus && clocks ) {
+		bus->sda_stuck = clocks;
+		bus->raw |= I2C_IRQ_BB;
+		bus->raw &= ~I2C_IRQ_BF;
+	}
+}
+
+void SIM_INJECT_HANG ( unsigned int bus_base )
+{
+	SIM_I2C *bus = I2C_AT ( bus_base );
+
+	if ( bus ) {
+		bus->hung = 1;
+	}
+}
+
+void SIM_INJECT_WEDGE ( unsigned int bus_base, unsigned char address )
+{
+	SIM_PCA9685 *pca = PCA_FIND ( I2C_AT ( bus_base ), address );
+
+	if ( pca ) {
+		pca->wedged = 1;
+	}
+}
+
+unsigned char SIM_BUS_PCA_REG ( unsigned int bus_base, unsigned char address, unsigned char reg )
+{
+	SIM_PCA9685 *pca = PCA_FIND ( I2C_AT ( bus_base ), address );
+
+	return pca ? pca->regs[reg] : 0;
+}
+
+unsigned char SIM_PCA_REG ( unsigned char address, unsigned char reg )
+{
+	return SIM_BUS_PCA_REG ( I2C2_BASE_ADDRESS, address, reg );
+}
+
+unsigned long long SIM_PCA_LATCH_NS ( unsigned char address, unsigned char reg )
+{
+	SIM_PCA9685 *pca = PCA_FIND ( &i2c[2], address );
+
+	return pca ? pca->latch_ns[reg] : 0;
+}
+
+unsigned long long SIM_PCA_PULSE_NS ( unsigned char address, unsigned int channel )
+{
+	SIM_PCA9685 *pca = PCA_FIND ( &i2c[2], address );
+	unsigned long long latched = 0, period_ns, first;
+	unsigned int on, off;
+
+	if ( !pca || channel >= 16 || ( pca->regs[MODE1] & MODE1_SLEEP ) ) {
+		return 0;
+	}
+	on = ( ( pca->regs[LED_ON_H ( channel )] & 0x0F ) << 8 ) | pca->regs[LED_ON_L ( channel )];
+	off = ( ( pca->regs[LED_OFF_H ( channel )] & 0x0F ) << 8 ) | pca->regs[LED_OFF_L ( channel )];
+	if ( ( pca->regs[LED_OFF_H ( channel )] & LED_FULL ) || ( pca->regs[LED_ON_H ( channel )] & LED_FULL ) || on == off ) {
+		return 0;
+	}
+	for ( unsigned int reg = LED_ON_L ( channel ); reg <= LED_OFF_H ( channel ); reg++ ) {
+		if ( pca->latch_ns[reg] > latched ) {
+			latched = pca->latch_ns[reg];
+		}
+	}
+
+	//the counter starts at 0 with the oscillator, a pulse latched later starts with the next period
+	first = pca->osc_ready_ns;
+	if ( latched > first ) {
+		period_ns = 4096ULL * ( pca->regs[PRE_SCALE_SERVO] + 1 ) * 1000000000ULL / pca->osc_hz;
+		first += ( latched - first + period_ns - 1 ) / period_ns * period_ns;
+	}
+	return first + (unsigned long long) on * ( pca->regs[PRE_SCALE_SERVO] + 1 ) * 1000000000ULL / pca->osc_hz;
+}
+
+unsigned long long SIM_PCA_PERIOD_NS ( unsigned char address )
+{
+	SIM_PCA9685 *pca = PCA_FIND ( &i2c[2], address );
+
+	return pca ? 4096ULL * ( pca->regs[PRE_SCALE_SERVO] + 1 ) * 1000000000ULL / pca->osc_hz : 0;
+}
+
+void SIM_SET_PCA_OSC ( unsigned char address, unsigned int hz )
+{
+	SIM_PCA9685 *pca = PCA_FIND ( &i2c[2], address );
+
+	if ( pca && hz ) {
+		pca->osc_hz = hz;
+	}
+}
+
+unsigned int SIM_GPIO1_PINS ( void )
+{
+	return gpio1.dataout & ~gpio1.oe;
+}
@@ -0,0 +1,152 @@
+/**********************************************************************************************************************
+*   Simulated AM335x register backend                                                                                 *
+*                                                                                                                     *
+*   Host side model of the parts of the AM335x the Beaglebone Black programs touch, so the driver can be run and      *
+*   measured on an x86 build box. Building with -DAM335X_SIM routes REG_READ / REG_WRITE (see hwreg.h) here.          *
+*                                                                                                                     *
+*   The I2C0, I2C1 and I2C2 blocks are modelled at the register level (SYSC, SYSS, BUF, CON, SA, CNT, DATA,           *
+*   IRQSTATUS_RAW, IRQSTATUS, PSC, SCLL, SCLH, BUFSTAT) with 32 byte transmit and receive FIFOs and a bus timed from  *
+*   PSC/SCLL/SCLH; the three buses run at the same time. PCA9685 slave models decode the bytes on their bus into      *
+*   their 256 registers and answer to the ALLCALL and subaddresses enabled in MODE1; each has its own oscillator      *
+*   frequency for the PWM timing. Any other address is plain memory. The bus counters in SIM_STATS are summed over    *
+*   the three buses.                                                                                                  *
+*                                                                                                                     *
+*   With TRX clear the controller is a master receiver: the addressed PCA9685 sends its registers from the pointer    *
+*   the write part of the transaction set, RRDY and RDR follow RXTRSH, and SCL is held low while the receive FIFO is  *
+*   full.                                                                                                             *
+*                                                                                                                     *
+*   Faults can be injected per bus (SIM_INJECT_*): NACKed address bytes, arbitration lost to another master, a slave  *
+*   holding SDA low until it has seen a number of SCL clocks, a controller state machine that only a soft reset       *
+*   frees, and a PCA9685 that ignores its addresses until a general call software reset. SYSTEST is modelled in       *
+*   SCL/SDA IO mode so a bus clear can be driven from the CPU.                                                        *
+*                                                                                                                     *
+*   Simulated time only moves when the CPU touches a register or spins, so every status poll has a cost. The counters *
+*   in SIM_STATS record register accesses, CPU time, bus cycles and START/STOP conditions.                            *
+*                                                                                                                     *
+*   The INTC is modelled too: when a module line is asserted and unmasked and the CPU has interrupts enabled, the     *
+*   vector set with SIM_SET_IRQ_VECTOR is called right after the register access that raised it. SIM_WFI sleeps until *
+*   the next module event without charging CPU time.                                                                  *
+*                                                                                                                     *
+*   The EDMA3 channel controller is modelled for the I2C2 transmit DMA request: the event is routed through the       *
+*   control module crossbar, each event runs one AB synchronized transfer from the PaRAM set of the channel, and the  *
+*   completion code raises EDMACOMPINT. The transfers take no simulated time and no CPU time. Buffers in host memory  *
+*   are given a 32 bit bus address with SIM_DMA_MAP (DMA_ADDRESS in hwreg.h).                                         *
+*                                                                                                                     *
+*   DMTimer2 counts on the 24 MHz master oscillator, or the 32 KHz clock if PRCMCLKSEL_TIMER2 selects it, with        *
+*   auto-reload, compare and the overflow and match interrupts on TINT2. Writes are not posted, TWPS always reads 0.  *
+*   The counter stops while the Timer2 CLKCTRL is disabled and counts on from there when it is enabled again.         *
+*                                                                                                                     *
+*   The CM_PER CLKCTRL registers of the modelled modules report IDLEST: disabled while MODULEMODE is off, in          *
+*   transition for SIM_CLOCK_NS after it is enabled, then functional. Accesses to a module before that are counted,   *
+*   and held until the module is functional when its clock is starting.                                               *
+*                                                                                                                     *
+*   GPIO1 has OUTPUT_ENABLE, DATAOUT and its SETDATAOUT / CLEARDATAOUT aliases; the pins driven high can be read back *
+*   with SIM_GPIO1_PINS and SIM_STATS counts the accesses and the output pin changes.                                 *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef SIM_AM335X_H
+#define SIM_AM335X_H
+
+#include <stdio.h>
+
+#define SIM_CPU_MHZ 1000                //Cortex-A8 core clock of the Beaglebone Black
+#define SIM_ACCESS_NS 150               //one uncached L4_PER register access from the core
+#define SIM_SPIN_NS 2                   //one iteration of a NOP delay loop
+#define SIM_IRQ_ENTRY_NS 100            //IRQ exception entry and INTC dispatch before the handler runs
+#define SIM_RESET_NS 2000               //I2C soft reset, counted from the moment the module is enabled
+#define SIM_FCLK_HZ 48000000            //I2C functional clock before the PSC prescaler
+#define SIM_PCA_MAX_SCL_HZ 1000000      //fastest SCL the PCA9685 is specified for (Fm+)
+#define SIM_PCA_OSC_NS 500000           //PCA9685 oscillator start up after SLEEP is cleared
+#define SIM_CLOCK_NS 1000               //CLKCTRL MODULEMODE enable to IDLEST functional
+
+typedef struct {
+	unsigned long long now_ns;          //simulated time
+	unsigned long long cpu_ns;          //time the CPU spent accessing registers or spinning
+	unsigned long long spin_ns;         //part of cpu_ns spent in NOP delay loops
+	unsigned long long reg_reads;
+	unsigned long long reg_writes;
+	unsigned long long poll_reads;      //reads of IRQSTATUS_RAW, IRQSTATUS, SYSS and BUFSTAT
+	unsigned long long poll_ns;
+	unsigned long long soft_resets;     //I2C SYSC soft resets
+	unsigned long long irqs;            //IRQ exceptions taken
+	unsigned long long irq_ns;          //time spent in interrupt handlers, part of cpu_ns
+	unsigned long long wfis;
+	unsigned long long idle_ns;         //time the CPU slept in WFI, not part of cpu_ns
+
+	unsigned long long transactions;    //START conditions that were not repeated starts
+	unsigned long long starts;          //all START conditions, including repeated starts
+	unsigned long long stops;
+	unsigned long long bus_bytes;       //bytes clocked on the bus, including the address byte
+	unsigned long long scl_cycles;
+	unsigned long long bus_busy_ns;     //time between START and the end of STOP
+	unsigned long long stretch_ns;      //time SCL was held low waiting for the transmit FIFO
+	unsigned long long nacks;
+	unsigned long long overspeed_bytes; //bytes clocked faster than the PCA9685 allows
+
+	unsigned long long pca_writes;      //register writes the PCA9685 accepted
+	unsigned long long pca_ignored;     //register writes the PCA9685 dropped (PRE_SCALE while awake, reserved)
+	unsigned long long pca_reads;       //register bytes the PCA9685 sent to a master receiver
+	unsigned long long pca_resets;      //general call software resets taken
+	unsigned long long pca_early_restarts;  //RESTART written before the oscillator was up
+	unsigned long long arbitration_lost;    //address bytes lost to an injected second master
+
+	unsigned long long dma_events;      //EDMA events that ran a transfer
+	unsigned long long dma_bytes;       //bytes the EDMA moved
+	unsigned long long dma_missed;      //events that found a used up (null) PaRAM set
+
+	unsigned long long gpio_reads;      //GPIO1 register reads
+	unsigned long long gpio_writes;
+	unsigned long long gpio_edges;      //output pin changes on GPIO1
+	unsigned long long unclocked;       //accesses to a module before its CLKCTRL IDLEST read functional, see CLOCK_CHECK
+} SIM_STATS;
+
+//simulator control
+void SIM_RESET ( void );                                    //power on state, one PCA9685 at 0x40 on I2C2
+void SIM_SET_TIME_LIMIT ( unsigned long long limit_ns );   //abort when simulated time passes the limit (0 = off)
+
+//register backend used by hwreg.h
+unsigned int SIM_READ ( unsigned int address );
+void SIM_WRITE ( unsigned int address, unsigned int value );
+void SIM_SPIN ( unsigned int iterations );
+unsigned int SIM_DMA_MAP ( const void *buffer, unsigned int length );  //bus address of a host buffer for the EDMA
+
+//CPU core, used through cpu.h
+void SIM_SET_IRQ_VECTOR ( void ( *vector ) ( void ) );
+unsigned int SIM_IRQ_SAVE ( void );
+void SIM_IRQ_RESTORE ( unsigned int state );
+void SIM_WFI ( void );
+unsigned int SIM_CYCLES ( void );
+
+//measurement
+unsigned long long SIM_NOW_NS ( void );
+SIM_STATS SIM_GET_STATS ( void );
+SIM_STATS SIM_STATS_DELTA ( const SIM_STATS *after, const SIM_STATS *before );
+void SIM_PRINT_STATS ( FILE *out, const char *label, const SIM_STATS *stats );
+
+//PCA9685 models: one at 0x40 on I2C2 after SIM_RESET, more can be attached to any of the three buses
+int SIM_ATTACH_PCA ( unsigned int bus_base, unsigned char address );
+unsigned char SIM_BUS_PCA_REG ( unsigned int bus_base, unsigned char address, unsigned char reg );
+unsigned char SIM_PCA_REG ( unsigned char address, unsigned char reg );                 //device on I2C2
+unsigned long long SIM_PCA_LATCH_NS ( unsigned char address, unsigned char reg );   //time the register last latched
+
+//start of the first PWM pulse the channel put out with its present ON / OFF counts, 0 when it puts out none (asleep,
+//FULL_ON, FULL_OFF or ON equal to OFF); device on I2C2
+unsigned long long SIM_PCA_PULSE_NS ( unsigned char address, unsigned int channel );
+
+//PWM period at the present PRE_SCALE, what a scope on an output would measure, and the oscillator frequency that
+//sets it (PCA9685_OSC_HZ after SIM_RESET); device on I2C2
+unsigned long long SIM_PCA_PERIOD_NS ( unsigned char address );
+void SIM_SET_PCA_OSC ( unsigned char address, unsigned int hz );
+
+//GPIO1 pins driven high: DATAOUT of the pins OUTPUT_ENABLE makes outputs
+unsigned int SIM_GPIO1_PINS ( void );
+
+//fault injection on one bus, every fault hits the next transactions until it is used up or cleared
+void SIM_INJECT_NACK ( unsigned int bus_base, unsigned int count );             //count address bytes go unacknowledged
+void SIM_INJECT_ARBITRATION_LOSS ( unsigned int bus_base, unsigned int count ); //count transfers lose the address byte
+void SIM_INJECT_SDA_STUCK ( unsigned int bus_base, unsigned int clocks );       //SDA held low until clocks SCL pulses
+void SIM_INJECT_HANG ( unsigned int bus_base );                                 //state machine stuck until a soft reset
+void SIM_INJECT_WEDGE ( unsigned int bus_base, unsigned char address );         //PCA9685 NACKs until a general call SWRST
+
+#endif
@@ -0,0 +1,212 @@
+/**********************************************************************************************************************
+*   DMTimer2 timer service                                                                                            *
+*                                                                                                                     *
+*   The list is shared with the interrupt handler, so TIMER_START and TIMER_CANCEL mask IRQs while they change it.    *
+*   Writes to TMAR and TCLR are posted to the timer clock domain; TWPS is checked before writing them again.          *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "intc.h"
+#include "timer.h"
+
+TIMER_SERVICE TIMER2_SERVICE = { .base = TIMER2_BASE_ADDRESS, .line = TIMER2_INT };
+
+void TIMER_SERVICE_INIT ( TIMER_SERVICE *service ){
+
+	//module clock from the master oscillator, wait until the module is functional
+	REG_WRITE ( CM_PER_ADDRESS + PRCMCLKSEL_TIMER2, CLKSEL_TIMER_M_OSC );
+	REG_WRITE ( CM_PER_ADDRESS + CM_PER_TIMER2_CLKCTRL, CM_PER_MODULEMODE_ENABLE );
+	while ( REG_READ ( CM_PER_ADDRESS + CM_PER_TIMER2_CLKCTRL ) & CM_PER_IDLEST_MASK );
+
+	REG_WRITE ( service->base + TIOCP_CFG, TIMER_TIOCP_SOFTRESET );
+	while ( REG_READ ( service->base + TIOCP_CFG ) & TIMER_TIOCP_SOFTRESET );
+
+	TIMER_SERVICE_START ( service );
+}
+
+//the module has just come out of its reset, from TIMER_SERVICE_INIT or from BOOT_INIT turning its clock on
+void TIMER_SERVICE_START ( TIMER_SERVICE *service ){
+
+	service->overflows = 0;
+	service->head = 0;
+
+	//free running from 0 with auto-reload of 0, compare always on, TMAR is loaded when a timer is armed
+	REG_WRITE ( service->base + TLDR, 0 );
+	REG_WRITE ( service->base + TCRR, 0 );
+	REG_WRITE ( service->base + IRQSTATUS_TIMER2, TIMER_IRQ_MAT | TIMER_IRQ_OVF | TIMER_IRQ_TCAR );
+	REG_WRITE ( service->base + IRQENABLE_SET_TIMER2, TIMER_IRQ_OVF );
+	while ( REG_READ ( service->base + TWPS ) & ( TIMER_TWPS_TLDR | TIMER_TWPS_TCRR ) );
+	REG_WRITE ( service->base + TCLR, TIMER_TCLR_ST | TIMER_TCLR_AR | TIMER_TCLR_CE );
+
+	if ( service == &TIMER2_SERVICE ) {
+		INTC_REGISTER ( service->line, TIMER2_IRQ_HANDLER );
+	}
+}
+
+//overflow count and TCRR read as one value; an overflow the handler has not seen yet is still pending in RAW
+unsigned long long TIMER_NOW ( TIMER_SERVICE *service ){
+
+	unsigned int state = IRQ_SAVE ( );
+	unsigned int high, low;
+
+	high = service->overflows;
+	low = REG_READ ( service->base + TCRR );
+
+	if ( REG_READ ( service->base + IRQSTATUS_RAW_TIMER2 ) & TIMER_IRQ_OVF ) {
+		//the counter may have wrapped after the TCRR read, read it again on this side of the overflow
+		low = REG_READ ( service->base + TCRR );
+		high++;
+	}
+	IRQ_RESTORE ( state );
+	return ( (unsigned long long) high << 32 ) | low;
+}
+
+//sorted insert, timers with the same deadline fire in the order they were started
+static void TIMER_INSERT ( TIMER_SERVICE *service, TIMER *timer ){
+
+	TIMER **link = &service->head;
+
+	while ( *link && ( *link )->deadline <= timer->deadline ) {
+		link = &( *link )->next;
+		service->insert_steps++;
+	}
+	timer->next = *link;
+	*link = timer;
+	timer->active = 1;
+}
+
+static void TIMER_UNLINK ( TIMER_SERVICE *service, TIMER *timer ){
+
+	TIMER **link = &service->head;
+
+	while ( *link && *link != timer ) {
+		link = &( *link )->next;
+	}
+	if ( *link ) {
+		*link = timer->next;
+	}
+	timer->active = 0;
+}
+
+//run every timer that is due, then load the next deadline into TMAR; IRQs are masked
+static void TIMER_EXPIRE ( TIMER_SERVICE *service ){
+
+	unsigned long long now = TIMER_NOW ( service );
+	unsigned long long late;
+	TIMER *timer;
+
+	for ( ;; ) {
+		while ( ( timer = service->head ) != 0 && timer->deadline <= now ) {
+			service->head = timer->next;
+			timer->active = 0;
+
+			late = now - timer->deadline;
+			service->fired++;
+			service->late_ticks += late;
+			if ( late > service->max_late_ticks ) {
+				service->max_late_ticks = (unsigned int) late;
+			}
+
+			//a periodic timer keeps its phase, whole periods it missed are counted and dropped
+			if ( timer->period ) {
+				timer->deadline += timer->period;
+				while ( timer->deadline <= now ) {
+					timer->deadline += timer->period;
+					service->overruns++;
+				}
+				TIMER_INSERT ( service, timer );
+			}
+			timer->callback ( timer->context );
+		}
+
+		//a deadline past the next overflow is loaded by the overflow interrupt instead
+		if ( !timer || timer->deadline >> 32 != now >> 32 ) {
+			REG_WRITE ( service->base + IRQENABLE_CLR_TIMER2, TIMER_IRQ_MAT );
+			return;
+		}
+		while ( REG_READ ( service->base + TWPS ) & TIMER_TWPS_TMAR );
+		REG_WRITE ( service->base + TMAR, (unsigned int) timer->deadline );
+		REG_WRITE ( service->base + IRQSTATUS_TIMER2, TIMER_IRQ_MAT );
+		REG_WRITE ( service->base + IRQENABLE_SET_TIMER2, TIMER_IRQ_MAT );
+
+		//the counter may have passed TMAR while it was written, then the match will not come
+		now = TIMER_NOW ( service );
+		if ( timer->deadline > now ) {
+			return;
+		}
+	}
+}
+
+void TIMER_START ( TIMER_SERVICE *service, TIMER *timer, unsigned long long delay, unsigned long long period,
+                   TIMER_CALLBACK callback, void *context ){
+
+	unsigned int begin = CYCLE_COUNT ( );
+	unsigned int state = IRQ_SAVE ( );
+
+	if ( timer->active ) {
+		TIMER_UNLINK ( service, timer );
+	}
+	timer->deadline = TIMER_NOW ( service ) + delay;
+	timer->period = period;
+	timer->callback = callback;
+	timer->context = context;
+	TIMER_INSERT ( service, timer );
+	service->started++;
+
+	//only a new earliest deadline changes TMAR
+	if ( service->head == timer ) {
+		TIMER_EXPIRE ( service );
+	}
+	IRQ_RESTORE ( state );
+	service->start_cycles += CYCLE_COUNT ( ) - begin;
+}
+
+void TIMER_CANCEL ( TIMER_SERVICE *service, TIMER *timer ){
+
+	unsigned int state = IRQ_SAVE ( );
+
+	//an early match for a cancelled head finds nothing due and loads the next deadline
+	if ( timer->active ) {
+		TIMER_UNLINK ( service, timer );
+		service->cancelled++;
+	}
+	IRQ_RESTORE ( state );
+}
+
+static void TIMER_WAKE ( void *context ){
+
+	*(volatile unsigned int *) context = 1;
+}
+
+void TIMER_DELAY ( TIMER_SERVICE *service, unsigned long long ticks ){
+
+	TIMER timer = { .active = 0 };
+	volatile unsigned int done = 0;
+
+	TIMER_START ( service, &timer, ticks, 0, TIMER_WAKE, (void *) &done );
+	while ( !done ) {
+		CPU_WAIT_FOR_INTERRUPT ( );
+	}
+}
+
+//overflow: one more epoch, match: a deadline is due
+void TIMER_IRQ ( TIMER_SERVICE *service ){
+
+	unsigned int begin = CYCLE_COUNT ( );
+	unsigned int status = REG_READ ( service->base + IRQSTATUS_TIMER2 );
+
+	REG_WRITE ( service->base + IRQSTATUS_TIMER2, status );
+	if ( status & TIMER_IRQ_OVF ) {
+		service->overflows++;
+	}
+	service->irqs++;
+	TIMER_EXPIRE ( service );
+	service->irq_cycles += CYCLE_COUNT ( ) - begin;
+}
+
+void TIMER2_IRQ_HANDLER ( ){
+
+	TIMER_IRQ ( &TIMER2_SERVICE );
+}
@@ -0,0 +1,73 @@
+/**********************************************************************************************************************
+*   DMTimer2 timer service                                                                                            *
+*                                                                                                                     *
+*   Timer2 is set up once as a free running 32 bit counter on the 24 MHz master oscillator. The overflow interrupt    *
+*   extends it to the 64 bit TIMER_NOW, so a timestamp never wraps. Software timers are kept in a list sorted by      *
+*   deadline and only the earliest one is loaded into TMAR; its match interrupt runs the callbacks that are due and   *
+*   loads the next deadline. Nothing polls the counter, a pending delay costs no CPU time.                            *
+*                                                                                                                     *
+*   A timer is one-shot when its period is 0, otherwise it is re-armed period ticks after its last deadline, so a     *
+*   periodic timer does not drift when a callback runs late. Callbacks run in interrupt context.                      *
+*                                                                                                                     *
+*   The module clock is never gated: the counter would stop with it and TIMER_NOW fall behind the deadlines.          *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "am335x.h"
+
+#define TIMER_HZ 24000000                           //CLK_M_OSC of the Beaglebone Black
+#define TIMER_US(us) ( (unsigned long long) (us) * ( TIMER_HZ / 1000000 ) )
+#define TIMER_MS(ms) ( (unsigned long long) (ms) * ( TIMER_HZ / 1000 ) )
+
+typedef void ( *TIMER_CALLBACK ) ( void *context );
+
+typedef struct TIMER {
+	unsigned long long deadline;        //TIMER_NOW ticks
+	unsigned long long period;          //0 for a one-shot timer
+	TIMER_CALLBACK callback;
+	void *context;
+	struct TIMER *next;
+	volatile unsigned int active;
+} TIMER;
+
+typedef struct {
+	unsigned int base;
+	unsigned int line;                  //INTC line of the module
+	volatile unsigned int overflows;    //upper 32 bits of TIMER_NOW
+	TIMER *head;                        //earliest deadline first
+
+	//statistics
+	unsigned int started;
+	unsigned int cancelled;
+	unsigned int fired;
+	unsigned int overruns;              //periods a periodic timer skipped because it ran too late
+	unsigned int irqs;
+	unsigned int insert_steps;          //list entries walked while inserting
+	unsigned long long late_ticks;      //deadline to callback, summed over fired timers
+	unsigned int max_late_ticks;
+	unsigned long long start_cycles;    //CPU cycles spent in TIMER_START
+	unsigned long long irq_cycles;      //CPU cycles spent in the interrupt handler
+} TIMER_SERVICE;
+
+extern TIMER_SERVICE TIMER2_SERVICE;
+
+void TIMER_SERVICE_INIT ( TIMER_SERVICE *service );  //clock, soft reset, start the counter, unmask the interrupt
+
+//start the counter and unmask the interrupt of a module BOOT_INIT has clocked and BOOT_FINISH found functional
+void TIMER_SERVICE_START ( TIMER_SERVICE *service );
+unsigned long long TIMER_NOW ( TIMER_SERVICE *service );
+
+//arm a timer delay ticks from now, then every period ticks if period is not 0
+void TIMER_START ( TIMER_SERVICE *service, TIMER *timer, unsigned long long delay, unsigned long long period,
+                   TIMER_CALLBACK callback, void *context );
+void TIMER_CANCEL ( TIMER_SERVICE *service, TIMER *timer );
+
+void TIMER_DELAY ( TIMER_SERVICE *service, unsigned long long ticks );  //sleep in WFI until the ticks have passed
+
+void TIMER_IRQ ( TIMER_SERVICE *service );          //service the module, called from its interrupt handler
+void TIMER2_IRQ_HANDLER ( );                        //INTC handler for Timer2
+
+#endif
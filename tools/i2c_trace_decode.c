@@ -0,0 +1,139 @@
+/**********************************************************************************************************************
+*   I2C phase trace decoder                                                                                           *
+*                                                                                                                     *
+*   Host program that reads the binary dumps of I2C_TRACE_DUMP (i2c_trace.h), from a file or stdin, and prints the    *
+*   per phase statistics of every bus in the same "name value" lines as the benchmark: count, min, max and mean in    *
+*   cycles and ns, and the log2 histogram. With -v every entry is printed as well.                                    *
+*                                                                                                                     *
+*   Build and run on the host:                                                                                        *
+*       gcc -std=gnu99 -DAM335X_SIM -I. -o i2c_trace_decode tools/i2c_trace_decode.c && ./i2c_trace_decode trace.bin  *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "i2c_trace.h"
+
+#define BUSES 16
+
+typedef struct {
+	unsigned long long count;
+	unsigned int min;
+	unsigned int max;
+	unsigned long long sum;
+	unsigned long long histogram[I2C_TRACE_BUCKETS];
+} PHASE_STATS;
+
+static PHASE_STATS stats [ BUSES ] [ I2C_TRACE_PHASES ];
+static unsigned int mhz [ BUSES ];
+static unsigned long long dropped [ BUSES ];
+
+static const char *PHASE_NAMES [ I2C_TRACE_PHASES ] = { "reset", "bus_free", "xrdy", "ardy", "rrdy", "spin" };
+
+static unsigned int GET32 ( const unsigned char *in )
+{
+	return in[0] | ( in[1] << 8 ) | ( in[2] << 16 ) | ( (unsigned int) in[3] << 24 );
+}
+
+//one dump block, returns 0 at the end of the input and -1 on a damaged block
+static int DECODE_BLOCK ( FILE *in, int verbose )
+{
+	unsigned char header [ I2C_TRACE_HEADER_BYTES ];
+	unsigned char entry [ I2C_TRACE_ENTRY_BYTES ];
+	unsigned int bus, count, info, phase, cycles;
+	PHASE_STATS *s;
+
+	if ( fread ( header, 1, sizeof ( header ), in ) != sizeof ( header ) ) {
+		return 0;
+	}
+	if ( memcmp ( header, I2C_TRACE_MAGIC, 4 ) != 0 || header[4] != I2C_TRACE_VERSION || header[5] >= BUSES ) {
+		fprintf ( stderr, "not an I2C trace dump (version %u)\n", header[4] );
+		return -1;
+	}
+	bus = header[5];
+	mhz[bus] = header[6] | ( header[7] << 8 );
+	count = GET32 ( header + 8 );
+	dropped[bus] += GET32 ( header + 12 );
+
+	for ( unsigned int i = 0; i < count; i++ ) {
+		if ( fread ( entry, 1, sizeof ( entry ), in ) != sizeof ( entry ) ) {
+			fprintf ( stderr, "dump cut short after %u of %u entries\n", i, count );
+			return -1;
+		}
+		info = GET32 ( entry + 4 );
+		phase = I2C_TRACE_INFO_PHASE ( info );
+		cycles = I2C_TRACE_INFO_CYCLES ( info );
+		if ( phase >= I2C_TRACE_PHASES ) {
+			continue;
+		}
+		if ( verbose ) {
+			printf ( "i2c%u %10u %-8s %u\n", I2C_TRACE_INFO_BUS ( info ), GET32 ( entry ), PHASE_NAMES[phase], cycles );
+		}
+
+		s = &stats[bus][phase];
+		if ( s->count == 0 || cycles < s->min ) {
+			s->min = cycles;
+		}
+		if ( cycles > s->max ) {
+			s->max = cycles;
+		}
+		s->count++;
+		s->sum += cycles;
+		s->histogram[I2C_TRACE_BUCKET ( cycles )]++;
+	}
+	return 1;
+}
+
+int main ( int argc, char **argv )
+{
+	FILE *in = stdin;
+	int verbose = 0;
+	int result;
+	PHASE_STATS *s;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp ( argv[i], "-v" ) == 0 ) {
+			verbose = 1;
+		}
+		else if ( ( in = fopen ( argv[i], "rb" ) ) == NULL ) {
+			perror ( argv[i] );
+			return 1;
+		}
+	}
+
+	while ( ( result = DECODE_BLOCK ( in, verbose ) ) > 0 ) {
+	}
+
+	for ( unsigned int bus = 0; bus < BUSES; bus++ ) {
+		if ( mhz[bus] == 0 ) {
+			continue;
+		}
+		printf ( "i2c%u.dropped %llu\n", bus, dropped[bus] );
+		for ( unsigned int phase = 0; phase < I2C_TRACE_PHASES; phase++ ) {
+			s = &stats[bus][phase];
+			if ( s->count == 0 ) {
+				continue;
+			}
+			printf ( "i2c%u.%s.count %llu\n", bus, PHASE_NAMES[phase], s->count );
+			printf ( "i2c%u.%s.min_cycles %u\n", bus, PHASE_NAMES[phase], s->min );
+			printf ( "i2c%u.%s.max_cycles %u\n", bus, PHASE_NAMES[phase], s->max );
+			printf ( "i2c%u.%s.mean_cycles %llu\n", bus, PHASE_NAMES[phase], s->sum / s->count );
+			printf ( "i2c%u.%s.mean_ns %llu\n", bus, PHASE_NAMES[phase], s->sum * 1000 / s->count / mhz[bus] );
+			for ( unsigned int bucket = 0; bucket < I2C_TRACE_BUCKETS; bucket++ ) {
+				if ( s->histogram[bucket] == 0 ) {
+					continue;
+				}
+				if ( bucket == I2C_TRACE_BUCKETS - 1 ) {
+					printf ( "i2c%u.%s.histogram.ge_%u %llu\n", bus, PHASE_NAMES[phase],
+					         1u << ( I2C_TRACE_BUCKET_SHIFT + bucket - 1 ), s->histogram[bucket] );
+				}
+				else {
+					printf ( "i2c%u.%s.histogram.lt_%u %llu\n", bus, PHASE_NAMES[phase],
+					         1u << ( I2C_TRACE_BUCKET_SHIFT + bucket ), s->histogram[bucket] );
+				}
+			}
+		}
+	}
+	return result < 0;
+}
@@ -0,0 +1,279 @@
+/**********************************************************************************************************************
+*   Servo update benchmark suite                                                                                      *
+*                                                                                                                     *
+*   Host program that puts the same servo updates through each transmit strategy against the simulated AM335x and     *
+*   four PCA9685 boards on I2C2, and prints a fixed set of numbers per strategy and update size (1, 16 and 64         *
+*   channels) as "name value" lines:                                                                                  *
+*                                                                                                                     *
+*       bytes           bus bytes per update, address bytes included                                                  *
+*       starts, stops   START (repeated ones too) and STOP conditions per update                                      *
+*       poll_cycles     CPU cycles per update spent reading status registers                                          *
+*       updates_per_s   updates back to back, in simulated time                                                       *
+*       latency_p50_ns, latency_p99_ns  from the call that issues an update to the last of its registers latching in  *
+*                       the PCA9685, over SUITE_UPDATES updates                                                       *
+*                                                                                                                     *
+*   The strategies are the one of Part 2.c (a transaction per register, each with its soft reset and NOP delays),     *
+*   bursts over a configured session, the register cache, and the cache on the interrupt driven queue. Every update   *
+*   moves every channel it covers, so the cache has no unchanged registers to drop.                                   *
+*                                                                                                                     *
+*   The numbers are then checked against a baseline, the output of an earlier run (tools/servo_suite_baseline.txt     *
+*   unless another file is given): costs may not go up and rates may not go down by more than SUITE_TOLERANCE.        *
+*   Every number past its limit is printed as a "regression" line and the exit status is 1. A change that is meant    *
+*   to move the numbers writes the baseline again with its output.                                                    *
+*                                                                                                                     *
+*   Build and run on the host, from the top of the tree:                                                              *
+*       gcc -std=gnu99 -DAM335X_SIM -I. -o servo_suite tools/servo_suite.c $(ls [a-z]*.c | grep -v benchmark.c)       *
+*       ./servo_suite [baseline.txt]                                                                                  *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hwreg.h"
+#include "am335x.h"
+#include "i2c.h"
+#include "i2c_async.h"
+#include "intc.h"
+#include "pca9685.h"
+#include "pca9685_cache.h"
+
+#define SUITE_BOARDS 4
+#define SUITE_UPDATES 200
+#define SUITE_TOLERANCE 0.02                        //a simulated run is exact, this is room for rounding
+#define SUITE_BASELINE "tools/servo_suite_baseline.txt"
+#define SUITE_MAX_RESULTS 128
+
+#define STRATEGY_PART2 0
+#define STRATEGY_BURST 1
+#define STRATEGY_CACHE 2
+#define STRATEGY_QUEUE 3
+#define STRATEGIES 4
+
+typedef struct {
+	char name[64];
+	double value;
+	int lower_is_better;
+} SUITE_RESULT;
+
+static const char *STRATEGY_NAMES [ STRATEGIES ] = { "part2", "burst", "cache", "queue" };
+static const unsigned int SIZES [ 3 ] = { 1, 16, 64 };
+
+static PCA9685_CACHE caches [ SUITE_BOARDS ];
+static SUITE_RESULT results [ SUITE_MAX_RESULTS ];
+static unsigned int result_count;
+
+static void RECORD ( const char *strategy, unsigned int channels, const char *metric, double value, int lower_is_better )
+{
+	SUITE_RESULT *r = &results[result_count++];
+
+	snprintf ( r->name, sizeof ( r->name ), "suite.%s.%uch.%s", strategy, channels, metric );
+	r->value = value;
+	r->lower_is_better = lower_is_better;
+	printf ( "%s %.1f\n", r->name, value );
+}
+
+static int COMPARE ( const void *a, const void *b )
+{
+	unsigned long long x = *(const unsigned long long *) a, y = *(const unsigned long long *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+//the pulse widths of update k: every channel a different width, all of them moved on by one every update
+static void WIDTHS ( unsigned int k, unsigned short widths[PCA9685_CHANNELS] )
+{
+	for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+		widths[i] = (unsigned short) ( 205 + ( ( i + k ) % PCA9685_CHANNELS ) * 13 );
+	}
+}
+
+//power on state, the boards at 0x40 to 0x43 awake with auto-increment, the strategy's bus set up
+static void SETUP ( unsigned int strategy )
+{
+	static const unsigned int PCA_INIT [ ] = { MODE1, 0xA1, MODE2, 0x04 };
+
+	SIM_RESET ( );
+	for ( unsigned int b = 1; b < SUITE_BOARDS; b++ ) {
+		SIM_ATTACH_PCA ( I2C2_BASE_ADDRESS, (unsigned char) ( PCA9685_ADDRESS + b ) );
+	}
+	I2C2_PINMUX_AND_CLOCK ( );
+	for ( unsigned int b = 0; b < SUITE_BOARDS; b++ ) {
+		I2C2_TRANSMIT_PAIRS ( PCA9685_ADDRESS + b, PCA_INIT, sizeof ( PCA_INIT ) / sizeof ( unsigned int ) );
+	}
+	if ( strategy == STRATEGY_PART2 ) {
+		return;
+	}
+	I2C_INIT ( &I2C2_BUS );
+	if ( strategy == STRATEGY_QUEUE ) {
+		INTC_INIT ( );
+		I2C_QUEUE_INIT ( &I2C2_QUEUE );
+	}
+	for ( unsigned int b = 0; b < SUITE_BOARDS; b++ ) {
+		PCA9685_CACHE_INIT ( &caches[b], &I2C2_BUS, strategy == STRATEGY_QUEUE ? &I2C2_QUEUE : 0, PCA9685_ADDRESS + b );
+		PCA9685_CACHE_WRITE ( &caches[b], MODE1, MODE1_AI | MODE1_ALLCALL );
+		PCA9685_CACHE_WRITE ( &caches[b], MODE2, MODE2_OUTDRV );
+		PCA9685_CACHE_FLUSH ( &caches[b] );
+	}
+	if ( strategy == STRATEGY_QUEUE ) {
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	}
+}
+
+//one update of channels channels, 8 alone or whole boards; returns when every register is in the device
+static void UPDATE ( unsigned int strategy, unsigned int channels, const unsigned short widths[PCA9685_CHANNELS] )
+{
+	unsigned int first = channels == 1 ? 8 : 0;
+	unsigned int count = channels == 1 ? 1 : PCA9685_CHANNELS;
+	unsigned int boards = channels <= PCA9685_CHANNELS ? 1 : channels / PCA9685_CHANNELS;
+	unsigned int pairs [ 2 * 4 * PCA9685_CHANNELS ];
+	unsigned char bytes [ 4 * PCA9685_CHANNELS ];
+	unsigned short frame [ PCA9685_CHANNELS ];
+
+	for ( unsigned int b = 0; b < boards; b++ ) {
+		for ( unsigned int i = 0; i < count; i++ ) {
+			unsigned short width = widths[first + i];
+
+			bytes[4 * i] = bytes[4 * i + 1] = 0x00;
+			bytes[4 * i + 2] = width & 0xFF;
+			bytes[4 * i + 3] = width >> 8;
+		}
+
+		switch ( strategy ) {
+
+		case STRATEGY_PART2:
+			for ( unsigned int i = 0; i < 4 * count; i++ ) {
+				pairs[2 * i] = LED_ON_L ( first ) + i;
+				pairs[2 * i + 1] = bytes[i];
+			}
+			I2C2_TRANSMIT_PAIRS ( PCA9685_ADDRESS + b, pairs, 2 * 4 * count );
+			break;
+
+		case STRATEGY_BURST:
+			PCA9685_WRITE_BURST ( &I2C2_BUS, PCA9685_ADDRESS + b, LED_ON_L ( first ), bytes, 4 * count );
+			break;
+
+		//the cache only sends the channels that changed, the others of the frame keep what the board has
+		default:
+			for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+				frame[i] = caches[b].valid[LED_OFF_L ( i )] && ( i < first || i >= first + count ) ?
+				           (unsigned short) ( caches[b].regs[LED_OFF_L ( i )] | ( caches[b].regs[LED_OFF_H ( i )] << 8 ) ) :
+				           widths[i];
+			}
+			PCA9685_CACHE_WRITE_FRAME ( &caches[b], frame );
+			break;
+		}
+	}
+	if ( strategy == STRATEGY_QUEUE ) {
+		I2C_QUEUE_FLUSH ( &I2C2_QUEUE );
+	}
+}
+
+//command to the last register of the update latching, in ns
+static unsigned long long LATENCY ( unsigned int channels, unsigned long long issued )
+{
+	unsigned int boards = channels <= PCA9685_CHANNELS ? 1 : channels / PCA9685_CHANNELS;
+	unsigned int first = channels == 1 ? 8 : 0;
+	unsigned int count = channels == 1 ? 1 : PCA9685_CHANNELS;
+	unsigned long long last = issued, latch;
+
+	for ( unsigned int b = 0; b < boards; b++ ) {
+		for ( unsigned int reg = LED_ON_L ( first ); reg <= LED_OFF_H ( first + count - 1 ); reg++ ) {
+			latch = SIM_PCA_LATCH_NS ( (unsigned char) ( PCA9685_ADDRESS + b ), (unsigned char) reg );
+			if ( latch > last ) {
+				last = latch;
+			}
+		}
+	}
+	return last - issued;
+}
+
+static void RUN ( unsigned int strategy, unsigned int channels )
+{
+	static unsigned long long latency [ SUITE_UPDATES ];
+	const char *name = STRATEGY_NAMES[strategy];
+	unsigned short widths [ PCA9685_CHANNELS ];
+	unsigned long long issued;
+	SIM_STATS before, after, delta;
+
+	SETUP ( strategy );
+	before = SIM_GET_STATS ( );
+	for ( unsigned int k = 0; k < SUITE_UPDATES; k++ ) {
+		WIDTHS ( k + 1, widths );
+		issued = SIM_NOW_NS ( );
+		UPDATE ( strategy, channels, widths );
+		latency[k] = LATENCY ( channels, issued );
+	}
+	after = SIM_GET_STATS ( );
+	delta = SIM_STATS_DELTA ( &after, &before );
+	qsort ( latency, SUITE_UPDATES, sizeof ( latency[0] ), COMPARE );
+
+	RECORD ( name, channels, "bytes", (double) delta.bus_bytes / SUITE_UPDATES, 1 );
+	RECORD ( name, channels, "starts", (double) delta.starts / SUITE_UPDATES, 1 );
+	RECORD ( name, channels, "stops", (double) delta.stops / SUITE_UPDATES, 1 );
+	RECORD ( name, channels, "poll_cycles", (double) delta.poll_ns * SIM_CPU_MHZ / 1000 / SUITE_UPDATES, 1 );
+	RECORD ( name, channels, "updates_per_s", SUITE_UPDATES * 1e9 / delta.now_ns, 0 );
+	RECORD ( name, channels, "latency_p50_ns", (double) latency[SUITE_UPDATES / 2 - 1], 1 );
+	RECORD ( name, channels, "latency_p99_ns", (double) latency[SUITE_UPDATES * 99 / 100 - 1], 1 );
+}
+
+//a number past its limit, printed
+static int REGRESSED ( const SUITE_RESULT *r, double limit )
+{
+	if ( r->lower_is_better ? r->value <= limit : r->value >= limit ) {
+		return 0;
+	}
+	printf ( "regression %s %.1f limit %.1f\n", r->name, r->value, limit );
+	return 1;
+}
+
+//the numbers against a baseline file of "name value" lines, -1 when it cannot be read
+static int CHECK_BASELINE ( const char *path )
+{
+	char name [ 64 ];
+	double value;
+	unsigned int regressions = 0, found = 0;
+	FILE *in = fopen ( path, "r" );
+
+	if ( in == NULL ) {
+		perror ( path );
+		return -1;
+	}
+	while ( fscanf ( in, "%63s %lf%*[^\n]", name, &value ) == 2 ) {
+		for ( unsigned int i = 0; i < result_count; i++ ) {
+			if ( strcmp ( results[i].name, name ) == 0 ) {
+				found++;
+				regressions += REGRESSED ( &results[i], value * ( results[i].lower_is_better ? 1 + SUITE_TOLERANCE : 1 - SUITE_TOLERANCE ) );
+			}
+		}
+	}
+	fclose ( in );
+	printf ( "suite.checked %u\n", found );
+	if ( found == 0 ) {
+		fprintf ( stderr, "%s: no baseline numbers\n", path );
+		return -1;
+	}
+	return (int) regressions;
+}
+
+int main ( int argc, char **argv )
+{
+	int regressions;
+
+	SIM_RESET ( );
+	SIM_SET_TIME_LIMIT ( 100000000000ULL );
+
+	for ( unsigned int strategy = 0; strategy < STRATEGIES; strategy++ ) {
+		for ( unsigned int size = 0; size < 3; size++ ) {
+			RUN ( strategy, SIZES[size] );
+		}
+	}
+
+	regressions = CHECK_BASELINE ( argc > 1 ? argv[1] : SUITE_BASELINE );
+	if ( regressions < 0 ) {
+		return 1;
+	}
+	printf ( "suite.regressions %d\n", regressions );
+	return regressions != 0;
+}
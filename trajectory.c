@@ -0,0 +1,313 @@
+/**********************************************************************************************************************
+*   Servo trajectory streamer                                                                                         *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#include "hwreg.h"
+#include "cpu.h"
+#include "trajectory.h"
+
+#define Q16(x) ( (long long) (x) << 16 )
+
+void TRAJECTORY_INIT ( TRAJECTORY *trajectory, PCA9685_CACHE *cache, const SERVO_MAP *map, unsigned char prescale ){
+
+	TRAJECTORY_CHANNEL *channel;
+
+	trajectory->cache = cache;
+	trajectory->map = map;
+
+	//4096 counts of ( PRE_SCALE + 1 ) oscillator clocks
+	trajectory->period_us = (unsigned int) ( 4096ULL * ( prescale + 1 ) * 1000000 / map->osc_hz );
+	trajectory->period_cycles = trajectory->period_us * CPU_MHZ;
+
+	for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+		channel = &trajectory->channel[i];
+		channel->position = channel->velocity = 0;
+		channel->head = channel->count = channel->moving = 0;
+		TRAJECTORY_PROFILE ( trajectory, i, TRAJECTORY_VELOCITY, TRAJECTORY_ACCELERATION );
+		trajectory->setpoint[0].angle[i] = trajectory->setpoint[1].angle[i] = 0;
+	}
+	trajectory->front = 0;
+	trajectory->fresh = 1;
+	trajectory->started = 0;
+	trajectory->steps = trajectory->frames = trajectory->repeats = trajectory->missed = 0;
+	trajectory->jitter_min = ~0u;
+	trajectory->jitter_max = 0;
+	trajectory->jitter_sum = 0;
+	trajectory->timers = 0;
+	trajectory->frame_timer.active = 0;
+	trajectory->waiter = 0;
+}
+
+void TRAJECTORY_PROFILE ( TRAJECTORY *trajectory, unsigned int channel, unsigned int velocity, unsigned int acceleration ){
+
+	unsigned long long period_us = trajectory->period_us;
+
+	if ( channel >= PCA9685_CHANNELS ) {
+		return;
+	}
+	trajectory->channel[channel].max_velocity = (long long) ( Q16 ( velocity ) * period_us / 1000000 );
+	trajectory->channel[channel].acceleration = (long long) ( Q16 ( acceleration ) * period_us * period_us / 1000000000000ULL );
+	if ( trajectory->channel[channel].acceleration == 0 ) {
+		trajectory->channel[channel].acceleration = 1;
+	}
+}
+
+void TRAJECTORY_SET_PRESCALE ( TRAJECTORY *trajectory, unsigned char prescale ){
+
+	unsigned long long from = trajectory->period_us;
+	unsigned long long to = 4096ULL * ( prescale + 1 ) * 1000000 / trajectory->map->osc_hz;
+	TRAJECTORY_CHANNEL *channel;
+
+	//the limits and the speed are per period, so they follow it: velocity by the ratio, acceleration by its square
+	for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+		channel = &trajectory->channel[i];
+		channel->velocity = (long long) ( channel->velocity * (long long) to / (long long) from );
+		channel->max_velocity = (long long) ( channel->max_velocity * (long long) to / (long long) from );
+		channel->acceleration = (long long) ( channel->acceleration * (long long) ( to * to ) / (long long) ( from * from ) );
+		if ( channel->acceleration == 0 ) {
+			channel->acceleration = 1;
+		}
+	}
+	trajectory->period_us = (unsigned int) to;
+	trajectory->period_cycles = trajectory->period_us * CPU_MHZ;
+
+	//a running stream gets its frame timer on the new period
+	if ( trajectory->timers && trajectory->frame_timer.active ) {
+		TIMER_CANCEL ( trajectory->timers, &trajectory->frame_timer );
+		TIMER_START ( trajectory->timers, &trajectory->frame_timer, TIMER_US ( trajectory->period_us ),
+		              TIMER_US ( trajectory->period_us ), SCHED_WAKE, &trajectory->frame_task );
+	}
+}
+
+int TRAJECTORY_WAYPOINT ( TRAJECTORY *trajectory, unsigned int channel, int angle ){
+
+	TRAJECTORY_CHANNEL *c;
+
+	if ( channel >= PCA9685_CHANNELS ) {
+		return 0;
+	}
+	c = &trajectory->channel[channel];
+	if ( c->count == TRAJECTORY_WAYPOINTS ) {
+		return 0;
+	}
+	if ( angle < SERVO_ANGLE_MIN ) {
+		angle = SERVO_ANGLE_MIN;
+	}
+	else if ( angle > SERVO_ANGLE_MAX ) {
+		angle = SERVO_ANGLE_MAX;
+	}
+	c->waypoints[( c->head + c->count ) % TRAJECTORY_WAYPOINTS] = angle;
+	c->count++;
+	c->moving = 1;
+	return 1;
+}
+
+int TRAJECTORY_IDLE ( const TRAJECTORY *trajectory ){
+
+	for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+		if ( trajectory->channel[i].moving ) {
+			return 0;
+		}
+	}
+	return !trajectory->fresh;
+}
+
+//one period of the trapezoidal profile towards the channel's next waypoint
+static void TRAJECTORY_ADVANCE ( TRAJECTORY_CHANNEL *c ){
+
+	long long target, distance, remaining;
+	long long v = c->velocity;
+	long long a = c->acceleration;
+	int direction;
+
+	if ( c->count == 0 ) {
+		c->moving = 0;
+		return;
+	}
+
+	target = Q16 ( c->waypoints[c->head] );
+	distance = target - c->position;
+	direction = distance > 0 ? 1 : -1;
+
+	//brake when the distance left is what it takes to stop, v^2 / 2a, compared without dividing
+	if ( distance != 0 && v * v >= 2 * a * ( distance > 0 ? distance : -distance ) && ( v > 0 ) == ( distance > 0 ) ) {
+		v -= v > 0 ? a : -a;
+	}
+	else if ( ( v > 0 ? v : -v ) < c->max_velocity || ( v > 0 ) != ( distance > 0 ) ) {
+		v += direction * a;
+		if ( v > c->max_velocity ) {
+			v = c->max_velocity;
+		}
+		else if ( v < -c->max_velocity ) {
+			v = -c->max_velocity;
+		}
+	}
+	c->position += v;
+
+	//passing the waypoint or crawling onto it ends the segment there
+	remaining = target - c->position;
+	if ( distance == 0 || ( remaining > 0 ) != ( distance > 0 ) || remaining == 0
+	     || ( ( remaining > 0 ? remaining : -remaining ) < a && ( v > 0 ? v : -v ) <= a ) ) {
+		c->position = target;
+		v = 0;
+		c->head = ( c->head + 1 ) % TRAJECTORY_WAYPOINTS;
+		c->count--;
+	}
+	c->velocity = v;
+}
+
+TRAJECTORY_SETPOINT *TRAJECTORY_BACK ( TRAJECTORY *trajectory ){
+
+	return &trajectory->setpoint[trajectory->front ^ 1];
+}
+
+//the writer may run from an interrupt, so the swap is the only place the two sides meet
+void TRAJECTORY_PUBLISH ( TRAJECTORY *trajectory ){
+
+	unsigned int state = IRQ_SAVE ( );
+
+	trajectory->front ^= 1;
+	trajectory->fresh = 1;
+	IRQ_RESTORE ( state );
+	trajectory->steps++;
+}
+
+void TRAJECTORY_STEP ( TRAJECTORY *trajectory ){
+
+	TRAJECTORY_SETPOINT *back = TRAJECTORY_BACK ( trajectory );
+
+	for ( unsigned int i = 0; i < PCA9685_CHANNELS; i++ ) {
+		TRAJECTORY_ADVANCE ( &trajectory->channel[i] );
+		back->angle[i] = (int) ( ( trajectory->channel[i].position + 0x8000 ) >> 16 );
+	}
+	TRAJECTORY_PUBLISH ( trajectory );
+}
+
+int TRAJECTORY_FRAME ( TRAJECTORY *trajectory ){
+
+	unsigned short widths [ PCA9685_CHANNELS ];
+	const TRAJECTORY_SETPOINT *front = &trajectory->setpoint[trajectory->front];
+	int result;
+
+	if ( trajectory->fresh ) {
+		trajectory->fresh = 0;
+	}
+	else {
+		trajectory->repeats++;
+	}
+
+	SERVO_FRAME ( trajectory->map, front->angle, widths );
+	result = PCA9685_CACHE_WRITE_FRAME ( trajectory->cache, widths );
+	if ( result != I2C_OK ) {
+		trajectory->missed++;
+		return result;
+	}
+	trajectory->frames++;
+	return I2C_OK;
+}
+
+static void TRAJECTORY_JITTER ( TRAJECTORY *trajectory, unsigned int late ){
+
+	if ( late < trajectory->jitter_min ) {
+		trajectory->jitter_min = late;
+	}
+	if ( late > trajectory->jitter_max ) {
+		trajectory->jitter_max = late;
+	}
+	trajectory->jitter_sum += late;
+}
+
+int TRAJECTORY_POLL ( TRAJECTORY *trajectory, unsigned int now ){
+
+	unsigned int late;
+
+	if ( !trajectory->started ) {
+		trajectory->started = 1;
+		trajectory->next_due = now;
+	}
+
+	//the slot has not come yet, the unsigned difference copes with the counter wrapping
+	late = now - trajectory->next_due;
+	if ( late >= 0x80000000u ) {
+		return 0;
+	}
+
+	//slots that passed completely are lost, the frame goes in the current one
+	while ( late >= trajectory->period_cycles ) {
+		trajectory->missed++;
+		trajectory->next_due += trajectory->period_cycles;
+		late -= trajectory->period_cycles;
+	}
+	trajectory->next_due += trajectory->period_cycles;
+
+	TRAJECTORY_JITTER ( trajectory, late );
+	TRAJECTORY_FRAME ( trajectory );
+	return 1;
+}
+
+void TRAJECTORY_RUN ( TRAJECTORY *trajectory ){
+
+	while ( !TRAJECTORY_IDLE ( trajectory ) ) {
+
+		//keep one setpoint ready ahead of the writer
+		if ( !trajectory->fresh ) {
+			TRAJECTORY_STEP ( trajectory );
+		}
+		if ( !TRAJECTORY_POLL ( trajectory, CYCLE_COUNT ( ) ) ) {
+			CPU_SPIN ( TRAJECTORY_POLL_SPIN );
+		}
+	}
+}
+
+//writer task, posted by the frame timer once per PWM period
+static void TRAJECTORY_FRAME_TASK ( void *context ){
+
+	TRAJECTORY *trajectory = context;
+	TIMER *timer = &trajectory->frame_timer;
+	unsigned long long late = TIMER_NOW ( trajectory->timers ) - ( timer->deadline - timer->period );
+
+	//the timer already moved on to its next deadline, periods it skipped are lost frames
+	trajectory->missed += (unsigned int) ( late / timer->period );
+	TRAJECTORY_JITTER ( trajectory, (unsigned int) ( late % timer->period * CPU_MHZ / ( TIMER_HZ / 1000000 ) ) );
+	TRAJECTORY_FRAME ( trajectory );
+	SCHED_POST ( &trajectory->step_task );
+}
+
+//producer task, the next setpoint is ready long before the next period
+static void TRAJECTORY_STEP_TASK ( void *context ){
+
+	TRAJECTORY *trajectory = context;
+	SCHED_TASK *waiter;
+
+	if ( !TRAJECTORY_IDLE ( trajectory ) ) {
+		if ( !trajectory->fresh ) {
+			TRAJECTORY_STEP ( trajectory );
+		}
+		return;
+	}
+	if ( ( waiter = trajectory->waiter ) != 0 ) {
+		trajectory->waiter = 0;
+		SCHED_POST ( waiter );
+	}
+}
+
+void TRAJECTORY_STREAM ( TRAJECTORY *trajectory, SCHEDULER *scheduler, TIMER_SERVICE *timers ){
+
+	trajectory->timers = timers;
+	SCHED_TASK_INIT ( &trajectory->frame_task, scheduler, TRAJECTORY_FRAME_TASK, trajectory );
+	SCHED_TASK_INIT ( &trajectory->step_task, scheduler, TRAJECTORY_STEP_TASK, trajectory );
+	SCHED_POST ( &trajectory->step_task );
+	TIMER_START ( timers, &trajectory->frame_timer, 0, TIMER_US ( trajectory->period_us ), SCHED_WAKE, &trajectory->frame_task );
+}
+
+void TRAJECTORY_STREAM_STOP ( TRAJECTORY *trajectory ){
+
+	TIMER_CANCEL ( trajectory->timers, &trajectory->frame_timer );
+}
+
+void TRAJECTORY_NOTIFY ( TRAJECTORY *trajectory, SCHED_TASK *task ){
+
+	trajectory->waiter = task;
+	SCHED_POST ( &trajectory->step_task );
+}
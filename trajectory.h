@@ -0,0 +1,113 @@
+/**********************************************************************************************************************
+*   Servo trajectory streamer                                                                                         *
+*                                                                                                                     *
+*   Moves the 16 servos smoothly instead of jumping them to the next position. Every channel has a queue of           *
+*   waypoints and a velocity / acceleration limit. TRAJECTORY_STEP advances each channel by one PWM period on a       *
+*   trapezoidal profile and publishes the angles of all channels as one setpoint.                                     *
+*                                                                                                                     *
+*   Setpoints are double buffered. The producer fills the back buffer and TRAJECTORY_PUBLISH swaps it to the front    *
+*   with IRQs masked for two stores, so the writer never waits for the producer. The writer, TRAJECTORY_FRAME, runs   *
+*   once per PWM period: it takes the front buffer and sends it as one frame through the register cache. With no      *
+*   new setpoint it sends the last one again, which the cache turns into no bus traffic.                              *
+*                                                                                                                     *
+*   TRAJECTORY_POLL schedules the writer from the cycle counter, one frame per PWM period of the configured           *
+*   PRE_SCALE (20 ms at 0x79, 3 ms at 333 Hz). The lateness of each frame against its slot is the jitter. Periods     *
+*   that passed without a frame, or frames the bus queue could not take, are missed frames.                           *
+*                                                                                                                     *
+*   TRAJECTORY_STREAM runs the same two sides as scheduler tasks instead: a periodic Timer2 timer posts the writer    *
+*   once per PWM period, the writer posts the producer, and the producer computes the next setpoint while the frame   *
+*   is still on the bus. The lateness of the writer against the timer deadline is the jitter.                         *
+*                                                                                                                     *
+**********************************************************************************************************************/
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include "servo.h"
+#include "scheduler.h"
+#include "timer.h"
+
+#define TRAJECTORY_WAYPOINTS 8                      //waypoints queued per channel
+#define TRAJECTORY_VELOCITY 3000                    //default limit, tenths of a degree per second
+#define TRAJECTORY_ACCELERATION 20000               //default limit, tenths of a degree per second squared
+#define TRAJECTORY_POLL_SPIN 10000                  //NOP iterations between two polls in TRAJECTORY_RUN
+
+typedef struct {
+	int angle[PCA9685_CHANNELS];        //tenths of a degree
+} TRAJECTORY_SETPOINT;
+
+typedef struct {
+	long long position;                 //tenths of a degree, Q16
+	long long velocity;                 //per period, Q16
+	long long max_velocity;             //per period, Q16
+	long long acceleration;             //per period squared, Q16
+	int waypoints[TRAJECTORY_WAYPOINTS];
+	unsigned int head;
+	unsigned int count;
+	unsigned int moving;
+} TRAJECTORY_CHANNEL;
+
+typedef struct {
+	PCA9685_CACHE *cache;
+	const SERVO_MAP *map;
+	unsigned int period_us;             //PWM period of the PRE_SCALE
+	unsigned int period_cycles;
+
+	TRAJECTORY_CHANNEL channel[PCA9685_CHANNELS];
+	TRAJECTORY_SETPOINT setpoint[2];
+	volatile unsigned int front;        //setpoint the writer reads
+	volatile unsigned int fresh;        //a setpoint was published since the last frame
+
+	unsigned int started;
+	unsigned int next_due;              //cycle count of the next frame slot
+
+	//streaming from scheduler tasks
+	TIMER_SERVICE *timers;
+	TIMER frame_timer;
+	SCHED_TASK frame_task;
+	SCHED_TASK step_task;
+	SCHED_TASK *waiter;                 //posted when every channel has reached its last waypoint
+
+	//statistics
+	unsigned int steps;                 //setpoints published
+	unsigned int frames;                //frames sent
+	unsigned int repeats;               //frames with no new setpoint
+	unsigned int missed;                //PWM periods without a frame
+	unsigned int jitter_min;            //lateness against the frame slot, cycles
+	unsigned int jitter_max;
+	unsigned long long jitter_sum;
+} TRAJECTORY;
+
+//all channels at 0 degrees with the default limits, frames on the PWM period of the PRE_SCALE
+void TRAJECTORY_INIT ( TRAJECTORY *trajectory, PCA9685_CACHE *cache, const SERVO_MAP *map, unsigned char prescale );
+
+//the PWM period changed (the map must already be on the new PRE_SCALE): the limits keep their meaning per second
+//and a running stream is timed on the new period
+void TRAJECTORY_SET_PRESCALE ( TRAJECTORY *trajectory, unsigned char prescale );
+
+//limits of one channel, tenths of a degree per second and per second squared
+void TRAJECTORY_PROFILE ( TRAJECTORY *trajectory, unsigned int channel, unsigned int velocity, unsigned int acceleration );
+
+//queue a position for one channel, returns 0 when its queue is full
+int TRAJECTORY_WAYPOINT ( TRAJECTORY *trajectory, unsigned int channel, int angle );
+
+int TRAJECTORY_IDLE ( const TRAJECTORY *trajectory );        //every channel stopped on its last waypoint
+
+//producer side: advance every channel one period and publish, or fill the back buffer and publish by hand
+void TRAJECTORY_STEP ( TRAJECTORY *trajectory );
+TRAJECTORY_SETPOINT *TRAJECTORY_BACK ( TRAJECTORY *trajectory );
+void TRAJECTORY_PUBLISH ( TRAJECTORY *trajectory );
+
+//writer side: one frame from the front buffer, and the scheduler that calls it once per PWM period
+int TRAJECTORY_FRAME ( TRAJECTORY *trajectory );
+int TRAJECTORY_POLL ( TRAJECTORY *trajectory, unsigned int now );
+
+//step and stream until every channel has reached its last waypoint
+void TRAJECTORY_RUN ( TRAJECTORY *trajectory );
+
+//stream from tasks of the scheduler, frames timed by the timer service, until TRAJECTORY_STREAM_STOP
+void TRAJECTORY_STREAM ( TRAJECTORY *trajectory, SCHEDULER *scheduler, TIMER_SERVICE *timers );
+void TRAJECTORY_STREAM_STOP ( TRAJECTORY *trajectory );
+void TRAJECTORY_NOTIFY ( TRAJECTORY *trajectory, SCHED_TASK *task );   //post task once the moves are done
+
+#endif